@@ -16,6 +16,8 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/tcp-header.h"
 #include "ns3/traffic-control-module.h"
+#include "short-flow-workload.h"
+#include "ts-store.h"
 #include <fstream>
 #include  <string>
 
@@ -25,12 +27,20 @@ NS_LOG_COMPONENT_DEFINE ("BlueTests");
 
 std::stringstream filePlotQueue;
 
+aqm::TsWriter tsWriter;         // optional compressed copy of the plotme series
+uint32_t tsQueue;
+
 uint32_t i = 0;
 
+double sumQueueDelay = 0;       // sojourn times sampled with the queue size
+uint32_t nQueueDelay = 0;
+
 void
 CheckQueueSize (Ptr<QueueDisc> queue)
 {
   uint32_t qSize = StaticCast<BlueQueueDisc> (queue)->GetQueueSize ();
+  sumQueueDelay += StaticCast<BlueQueueDisc> (queue)->GetQueueDelay ().GetSeconds ();
+  nQueueDelay++;
 
   // check queue size every 1/100 of a second
   Simulator::Schedule (Seconds (0.1), &CheckQueueSize, queue);
@@ -38,6 +48,11 @@ CheckQueueSize (Ptr<QueueDisc> queue)
   std::ofstream fPlotQueue (filePlotQueue.str ().c_str (), std::ios::out | std::ios::app);
   fPlotQueue << Simulator::Now ().GetSeconds () << " " << qSize << std::endl;
   fPlotQueue.close ();
+
+  if (tsWriter.IsOpen ())
+    {
+      tsWriter.Append (tsQueue, Simulator::Now ().GetSeconds (), qSize);
+    }
 }
 
 int main (int argc, char *argv[])
@@ -52,8 +67,21 @@ int main (int argc, char *argv[])
 
   float stopTime = startTime + simDuration;
 
+  double shortFlowRate = 0;     // short TCP transfers per second, 0 disables them
+  double shortFlowMeanSize = 50000;
+  double shortFlowShape = 1.2;
+  double shortFlowMaxSize = 1e7;
+  std::string tsStore = "";     // time-series store file, empty disables it
+  std::string telemetry = "";   // shared-memory telemetry segment, empty disables it
+
   CommandLine cmd;
-  cmd.Parse (argc,argv);
+  cmd.AddValue ("shortFlowRate", "Arrivals per second of short TCP transfers (0 disables them)", shortFlowRate);
+  cmd.AddValue ("shortFlowMeanSize", "Mean size of the Pareto short transfers in bytes", shortFlowMeanSize);
+  cmd.AddValue ("shortFlowShape", "Shape of the Pareto short transfers", shortFlowShape);
+  cmd.AddValue ("shortFlowMaxSize", "Largest Pareto short transfer in bytes", shortFlowMaxSize);
+  cmd.AddValue ("tsStore", "Also write the queue series into this time-series store", tsStore);
+  cmd.AddValue ("telemetry", "Publish live queue samples in this shared-memory segment (see tools/telemetry)", telemetry);
+  cmd.AddValue ("simDuration", "Simulation duration in seconds", simDuration);
 
   LogComponentEnable ("BlueQueueDisc", LOG_LEVEL_INFO);
 
@@ -85,6 +113,12 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::BlueQueueDisc::FreezeTime", TimeValue (Seconds(0.1)));
   Config::SetDefault ("ns3::BlueQueueDisc::Increment", DoubleValue (0.0025));
   Config::SetDefault ("ns3::BlueQueueDisc::Decrement", DoubleValue (0.00025));
+  Config::SetDefault ("ns3::BlueQueueDisc::LinkBandwidth", StringValue (bottleneckBandwidth));
+
+  // Parse after the defaults above, so that --ns3::<TypeId>::<Attribute>=<value>
+  // on the command line overrides them
+  cmd.Parse (argc,argv);
+  stopTime = startTime + simDuration;
 
   NS_LOG_INFO ("Install internet stack on all nodes.");
   InternetStackHelper internet;
@@ -173,14 +207,38 @@ int main (int argc, char *argv[])
 
     }
 
+  FctRecorder fct;
+  ShortFlowWorkload shortFlows (source, sink.Get (0), interfaces_sink.GetAddress (1), 50002, &fct);
+  if (shortFlowRate > 0)
+    {
+      shortFlows.SetArrivalRate (shortFlowRate);
+      shortFlows.SetParetoSizes (shortFlowMeanSize, shortFlowShape, shortFlowMaxSize);
+      shortFlows.Install (Seconds (1), Seconds (stopTime - 1));
+    }
+
   if (writeForPlot)
     {
       filePlotQueue << pathOut << "/" << "blue-queue.plotme";
       remove (filePlotQueue.str ().c_str ());
+      if (!tsStore.empty ())
+        {
+          tsWriter.Open (tsStore);
+          tsQueue = tsWriter.BeginSeries (RngSeedManager::GetRun (), "queue");
+        }
       Ptr<QueueDisc> queue = queueDiscs.Get (0);
       Simulator::ScheduleNow (&CheckQueueSize, queue);
     }
 
+  Ptr<AqmTelemetry> telemetryPublisher;
+  if (!telemetry.empty ())
+    {
+      telemetryPublisher = CreateObject<AqmTelemetry> ();
+      telemetryPublisher->SetAttribute ("SegmentName", StringValue (telemetry));
+      Ptr<BlueQueueDisc> blue = StaticCast<BlueQueueDisc> (queueDiscs.Get (0));
+      telemetryPublisher->Watch (blue, "bottleneck", MakeCallback (&BlueQueueDisc::GetPmark, blue), &blue->GetAqmStats ());
+      telemetryPublisher->Start ();
+    }
+
   if (isPcapEnabled)
     {
       bottleneckLink.EnablePcap (pcapFileName, gateway, false);
@@ -194,6 +252,11 @@ int main (int argc, char *argv[])
 
   Simulator::Stop (Seconds (stopTime));
   Simulator::Run ();
+  tsWriter.Close ();
+  if (telemetryPublisher)
+    {
+      telemetryPublisher->Stop ();
+    }
 
   if (printBlueStats)
     {
@@ -203,6 +266,36 @@ int main (int argc, char *argv[])
       std::cout << "\t " << st.forcedDrop << " drops due queue full" << std::endl;
     }
 
+  if (nQueueDelay > 0)
+    {
+      std::cout << "summary meanQueueDelay " << sumQueueDelay / nQueueDelay << std::endl;
+    }
+
+  // --ns3::BlueQueueDisc::FixedPointShadow=true: how far the fixed-point
+  // controller drifted from the double one
+  Ptr<BlueQueueDisc> bottleneck = StaticCast<BlueQueueDisc> (queueDiscs.Get (0));
+  BooleanValue shadow;
+  bottleneck->GetAttribute ("FixedPointShadow", shadow);
+  if (shadow.Get ())
+    {
+      const aqm::AqmFixedDivergence &d = bottleneck->GetFixedPointDivergence ();
+      std::cout << "summary fixedPoint.updates " << d.updates << std::endl;
+      std::cout << "summary fixedPoint.maxError " << d.maxError << std::endl;
+      std::cout << "summary fixedPoint.meanError " << (d.updates ? d.sumError / d.updates : 0) << std::endl;
+      std::cout << "summary fixedPoint.decisions " << d.decisions << std::endl;
+      std::cout << "summary fixedPoint.disagreements " << d.disagreements << std::endl;
+    }
+
+  if (shortFlowRate > 0)
+    {
+      std::vector<uint32_t> edges;
+      edges.push_back (10000);
+      edges.push_back (100000);
+      edges.push_back (1000000);
+      fct.Report (std::cout, edges);
+      fct.WriteTable (pathOut + "/blue-tcp-fct.txt");
+    }
+
   Simulator::Destroy ();
   return 0;
 }
@@ -47,7 +47,6 @@ int main (int argc, char *argv[])
   std::string pcapFileName = "blue-udp.pcap";
 
   CommandLine cmd;
-  cmd.Parse (argc,argv);
 
   LogComponentEnable ("BlueQueueDisc", LOG_LEVEL_INFO);
 
@@ -74,7 +73,12 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::BlueQueueDisc::FreezeTime", TimeValue (Seconds(0.1)));
   Config::SetDefault ("ns3::BlueQueueDisc::Increment", DoubleValue (0.0025));
   Config::SetDefault ("ns3::BlueQueueDisc::Decrement", DoubleValue (0.00025));
+  Config::SetDefault ("ns3::BlueQueueDisc::LinkBandwidth", StringValue (bottleneckBandwidth));
  
+  // Parse after the defaults above, so that --ns3::<TypeId>::<Attribute>=<value>
+  // on the command line overrides them
+  cmd.Parse (argc,argv);
+
   NS_LOG_INFO ("Install internet stack on all nodes.");
   InternetStackHelper internet;
   internet.InstallAll ();
@@ -20,12 +20,15 @@
  *          Mohit P. Tahiliani <tahiliani@nitk.edu.in>
  */
 
+#include <algorithm>
 #include "ns3/log.h"
 #include "ns3/enum.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
 #include "ns3/simulator.h"
 #include "ns3/abort.h"
+#include "ns3/net-device.h"
 #include "blue-queue-disc.h"
 #include "ns3/drop-tail-queue.h"
 
@@ -77,6 +80,66 @@ TypeId BlueQueueDisc::GetTypeId (void)
                    TimeValue (Seconds (0.1)),
                    MakeTimeAccessor (&BlueQueueDisc::m_freezeTime),
                    MakeTimeChecker ())
+    .AddAttribute ("UseUtilization",
+                   "True to also decrement Pmark while the link utilization is below TargetUtilization",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BlueQueueDisc::m_useUtilization),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LinkBandwidth",
+                   "The BLUE link bandwidth, 0 to take the DataRate of the device",
+                   DataRateValue (DataRate (0)),
+                   MakeDataRateAccessor (&BlueQueueDisc::m_linkBandwidth),
+                   MakeDataRateChecker ())
+    .AddAttribute ("TargetUtilization",
+                   "Link utilization below which Pmark is decremented",
+                   DoubleValue (0.95),
+                   MakeDoubleAccessor (&BlueQueueDisc::m_targetUtilization),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("UtilizationWindow",
+                   "Averaging window of the departure rate",
+                   TimeValue (Seconds (0.1)),
+                   MakeTimeAccessor (&BlueQueueDisc::m_utilizationWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("Rtt",
+                   "Base round trip time of the flows; if not zero, the freeze time follows it instead of FreezeTime",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&BlueQueueDisc::m_rtt),
+                   MakeTimeChecker ())
+    .AddAttribute ("FreezeRttFactor",
+                   "Freeze time in round trip times (base RTT plus queueing delay), when Rtt is set",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&BlueQueueDisc::m_freezeRttFactor),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("AdaptiveSteps",
+                   "True to double the Pmark step on every consecutive update in the same direction",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BlueQueueDisc::m_adaptiveSteps),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxStepScale",
+                   "Largest multiple of Increment and Decrement used with AdaptiveSteps",
+                   DoubleValue (16.0),
+                   MakeDoubleAccessor (&BlueQueueDisc::m_maxStepScale),
+                   MakeDoubleChecker<double> (1))
+    .AddAttribute ("FixedPoint",
+                   "True to compute Pmark and the drop test in fixed point (Q48 Pmark and steps, 32-bit integer draw)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BlueQueueDisc::m_fixedPoint),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FixedPointShadow",
+                   "True to also run the other controller (double or fixed point) on the same inputs and count the divergence",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BlueQueueDisc::m_fixedPointShadow),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TargetDelay",
+                   "Sojourn time above which a dequeue increments Pmark (and below which it decrements it), zero to disable",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&BlueQueueDisc::m_targetDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("HeadDrop",
+                   "True to make the early drop decision for the head packet at dequeue instead of for the arriving one",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BlueQueueDisc::m_headDrop),
+                   MakeBooleanChecker ())
   ;
 
   return tid;
@@ -141,13 +204,82 @@ BlueQueueDisc::GetQueueSize (void)
     }
 }
 
+double
+BlueQueueDisc::GetPmark (void) const
+{
+  return m_fixedPoint ? aqm::AqmFromFixed (m_PmarkFixed) : m_Pmark;
+}
+
+const aqm::AqmFixedDivergence &
+BlueQueueDisc::GetFixedPointDivergence (void) const
+{
+  return m_divergence;
+}
+
+Time
+BlueQueueDisc::GetQueueDelay (void)
+{
+  NS_LOG_FUNCTION (this);
+  return m_qDelay;
+}
+
 BlueQueueDisc::Stats
 BlueQueueDisc::GetStats ()
 {
   NS_LOG_FUNCTION (this);
+  Stats st;
+  st.unforcedDrop = m_stats.GetPackets (AqmStats::EARLY_DROP);
+  st.forcedDrop = m_stats.GetPackets (AqmStats::FORCED_DROP);
+  st.packetsDequeued = m_stats.GetPackets (AqmStats::DEQUEUE);
+  st.bytesDequeued = m_stats.GetBytes (AqmStats::DEQUEUE);
+  return st;
+}
+
+AqmStats::Snapshot
+BlueQueueDisc::GetSnapshot (void)
+{
+  return m_stats.GetSnapshot (Simulator::Now ());
+}
+
+const AqmStats &
+BlueQueueDisc::GetAqmStats (void) const
+{
   return m_stats;
 }
 
+double
+BlueQueueDisc::GetUtilization (void)
+{
+  NS_LOG_FUNCTION (this);
+  return m_departureRate.GetUtilization (Simulator::Now (), m_linkBandwidth);
+}
+
+void
+BlueQueueDisc::SetRtt (Time rtt)
+{
+  NS_LOG_FUNCTION (this << rtt);
+  m_rtt = rtt;
+}
+
+Time
+BlueQueueDisc::GetFreezeTime (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_rtt.IsZero ())
+    {
+      return m_freezeTime;
+    }
+  // A drop takes one RTT, including the wait in this queue, to show in the
+  // arrival rate: do not update Pmark again before. The wait is measured,
+  // as the sojourn time of the head packet so far
+  Time rtt = m_rtt;
+  if (!m_enqueueTimes.empty ())
+    {
+      rtt += Simulator::Now () - m_enqueueTimes.front ();
+    }
+  return Seconds (m_freezeRttFactor * rtt.GetSeconds ());
+}
+
 int64_t
 BlueQueueDisc::AssignStreams (int64_t stream)
 {
@@ -176,24 +308,29 @@ BlueQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
       IncrementPmark ();
 
       // Drops due to queue limit: reactive
-      m_stats.forcedDrop++;
+      m_stats.Record (AqmStats::FORCED_DROP, item->GetPacketSize ());
 
       Drop (item);
       return false;
     }
-  else if (DropEarly ())
+  else if (!m_headDrop && DropEarly ())
     {
       // Increment the Pmark
       IncrementPmark ();
 
       // Early probability drop: proactive
-      m_stats.unforcedDrop++;
+      m_stats.Record (AqmStats::EARLY_DROP, item->GetPacketSize ());
       Drop (item);
       return false;
     }
 
   // No drop
   bool isEnqueued = GetInternalQueue (0)->Enqueue (item);
+  if (isEnqueued)
+    {
+      m_stats.Record (AqmStats::ENQUEUE, item->GetPacketSize ());
+      m_enqueueTimes.push (Simulator::Now ());
+    }
 
   NS_LOG_LOGIC ("\t bytesInQueue  " << GetInternalQueue (0)->GetNBytes ());
   NS_LOG_LOGIC ("\t packetsInQueue  " << GetInternalQueue (0)->GetNPackets ());
@@ -206,34 +343,77 @@ BlueQueueDisc::InitializeParams (void)
 {
   m_lastUpdateTime = Time (Seconds (0.0));
   m_idleStartTime = Time (Seconds (0.0));
-  m_stats.forcedDrop = 0;
-  m_stats.unforcedDrop = 0;
+  m_stats.Reset ();
   m_isIdle = true;
+  m_incrementScale = 1.0;
+  m_decrementScale = 1.0;
+  m_departureRate.SetWindow (m_utilizationWindow);
+  m_departureRate.Reset ();
+  m_enqueueTimes = std::queue<Time> ();
+  m_qDelay = Time (Seconds (0.0));
+  m_PmarkFixed = aqm::AqmToFixed (m_Pmark);
+  m_incrementFixed = aqm::AqmToFixed (m_increment);
+  m_decrementFixed = aqm::AqmToFixed (m_decrement);
+  m_incrementStepFixed = m_incrementFixed;
+  m_decrementStepFixed = m_decrementFixed;
+  m_maxIncrementStepFixed = aqm::AqmToFixed (m_increment * m_maxStepScale);
+  m_maxDecrementStepFixed = aqm::AqmToFixed (m_decrement * m_maxStepScale);
+  m_divergence = aqm::AqmFixedDivergence ();
 }
 
 bool BlueQueueDisc::DropEarly (void)
 {
   NS_LOG_FUNCTION (this);
+  if (m_fixedPoint && !m_fixedPointShadow)
+    {
+      return aqm::AqmFixedDrop (m_uv->GetInteger (0, 0xffffffff), aqm::AqmFixedThreshold (m_PmarkFixed));
+    }
   double u =  m_uv->GetValue ();
-  if (u <= m_Pmark)
+  bool earlyDrop = u <= m_Pmark;
+  if (m_fixedPointShadow)
     {
-      return true;
+      // Same draw for both controllers
+      bool fixedDrop = aqm::AqmFixedDrop (aqm::AqmDrawToFixed (u), aqm::AqmFixedThreshold (m_PmarkFixed));
+      m_divergence.RecordDecision (fixedDrop, earlyDrop);
+      if (m_fixedPoint)
+        {
+          return fixedDrop;
+        }
     }
-  return false;
+  return earlyDrop;
 }
 
 void BlueQueueDisc::IncrementPmark (void)
 {
   NS_LOG_FUNCTION (this);
   Time now = Simulator::Now ();
-  if (now - m_lastUpdateTime > m_freezeTime)
+  if (now - m_lastUpdateTime > GetFreezeTime ())
     {
-      m_Pmark += m_increment;
+      m_Pmark += m_increment * m_incrementScale;
       m_lastUpdateTime = now;
       if (m_Pmark > 1.0)
         {
           m_Pmark = 1.0;
         }
+      if (m_adaptiveSteps)
+        {
+          // Still overflowing one freeze time later: step up faster
+          m_incrementScale = std::min (m_incrementScale * 2, m_maxStepScale);
+          m_decrementScale = 1.0;
+        }
+      if (m_fixedPoint || m_fixedPointShadow)
+        {
+          m_PmarkFixed = aqm::AqmClampFixed (m_PmarkFixed + m_incrementStepFixed);
+          if (m_adaptiveSteps)
+            {
+              m_incrementStepFixed = std::min (m_incrementStepFixed * 2, m_maxIncrementStepFixed);
+              m_decrementStepFixed = m_decrementFixed;
+            }
+          if (m_fixedPointShadow)
+            {
+              m_divergence.RecordUpdate (m_PmarkFixed, m_Pmark);
+            }
+        }
     }
 }
 
@@ -244,22 +424,68 @@ void BlueQueueDisc::DecrementPmark (void)
   if (m_isIdle)
     {
       uint32_t m = 0; // stores the number of times Pmark should be decremented
-      m = ((now - m_idleStartTime) / m_freezeTime);
-      m_Pmark -= (m_decrement * m);
+      m = ((now - m_idleStartTime) / GetFreezeTime ());
+      if (!m_adaptiveSteps)
+        {
+          m_Pmark -= (m_decrement * m);
+        }
+      for (uint32_t i = 0; m_adaptiveSteps && i < m && m_Pmark > 0.0; i++)
+        {
+          m_Pmark -= m_decrement * m_decrementScale;
+          m_decrementScale = std::min (m_decrementScale * 2, m_maxStepScale);
+          m_incrementScale = 1.0;
+        }
       m_lastUpdateTime = now;
       if (m_Pmark < 0.0)
         {
           m_Pmark = 0.0;
         }
+      if (m_fixedPoint || m_fixedPointShadow)
+        {
+          if (!m_adaptiveSteps && m > 0 && m_decrementFixed > 0)
+            {
+              // m decrements at once, without overflowing m * Decrement
+              m_PmarkFixed = (m > m_PmarkFixed / m_decrementFixed) ? 0 : m_PmarkFixed - m_decrementFixed * m;
+            }
+          for (uint32_t i = 0; m_adaptiveSteps && i < m && m_PmarkFixed > 0; i++)
+            {
+              m_PmarkFixed -= m_decrementStepFixed;
+              m_decrementStepFixed = std::min (m_decrementStepFixed * 2, m_maxDecrementStepFixed);
+              m_incrementStepFixed = m_incrementFixed;
+            }
+          m_PmarkFixed = aqm::AqmClampFixed (m_PmarkFixed);
+          if (m_fixedPointShadow)
+            {
+              m_divergence.RecordUpdate (m_PmarkFixed, m_Pmark);
+            }
+        }
     }
-  else if (now - m_lastUpdateTime > m_freezeTime)
+  else if (now - m_lastUpdateTime > GetFreezeTime ())
     {
-      m_Pmark -= m_decrement;
+      m_Pmark -= m_decrement * m_decrementScale;
       m_lastUpdateTime = now;
       if (m_Pmark < 0.0)
         {
           m_Pmark = 0.0;
         }
+      if (m_adaptiveSteps)
+        {
+          m_decrementScale = std::min (m_decrementScale * 2, m_maxStepScale);
+          m_incrementScale = 1.0;
+        }
+      if (m_fixedPoint || m_fixedPointShadow)
+        {
+          m_PmarkFixed = aqm::AqmClampFixed (m_PmarkFixed - m_decrementStepFixed);
+          if (m_adaptiveSteps)
+            {
+              m_decrementStepFixed = std::min (m_decrementStepFixed * 2, m_maxDecrementStepFixed);
+              m_incrementStepFixed = m_incrementFixed;
+            }
+          if (m_fixedPointShadow)
+            {
+              m_divergence.RecordUpdate (m_PmarkFixed, m_Pmark);
+            }
+        }
     }
 }
 
@@ -269,17 +495,61 @@ BlueQueueDisc::DoDequeue (void)
   NS_LOG_FUNCTION (this);
 
   Ptr<QueueDiscItem> item = StaticCast<QueueDiscItem> (GetInternalQueue (0)->Dequeue ());
+  while (item != 0)
+    {
+      // The internal queue is FIFO, so the oldest timestamp is this packet's
+      m_qDelay = Simulator::Now () - m_enqueueTimes.front ();
+      m_enqueueTimes.pop ();
+      if (!m_headDrop || !DropEarly ())
+        {
+          m_stats.Record (AqmStats::DEQUEUE, item->GetPacketSize ());
+          break;
+        }
+      // Early probability drop of the head packet: proactive, and seen by
+      // the sender a queueing delay earlier than a drop on arrival
+      IncrementPmark ();
+      m_stats.Record (AqmStats::EARLY_DROP, item->GetPacketSize ());
+      Drop (item);
+      item = StaticCast<QueueDiscItem> (GetInternalQueue (0)->Dequeue ());
+    }
 
   NS_LOG_LOGIC ("Popped " << item);
 
   NS_LOG_LOGIC ("Number packets " << GetInternalQueue (0)->GetNPackets ());
   NS_LOG_LOGIC ("Number bytes " << GetInternalQueue (0)->GetNBytes ());
+  NS_LOG_LOGIC ("Queue delay " << m_qDelay);
+
+  if (!m_targetDelay.IsZero () && item != 0)
+    {
+      // Delay-based BLUE: a standing queue counts as an overflow event even
+      // when the buffer is far from full, at most once per freeze time
+      if (m_qDelay > m_targetDelay)
+        {
+          IncrementPmark ();
+        }
+      else
+        {
+          DecrementPmark ();
+        }
+    }
+
+  if (m_useUtilization && item != 0)
+    {
+      // The queue may never drain while the link is underused, e.g. with
+      // short idle periods between bursts: lower Pmark on utilization too
+      m_departureRate.NotifyDeparture (item->GetPacketSize (), Simulator::Now ());
+      if (!m_isIdle && GetUtilization () < m_targetUtilization)
+        {
+          DecrementPmark ();
+        }
+    }
 
   if (GetInternalQueue (0)->IsEmpty () && !m_isIdle)
     {
       NS_LOG_LOGIC ("Queue empty");
 
       m_idleStartTime = Simulator::Now ();
+      m_qDelay = Time (Seconds (0.0));
       // Decrement the Pmark
       m_isIdle = true;
       DecrementPmark ();
@@ -322,6 +592,34 @@ BlueQueueDisc::CheckConfig (void)
       return false;
     }
 
+  if (m_targetDelay.IsStrictlyNegative ())
+    {
+      NS_LOG_ERROR ("TargetDelay cannot be negative");
+      return false;
+    }
+
+  if (!m_rtt.IsZero () && m_freezeRttFactor <= 0)
+    {
+      NS_LOG_ERROR ("FreezeRttFactor must be positive when Rtt is set");
+      return false;
+    }
+
+  if (m_linkBandwidth.GetBitRate () == 0 && GetNetDevice () != 0)
+    {
+      // Point-to-point and CSMA devices have a DataRate attribute
+      DataRateValue rate;
+      if (GetNetDevice ()->GetAttributeFailSafe ("DataRate", rate))
+        {
+          m_linkBandwidth = rate.Get ();
+        }
+    }
+
+  if (m_useUtilization && m_linkBandwidth.GetBitRate () == 0)
+    {
+      NS_LOG_ERROR ("UseUtilization needs LinkBandwidth, or a device with a DataRate attribute");
+      return false;
+    }
+
   if (GetNInternalQueues () == 0)
     {
       // create a DropTail queue
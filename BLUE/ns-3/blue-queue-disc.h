@@ -32,6 +32,9 @@
 #include "ns3/timer.h"
 #include "ns3/event-id.h"
 #include "ns3/random-variable-stream.h"
+#include "departure-rate-estimator.h"
+#include "aqm-stats.h"
+#include "aqm-fixed-point.h"
 
 namespace ns3 {
 
@@ -61,8 +64,10 @@ public:
    */
   typedef struct
   {
-    uint32_t unforcedDrop;      //!< Early probability drops: proactive
-    uint32_t forcedDrop;        //!< Drops due to queue limit: reactive
+    uint64_t unforcedDrop;      //!< Early probability drops: proactive
+    uint64_t forcedDrop;        //!< Drops due to queue limit: reactive
+    uint64_t packetsDequeued;   //!< Packets dequeued
+    uint64_t bytesDequeued;     //!< Bytes dequeued
   } Stats;
 
   /**
@@ -93,8 +98,27 @@ public:
    */
   void SetQueueLimit (uint32_t lim);
 
+  /**
+   * \brief Get the current marking probability
+   *
+   * \returns Pmark
+   */
+  double GetPmark (void) const;
+
+  /**
+   * \brief Get the divergence of the fixed-point and double controllers
+   *
+   * Only counted with FixedPointShadow=true, when both run side by side.
+   *
+   * \returns The differences of Pmark and of the drop decisions
+   */
+  const aqm::AqmFixedDivergence & GetFixedPointDivergence (void) const;
+
   /**
    * \brief Get queue delay
+   *
+   * \returns The sojourn time of the last dequeued packet, zero once the
+   * queue has gone empty
    */
   Time GetQueueDelay (void);
 
@@ -105,6 +129,45 @@ public:
    */
   Stats GetStats ();
 
+  /**
+   * \brief Get a snapshot of the event counters
+   *
+   * \returns The counters at the current time
+   */
+  AqmStats::Snapshot GetSnapshot (void);
+
+  /**
+   * \brief Get the event counters
+   *
+   * \returns The 64-bit packet and byte counters
+   */
+  const AqmStats & GetAqmStats (void) const;
+
+  /**
+   * \brief Get the link utilization measured over the departures
+   *
+   * \returns The departure rate divided by the link bandwidth
+   */
+  double GetUtilization (void);
+
+  /**
+   * \brief Set the base round trip time the freeze time is derived from
+   *
+   * Lets a scenario feed in a measured RTT (e.g. from the TCP sockets),
+   * overriding the Rtt attribute. Zero reverts to the fixed FreezeTime.
+   *
+   * \param rtt The round trip time without the queueing delay of this queue
+   */
+  void SetRtt (Time rtt);
+
+  /**
+   * \brief Get the interval during which Pmark cannot be updated
+   *
+   * \returns FreezeTime, or FreezeRttFactor times the base RTT plus the
+   * sojourn time of the head packet if an RTT is set
+   */
+  Time GetFreezeTime (void);
+
   /**
    * Assign a fixed random variable stream number to the random variables
    * used by this model.  Return the number of streams (possibly zero) that
@@ -150,7 +213,7 @@ protected:
 private:
   Queue::QueueMode m_mode;                      //!< Mode (bytes or packets)
   uint32_t m_queueLimit;                        //!< Queue limit in bytes / packets
-  Stats m_stats;                                //!< BLUE statistics
+  AqmStats m_stats;                             //!< BLUE statistics
   Ptr<UniformRandomVariable> m_uv;              //!< Rng stream
 
   // ** Variables supplied by user
@@ -159,11 +222,38 @@ private:
   double m_increment;                           //!< increment value for marking probability
   double m_decrement;                           //!< decrement value for marking probability
   Time m_freezeTime;                            //!< Time interval during which Pmark cannot be updated
+  bool m_useUtilization;                        //!< Also decrement Pmark when the link is underused
+  DataRate m_linkBandwidth;                     //!< Link bandwidth, from the device if not set
+  double m_targetUtilization;                   //!< Utilization below which Pmark is decremented
+  Time m_utilizationWindow;                     //!< Averaging window of the departure rate
+  Time m_rtt;                                   //!< Base round trip time, zero to use m_freezeTime
+  double m_freezeRttFactor;                     //!< Freeze time in round trip times
+  bool m_adaptiveSteps;                         //!< Scale the steps while Pmark keeps moving one way
+  double m_maxStepScale;                        //!< Bound of the step scale
+  bool m_fixedPoint;                            //!< Use the fixed-point controller
+  bool m_fixedPointShadow;                      //!< Run both controllers and count their divergence
+  Time m_targetDelay;                           //!< Sojourn time above which Pmark is incremented, zero to disable
+  bool m_headDrop;                              //!< Make the early drop decision at dequeue, for the head packet
 
   // ** Variables maintained by BLUE
   Time m_lastUpdateTime;                        //!< last time at which Pmark was updated
   Time m_idleStartTime;                         //!< Time when BLUE Queue Disc entered the idle period
   bool m_isIdle;                                //!< True if queue is Idle
+  double m_incrementScale;                      //!< Current multiple of m_increment
+  double m_decrementScale;                      //!< Current multiple of m_decrement
+  DepartureRateEstimator m_departureRate;       //!< Departure rate of the queue
+  std::queue<Time> m_enqueueTimes;              //!< Enqueue times of the queued packets, oldest first
+  Time m_qDelay;                                //!< Sojourn time of the last dequeued packet
+
+  // ** Fixed-point controller, Q48 (see aqm-fixed-point.h)
+  int64_t m_PmarkFixed;                         //!< Marking probability
+  int64_t m_incrementFixed;                     //!< Increment
+  int64_t m_decrementFixed;                     //!< Decrement
+  int64_t m_incrementStepFixed;                 //!< Current increment step, with m_adaptiveSteps
+  int64_t m_decrementStepFixed;                 //!< Current decrement step, with m_adaptiveSteps
+  int64_t m_maxIncrementStepFixed;              //!< Bound of the increment step
+  int64_t m_maxDecrementStepFixed;              //!< Bound of the decrement step
+  aqm::AqmFixedDivergence m_divergence;         //!< Fixed-point versus double, with m_fixedPointShadow
 };
 
 } // namespace ns3
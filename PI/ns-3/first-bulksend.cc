@@ -17,6 +17,8 @@
 #include "ns3/flow-monitor-module.h"
 #include "ns3/tcp-header.h"
 #include "ns3/traffic-control-module.h"
+#include "short-flow-workload.h"
+#include "ts-store.h"
 #include  <string>
 
 using namespace ns3;
@@ -25,6 +27,9 @@ NS_LOG_COMPONENT_DEFINE ("PiTests");
 
 std::stringstream filePlotQueue;
 
+aqm::TsWriter tsWriter;         // optional compressed copy of the plotme series
+uint32_t tsQueue;
+
 void
 CheckQueueSize (Ptr<QueueDisc> queue)
 {
@@ -36,6 +41,11 @@ CheckQueueSize (Ptr<QueueDisc> queue)
   std::ofstream fPlotQueue (filePlotQueue.str ().c_str (), std::ios::out | std::ios::app);
   fPlotQueue << Simulator::Now ().GetSeconds () << " " << qSize << std::endl;
   fPlotQueue.close ();
+
+  if (tsWriter.IsOpen ())
+    {
+      tsWriter.Append (tsQueue, Simulator::Now ().GetSeconds (), qSize);
+    }
 }
 
 int main (int argc, char *argv[])
@@ -50,8 +60,21 @@ int main (int argc, char *argv[])
 
   float stopTime = startTime + simDuration;
 
+  double shortFlowRate = 0;     // short TCP transfers per second, 0 disables them
+  double shortFlowMeanSize = 50000;
+  double shortFlowShape = 1.2;
+  double shortFlowMaxSize = 1e7;
+  std::string tsStore = "";     // time-series store file, empty disables it
+  std::string telemetry = "";   // shared-memory telemetry segment, empty disables it
+
   CommandLine cmd;
-  cmd.Parse (argc,argv);
+  cmd.AddValue ("shortFlowRate", "Arrivals per second of short TCP transfers (0 disables them)", shortFlowRate);
+  cmd.AddValue ("shortFlowMeanSize", "Mean size of the Pareto short transfers in bytes", shortFlowMeanSize);
+  cmd.AddValue ("shortFlowShape", "Shape of the Pareto short transfers", shortFlowShape);
+  cmd.AddValue ("shortFlowMaxSize", "Largest Pareto short transfer in bytes", shortFlowMaxSize);
+  cmd.AddValue ("tsStore", "Also write the queue series into this time-series store", tsStore);
+  cmd.AddValue ("telemetry", "Publish live queue samples in this shared-memory segment (see tools/telemetry)", telemetry);
+  cmd.AddValue ("simDuration", "Simulation duration in seconds", simDuration);
 
   LogComponentEnable ("PiQueueDisc", LOG_LEVEL_INFO);
 
@@ -84,6 +107,11 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::PiQueueDisc::QueueRef", DoubleValue (50));
   Config::SetDefault ("ns3::PiQueueDisc::QueueLimit", DoubleValue (200));
 
+  // Parse after the defaults above, so that --ns3::<TypeId>::<Attribute>=<value>
+  // on the command line overrides them
+  cmd.Parse (argc,argv);
+  stopTime = startTime + simDuration;
+
   NS_LOG_INFO ("Install internet stack on all nodes.");
   InternetStackHelper internet;
   internet.InstallAll ();
@@ -176,14 +204,38 @@ int main (int argc, char *argv[])
 
     }
 
+  FctRecorder fct;
+  ShortFlowWorkload shortFlows (source, sink.Get (0), interfaces_sink.GetAddress (1), 50002, &fct);
+  if (shortFlowRate > 0)
+    {
+      shortFlows.SetArrivalRate (shortFlowRate);
+      shortFlows.SetParetoSizes (shortFlowMeanSize, shortFlowShape, shortFlowMaxSize);
+      shortFlows.Install (Seconds (1), Seconds (stopTime - 1));
+    }
+
   if (writeForPlot)
     {
       filePlotQueue << pathOut << "/" << "pi-queue.plotme";
       remove (filePlotQueue.str ().c_str ());
+      if (!tsStore.empty ())
+        {
+          tsWriter.Open (tsStore);
+          tsQueue = tsWriter.BeginSeries (RngSeedManager::GetRun (), "queue");
+        }
       Ptr<QueueDisc> queue = queueDiscs.Get (0);
       Simulator::ScheduleNow (&CheckQueueSize, queue);
     }
 
+  Ptr<AqmTelemetry> telemetryPublisher;
+  if (!telemetry.empty ())
+    {
+      telemetryPublisher = CreateObject<AqmTelemetry> ();
+      telemetryPublisher->SetAttribute ("SegmentName", StringValue (telemetry));
+      Ptr<PiQueueDisc> pi = StaticCast<PiQueueDisc> (queueDiscs.Get (0));
+      telemetryPublisher->Watch (pi, "bottleneck", MakeCallback (&PiQueueDisc::GetDropProbability, pi), &pi->GetAqmStats ());
+      telemetryPublisher->Start ();
+    }
+
   if (isPcapEnabled)
     {
       bottleneckLink.EnablePcap (pcapFileName, gateway, false);
@@ -197,6 +249,11 @@ int main (int argc, char *argv[])
 
   Simulator::Stop (Seconds (stopTime));
   Simulator::Run ();
+  tsWriter.Close ();
+  if (telemetryPublisher)
+    {
+      telemetryPublisher->Stop ();
+    }
 
   if (printPiStats)
     {
@@ -206,6 +263,38 @@ int main (int argc, char *argv[])
       std::cout << "\t " << st.forcedDrop << " drops due queue full" << std::endl;
     }
 
+  // --ns3::PiQueueDisc::FixedPointShadow=true: how far the fixed-point
+  // controller drifted from the double one
+  Ptr<PiQueueDisc> bottleneck = StaticCast<PiQueueDisc> (queueDiscs.Get (0));
+  BooleanValue shadow;
+  bottleneck->GetAttribute ("FixedPointShadow", shadow);
+  if (shadow.Get ())
+    {
+      const aqm::AqmFixedDivergence &d = bottleneck->GetFixedPointDivergence ();
+      std::cout << "summary fixedPoint.updates " << d.updates << std::endl;
+      std::cout << "summary fixedPoint.maxError " << d.maxError << std::endl;
+      std::cout << "summary fixedPoint.meanError " << (d.updates ? d.sumError / d.updates : 0) << std::endl;
+      std::cout << "summary fixedPoint.decisions " << d.decisions << std::endl;
+      std::cout << "summary fixedPoint.disagreements " << d.disagreements << std::endl;
+    }
+
+  BooleanValue adaptiveSampling;
+  bottleneck->GetAttribute ("AdaptiveSampling", adaptiveSampling);
+  if (adaptiveSampling.Get ())
+    {
+      std::cout << "summary piUpdates " << bottleneck->GetUpdateCount () << std::endl;
+    }
+
+  if (shortFlowRate > 0)
+    {
+      std::vector<uint32_t> edges;
+      edges.push_back (10000);
+      edges.push_back (100000);
+      edges.push_back (1000000);
+      fct.Report (std::cout, edges);
+      fct.WriteTable (pathOut + "/first-bulksend-fct.txt");
+    }
+
   Simulator::Destroy ();
   return 0;
 }
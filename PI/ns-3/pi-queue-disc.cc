@@ -25,10 +25,14 @@
  * Most of the comments are also ported from the same.
  */
 
+#include <algorithm>
+#include <cmath>
 #include "ns3/log.h"
 #include "ns3/enum.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/nstime.h"
 #include "ns3/simulator.h"
 #include "ns3/abort.h"
 #include "pi-queue-disc.h"
@@ -82,6 +86,90 @@ TypeId PiQueueDisc::GetTypeId (void)
                    DoubleValue (50),
                    MakeDoubleAccessor (&PiQueueDisc::SetQueueLimit),
                    MakeDoubleChecker<double> ())
+    .AddAttribute ("DropProbability",
+                   "Current drop probability (read only)",
+                   TypeId::ATTR_GET,
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&PiQueueDisc::GetDropProbability),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("FixedPoint",
+                   "True to compute the drop probability and the drop test in fixed point (Q48 probability and gains, 32-bit integer draw)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PiQueueDisc::m_fixedPoint),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FixedPointShadow",
+                   "True to also run the other controller (double or fixed point) on the same inputs and count the divergence",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PiQueueDisc::m_fixedPointShadow),
+                   MakeBooleanChecker ())
+    .AddAttribute ("AdaptiveSampling",
+                   "True to stretch the update interval while the queue is stable and shrink it during transients, recomputing A and B for each interval",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PiQueueDisc::m_adaptiveSampling),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MinInterval",
+                   "Update interval during transients with AdaptiveSampling, zero for 1 / W",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&PiQueueDisc::m_minInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxInterval",
+                   "Longest update interval with AdaptiveSampling",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&PiQueueDisc::m_maxInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("StableQueueDelta",
+                   "Largest queue change between updates, in packets, for which the queue is stable with AdaptiveSampling",
+                   DoubleValue (2),
+                   MakeDoubleAccessor (&PiQueueDisc::m_stableQueueDelta),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("MaxBurstAllowance",
+                   "Time without early drops granted to a burst once the queue has been short with no drop probability (as in PIE), zero to disable",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&PiQueueDisc::m_maxBurstAllowance),
+                   MakeTimeChecker ())
+    .AddAttribute ("LowWatermark",
+                   "Queue size in packets below which no packet is dropped early, zero to disable",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&PiQueueDisc::m_lowWatermark),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("IdleDecay",
+                   "Factor applied to the drop probability at every update that finds the queue still empty, 1 to disable",
+                   DoubleValue (1),
+                   MakeDoubleAccessor (&PiQueueDisc::m_idleDecay),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("Controller",
+                   "Control law: the PI law of the paper or the extended PID controller",
+                   EnumValue (PiQueueDisc::CONTROLLER_PI),
+                   MakeEnumAccessor (&PiQueueDisc::m_controller),
+                   MakeEnumChecker (PiQueueDisc::CONTROLLER_PI, "PI",
+                                    PiQueueDisc::CONTROLLER_PID, "PID"))
+    .AddAttribute ("Kd",
+                   "Derivative gain of the PID controller, in probability per packet per second of queue change",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&PiQueueDisc::m_kd),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("AntiWindup",
+                   "Integrator anti-windup of the PID controller",
+                   EnumValue (PiQueueDisc::ANTI_WINDUP_CONDITIONAL),
+                   MakeEnumAccessor (&PiQueueDisc::m_antiWindup),
+                   MakeEnumChecker (PiQueueDisc::ANTI_WINDUP_NONE, "NONE",
+                                    PiQueueDisc::ANTI_WINDUP_CONDITIONAL, "CONDITIONAL",
+                                    PiQueueDisc::ANTI_WINDUP_BACK_CALCULATION, "BACK_CALCULATION"))
+    .AddAttribute ("TrackingTime",
+                   "Time constant of the BACK_CALCULATION anti-windup",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&PiQueueDisc::m_trackingTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRate",
+                   "Largest change of the PID drop probability per second, 0 for no limit",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&PiQueueDisc::m_maxRate),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("HeadDrop",
+                   "True to make the early drop decision for the head packet at dequeue instead of for the arriving one",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PiQueueDisc::m_headDrop),
+                   MakeBooleanChecker ())
   ;
 
   return tid;
@@ -92,7 +180,6 @@ PiQueueDisc::PiQueueDisc ()
 {
 //  NS_LOG_FUNCTION (this);
   m_uv = CreateObject<UniformRandomVariable> ();
-  m_rtrsEvent = Simulator::Schedule (Time (Seconds (1.0 / m_w)), &PiQueueDisc::CalculateP, this);
 }
 
 PiQueueDisc::~PiQueueDisc ()
@@ -148,28 +235,72 @@ PiQueueDisc::GetQueueSize (void)
     }
 }
 
-uint32_t
+uint64_t
 PiQueueDisc::GetDropCount (void)
 {
 //  NS_LOG_FUNCTION (this);
-  uint32_t drops = m_stats.forcedDrop + m_stats.unforcedDrop;
-  return drops;
+  return m_stats.GetPackets (AqmStats::FORCED_DROP) + m_stats.GetPackets (AqmStats::EARLY_DROP);
 }
 
-uint32_t
-PiQueueDisc::GetThroughput (void)
+double
+PiQueueDisc::GetDropProbability (void) const
+{
+  return m_fixedPoint ? aqm::AqmFromFixed (m_dropProbFixed) : m_dropProb;
+}
+
+const aqm::AqmFixedDivergence &
+PiQueueDisc::GetFixedPointDivergence (void) const
+{
+  return m_divergence;
+}
+
+Time
+PiQueueDisc::GetSamplingInterval (void) const
+{
+  return m_interval;
+}
+
+uint64_t
+PiQueueDisc::GetUpdateCount (void) const
+{
+  return m_updates;
+}
+
+Time
+PiQueueDisc::GetMinInterval (void) const
+{
+  return m_minInterval.IsZero () ? Seconds (1.0 / m_w) : m_minInterval;
+}
+
+double
+PiQueueDisc::GetThroughput (const AqmStats::Snapshot &since)
 {
 //  NS_LOG_FUNCTION (this);
-  uint32_t packetsDequeued = m_stats.packetsDequeued;
-  m_stats.packetsDequeued = 0;
-  return packetsDequeued * 10;
+  return AqmStats::GetRates (since, GetSnapshot ()).bytes[AqmStats::DEQUEUE];
+}
+
+AqmStats::Snapshot
+PiQueueDisc::GetSnapshot (void)
+{
+  return m_stats.GetSnapshot (Simulator::Now ());
+}
+
+const AqmStats &
+PiQueueDisc::GetAqmStats (void) const
+{
+  return m_stats;
 }
 
 PiQueueDisc::Stats
 PiQueueDisc::GetStats ()
 {
 //  NS_LOG_FUNCTION (this);
-  return m_stats;
+  Stats st;
+  st.unforcedDrop = m_stats.GetPackets (AqmStats::EARLY_DROP);
+  st.forcedDrop = m_stats.GetPackets (AqmStats::FORCED_DROP);
+  st.packetsDequeued = m_stats.GetPackets (AqmStats::DEQUEUE);
+  st.bytesDequeued = m_stats.GetBytes (AqmStats::DEQUEUE);
+  return st;
 }
 
 int64_t
@@ -193,21 +324,25 @@ PiQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
     {
       // Drops due to queue limit: reactive
       Drop (item);
-      m_stats.forcedDrop++;
+      m_stats.Record (AqmStats::FORCED_DROP, item->GetPacketSize ());
       NS_LOG_LOGIC ("\t QueueLength:: " << GetInternalQueue (0)->GetNPackets ());
       return false;
     }
-  else if (DropEarly (item, nQueued))
+  else if (!m_headDrop && DropEarly (item, nQueued))
     {
       // Early probability drop: proactive
       Drop (item);
-      m_stats.unforcedDrop++;
+      m_stats.Record (AqmStats::EARLY_DROP, item->GetPacketSize ());
       NS_LOG_LOGIC ("\t QueueLength:: " << GetInternalQueue (0)->GetNPackets ());
       return false;
     }
 
   // No drop
   bool retval = GetInternalQueue (0)->Enqueue (item);
+  if (retval)
+    {
+      m_stats.Record (AqmStats::ENQUEUE, item->GetPacketSize ());
+    }
   NS_LOG_LOGIC ("\t QueueLength:: " << GetInternalQueue (0)->GetNPackets ());
   // If Queue::Enqueue fails, QueueDisc::Drop is called by the internal queue
   // because QueueDisc::AddInternalQueue sets the drop callback
@@ -222,16 +357,62 @@ void
 PiQueueDisc::InitializeParams (void)
 {
   m_dropProb = 0;
-  m_stats.forcedDrop = 0;
-  m_stats.unforcedDrop = 0;
-  m_stats.packetsDequeued = 0;
+  m_stats.Reset ();
   m_qOld = 0;
+
+  m_dropProbFixed = 0;
+  SetFixedPointGains (m_a, m_b);
+  m_divergence = aqm::AqmFixedDivergence ();
+  m_updates = 0;
+  m_burstAllowance = m_maxBurstAllowance;
+  // The integral that gives probability 0 for the empty queue assumed
+  // before the first update, as the PI law starts from
+  m_integral = (m_a + m_b) / 2 * m_qRef;
+  m_idleDecayFixed = std::min<uint64_t> ((uint64_t) (m_idleDecay * 65536 + 0.5), 65535);
+
+  // The sampling frequency is known only once the attributes are set
+  m_interval = Seconds (1.0 / m_w);
+  m_rtrsEvent = Simulator::Schedule (m_interval, &PiQueueDisc::CalculateP, this);
+}
+
+void
+PiQueueDisc::SetFixedPointGains (double a, double b)
+{
+  // Gains in Q48; in byte mode the queue is in bytes, so alpha and beta
+  // are per byte and the QueueRef terms stay in packets
+  double unit = (GetMode () == Queue::QUEUE_MODE_BYTES) ? m_meanPktSize : 1.0;
+  m_aFixed = aqm::AqmToFixed (a / unit);
+  m_bFixed = aqm::AqmToFixed (b / unit);
+  m_aQRefFixed = aqm::AqmToFixed (a * m_qRef);
+  m_bQRefFixed = aqm::AqmToFixed (b * m_qRef);
 }
 
 bool PiQueueDisc::DropEarly (Ptr<QueueDiscItem> item, uint32_t qSize)
 {
 //  NS_LOG_FUNCTION (this << item << qSize);
 
+  if (m_burstAllowance > Seconds (0))
+    {
+      // Let the burst after a quiet period through
+      return false;
+    }
+
+  double unit = (GetMode () == Queue::QUEUE_MODE_BYTES) ? m_meanPktSize : 1.0;
+  if (qSize < m_lowWatermark * unit)
+    {
+      return false;
+    }
+
+  if (m_fixedPoint && !m_fixedPointShadow)
+    {
+      uint64_t threshold = aqm::AqmFixedThreshold (m_dropProbFixed);
+      if (GetMode () == Queue::QUEUE_MODE_BYTES)
+        {
+          threshold = aqm::AqmScaleThreshold (threshold, item->GetPacketSize (), m_meanPktSize);
+        }
+      return aqm::AqmFixedDrop (m_uv->GetInteger (0, 0xffffffff), threshold);
+    }
+
   double p = m_dropProb;
   bool earlyDrop = true;
 
@@ -247,6 +428,23 @@ bool PiQueueDisc::DropEarly (Ptr<QueueDiscItem> item, uint32_t qSize)
     {
       earlyDrop = false;
     }
+
+  if (m_fixedPointShadow)
+    {
+      // Same draw for both controllers
+      uint64_t threshold = aqm::AqmFixedThreshold (m_dropProbFixed);
+      if (GetMode () == Queue::QUEUE_MODE_BYTES)
+        {
+          threshold = aqm::AqmScaleThreshold (threshold, item->GetPacketSize (), m_meanPktSize);
+        }
+      bool fixedDrop = aqm::AqmFixedDrop (aqm::AqmDrawToFixed (u), threshold);
+      m_divergence.RecordDecision (fixedDrop, earlyDrop);
+      if (m_fixedPoint)
+        {
+          return fixedDrop;
+        }
+    }
+
   if (!earlyDrop)
     {
       return false;
@@ -260,20 +458,140 @@ void PiQueueDisc::CalculateP ()
 //  NS_LOG_FUNCTION (this);
   double p = 0.0;
   uint32_t qlen = GetQueueSize ();
-  if (GetMode () == Queue::QUEUE_MODE_BYTES)
+  double a = m_a;
+  double b = m_b;
+  m_updates++;
+  if (m_adaptiveSampling)
     {
-      p = m_a * ((qlen * 1.0 / m_meanPktSize) - m_qRef) - m_b * ((m_qOld * 1.0 / m_meanPktSize) - m_qRef) + m_dropProb;
+      // Keep the continuous-time controller of A and B at 1 / W: with
+      // Tustin's discretization a = Kp + Ki T / 2 and b = Kp - Ki T / 2,
+      // where T is the interval that just ended
+      double kp = (m_a + m_b) / 2;
+      double ki = (m_a - m_b) * m_w;
+      double t = m_interval.GetSeconds ();
+      a = kp + ki * t / 2;
+      b = kp - ki * t / 2;
+      if (m_fixedPoint || m_fixedPointShadow)
+        {
+          SetFixedPointGains (a, b);
+        }
     }
-  else
+  bool idle = m_idleDecay < 1 && qlen == 0 && m_qOld == 0;
+  if (m_fixedPoint || m_fixedPointShadow)
     {
-      p = m_a * (qlen - m_qRef) - m_b * (m_qOld - m_qRef) + m_dropProb;
+      int64_t pFixed = m_aFixed * qlen - m_aQRefFixed - (m_bFixed * m_qOld - m_bQRefFixed) + m_dropProbFixed;
+      m_dropProbFixed = aqm::AqmClampFixed (pFixed);
+      if (idle)
+        {
+          // Q16 factor below 1: the product stays below 2^64
+          m_dropProbFixed = (int64_t) (((uint64_t) m_dropProbFixed * m_idleDecayFixed) >> 16);
+        }
+    }
+  if (!m_fixedPoint || m_fixedPointShadow)
+    {
+      if (m_controller == CONTROLLER_PID)
+        {
+          double unit = (GetMode () == Queue::QUEUE_MODE_BYTES) ? m_meanPktSize : 1.0;
+          p = UpdatePid (qlen / unit - m_qRef, m_qOld / unit - m_qRef, m_interval.GetSeconds ());
+        }
+      else if (GetMode () == Queue::QUEUE_MODE_BYTES)
+        {
+          p = a * ((qlen * 1.0 / m_meanPktSize) - m_qRef) - b * ((m_qOld * 1.0 / m_meanPktSize) - m_qRef) + m_dropProb;
+        }
+      else
+        {
+          p = a * (qlen - m_qRef) - b * (m_qOld - m_qRef) + m_dropProb;
+        }
+      p = (p < 0) ? 0 : p;
+      p = (p > 1) ? 1 : p;
+      if (idle)
+        {
+          // The queue stayed empty for a whole interval: do not wait for
+          // the integral term to bring the probability down
+          if (m_controller == CONTROLLER_PID)
+            {
+              m_integral -= p * (1 - m_idleDecay);
+            }
+          p *= m_idleDecay;
+        }
+
+      m_dropProb = p;
+      if (m_fixedPointShadow)
+        {
+          m_divergence.RecordUpdate (m_dropProbFixed, m_dropProb);
+        }
+    }
+
+  if (!m_maxBurstAllowance.IsZero ())
+    {
+      // As in PIE: use up the allowance, and grant a new one once the
+      // queue has been below half of QueueRef over a whole interval with
+      // no drop probability left
+      double unit = (GetMode () == Queue::QUEUE_MODE_BYTES) ? m_meanPktSize : 1.0;
+      m_burstAllowance = std::max (m_burstAllowance - m_interval, Seconds (0));
+      if (m_burstAllowance.IsZero () && GetDropProbability () == 0
+          && qlen < m_qRef * unit / 2 && m_qOld < m_qRef * unit / 2)
+        {
+          m_burstAllowance = m_maxBurstAllowance;
+        }
+    }
+
+  if (m_adaptiveSampling)
+    {
+      // Stable: the queue barely moved and the probability is at rest,
+      // either at QueueRef or clamped at 0 or 1 by the sign of the error.
+      // Double the interval then, and fall back to the shortest one as
+      // soon as the load changes
+      double unit = (GetMode () == Queue::QUEUE_MODE_BYTES) ? m_meanPktSize : 1.0;
+      double delta = m_stableQueueDelta * unit;
+      double error = qlen - m_qRef * unit;
+      double prob = GetDropProbability ();
+      bool stable = std::fabs ((double) qlen - m_qOld) <= delta
+        && (std::fabs (error) <= delta || (prob <= 0 && error < 0) || (prob >= 1 && error > 0));
+      m_interval = stable ? std::min (Seconds (2 * m_interval.GetSeconds ()), m_maxInterval) : GetMinInterval ();
     }
-  p = (p < 0) ? 0 : p;
-  p = (p > 1) ? 1 : p;
 
-  m_dropProb = p;
   m_qOld = qlen;
-  m_rtrsEvent = Simulator::Schedule (Time (Seconds (1.0 / m_w)), &PiQueueDisc::CalculateP, this);
+  m_rtrsEvent = Simulator::Schedule (m_interval, &PiQueueDisc::CalculateP, this);
+}
+
+double
+PiQueueDisc::UpdatePid (double error, double errorOld, double t)
+{
+//  NS_LOG_FUNCTION (this << error << errorOld << t);
+  // Positional form of the controller of A and B at 1 / W, with the
+  // integral discretized as in the PI law (Tustin): with Kd = 0 and no
+  // limit reached it gives the probabilities of the PI law
+  double kp = (m_a + m_b) / 2;
+  double ki = (m_a - m_b) * m_w;
+  double step = ki * t * (error + errorOld) / 2;
+  double integral = m_integral + step;
+  double p = kp * error + integral + m_kd * (error - errorOld) / t;
+
+  // Output limits: [0, 1], narrowed to MaxRate per second around the
+  // previous output
+  double low = 0;
+  double high = 1;
+  if (m_maxRate > 0)
+    {
+      low = std::max (low, m_dropProb - m_maxRate * t);
+      high = std::min (high, m_dropProb + m_maxRate * t);
+    }
+  double limited = std::min (std::max (p, low), high);
+
+  if (m_antiWindup == ANTI_WINDUP_CONDITIONAL)
+    {
+      if ((p > high && step > 0) || (p < low && step < 0))
+        {
+          integral = m_integral;
+        }
+    }
+  else if (m_antiWindup == ANTI_WINDUP_BACK_CALCULATION)
+    {
+      integral += (limited - p) * std::min (t / m_trackingTime.GetSeconds (), 1.0);
+    }
+  m_integral = integral;
+  return limited;
 }
 
 Ptr<QueueDiscItem>
@@ -288,9 +606,24 @@ PiQueueDisc::DoDequeue ()
       return 0;
     }
 
-  Ptr<QueueDiscItem> item = StaticCast<QueueDiscItem> (GetInternalQueue (0)->Dequeue ());
-  m_stats.packetsDequeued += item->GetPacketSize ();
-  NS_LOG_LOGIC ("\t BytesDequeued:: " << item->GetPacketSize ());
+  Ptr<QueueDiscItem> item;
+  while (!GetInternalQueue (0)->IsEmpty ())
+    {
+      uint32_t nQueued = GetQueueSize ();
+      item = StaticCast<QueueDiscItem> (GetInternalQueue (0)->Dequeue ());
+      if (m_headDrop && DropEarly (item, nQueued))
+        {
+          // Early probability drop of the head packet: the sender learns
+          // about it a queueing delay earlier than with a tail drop
+          Drop (item);
+          m_stats.Record (AqmStats::EARLY_DROP, item->GetPacketSize ());
+          item = 0;
+          continue;
+        }
+      m_stats.Record (AqmStats::DEQUEUE, item->GetPacketSize ());
+      NS_LOG_LOGIC ("\t BytesDequeued:: " << item->GetPacketSize ());
+      break;
+    }
   NS_LOG_LOGIC ("\t QueueLength:: " << GetInternalQueue (0)->GetNPackets ());
   return item;
 }
@@ -350,6 +683,42 @@ PiQueueDisc::CheckConfig (void)
       return false;
     }
 
+  if (m_adaptiveSampling && (GetMinInterval () <= Seconds (0) || m_maxInterval < GetMinInterval ()))
+    {
+      NS_LOG_ERROR ("MinInterval must be positive and at most MaxInterval");
+      return false;
+    }
+
+  if (m_controller == CONTROLLER_PID && (m_fixedPoint || m_fixedPointShadow))
+    {
+      NS_LOG_ERROR ("The fixed-point controller implements the PI law only");
+      return false;
+    }
+
+  if (m_controller == CONTROLLER_PID && m_antiWindup == ANTI_WINDUP_BACK_CALCULATION && m_trackingTime <= Seconds (0))
+    {
+      NS_LOG_ERROR ("TrackingTime must be positive with BACK_CALCULATION");
+      return false;
+    }
+
+  if (m_fixedPoint || m_fixedPointShadow)
+    {
+      // The fixed-point update multiplies the gains (Q48) by the queue
+      // length: keep the products below 2^62, for the longest interval
+      // with AdaptiveSampling
+      double maxQueue = (m_mode == Queue::QUEUE_MODE_BYTES) ? m_queueLimit / m_meanPktSize : m_queueLimit;
+      double gain = (m_a > m_b ? m_a : m_b);
+      if (m_adaptiveSampling)
+        {
+          gain = std::fabs (m_a + m_b) / 2 + std::fabs (m_a - m_b) * m_w * m_maxInterval.GetSeconds () / 2;
+        }
+      if (gain * (maxQueue + m_qRef) >= 1 << 14)
+        {
+          NS_LOG_ERROR ("A, B and QueueLimit are too large for the fixed-point controller");
+          return false;
+        }
+    }
+
   if (GetInternalQueue (0)->GetMode () != m_mode)
     {
 //      NS_LOG_ERROR ("The mode of the provided queue does not match the mode set on the PiQueueDisc");
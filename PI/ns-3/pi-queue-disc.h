@@ -37,6 +37,8 @@
 #include "ns3/timer.h"
 #include "ns3/event-id.h"
 #include "ns3/random-variable-stream.h"
+#include "aqm-stats.h"
+#include "aqm-fixed-point.h"
 
 namespace ns3 {
 
@@ -67,14 +69,34 @@ public:
    */
   virtual ~PiQueueDisc ();
 
+  /**
+   * \brief Control law of CalculateP
+   */
+  enum ControllerType
+  {
+    CONTROLLER_PI,              //!< The PI law of the paper, in velocity form
+    CONTROLLER_PID              //!< Positional PID with anti-windup and rate limit
+  };
+
+  /**
+   * \brief Integrator anti-windup of the PID controller
+   */
+  enum AntiWindupType
+  {
+    ANTI_WINDUP_NONE,                   //!< Integrate regardless of the limits
+    ANTI_WINDUP_CONDITIONAL,            //!< Stop integrating while the error pushes against a limit
+    ANTI_WINDUP_BACK_CALCULATION        //!< Bleed the integral towards the limited output
+  };
+
   /**
    * \brief Stats
    */
   typedef struct
   {
-    uint32_t unforcedDrop;      //!< Early probability drops: proactive
-    uint32_t forcedDrop;        //!< Drops due to queue limit: reactive
-    uint32_t packetsDequeued;
+    uint64_t unforcedDrop;      //!< Early probability drops: proactive
+    uint64_t forcedDrop;        //!< Drops due to queue limit: reactive
+    uint64_t packetsDequeued;   //!< Packets dequeued
+    uint64_t bytesDequeued;     //!< Bytes dequeued
   } Stats;
 
   /**
@@ -108,12 +130,60 @@ public:
   /**
    * \brief Get drop count
    */
-  uint32_t GetDropCount (void);
-  
+  uint64_t GetDropCount (void);
+
   /**
-   * \brief Get throughput
+   * \brief Get the drop probability of the last CalculateP update
+   *
+   * \returns The current drop probability
    */
-  uint32_t GetThroughput (void);
+  double GetDropProbability (void) const;
+
+  /**
+   * \brief Get throughput since a snapshot, without resetting anything
+   *
+   * \param since A snapshot taken earlier with GetSnapshot
+   * \returns The dequeued bytes per second since the snapshot
+   */
+  double GetThroughput (const AqmStats::Snapshot &since);
+
+  /**
+   * \brief Get a snapshot of the event counters
+   *
+   * \returns The counters at the current time
+   */
+  AqmStats::Snapshot GetSnapshot (void);
+
+  /**
+   * \brief Get the event counters
+   *
+   * \returns The 64-bit packet and byte counters
+   */
+  const AqmStats & GetAqmStats (void) const;
+
+  /**
+   * \brief Get the divergence of the fixed-point and double controllers
+   *
+   * Only counted with FixedPointShadow=true, when both run side by side.
+   *
+   * \returns The differences of the probabilities and drop decisions
+   */
+  const aqm::AqmFixedDivergence & GetFixedPointDivergence (void) const;
+
+  /**
+   * \brief Get the interval until the next CalculateP update
+   *
+   * \returns 1 / W, or the current interval with AdaptiveSampling
+   */
+  Time GetSamplingInterval (void) const;
+
+  /**
+   * \brief Get the number of CalculateP updates since the start
+   *
+   * \returns The number of updates
+   */
+  uint64_t GetUpdateCount (void) const;
+
   /**
    * \brief Get PI statistics after running.
    *
@@ -163,7 +233,32 @@ private:
    */
   void CalculateP ();
 
-  Stats m_stats;                                //!< PI statistics
+  /**
+   * \brief One update of the PID controller
+   *
+   * \param error Queue length minus QueueRef, in packets
+   * \param errorOld The error at the previous update
+   * \param t The interval since the previous update in seconds
+   * \returns The new drop probability
+   */
+  double UpdatePid (double error, double errorOld, double t);
+
+  /**
+   * \brief Set the fixed-point gains from alpha and beta
+   *
+   * \param a Alpha for the current update interval
+   * \param b Beta for the current update interval
+   */
+  void SetFixedPointGains (double a, double b);
+
+  /**
+   * \brief Get the update interval during transients
+   *
+   * \returns MinInterval, or 1 / W if it is zero
+   */
+  Time GetMinInterval (void) const;
+
+  AqmStats m_stats;                             //!< PI statistics
 
   // ** Variables supplied by user
   Queue::QueueMode m_mode;                      //!< Mode (bytes or packets)
@@ -173,6 +268,21 @@ private:
   double m_a;                                   //!< Parameter to pi controller
   double m_b;                                   //!< Parameter to pi controller
   double m_w;                                   //!< Sampling frequency (Number of times per second)
+  bool m_fixedPoint;                            //!< Use the fixed-point controller
+  bool m_fixedPointShadow;                      //!< Run both controllers and count their divergence
+  bool m_adaptiveSampling;                      //!< Adapt the update interval to the load
+  Time m_minInterval;                           //!< Update interval during transients, zero for 1 / W
+  Time m_maxInterval;                           //!< Longest update interval
+  double m_stableQueueDelta;                    //!< Queue change, in packets, below which the queue is stable
+  Time m_maxBurstAllowance;                     //!< Burst allowance granted after a quiet period
+  double m_lowWatermark;                        //!< Queue size in packets below which there is no early drop
+  double m_idleDecay;                           //!< Factor of the drop probability while the queue stays empty
+  ControllerType m_controller;                  //!< Control law
+  double m_kd;                                  //!< Derivative gain of the PID controller
+  AntiWindupType m_antiWindup;                  //!< Anti-windup of the PID controller
+  Time m_trackingTime;                          //!< Time constant of the back-calculation
+  double m_maxRate;                             //!< Largest change of the PID output per second, 0 for no limit
+  bool m_headDrop;                              //!< Make the early drop decision at dequeue, for the head packet
 
   // ** Variables maintained by PI
   double m_dropProb;                            //!< Variable used in calculation of drop probability
@@ -181,7 +291,20 @@ private:
   double m_count;                               //!< Number of packets since last drop
   uint32_t m_countBytes;                        //!< Number of bytes since last drop
   EventId m_rtrsEvent;                          //!< Event used to decide the decision of interval of drop probability calculation
+  Time m_interval;                              //!< Interval until the next update
+  uint64_t m_updates;                           //!< Number of updates
+  Time m_burstAllowance;                        //!< Remaining time without early drops
+  uint64_t m_idleDecayFixed;                    //!< m_idleDecay in Q16
+  double m_integral;                            //!< Integral term of the PID controller
   Ptr<UniformRandomVariable> m_uv;              //!< Rng stream
+
+  // ** Fixed-point controller, Q48 (see aqm-fixed-point.h)
+  int64_t m_dropProbFixed;                      //!< Drop probability
+  int64_t m_aFixed;                             //!< Alpha per packet, or per byte in byte mode
+  int64_t m_bFixed;                             //!< Beta per packet, or per byte in byte mode
+  int64_t m_aQRefFixed;                         //!< Alpha times QueueRef
+  int64_t m_bQRefFixed;                         //!< Beta times QueueRef
+  aqm::AqmFixedDivergence m_divergence;         //!< Fixed-point versus double, with m_fixedPointShadow
 };
 
 };   // namespace ns3
@@ -51,7 +51,7 @@ int main (int argc, char *argv[])
   float stopTime = startTime + simDuration;
 
   CommandLine cmd;
-  cmd.Parse (argc,argv);
+  cmd.AddValue ("simDuration", "Simulation duration in seconds", simDuration);
 
   LogComponentEnable ("PiQueueDisc", LOG_LEVEL_INFO);
 
@@ -84,6 +84,11 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::PiQueueDisc::QueueRef", DoubleValue (50));
   Config::SetDefault ("ns3::PiQueueDisc::QueueLimit", DoubleValue (200));
 
+  // Parse after the defaults above, so that --ns3::<TypeId>::<Attribute>=<value>
+  // on the command line overrides them
+  cmd.Parse (argc,argv);
+  stopTime = startTime + simDuration;
+
   NS_LOG_INFO ("Install internet stack on all nodes.");
   InternetStackHelper internet;
   internet.InstallAll ();
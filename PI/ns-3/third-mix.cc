@@ -17,6 +17,7 @@
 #include "ns3/flow-monitor-module.h"
 #include "ns3/tcp-header.h"
 #include "ns3/traffic-control-module.h"
+#include "short-flow-workload.h"
 #include  <string>
 
 using namespace ns3;
@@ -50,8 +51,17 @@ int main (int argc, char *argv[])
 
   float stopTime = startTime + simDuration;
 
+  double shortFlowRate = 0;     // short TCP transfers per second, 0 disables them
+  double shortFlowMeanSize = 50000;
+  double shortFlowShape = 1.2;
+  double shortFlowMaxSize = 1e7;
+
   CommandLine cmd;
-  cmd.Parse (argc,argv);
+  cmd.AddValue ("shortFlowRate", "Arrivals per second of short TCP transfers (0 disables them)", shortFlowRate);
+  cmd.AddValue ("shortFlowMeanSize", "Mean size of the Pareto short transfers in bytes", shortFlowMeanSize);
+  cmd.AddValue ("shortFlowShape", "Shape of the Pareto short transfers", shortFlowShape);
+  cmd.AddValue ("shortFlowMaxSize", "Largest Pareto short transfer in bytes", shortFlowMaxSize);
+  cmd.AddValue ("simDuration", "Simulation duration in seconds", simDuration);
 
   LogComponentEnable ("PiQueueDisc", LOG_LEVEL_INFO);
 
@@ -88,6 +98,11 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::PiQueueDisc::QueueRef", DoubleValue (50));
   Config::SetDefault ("ns3::PiQueueDisc::QueueLimit", DoubleValue (200));
 
+  // Parse after the defaults above, so that --ns3::<TypeId>::<Attribute>=<value>
+  // on the command line overrides them
+  cmd.Parse (argc,argv);
+  stopTime = startTime + simDuration;
+
   NS_LOG_INFO ("Install internet stack on all nodes.");
   InternetStackHelper internet;
   internet.InstallAll ();
@@ -227,6 +242,15 @@ int main (int argc, char *argv[])
   sinkApp1.Start (Seconds (0));
   sinkApp1.Stop (Seconds (stopTime));
 
+  FctRecorder fct;
+  ShortFlowWorkload shortFlows (source, sink.Get (0), interfaces_sink.GetAddress (1), 50002, &fct);
+  if (shortFlowRate > 0)
+    {
+      shortFlows.SetArrivalRate (shortFlowRate);
+      shortFlows.SetParetoSizes (shortFlowMeanSize, shortFlowShape, shortFlowMaxSize);
+      shortFlows.Install (Seconds (1), Seconds (stopTime - 1));
+    }
+
   if (writeForPlot)
     {
       filePlotQueue << pathOut << "/" << "pi-queue3.plotme";
@@ -256,6 +280,16 @@ int main (int argc, char *argv[])
       std::cout << "\t " << st.forcedDrop << " drops due queue full" << std::endl;
     }
 
+  if (shortFlowRate > 0)
+    {
+      std::vector<uint32_t> edges;
+      edges.push_back (10000);
+      edges.push_back (100000);
+      edges.push_back (1000000);
+      fct.Report (std::cout, edges);
+      fct.WriteTable (pathOut + "/third-mix-fct.txt");
+    }
+
   Simulator::Destroy ();
   return 0;
 }
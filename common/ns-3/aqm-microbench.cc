@@ -0,0 +1,593 @@
+/*
+ * This program measures the per-packet cost of the BLUE and PI queue
+ * discs in isolation: no devices, TCP or routing, only Enqueue and
+ * Dequeue calls on the queue disc with synthetic patterns
+ *
+ *   full       the queue stays at its limit: every step is one forced
+ *              drop (IncrementPmark), one accepted packet and one dequeue
+ *   steady     the queue stays half full: one enqueue (DropEarly) and one
+ *              dequeue per step
+ *   busy-idle  bursts that are drained completely, 0.2 s apart, so every
+ *              burst goes through the idle paths (DecrementPmark)
+ *   controller periodic updates alone (CalculateP of PiQueueDisc), less
+ *              the cost of as many empty events
+ *
+ * in packet and byte mode, with a mix of 64, 576 and 1500 byte packets.
+ * It reports nanoseconds, instructions (from the hardware counters, where
+ * perf_event_open is allowed) and heap allocations per packet. The
+ * packets are preallocated and recycled, so the allocations are those of
+ * the queue disc and its internal queue.
+ *
+ * A saved baseline flags regressions: with --baseline the program exits
+ * with status 1 if a case is slower or executes more instructions than
+ * the baseline by more than the tolerance, or allocates more.
+ *
+ * Examples:
+ *   ./waf --run "aqm-microbench --saveBaseline=bench.txt"
+ *   ./waf --run "aqm-microbench --baseline=bench.txt --tolerance=0.1"
+ *   ./waf --run "aqm-microbench --aqm=ns3::BlueQueueDisc[AdaptiveSteps=true] --patterns=full"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/traffic-control-module.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("AqmMicrobench");
+
+// Heap allocations, counted while g_countAllocs is set
+static bool g_countAllocs = false;
+static uint64_t g_allocs = 0;
+
+#if __cplusplus >= 201103L
+#define MICROBENCH_NEW_SPEC
+#define MICROBENCH_DELETE_SPEC noexcept
+#else
+#define MICROBENCH_NEW_SPEC throw (std::bad_alloc)
+#define MICROBENCH_DELETE_SPEC throw ()
+#endif
+
+void *
+operator new (std::size_t size) MICROBENCH_NEW_SPEC
+{
+  if (g_countAllocs)
+    {
+      g_allocs++;
+    }
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) MICROBENCH_DELETE_SPEC
+{
+  std::free (p);
+}
+
+/**
+ * Instructions retired by this thread, from the hardware counters
+ */
+class InstructionCounter
+{
+public:
+  InstructionCounter ()
+    : m_fd (-1)
+  {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    std::memset (&attr, 0, sizeof (attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof (attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    m_fd = syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+
+  ~InstructionCounter ()
+  {
+#ifdef __linux__
+    if (m_fd >= 0)
+      {
+        close (m_fd);
+      }
+#endif
+  }
+
+  bool IsAvailable (void) const
+  {
+    return m_fd >= 0;
+  }
+
+  void Start (void)
+  {
+#ifdef __linux__
+    if (m_fd >= 0)
+      {
+        ioctl (m_fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+  }
+
+  void Stop (void)
+  {
+#ifdef __linux__
+    if (m_fd >= 0)
+      {
+        ioctl (m_fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+#endif
+  }
+
+  uint64_t Read (void) const
+  {
+    uint64_t count = 0;
+#ifdef __linux__
+    if (m_fd >= 0 && read (m_fd, &count, sizeof (count)) != sizeof (count))
+      {
+        count = 0;
+      }
+#endif
+    return count;
+  }
+
+  void Reset (void)
+  {
+#ifdef __linux__
+    if (m_fd >= 0)
+      {
+        ioctl (m_fd, PERF_EVENT_IOC_RESET, 0);
+      }
+#endif
+  }
+
+private:
+  int m_fd;
+};
+
+static InstructionCounter g_instructions;
+
+/**
+ * Queue disc item without headers to add
+ */
+class MicrobenchItem : public QueueDiscItem
+{
+public:
+  MicrobenchItem (Ptr<Packet> p, const Address &addr, uint16_t protocol)
+    : QueueDiscItem (p, addr, protocol)
+  {
+  }
+
+  virtual void AddHeader (void)
+  {
+  }
+};
+
+static double
+NowNs (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Cost of one case
+ */
+struct BenchResult
+{
+  double nsPerPacket;                   //!< Wall clock time per packet
+  double instrPerPacket;                //!< Instructions per packet, -1 if unavailable
+  double allocsPerPacket;               //!< Heap allocations per packet
+};
+
+/**
+ * Drives one queue disc with one pattern
+ */
+class Bench
+{
+public:
+  Bench (Ptr<QueueDisc> disc, std::string pattern, uint32_t packets, uint32_t limit)
+    : m_disc (disc),
+      m_pattern (pattern),
+      m_packets (packets),
+      m_limit (limit),
+      m_ns (0),
+      m_instructions (0),
+      m_allocs (0),
+      m_attempts (0)
+  {
+    static const uint32_t sizes[] = { 64, 576, 1500 };
+    for (uint32_t i = 0; i < 4096 + BATCH; i++)
+      {
+        Ptr<Packet> p = Create<Packet> (sizes[i % 3]);
+        m_free.push_back (Create<MicrobenchItem> (p, Address (), 0));
+      }
+  }
+
+  BenchResult Run (void)
+  {
+    double gap = m_pattern == "busy-idle" ? 0.2 : 0.001;
+    if (m_pattern == "full")
+      {
+        Simulator::Schedule (Seconds (0), &Bench::Fill, this, m_limit);
+      }
+    else if (m_pattern == "steady")
+      {
+        Simulator::Schedule (Seconds (0), &Bench::Fill, this, m_limit / 2);
+      }
+    uint32_t nBatches = (m_packets + BATCH - 1) / BATCH;
+    for (uint32_t b = 0; b < nBatches; b++)
+      {
+        Simulator::Schedule (Seconds (gap * (b + 1)), &Bench::Batch, this);
+      }
+    Simulator::Stop (Seconds (gap * (nBatches + 1)));
+    Simulator::Run ();
+
+    BenchResult r;
+    r.nsPerPacket = m_ns / m_attempts;
+    r.instrPerPacket = g_instructions.IsAvailable () ? (double) m_instructions / m_attempts : -1;
+    r.allocsPerPacket = (double) m_allocs / m_attempts;
+    return r;
+  }
+
+private:
+  static const uint32_t BATCH = 64;
+
+  bool Enqueue (void)
+  {
+    Ptr<QueueDiscItem> item = m_free.back ();
+    m_free.pop_back ();
+    m_attempts++;
+    if (!m_disc->Enqueue (item))
+      {
+        m_free.push_back (item);
+        return false;
+      }
+    return true;
+  }
+
+  bool Dequeue (void)
+  {
+    Ptr<QueueDiscItem> item = m_disc->Dequeue ();
+    if (item == 0)
+      {
+        return false;
+      }
+    m_free.push_back (item);
+    return true;
+  }
+
+  /**
+   * Fill the queue, not measured
+   */
+  void Fill (uint32_t n)
+  {
+    for (uint32_t i = 0; i < 2 * n && m_disc->GetNPackets () < n; i++)
+      {
+        Ptr<QueueDiscItem> item = m_free.back ();
+        m_free.pop_back ();
+        if (!m_disc->Enqueue (item))
+          {
+            m_free.push_back (item);
+          }
+      }
+  }
+
+  void Batch (void)
+  {
+    uint64_t allocs = g_allocs;
+    g_instructions.Reset ();
+    g_countAllocs = true;
+    g_instructions.Start ();
+    double start = NowNs ();
+
+    if (m_pattern == "full")
+      {
+        for (uint32_t i = 0; i < BATCH / 2; i++)
+          {
+            Enqueue ();
+            Dequeue ();
+            Enqueue ();
+          }
+      }
+    else if (m_pattern == "steady")
+      {
+        for (uint32_t i = 0; i < BATCH; i++)
+          {
+            // Dequeue only behind an accepted packet, so that early drops
+            // do not drain the queue
+            if (Enqueue ())
+              {
+                Dequeue ();
+              }
+          }
+      }
+    else
+      {
+        for (uint32_t i = 0; i < BATCH; i++)
+          {
+            Enqueue ();
+          }
+        while (Dequeue ())
+          {
+          }
+      }
+
+    m_ns += NowNs () - start;
+    g_instructions.Stop ();
+    g_countAllocs = false;
+    m_instructions += g_instructions.Read ();
+    m_allocs += g_allocs - allocs;
+  }
+
+  Ptr<QueueDisc> m_disc;
+  std::string m_pattern;
+  uint32_t m_packets;
+  uint32_t m_limit;
+  std::vector<Ptr<QueueDiscItem> > m_free;      //!< Items not in the queue disc
+  double m_ns;
+  uint64_t m_instructions;
+  uint64_t m_allocs;
+  uint64_t m_attempts;
+};
+
+static void
+EmptyEvent (void)
+{
+}
+
+/**
+ * Split "ns3::PiQueueDisc[A=0.00003|B=0.00002]" into a factory
+ */
+static ObjectFactory
+MakeFactory (const std::string &spec, const std::string &mode, uint32_t limit)
+{
+  ObjectFactory factory;
+  std::string::size_type open = spec.find ('[');
+  factory.SetTypeId (spec.substr (0, open));
+  factory.Set ("Mode", StringValue (mode == "bytes" ? "QUEUE_MODE_BYTES" : "QUEUE_MODE_PACKETS"));
+  std::ostringstream oss;
+  oss << (mode == "bytes" ? limit * 1000 : limit);
+  factory.Set ("QueueLimit", StringValue (oss.str ()));
+  if (open != std::string::npos)
+    {
+      std::string attrs = spec.substr (open + 1, spec.rfind (']') - open - 1);
+      std::replace (attrs.begin (), attrs.end (), '|', ' ');
+      std::istringstream iss (attrs);
+      std::string token;
+      while (iss >> token)
+        {
+          std::string::size_type eq = token.find ('=');
+          NS_ABORT_MSG_IF (eq == std::string::npos, "Malformed attribute " << token);
+          factory.Set (token.substr (0, eq), StringValue (token.substr (eq + 1)));
+        }
+    }
+  return factory;
+}
+
+/**
+ * Cost of the periodic controller updates: the time of a run with only
+ * the updates, less that of as many empty events
+ */
+static BenchResult
+RunController (ObjectFactory factory, uint32_t updates)
+{
+  Ptr<QueueDisc> disc = factory.Create<QueueDisc> ();
+  disc->Initialize ();
+  DoubleValue w;
+  disc->GetAttribute ("W", w);
+  double end = updates / w.Get ();
+
+  double start = NowNs ();
+  g_instructions.Reset ();
+  g_instructions.Start ();
+  Simulator::Stop (Seconds (end));
+  Simulator::Run ();
+  g_instructions.Stop ();
+  double ns = NowNs () - start;
+  uint64_t instructions = g_instructions.Read ();
+  disc = 0;
+  Simulator::Destroy ();
+
+  for (uint32_t i = 0; i < updates; i++)
+    {
+      Simulator::Schedule (Seconds ((i + 1) / w.Get ()), &EmptyEvent);
+    }
+  start = NowNs ();
+  g_instructions.Reset ();
+  g_instructions.Start ();
+  Simulator::Stop (Seconds (end));
+  Simulator::Run ();
+  g_instructions.Stop ();
+  ns -= NowNs () - start;
+  instructions -= std::min (instructions, g_instructions.Read ());
+  Simulator::Destroy ();
+
+  BenchResult r;
+  r.nsPerPacket = std::max (0.0, ns / updates);
+  r.instrPerPacket = g_instructions.IsAvailable () ? (double) instructions / updates : -1;
+  r.allocsPerPacket = 0;
+  return r;
+}
+
+static std::vector<std::string>
+Split (std::string list, char sep)
+{
+  std::replace (list.begin (), list.end (), sep, ' ');
+  std::istringstream iss (list);
+  std::vector<std::string> items;
+  std::string item;
+  while (iss >> item)
+    {
+      items.push_back (item);
+    }
+  return items;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string aqmList = "ns3::PiQueueDisc,ns3::BlueQueueDisc";
+  std::string patternList = "full,steady,busy-idle,controller";
+  std::string modeList = "packets,bytes";
+  uint32_t packets = 1000000;
+  uint32_t reps = 5;
+  uint32_t limit = 200;
+  std::string baselineFile = "";
+  std::string saveBaselineFile = "";
+  double tolerance = 0.15;
+
+  CommandLine cmd;
+  cmd.AddValue ("aqm", "Comma separated queue discs, e.g. ns3::PiQueueDisc[QueueRef=30]", aqmList);
+  cmd.AddValue ("patterns", "Comma separated patterns: full, steady, busy-idle, controller", patternList);
+  cmd.AddValue ("modes", "Comma separated queue modes: packets, bytes", modeList);
+  cmd.AddValue ("packets", "Enqueue attempts (or controller updates) per repetition", packets);
+  cmd.AddValue ("reps", "Repetitions of every case; the fastest is reported", reps);
+  cmd.AddValue ("limit", "Queue limit in packets (times 1000 bytes in byte mode)", limit);
+  cmd.AddValue ("baseline", "Baseline file to compare with", baselineFile);
+  cmd.AddValue ("saveBaseline", "File to save the results to, as a baseline", saveBaselineFile);
+  cmd.AddValue ("tolerance", "Relative slowdown above which a case is a regression", tolerance);
+  cmd.Parse (argc, argv);
+
+  std::map<std::string, BenchResult> baseline;
+  if (!baselineFile.empty ())
+    {
+      std::ifstream in (baselineFile.c_str ());
+      NS_ABORT_MSG_IF (!in, "Cannot open " << baselineFile);
+      std::string line;
+      while (std::getline (in, line))
+        {
+          std::istringstream iss (line);
+          std::string name;
+          BenchResult r;
+          if (line.empty () || line[0] == '#' || !(iss >> name >> r.nsPerPacket >> r.instrPerPacket >> r.allocsPerPacket))
+            {
+              continue;
+            }
+          baseline[name] = r;
+        }
+    }
+
+  std::ofstream save;
+  if (!saveBaselineFile.empty ())
+    {
+      save.open (saveBaselineFile.c_str ());
+      save << "# case nsPerPacket instrPerPacket allocsPerPacket" << std::endl;
+    }
+
+  std::cout << std::left << std::setw (40) << "case" << std::right << std::setw (10) << "ns/pkt"
+            << std::setw (12) << "instr/pkt" << std::setw (12) << "allocs/pkt" << std::setw (10) << "vs base" << std::endl;
+
+  std::vector<std::string> aqms = Split (aqmList, ',');
+  std::vector<std::string> patterns = Split (patternList, ',');
+  std::vector<std::string> modes = Split (modeList, ',');
+  uint32_t regressions = 0;
+  for (size_t a = 0; a < aqms.size (); a++)
+    {
+      for (size_t p = 0; p < patterns.size (); p++)
+        {
+          for (size_t m = 0; m < modes.size (); m++)
+            {
+              ObjectFactory factory = MakeFactory (aqms[a], modes[m], limit);
+              std::string name = aqms[a] + "/" + patterns[p] + "/" + modes[m];
+              struct TypeId::AttributeInformation info;
+              bool periodic = factory.GetTypeId ().LookupAttributeByName ("W", &info);
+              if (patterns[p] == "controller" && (!periodic || m > 0))
+                {
+                  // Only PI has periodic updates, and they do not depend on the mode
+                  continue;
+                }
+
+              BenchResult best;
+              best.nsPerPacket = -1;
+              for (uint32_t r = 0; r < reps; r++)
+                {
+                  BenchResult res;
+                  if (patterns[p] == "controller")
+                    {
+                      res = RunController (factory, packets / 10);
+                    }
+                  else
+                    {
+                      Ptr<QueueDisc> disc = factory.Create<QueueDisc> ();
+                      disc->Initialize ();
+                      // In byte mode the limit holds limit * 1000 / 713 packets of the mix
+                      Bench bench (disc, patterns[p], packets, modes[m] == "bytes" ? limit * 3000 / 2140 : limit);
+                      res = bench.Run ();
+                      Simulator::Destroy ();
+                    }
+                  if (best.nsPerPacket < 0 || res.nsPerPacket < best.nsPerPacket)
+                    {
+                      best = res;
+                    }
+                }
+
+              std::ostringstream change;
+              std::map<std::string, BenchResult>::const_iterator base = baseline.find (name);
+              if (base != baseline.end ())
+                {
+                  const BenchResult &b = base->second;
+                  bool slower = best.nsPerPacket > b.nsPerPacket * (1 + tolerance);
+                  bool moreInstr = best.instrPerPacket >= 0 && b.instrPerPacket >= 0
+                    && best.instrPerPacket > b.instrPerPacket * (1 + tolerance);
+                  bool moreAllocs = best.allocsPerPacket > b.allocsPerPacket + 0.01;
+                  change << std::showpos << std::fixed << std::setprecision (1)
+                         << (b.nsPerPacket > 0 ? 100 * (best.nsPerPacket / b.nsPerPacket - 1) : 0) << "%";
+                  if (slower || moreInstr || moreAllocs)
+                    {
+                      change << " REGRESSION";
+                      regressions++;
+                    }
+                }
+
+              std::cout << std::left << std::setw (40) << name << std::right << std::fixed
+                        << std::setprecision (1) << std::setw (10) << best.nsPerPacket
+                        << std::setw (12) << best.instrPerPacket
+                        << std::setprecision (3) << std::setw (12) << best.allocsPerPacket
+                        << "  " << change.str () << std::endl;
+              std::cout.unsetf (std::ios::floatfield);
+              std::cout << "summary " << name << ":nsPerPacket " << best.nsPerPacket << std::endl;
+              if (save.is_open ())
+                {
+                  save << name << " " << best.nsPerPacket << " " << best.instrPerPacket
+                       << " " << best.allocsPerPacket << std::endl;
+                }
+            }
+        }
+    }
+
+  if (!g_instructions.IsAvailable ())
+    {
+      std::cout << "Instruction counts unavailable (perf_event_open not permitted), shown as -1" << std::endl;
+    }
+  if (regressions > 0)
+    {
+      std::cout << regressions << " regression(s) against " << baselineFile << std::endl;
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,564 @@
+/*
+ * This script runs a parking-lot scenario: K bottleneck hops in a chain
+ * of routers R0 - R1 - ... - RK, each with its own AQM queue disc on the
+ * forward direction.
+ *
+ *   long flows     R0 -> R1 -> ... -> RK   (cross every hop)
+ *   cross flows    Rk -> Rk+1              (enter and leave at hop k)
+ *
+ * All the long-flow sources share one host behind R0 and all the
+ * cross-flow sources of a hop share one host behind Rk (and likewise for
+ * the sinks), so the number of nodes grows with the hops only and
+ * thousands of flows cost one socket and one application each.
+ *
+ * Every hop's queue length, drop or marking probability and utilization
+ * are sampled by one recorder event for all the hops and written into a
+ * time-series store (tools/tsstore), one series per hop and quantity.
+ * The per-hop means after the warmup are printed at the end.
+ *
+ * Examples:
+ *   ./waf --run "aqm-parking-lot --hops=4 --nLong=20 --nCross=20"
+ *   ./waf --run "aqm-parking-lot --hops=3 --hopAqm=ns3::PiQueueDisc;ns3::BlueQueueDisc;ns3::PiQueueDisc[QueueRef=20]"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ts-store.h"
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("AqmParkingLot");
+
+/**
+ * A queue disc type together with the attributes it is configured with,
+ * e.g. "ns3::PiQueueDisc[A=0.00003|B=0.00002]"
+ */
+struct AqmSpec
+{
+  std::string spec;                                             //!< As given by the user
+  std::string type;                                             //!< TypeId name
+  std::vector<std::pair<std::string, std::string> > attributes; //!< Attribute name/value pairs
+};
+
+/**
+ * Parse "TypeId[Name=Value|Name=Value]" into an AqmSpec
+ */
+static AqmSpec
+ParseAqmSpec (std::string spec)
+{
+  AqmSpec s;
+  s.spec = spec;
+  std::string::size_type open = spec.find ('[');
+  s.type = spec.substr (0, open);
+  if (open != std::string::npos)
+    {
+      std::string::size_type close = spec.rfind (']');
+      NS_ABORT_MSG_IF (close == std::string::npos || close < open, "Malformed queue disc " << spec);
+      std::string attrs = spec.substr (open + 1, close - open - 1);
+      std::replace (attrs.begin (), attrs.end (), '|', ' ');
+      std::istringstream iss (attrs);
+      std::string token;
+      while (iss >> token)
+        {
+          std::string::size_type eq = token.find ('=');
+          NS_ABORT_MSG_IF (eq == std::string::npos, "Malformed attribute " << token);
+          s.attributes.push_back (std::make_pair (token.substr (0, eq), token.substr (eq + 1)));
+        }
+    }
+  return s;
+}
+
+/**
+ * The drop or marking probability of a BLUE or PI queue disc, the classic
+ * drop probability of DualPI2, or a null callback for other queue discs
+ */
+static Callback<double>
+GetProbabilityCallback (Ptr<QueueDisc> qd)
+{
+  Ptr<BlueQueueDisc> blue = DynamicCast<BlueQueueDisc> (qd);
+  Ptr<PiQueueDisc> pi = DynamicCast<PiQueueDisc> (qd);
+  Ptr<DualPi2QueueDisc> dualPi2 = DynamicCast<DualPi2QueueDisc> (qd);
+  if (blue != 0)
+    {
+      return MakeCallback (&BlueQueueDisc::GetPmark, blue);
+    }
+  if (pi != 0)
+    {
+      return MakeCallback (&PiQueueDisc::GetDropProbability, pi);
+    }
+  if (dualPi2 != 0)
+    {
+      return MakeCallback (&DualPi2QueueDisc::GetClassicProbability, dualPi2);
+    }
+  return MakeNullCallback<double> ();
+}
+
+/**
+ * Samples the queue discs of all the hops in one periodic event, writes
+ * the samples into a time-series store and keeps the means after the
+ * warmup.
+ *
+ * The departed bytes are derived from the 32-bit totals of QueueDisc
+ * (received - dropped - queued) by differences between two samples, so
+ * they are right across wrap-arounds and for any queue disc type.
+ */
+class HopRecorder
+{
+public:
+  HopRecorder (Time interval, Time warmup)
+    : m_interval (interval),
+      m_warmup (warmup),
+      m_store (0),
+      m_run (0)
+  {
+  }
+
+  /**
+   * \brief Write the samples into a store
+   * \param store The open store, or 0
+   * \param run The run the series are stored under
+   */
+  void SetStore (aqm::TsWriter *store, uint32_t run)
+  {
+    m_store = store;
+    m_run = run;
+  }
+
+  /**
+   * \brief Add the next hop
+   * \param qd The queue disc of the hop
+   * \param rate The link rate of the hop
+   */
+  void AddHop (Ptr<QueueDisc> qd, DataRate rate)
+  {
+    Hop h;
+    h.qd = qd;
+    h.probability = GetProbabilityCallback (qd);
+    h.bitRate = rate.GetBitRate ();
+    h.lastReceived = 0;
+    h.lastReceivedBytes = 0;
+    h.lastDropped = 0;
+    h.lastDroppedBytes = 0;
+    h.lastQueuedBytes = 0;
+    h.departed = 0;
+    h.received = 0;
+    h.dropped = 0;
+    h.queueSum = 0;
+    h.probSum = 0;
+    h.samples = 0;
+    if (m_store)
+      {
+        std::ostringstream name;
+        name << "hop" << m_hops.size () << "/";
+        h.queueSeries = m_store->BeginSeries (m_run, name.str () + "queue");
+        h.probSeries = m_store->BeginSeries (m_run, name.str () + "prob");
+        h.utilSeries = m_store->BeginSeries (m_run, name.str () + "utilization");
+      }
+    m_hops.push_back (h);
+  }
+
+  void Start (void)
+  {
+    Simulator::ScheduleNow (&HopRecorder::Sample, this);
+  }
+
+  double GetMeanQueue (uint32_t hop) const
+  {
+    const Hop &h = m_hops[hop];
+    return h.samples ? h.queueSum / h.samples : 0.0;
+  }
+
+  /**
+   * \returns The mean probability, or -1 if the queue disc has none
+   */
+  double GetMeanProbability (uint32_t hop) const
+  {
+    const Hop &h = m_hops[hop];
+    if (h.probability.IsNull ())
+      {
+        return -1;
+      }
+    return h.samples ? h.probSum / h.samples : 0.0;
+  }
+
+  double GetDropRate (uint32_t hop) const
+  {
+    const Hop &h = m_hops[hop];
+    return h.received ? double (h.dropped) / h.received : 0.0;
+  }
+
+  double GetUtilization (uint32_t hop, Time measured) const
+  {
+    const Hop &h = m_hops[hop];
+    return h.departed * 8.0 / h.bitRate / measured.GetSeconds ();
+  }
+
+private:
+  /**
+   * \brief Per-hop state
+   */
+  struct Hop
+  {
+    Ptr<QueueDisc> qd;                  //!< Queue disc of the hop
+    Callback<double> probability;       //!< Drop or marking probability, may be null
+    uint64_t bitRate;                   //!< Link rate
+    uint32_t lastReceived;              //!< Received packets at the previous sample
+    uint32_t lastReceivedBytes;         //!< Received bytes at the previous sample
+    uint32_t lastDropped;               //!< Dropped packets at the previous sample
+    uint32_t lastDroppedBytes;          //!< Dropped bytes at the previous sample
+    uint32_t lastQueuedBytes;           //!< Queued bytes at the previous sample
+    uint64_t departed;                  //!< Bytes departed after the warmup
+    uint64_t received;                  //!< Packets received after the warmup
+    uint64_t dropped;                   //!< Packets dropped after the warmup
+    double queueSum;                    //!< Sum of the queue samples after the warmup
+    double probSum;                     //!< Sum of the probability samples after the warmup
+    uint64_t samples;                   //!< Samples after the warmup
+    uint32_t queueSeries;               //!< Store series of the queue length
+    uint32_t probSeries;                //!< Store series of the probability
+    uint32_t utilSeries;                //!< Store series of the utilization
+  };
+
+  void Sample (void)
+  {
+    Time now = Simulator::Now ();
+    double t = now.GetSeconds ();
+    bool measuring = now > m_warmup;
+    for (std::vector<Hop>::iterator h = m_hops.begin (); h != m_hops.end (); ++h)
+      {
+        uint32_t queued = h->qd->GetNPackets ();
+        uint32_t queuedBytes = h->qd->GetNBytes ();
+        uint32_t received = h->qd->GetTotalReceivedPackets ();
+        uint32_t receivedBytes = h->qd->GetTotalReceivedBytes ();
+        uint32_t dropped = h->qd->GetTotalDroppedPackets ();
+        uint32_t droppedBytes = h->qd->GetTotalDroppedBytes ();
+        double prob = h->probability.IsNull () ? 0.0 : h->probability ();
+        int64_t departed = int64_t (uint32_t (receivedBytes - h->lastReceivedBytes))
+          - uint32_t (droppedBytes - h->lastDroppedBytes)
+          - (int64_t (queuedBytes) - h->lastQueuedBytes);
+        if (measuring)
+          {
+            h->departed += departed;
+            h->received += uint32_t (received - h->lastReceived);
+            h->dropped += uint32_t (dropped - h->lastDropped);
+            h->queueSum += queued;
+            h->probSum += prob;
+            h->samples++;
+          }
+        if (m_store)
+          {
+            m_store->Append (h->queueSeries, t, queued);
+            m_store->Append (h->probSeries, t, prob);
+            m_store->Append (h->utilSeries, t, departed * 8.0 / h->bitRate / m_interval.GetSeconds ());
+          }
+        h->lastReceived = received;
+        h->lastReceivedBytes = receivedBytes;
+        h->lastDropped = dropped;
+        h->lastDroppedBytes = droppedBytes;
+        h->lastQueuedBytes = queuedBytes;
+      }
+    Simulator::Schedule (m_interval, &HopRecorder::Sample, this);
+  }
+
+  Time m_interval;                      //!< Sampling interval
+  Time m_warmup;                        //!< Samples before this time are not averaged
+  aqm::TsWriter *m_store;               //!< Store of the series, may be 0
+  uint32_t m_run;                       //!< Run of the series in the store
+  std::vector<Hop> m_hops;              //!< The hops, in path order
+};
+
+static void
+SnapshotRx (Ptr<PacketSink> sink, uint64_t *rx)
+{
+  *rx = sink->GetTotalRx ();
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t hops = 4;
+  uint32_t nLong = 10;
+  uint32_t nCross = 10;
+  std::string aqm = "ns3::PiQueueDisc";
+  std::string hopAqm = "";
+  std::string hopBandwidth = "10Mbps";
+  std::string hopDelay = "10ms";
+  std::string accessBandwidth = "1Gbps";
+  std::string accessDelay = "2ms";
+  double simDuration = 101;
+  double warmup = 10;
+  double startJitter = 1.0;
+  double sampleInterval = 0.01;
+  std::string tsStore = "aqm-parking-lot.ts";   // series of every hop, empty disables it
+  std::string telemetry = "";   // shared-memory telemetry segment, empty disables it
+
+  Config::SetDefault ("ns3::Queue::MaxPackets", UintegerValue (13));
+  Config::SetDefault ("ns3::PfifoFastQueueDisc::Limit", UintegerValue (1000));
+
+  Config::SetDefault ("ns3::TcpSocket::DelAckTimeout", TimeValue (Seconds (0)));
+  Config::SetDefault ("ns3::TcpSocket::InitialCwnd", UintegerValue (1));
+  Config::SetDefault ("ns3::TcpSocketBase::LimitedTransmit", BooleanValue (false));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::TcpSocketBase::WindowScaling", BooleanValue (true));
+
+  Config::SetDefault ("ns3::PiQueueDisc::MeanPktSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::PiQueueDisc::Mode", StringValue ("QUEUE_MODE_PACKETS"));
+  Config::SetDefault ("ns3::PiQueueDisc::QueueRef", DoubleValue (50));
+  Config::SetDefault ("ns3::PiQueueDisc::QueueLimit", DoubleValue (200));
+
+  Config::SetDefault ("ns3::BlueQueueDisc::Mode", StringValue ("QUEUE_MODE_PACKETS"));
+  Config::SetDefault ("ns3::BlueQueueDisc::QueueLimit", UintegerValue (200));
+
+  // Attribute defaults above can be overridden from the command line,
+  // e.g. --ns3::PiQueueDisc::A=0.00002
+  CommandLine cmd;
+  cmd.AddValue ("hops", "Number of bottleneck hops", hops);
+  cmd.AddValue ("nLong", "Number of TCP flows crossing every hop", nLong);
+  cmd.AddValue ("nCross", "Number of TCP cross flows entering and leaving at each hop", nCross);
+  cmd.AddValue ("aqm", "Queue disc of every hop, e.g. ns3::PiQueueDisc[QueueRef=30]", aqm);
+  cmd.AddValue ("hopAqm", "Semicolon separated queue discs of the first hops, overriding --aqm, "
+                "e.g. ns3::PiQueueDisc;ns3::BlueQueueDisc", hopAqm);
+  cmd.AddValue ("hopBandwidth", "Link rate of every hop", hopBandwidth);
+  cmd.AddValue ("hopDelay", "Link delay of every hop", hopDelay);
+  cmd.AddValue ("accessBandwidth", "Access link rate", accessBandwidth);
+  cmd.AddValue ("accessDelay", "Access link delay", accessDelay);
+  cmd.AddValue ("simDuration", "Simulation duration in seconds", simDuration);
+  cmd.AddValue ("warmup", "Time discarded before averaging in seconds", warmup);
+  cmd.AddValue ("startJitter", "Sources start uniformly at random within this many seconds", startJitter);
+  cmd.AddValue ("sampleInterval", "Seconds between two samples of the hops", sampleInterval);
+  cmd.AddValue ("tsStore", "Time-series store of the hop samples (empty disables it)", tsStore);
+  cmd.AddValue ("telemetry", "Publish live samples of the first hops in this shared-memory segment (see tools/telemetry)", telemetry);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (hops == 0, "At least one hop is needed");
+  NS_ABORT_MSG_IF (warmup >= simDuration - 1, "Warmup must end before the sources stop");
+
+  std::vector<AqmSpec> hopSpecs (hops, ParseAqmSpec (aqm));
+  if (!hopAqm.empty ())
+    {
+      std::istringstream iss (hopAqm);
+      std::string spec;
+      for (uint32_t k = 0; std::getline (iss, spec, ';'); k++)
+        {
+          NS_ABORT_MSG_IF (k >= hops, "More queue discs than hops in " << hopAqm);
+          hopSpecs[k] = ParseAqmSpec (spec);
+        }
+    }
+
+  std::clock_t cpuStart = std::clock ();
+
+  NodeContainer routers;
+  routers.Create (hops + 1);
+  NodeContainer longHosts;              // long-flow source and sink
+  longHosts.Create (2);
+  NodeContainer crossSources;           // one per hop, behind Rk
+  crossSources.Create (hops);
+  NodeContainer crossSinks;             // one per hop, behind Rk+1
+  crossSinks.Create (hops);
+
+  InternetStackHelper internet;
+  internet.InstallAll ();
+
+  TrafficControlHelper tchPfifo;
+  uint16_t handle = tchPfifo.SetRootQueueDisc ("ns3::PfifoFastQueueDisc");
+  tchPfifo.AddInternalQueues (handle, 3, "ns3::DropTailQueue", "MaxPackets", UintegerValue (1000));
+
+  PointToPointHelper accessLink;
+  accessLink.SetQueue ("ns3::DropTailQueue");
+  accessLink.SetDeviceAttribute ("DataRate", StringValue (accessBandwidth));
+  accessLink.SetChannelAttribute ("Delay", StringValue (accessDelay));
+
+  PointToPointHelper hopLink;
+  hopLink.SetQueue ("ns3::DropTailQueue");
+  hopLink.SetDeviceAttribute ("DataRate", StringValue (hopBandwidth));
+  hopLink.SetChannelAttribute ("Delay", StringValue (hopDelay));
+
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.255.255.0");
+
+  // The hops: AQM on the forward device, FIFO on the reverse one
+  std::vector<Ptr<QueueDisc> > hopQueueDiscs;
+  for (uint32_t k = 0; k < hops; k++)
+    {
+      NetDeviceContainer devices = hopLink.Install (routers.Get (k), routers.Get (k + 1));
+      TrafficControlHelper tchAqm;
+      uint16_t aqmHandle = tchAqm.SetRootQueueDisc (hopSpecs[k].type);
+      if (TypeId::LookupByName (hopSpecs[k].type).IsChildOf (FqAqmQueueDisc::GetTypeId ()))
+        {
+          // The flow-queuing discs tell the flows apart by their packet filter
+          tchAqm.AddPacketFilter (aqmHandle, "ns3::FqCoDelIpv4PacketFilter");
+        }
+      Ptr<QueueDisc> qd = tchAqm.Install (devices.Get (0)).Get (0);
+      if (DynamicCast<BlueQueueDisc> (qd) != 0)
+        {
+          qd->SetAttribute ("LinkBandwidth", StringValue (hopBandwidth));
+        }
+      for (uint32_t j = 0; j < hopSpecs[k].attributes.size (); j++)
+        {
+          qd->SetAttribute (hopSpecs[k].attributes[j].first, StringValue (hopSpecs[k].attributes[j].second));
+        }
+      tchPfifo.Install (devices.Get (1));
+      hopQueueDiscs.push_back (qd);
+      address.NewNetwork ();
+      address.Assign (devices);
+    }
+
+  NetDeviceContainer devices = accessLink.Install (longHosts.Get (0), routers.Get (0));
+  tchPfifo.Install (devices);
+  address.NewNetwork ();
+  address.Assign (devices);
+  devices = accessLink.Install (routers.Get (hops), longHosts.Get (1));
+  tchPfifo.Install (devices);
+  address.NewNetwork ();
+  Ipv4Address longSinkAddress = address.Assign (devices).GetAddress (1);
+
+  std::vector<Ipv4Address> crossSinkAddresses;
+  for (uint32_t k = 0; k < hops; k++)
+    {
+      devices = accessLink.Install (crossSources.Get (k), routers.Get (k));
+      tchPfifo.Install (devices);
+      address.NewNetwork ();
+      address.Assign (devices);
+      devices = accessLink.Install (routers.Get (k + 1), crossSinks.Get (k));
+      tchPfifo.Install (devices);
+      address.NewNetwork ();
+      crossSinkAddresses.push_back (address.Assign (devices).GetAddress (1));
+    }
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  double stopTime = simDuration;
+  uint16_t port = 50000;
+
+  Ptr<UniformRandomVariable> startVar = CreateObject<UniformRandomVariable> ();
+  startVar->SetAttribute ("Max", DoubleValue (startJitter));
+
+  // One sink per host accepts all the flows towards it; one BulkSend
+  // application per flow
+  PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+  Ptr<PacketSink> longSink = DynamicCast<PacketSink> (sinkHelper.Install (longHosts.Get (1)).Get (0));
+  ApplicationContainer crossSinkApps = sinkHelper.Install (crossSinks);
+  ApplicationContainer sinkApps;
+  sinkApps.Add (longSink);
+  sinkApps.Add (crossSinkApps);
+  sinkApps.Start (Seconds (0));
+  sinkApps.Stop (Seconds (stopTime));
+
+  ApplicationContainer sourceApps;
+  BulkSendHelper longFtp ("ns3::TcpSocketFactory", InetSocketAddress (longSinkAddress, port));
+  longFtp.SetAttribute ("SendSize", UintegerValue (1000));
+  for (uint32_t i = 0; i < nLong; i++)
+    {
+      sourceApps.Add (longFtp.Install (longHosts.Get (0)));
+    }
+  for (uint32_t k = 0; k < hops; k++)
+    {
+      BulkSendHelper crossFtp ("ns3::TcpSocketFactory", InetSocketAddress (crossSinkAddresses[k], port));
+      crossFtp.SetAttribute ("SendSize", UintegerValue (1000));
+      for (uint32_t i = 0; i < nCross; i++)
+        {
+          sourceApps.Add (crossFtp.Install (crossSources.Get (k)));
+        }
+    }
+  for (uint32_t i = 0; i < sourceApps.GetN (); i++)
+    {
+      sourceApps.Get (i)->SetStartTime (Seconds (startVar->GetValue ()));
+    }
+  sourceApps.Stop (Seconds (stopTime - 1));
+
+  aqm::TsWriter store;
+  if (!tsStore.empty ())
+    {
+      store.Open (tsStore);
+    }
+  HopRecorder recorder (Seconds (sampleInterval), Seconds (warmup));
+  recorder.SetStore (store.IsOpen () ? &store : 0, RngSeedManager::GetRun ());
+  for (uint32_t k = 0; k < hops; k++)
+    {
+      recorder.AddHop (hopQueueDiscs[k], DataRate (hopBandwidth));
+    }
+  recorder.Start ();
+
+  Ptr<AqmTelemetry> telemetryPublisher;
+  if (!telemetry.empty ())
+    {
+      telemetryPublisher = CreateObject<AqmTelemetry> ();
+      telemetryPublisher->SetAttribute ("SegmentName", StringValue (telemetry));
+      for (uint32_t k = 0; k < hops && k < aqm::TELEMETRY_MAX_SOURCES; k++)
+        {
+          std::ostringstream name;
+          name << "hop" << k;
+          Ptr<BlueQueueDisc> blue = DynamicCast<BlueQueueDisc> (hopQueueDiscs[k]);
+          Ptr<PiQueueDisc> pi = DynamicCast<PiQueueDisc> (hopQueueDiscs[k]);
+          if (blue != 0)
+            {
+              telemetryPublisher->Watch (blue, name.str (), GetProbabilityCallback (blue), &blue->GetAqmStats ());
+            }
+          else if (pi != 0)
+            {
+              telemetryPublisher->Watch (pi, name.str (), GetProbabilityCallback (pi), &pi->GetAqmStats ());
+            }
+          else
+            {
+              telemetryPublisher->Watch (hopQueueDiscs[k], name.str ());
+            }
+        }
+      telemetryPublisher->Start ();
+    }
+
+  uint64_t longRxAtWarmup = 0;
+  Simulator::Schedule (Seconds (warmup), &SnapshotRx, longSink, &longRxAtWarmup);
+  std::vector<uint64_t> crossRxAtWarmup (hops, 0);
+  for (uint32_t k = 0; k < hops; k++)
+    {
+      Simulator::Schedule (Seconds (warmup), &SnapshotRx,
+                           DynamicCast<PacketSink> (crossSinkApps.Get (k)), &crossRxAtWarmup[k]);
+    }
+
+  Simulator::Stop (Seconds (stopTime));
+  Simulator::Run ();
+  store.Close ();
+  if (telemetryPublisher)
+    {
+      telemetryPublisher->Stop ();
+    }
+
+  Time measured = Seconds (stopTime - warmup);
+  double longMbps = (longSink->GetTotalRx () - longRxAtWarmup) * 8.0 / measured.GetSeconds () / 1e6;
+  std::cout << "hop\taqm\tmeanQueue\tmeanProb\tdropRate\tutilization\tcrossMbps" << std::endl;
+  double dropSum = 0;
+  double maxQueue = 0;
+  for (uint32_t k = 0; k < hops; k++)
+    {
+      Ptr<PacketSink> crossSink = DynamicCast<PacketSink> (crossSinkApps.Get (k));
+      double crossMbps = (crossSink->GetTotalRx () - crossRxAtWarmup[k]) * 8.0 / measured.GetSeconds () / 1e6;
+      std::cout << k << "\t" << hopSpecs[k].spec << "\t" << recorder.GetMeanQueue (k)
+                << "\t" << recorder.GetMeanProbability (k) << "\t" << recorder.GetDropRate (k)
+                << "\t" << recorder.GetUtilization (k, measured) << "\t" << crossMbps << std::endl;
+      dropSum += recorder.GetDropRate (k);
+      maxQueue = std::max (maxQueue, recorder.GetMeanQueue (k));
+    }
+  std::cout << "long flows: " << longMbps << " Mbps in total, "
+            << (nLong ? longMbps / nLong : 0) << " Mbps per flow" << std::endl;
+
+  for (uint32_t k = 0; k < hops; k++)
+    {
+      std::cout << "summary hop" << k << ".meanQueue " << recorder.GetMeanQueue (k) << std::endl
+                << "summary hop" << k << ".dropRate " << recorder.GetDropRate (k) << std::endl
+                << "summary hop" << k << ".utilization " << recorder.GetUtilization (k, measured) << std::endl;
+    }
+  std::cout << "summary longThroughput " << longMbps << std::endl
+            << "summary maxMeanQueue " << maxQueue << std::endl
+            << "summary meanDropRate " << dropSum / hops << std::endl
+            << "summary cpuSeconds " << double (std::clock () - cpuStart) / CLOCKS_PER_SEC << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,751 @@
+/*
+ * This script runs independent replications of the dumbbell scenario
+ * used for BLUE and PI evaluation and stops as soon as the confidence
+ * interval of every requested metric is narrower than the target.
+ *
+ * Each replication uses a distinct RNG run number. The per-replication
+ * metrics are folded into running (Welford) statistics, so nothing but
+ * the summary is kept in memory.
+ *
+ * In comparison mode (--compare) every replication runs each candidate
+ * AQM with common random numbers: the traffic generators and start times
+ * draw from the same explicitly assigned RNG streams for all candidates,
+ * while the AQM's own stream is assigned separately. The paired
+ * differences against the first candidate are reported directly, which
+ * needs far fewer replications than comparing independent runs.
+ *
+ * Examples:
+ *   ./waf --run "aqm-replications --aqm=ns3::BlueQueueDisc --nTcp=5 --relPrecision=0.05"
+ *   ./waf --run "aqm-replications --compare=ns3::PiQueueDisc;ns3::PiQueueDisc[A=0.00003|B=0.00002]"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/traffic-control-module.h"
+#include "running-stats.h"
+#include "short-flow-workload.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("AqmReplications");
+
+/**
+ * Parameters of the dumbbell scenario
+ */
+struct ScenarioConfig
+{
+  std::string aqm;                      //!< TypeId name of the bottleneck queue disc
+  uint32_t nTcp;                        //!< Number of long-lived TCP sources
+  uint32_t nUdp;                        //!< Number of constant-rate UDP sources
+  std::string udpRate;                  //!< Rate of each UDP source
+  std::string bottleneckBandwidth;      //!< Bottleneck link rate
+  std::string bottleneckDelay;          //!< Bottleneck link delay
+  std::string accessBandwidth;          //!< Access link rate
+  std::string accessDelay;              //!< Access link delay
+  double duration;                      //!< Simulated time in seconds
+  double warmup;                        //!< Time discarded before sampling, in seconds
+  double startJitter;                   //!< Sources start uniformly in [0, startJitter] seconds
+  double shortFlowRate;                 //!< Arrival rate of short TCP transfers, 0 to disable
+  double shortFlowMeanSize;             //!< Mean size of the Pareto short transfers in bytes
+  double shortFlowShape;                //!< Shape of the Pareto short transfers
+  double shortFlowMaxSize;              //!< Largest Pareto short transfer in bytes
+  std::string shortFlowCdf;             //!< Empirical size CDF file, overrides the Pareto sizes
+};
+
+/**
+ * A bottleneck queue disc type together with the attributes it is
+ * configured with, e.g. "ns3::PiQueueDisc[A=0.00003|B=0.00002]"
+ */
+struct AqmCandidate
+{
+  std::string spec;                                             //!< Candidate as given by the user
+  std::string type;                                             //!< TypeId name
+  std::vector<std::pair<std::string, std::string> > attributes; //!< Attribute name/value pairs
+};
+
+// RNG stream indices. Traffic streams are shared by all the candidates
+// of a comparison, the AQM streams are kept apart from them.
+static const int64_t AQM_STREAM = 0;
+static const int64_t TRAFFIC_STREAM = 1000;
+
+typedef std::map<std::string, double> Metrics;
+
+/**
+ * Time-average of the bottleneck queue length, sampled periodically
+ */
+class QueueSampler
+{
+public:
+  QueueSampler (Ptr<QueueDisc> queue, Time interval)
+    : m_queue (queue),
+      m_interval (interval),
+      m_sum (0),
+      m_samples (0)
+  {
+  }
+
+  void Sample (void)
+  {
+    Ptr<MqAqmQueueDisc> mq = DynamicCast<MqAqmQueueDisc> (m_queue);
+    m_sum += mq != 0 ? mq->GetStats ().packetsQueued : m_queue->GetNPackets ();
+    m_samples++;
+    Simulator::Schedule (m_interval, &QueueSampler::Sample, this);
+  }
+
+  double GetMean (void) const
+  {
+    return m_samples ? double (m_sum) / m_samples : 0.0;
+  }
+
+private:
+  Ptr<QueueDisc> m_queue;
+  Time m_interval;
+  uint64_t m_sum;
+  uint64_t m_samples;
+};
+
+/**
+ * Sum of the bytes received by all the sink applications
+ */
+static uint64_t
+GetTotalRx (ApplicationContainer sinks)
+{
+  uint64_t rx = 0;
+  for (uint32_t i = 0; i < sinks.GetN (); i++)
+    {
+      rx += DynamicCast<PacketSink> (sinks.Get (i))->GetTotalRx ();
+    }
+  return rx;
+}
+
+static void
+SnapshotRx (ApplicationContainer sinks, uint64_t *rx)
+{
+  *rx = GetTotalRx (sinks);
+}
+
+/**
+ * Percentile of the one-way delay over all the flows towards the sink,
+ * computed from the merged FlowMonitor delay histograms of the packets
+ * sent after the warmup
+ */
+static double
+GetDelayPercentile (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier,
+                    Ipv4Address sinkAddress, double percentile)
+{
+  std::map<double, uint64_t> bins;
+  uint64_t total = 0;
+  FlowMonitor::FlowStatsContainer stats = monitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainer::iterator it = stats.begin (); it != stats.end (); ++it)
+    {
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (it->first);
+      if (t.destinationAddress != sinkAddress)
+        {
+          continue;
+        }
+      Histogram &h = it->second.delayHistogram;
+      for (uint32_t b = 0; b < h.GetNBins (); b++)
+        {
+          bins[h.GetBinEnd (b)] += h.GetBinCount (b);
+          total += h.GetBinCount (b);
+        }
+    }
+
+  if (total == 0)
+    {
+      return 0.0;
+    }
+
+  uint64_t threshold = static_cast<uint64_t> (std::ceil (percentile * total));
+  uint64_t cumulative = 0;
+  for (std::map<double, uint64_t>::iterator it = bins.begin (); it != bins.end (); ++it)
+    {
+      cumulative += it->second;
+      if (cumulative >= threshold)
+        {
+          return it->first;
+        }
+    }
+  return bins.rbegin ()->first;
+}
+
+/**
+ * Assign fixed RNG streams to a BLUE or PI queue disc, or to the BLUE and
+ * PI children of a classful queue disc
+ * \param qd the queue disc
+ * \param stream first stream index to use
+ * \return the number of stream indices assigned
+ */
+static int64_t
+AssignAqmStreams (Ptr<QueueDisc> qd, int64_t stream)
+{
+  Ptr<BlueQueueDisc> blue = DynamicCast<BlueQueueDisc> (qd);
+  Ptr<PiQueueDisc> pi = DynamicCast<PiQueueDisc> (qd);
+  Ptr<FqAqmQueueDisc> fq = DynamicCast<FqAqmQueueDisc> (qd);
+  Ptr<DualPi2QueueDisc> dualPi2 = DynamicCast<DualPi2QueueDisc> (qd);
+  if (blue != 0)
+    {
+      return blue->AssignStreams (stream);
+    }
+  if (pi != 0)
+    {
+      return pi->AssignStreams (stream);
+    }
+  if (fq != 0)
+    {
+      return fq->AssignStreams (stream);
+    }
+  if (dualPi2 != 0)
+    {
+      return dualPi2->AssignStreams (stream);
+    }
+  int64_t currentStream = stream;
+  for (uint32_t i = 0; i < qd->GetNQueueDiscClasses (); i++)
+    {
+      currentStream += AssignAqmStreams (qd->GetQueueDiscClass (i)->GetQueueDisc (), currentStream);
+    }
+  return (currentStream - stream);
+}
+
+/**
+ * Assign fixed RNG streams to the BLUE or PI queue discs in the container
+ * \param c the queue discs
+ * \param stream first stream index to use
+ * \return the number of stream indices assigned
+ */
+static int64_t
+AssignQueueDiscStreams (QueueDiscContainer c, int64_t stream)
+{
+  int64_t currentStream = stream;
+  for (QueueDiscContainer::ConstIterator i = c.Begin (); i != c.End (); ++i)
+    {
+      currentStream += AssignAqmStreams (*i, currentStream);
+    }
+  return (currentStream - stream);
+}
+
+/**
+ * Abort if the long-lived flows through a flow-queuing disc all ended up
+ * in one sub-queue, or those through a multi-queue disc with flow hash
+ * steering in one child, i.e. the disc did not tell them apart
+ * \param qd the bottleneck queue disc
+ * \param nFlows the number of long-lived flows through it
+ */
+static void
+CheckFlowSpread (Ptr<QueueDisc> qd, uint32_t nFlows)
+{
+  uint32_t buckets = 0;
+  uint32_t used = 0;
+  Ptr<FqAqmQueueDisc> fq = DynamicCast<FqAqmQueueDisc> (qd);
+  Ptr<MqAqmQueueDisc> mq = DynamicCast<MqAqmQueueDisc> (qd);
+  if (fq != 0)
+    {
+      buckets = fq->GetNFlows ();
+      used = fq->GetNUsedFlows ();
+    }
+  else if (mq != 0)
+    {
+      EnumValue steering;
+      mq->GetAttribute ("Steering", steering);
+      if (steering.Get () != MqAqmQueueDisc::FLOW_HASH)
+        {
+          return;
+        }
+      buckets = mq->GetNChildren ();
+      for (uint32_t i = 0; i < buckets; i++)
+        {
+          used += mq->GetChild (i)->GetTotalReceivedPackets () > 0 ? 1 : 0;
+        }
+    }
+  // Only check when all the flows hashing into one bucket by chance is
+  // less likely than 1e-4
+  if (buckets < 2 || std::pow (double (buckets), double (nFlows) - 1) < 1e4)
+    {
+      return;
+    }
+  NS_ABORT_MSG_IF (used < 2, nFlows << " flows were all hashed into one of " << buckets
+                   << " sub-queues of " << qd->GetInstanceTypeId ().GetName ());
+}
+
+/**
+ * Parse "TypeId[Name=Value|Name=Value]" into an AqmCandidate
+ */
+static AqmCandidate
+ParseCandidate (std::string spec)
+{
+  AqmCandidate c;
+  c.spec = spec;
+  std::string::size_type open = spec.find ('[');
+  c.type = spec.substr (0, open);
+  if (open != std::string::npos)
+    {
+      std::string::size_type close = spec.rfind (']');
+      NS_ABORT_MSG_IF (close == std::string::npos || close < open, "Malformed candidate " << spec);
+      std::string attrs = spec.substr (open + 1, close - open - 1);
+      std::replace (attrs.begin (), attrs.end (), '|', ' ');
+      std::istringstream iss (attrs);
+      std::string token;
+      while (iss >> token)
+        {
+          std::string::size_type eq = token.find ('=');
+          NS_ABORT_MSG_IF (eq == std::string::npos, "Malformed attribute " << token);
+          c.attributes.push_back (std::make_pair (token.substr (0, eq), token.substr (eq + 1)));
+        }
+    }
+  return c;
+}
+
+/**
+ * Build the dumbbell, run it once with the given RNG run number and
+ * return the metrics of this replication
+ */
+static Metrics
+RunReplication (const ScenarioConfig &cfg, const AqmCandidate &aqm, uint32_t run)
+{
+  RngSeedManager::SetRun (run);
+  Ipv4AddressGenerator::Reset ();
+
+  NodeContainer source;
+  source.Create (cfg.nTcp);
+
+  NodeContainer udpsource;
+  udpsource.Create (cfg.nUdp);
+
+  NodeContainer gateway;
+  gateway.Create (2);
+
+  NodeContainer sink;
+  sink.Create (1);
+
+  InternetStackHelper internet;
+  internet.InstallAll ();
+
+  TrafficControlHelper tchPfifo;
+  uint16_t handle = tchPfifo.SetRootQueueDisc ("ns3::PfifoFastQueueDisc");
+  tchPfifo.AddInternalQueues (handle, 3, "ns3::DropTailQueue", "MaxPackets", UintegerValue (1000));
+
+  TrafficControlHelper tchAqm;
+  uint16_t aqmHandle = tchAqm.SetRootQueueDisc (aqm.type);
+  TypeId aqmTid = TypeId::LookupByName (aqm.type);
+  if (aqmTid.IsChildOf (FqAqmQueueDisc::GetTypeId ()) || aqmTid == MqAqmQueueDisc::GetTypeId ())
+    {
+      // The flow-queuing discs and the flow hash steering of the
+      // multi-queue disc tell the flows apart by their packet filter
+      tchAqm.AddPacketFilter (aqmHandle, "ns3::FqCoDelIpv4PacketFilter");
+    }
+
+  PointToPointHelper accessLink;
+  accessLink.SetQueue ("ns3::DropTailQueue");
+  accessLink.SetDeviceAttribute ("DataRate", StringValue (cfg.accessBandwidth));
+  accessLink.SetChannelAttribute ("Delay", StringValue (cfg.accessDelay));
+
+  PointToPointHelper bottleneckLink;
+  bottleneckLink.SetQueue ("ns3::DropTailQueue");
+  bottleneckLink.SetDeviceAttribute ("DataRate", StringValue (cfg.bottleneckBandwidth));
+  bottleneckLink.SetChannelAttribute ("Delay", StringValue (cfg.bottleneckDelay));
+
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.255.255.0");
+
+  for (uint32_t i = 0; i < cfg.nTcp; i++)
+    {
+      NetDeviceContainer devices = accessLink.Install (source.Get (i), gateway.Get (0));
+      tchPfifo.Install (devices);
+      address.NewNetwork ();
+      address.Assign (devices);
+    }
+
+  for (uint32_t i = 0; i < cfg.nUdp; i++)
+    {
+      NetDeviceContainer devices = accessLink.Install (udpsource.Get (i), gateway.Get (0));
+      tchPfifo.Install (devices);
+      address.NewNetwork ();
+      address.Assign (devices);
+    }
+
+  NetDeviceContainer devices_gateway = bottleneckLink.Install (gateway.Get (0), gateway.Get (1));
+  // only backbone link has the AQM queue disc
+  QueueDiscContainer queueDiscs = tchAqm.Install (devices_gateway);
+  for (QueueDiscContainer::ConstIterator i = queueDiscs.Begin (); i != queueDiscs.End (); ++i)
+    {
+      // Set before the candidate's attributes, so these can override it
+      if (DynamicCast<BlueQueueDisc> (*i) != 0)
+        {
+          (*i)->SetAttribute ("LinkBandwidth", StringValue (cfg.bottleneckBandwidth));
+        }
+      for (uint32_t j = 0; j < aqm.attributes.size (); j++)
+        {
+          (*i)->SetAttribute (aqm.attributes[j].first, StringValue (aqm.attributes[j].second));
+        }
+    }
+  // Classful discs create their children when they are initialized, at
+  // time zero, so the streams are assigned right after that
+  Simulator::ScheduleNow (&AssignQueueDiscStreams, queueDiscs, AQM_STREAM);
+  address.NewNetwork ();
+  address.Assign (devices_gateway);
+
+  NetDeviceContainer devices_sink = accessLink.Install (gateway.Get (1), sink.Get (0));
+  tchPfifo.Install (devices_sink);
+  address.NewNetwork ();
+  Ipv4InterfaceContainer interfaces_sink = address.Assign (devices_sink);
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  double stopTime = cfg.duration;
+  uint16_t port = 50000;
+  uint16_t port1 = 50001;
+  Ipv4Address sinkAddress = interfaces_sink.GetAddress (1);
+
+  ApplicationContainer sinkApps;
+  PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+  sinkApps.Add (sinkHelper.Install (sink));
+  PacketSinkHelper sinkHelper1 ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port1));
+  sinkApps.Add (sinkHelper1.Install (sink));
+  sinkApps.Start (Seconds (0));
+  sinkApps.Stop (Seconds (stopTime));
+
+  BulkSendHelper ftp ("ns3::TcpSocketFactory", InetSocketAddress (sinkAddress, port));
+  ftp.SetAttribute ("SendSize", UintegerValue (1000));
+  ApplicationContainer sourceApps = ftp.Install (source);
+  sourceApps.Stop (Seconds (stopTime - 1));
+
+  // Common random numbers: the same streams drive the traffic of every
+  // candidate, whatever random variables the queue discs create
+  int64_t stream = TRAFFIC_STREAM;
+  stream += internet.AssignStreams (NodeContainer::GetGlobal (), stream);
+  Ptr<UniformRandomVariable> startVar = CreateObject<UniformRandomVariable> ();
+  startVar->SetAttribute ("Max", DoubleValue (cfg.startJitter));
+  startVar->SetStream (stream++);
+  for (uint32_t i = 0; i < sourceApps.GetN (); i++)
+    {
+      sourceApps.Get (i)->SetStartTime (Seconds (startVar->GetValue ()));
+    }
+
+  if (cfg.nUdp > 0)
+    {
+      OnOffHelper udp ("ns3::UdpSocketFactory", InetSocketAddress (sinkAddress, port1));
+      udp.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1]"));
+      udp.SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+      udp.SetAttribute ("DataRate", DataRateValue (DataRate (cfg.udpRate)));
+      udp.SetAttribute ("PacketSize", UintegerValue (1000));
+      ApplicationContainer udpApps = udp.Install (udpsource);
+      stream += udp.AssignStreams (udpsource, stream);
+      for (uint32_t i = 0; i < udpApps.GetN (); i++)
+        {
+          udpApps.Get (i)->SetStartTime (Seconds (startVar->GetValue ()));
+        }
+      udpApps.Stop (Seconds (stopTime - 1));
+    }
+
+  FctRecorder fct;
+  ShortFlowWorkload shortFlows (source, sink.Get (0), sinkAddress, 50002, &fct);
+  if (cfg.shortFlowRate > 0)
+    {
+      NS_ABORT_MSG_IF (cfg.nTcp == 0, "Short flows are sent by the TCP sources");
+      shortFlows.SetArrivalRate (cfg.shortFlowRate);
+      shortFlows.SetParetoSizes (cfg.shortFlowMeanSize, cfg.shortFlowShape, cfg.shortFlowMaxSize);
+      if (!cfg.shortFlowCdf.empty ())
+        {
+          shortFlows.SetEmpiricalSizes (cfg.shortFlowCdf);
+        }
+      stream += shortFlows.AssignStreams (stream);
+      shortFlows.Install (Seconds (cfg.warmup), Seconds (stopTime - 1));
+    }
+
+  Ptr<QueueDisc> queue = queueDiscs.Get (0);
+  QueueSampler sampler (queue, Seconds (0.01));
+  Simulator::Schedule (Seconds (cfg.warmup), &QueueSampler::Sample, &sampler);
+
+  uint64_t rxAtWarmup = 0;
+  Simulator::Schedule (Seconds (cfg.warmup), &SnapshotRx, sinkApps, &rxAtWarmup);
+
+  // Like the other metrics, the delays leave out the warmup
+  FlowMonitorHelper flowmon;
+  flowmon.SetMonitorAttribute ("StartTime", TimeValue (Seconds (cfg.warmup)));
+  Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
+
+  Simulator::Stop (Seconds (stopTime));
+  Simulator::Run ();
+
+  CheckFlowSpread (queue, cfg.nTcp + cfg.nUdp);
+
+  monitor->CheckForLostPackets ();
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
+
+  Metrics m;
+  m["meanQueue"] = sampler.GetMean ();
+  uint64_t received = queue->GetTotalReceivedPackets ();
+  uint64_t dropped = queue->GetTotalDroppedPackets ();
+  Ptr<MqAqmQueueDisc> mq = DynamicCast<MqAqmQueueDisc> (queue);
+  if (mq != 0)
+    {
+      // With TX_QUEUE steering the packets bypass the counters of the root
+      received = mq->GetStats ().packetsReceived;
+      dropped = mq->GetStats ().packetsDropped;
+    }
+  m["dropRate"] = received ? double (dropped) / received : 0.0;
+  m["throughput"] = (GetTotalRx (sinkApps) - rxAtWarmup) * 8.0 / (stopTime - cfg.warmup) / 1e6;
+  m["delayP50"] = GetDelayPercentile (monitor, classifier, sinkAddress, 0.50);
+  m["delayP99"] = GetDelayPercentile (monitor, classifier, sinkAddress, 0.99);
+  if (cfg.shortFlowRate > 0)
+    {
+      m["fctP50"] = fct.GetPercentile (0.50);
+      m["fctP99"] = fct.GetPercentile (0.99);
+      m["fctSmallP99"] = fct.GetPercentile (0.99, 0, 100000);
+    }
+
+  Simulator::Destroy ();
+  return m;
+}
+
+/**
+ * Parse "name:value,name:value" into a map
+ */
+static std::map<std::string, double>
+ParseTargets (std::string spec)
+{
+  std::map<std::string, double> targets;
+  std::replace (spec.begin (), spec.end (), ',', ' ');
+  std::istringstream iss (spec);
+  std::string token;
+  while (iss >> token)
+    {
+      std::string::size_type colon = token.find (':');
+      NS_ABORT_MSG_IF (colon == std::string::npos, "Malformed target " << token);
+      targets[token.substr (0, colon)] = std::atof (token.substr (colon + 1).c_str ());
+    }
+  return targets;
+}
+
+/**
+ * \returns true if the confidence interval of every metric in the list is
+ * within its target half-width
+ */
+static bool
+IsConverged (std::map<std::string, RunningStats> &stats, const std::vector<std::string> &metrics,
+             std::map<std::string, double> &targets, double relPrecision, double confidence)
+{
+  for (std::vector<std::string>::const_iterator it = metrics.begin (); it != metrics.end (); ++it)
+    {
+      NS_ABORT_MSG_IF (stats.find (*it) == stats.end (), "Unknown metric " << *it);
+      const RunningStats &s = stats[*it];
+      double target = relPrecision * std::fabs (s.GetMean ());
+      if (targets.find (*it) != targets.end ())
+        {
+          target = std::max (target, targets[*it]);
+        }
+      if (s.GetHalfWidth (confidence) > target)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+int main (int argc, char *argv[])
+{
+  ScenarioConfig cfg;
+  cfg.aqm = "ns3::PiQueueDisc";
+  cfg.nTcp = 5;
+  cfg.nUdp = 0;
+  cfg.udpRate = "10Mbps";
+  cfg.bottleneckBandwidth = "10Mbps";
+  cfg.bottleneckDelay = "50ms";
+  cfg.accessBandwidth = "10Mbps";
+  cfg.accessDelay = "5ms";
+  cfg.duration = 101;
+  cfg.warmup = 10;
+  cfg.startJitter = 1.0;
+  cfg.shortFlowRate = 0;
+  cfg.shortFlowMeanSize = 50000;
+  cfg.shortFlowShape = 1.2;
+  cfg.shortFlowMaxSize = 1e7;
+  cfg.shortFlowCdf = "";
+
+  uint32_t firstRun = 1;
+  uint32_t minRuns = 3;
+  uint32_t maxRuns = 50;
+  double confidence = 0.95;
+  double relPrecision = 0.05;
+  std::string targetSpec = "";
+  std::string metricSpec = "meanQueue,dropRate,throughput,delayP50,delayP99";
+  std::string compareSpec = "";
+
+  Config::SetDefault ("ns3::Queue::MaxPackets", UintegerValue (13));
+  Config::SetDefault ("ns3::PfifoFastQueueDisc::Limit", UintegerValue (50));
+
+  Config::SetDefault ("ns3::TcpSocket::DelAckTimeout", TimeValue (Seconds (0)));
+  Config::SetDefault ("ns3::TcpSocket::InitialCwnd", UintegerValue (1));
+  Config::SetDefault ("ns3::TcpSocketBase::LimitedTransmit", BooleanValue (false));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::TcpSocketBase::WindowScaling", BooleanValue (true));
+
+  Config::SetDefault ("ns3::PiQueueDisc::MeanPktSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::PiQueueDisc::Mode", StringValue ("QUEUE_MODE_PACKETS"));
+  Config::SetDefault ("ns3::PiQueueDisc::QueueRef", DoubleValue (50));
+  Config::SetDefault ("ns3::PiQueueDisc::QueueLimit", DoubleValue (200));
+
+  Config::SetDefault ("ns3::BlueQueueDisc::Mode", StringValue ("QUEUE_MODE_PACKETS"));
+  Config::SetDefault ("ns3::BlueQueueDisc::QueueLimit", UintegerValue (200));
+
+  // Attribute defaults above can be overridden from the command line,
+  // e.g. --ns3::PiQueueDisc::A=0.00002
+  CommandLine cmd;
+  cmd.AddValue ("aqm", "Bottleneck queue disc, e.g. ns3::PiQueueDisc[QueueRef=30]", cfg.aqm);
+  cmd.AddValue ("nTcp", "Number of long-lived TCP sources", cfg.nTcp);
+  cmd.AddValue ("nUdp", "Number of constant-rate UDP sources", cfg.nUdp);
+  cmd.AddValue ("udpRate", "Rate of each UDP source", cfg.udpRate);
+  cmd.AddValue ("bottleneckBandwidth", "Bottleneck link rate", cfg.bottleneckBandwidth);
+  cmd.AddValue ("bottleneckDelay", "Bottleneck link delay", cfg.bottleneckDelay);
+  cmd.AddValue ("accessBandwidth", "Access link rate", cfg.accessBandwidth);
+  cmd.AddValue ("accessDelay", "Access link delay", cfg.accessDelay);
+  cmd.AddValue ("simDuration", "Simulated time of each replication in seconds", cfg.duration);
+  cmd.AddValue ("warmup", "Time discarded before sampling in seconds", cfg.warmup);
+  cmd.AddValue ("startJitter", "Sources start uniformly at random within this many seconds", cfg.startJitter);
+  cmd.AddValue ("shortFlowRate", "Arrivals per second of short TCP transfers (0 disables them)", cfg.shortFlowRate);
+  cmd.AddValue ("shortFlowMeanSize", "Mean size of the Pareto short transfers in bytes", cfg.shortFlowMeanSize);
+  cmd.AddValue ("shortFlowShape", "Shape of the Pareto short transfers", cfg.shortFlowShape);
+  cmd.AddValue ("shortFlowMaxSize", "Largest Pareto short transfer in bytes", cfg.shortFlowMaxSize);
+  cmd.AddValue ("shortFlowCdf", "File with an empirical size CDF (bytes probability per line)", cfg.shortFlowCdf);
+  cmd.AddValue ("firstRun", "RNG run number of the first replication", firstRun);
+  cmd.AddValue ("minRuns", "Minimum number of replications", minRuns);
+  cmd.AddValue ("maxRuns", "Maximum number of replications", maxRuns);
+  cmd.AddValue ("confidence", "Confidence level (0.90, 0.95 or 0.99)", confidence);
+  cmd.AddValue ("relPrecision", "Target half-width relative to the mean", relPrecision);
+  cmd.AddValue ("targets", "Absolute target half-widths, e.g. meanQueue:2,delayP99:0.005", targetSpec);
+  cmd.AddValue ("metrics", "Comma separated metrics the stopping rule applies to", metricSpec);
+  cmd.AddValue ("compare", "Semicolon separated candidates compared with common random numbers, "
+                "e.g. ns3::BlueQueueDisc;ns3::PiQueueDisc[QueueRef=30]", compareSpec);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (cfg.warmup >= cfg.duration - 1, "Warmup must end before the sources stop");
+  NS_ABORT_MSG_IF (minRuns < 2, "At least two replications are needed for a confidence interval");
+
+  std::map<std::string, double> targets = ParseTargets (targetSpec);
+  std::vector<std::string> metrics;
+  std::replace (metricSpec.begin (), metricSpec.end (), ',', ' ');
+  std::istringstream iss (metricSpec);
+  std::string name;
+  while (iss >> name)
+    {
+      metrics.push_back (name);
+    }
+
+  std::vector<AqmCandidate> candidates;
+  if (compareSpec.empty ())
+    {
+      candidates.push_back (ParseCandidate (cfg.aqm));
+    }
+  else
+    {
+      std::replace (compareSpec.begin (), compareSpec.end (), ';', ' ');
+      std::istringstream css (compareSpec);
+      while (css >> name)
+        {
+          candidates.push_back (ParseCandidate (name));
+        }
+    }
+
+  // stats[c]: metrics of candidate c; diffs[c]: paired difference of
+  // candidate c against candidate 0
+  std::vector<std::map<std::string, RunningStats> > stats (candidates.size ());
+  std::vector<std::map<std::string, RunningStats> > diffs (candidates.size ());
+  uint32_t n = 0;
+  bool converged = false;
+
+  while (n < maxRuns && !converged)
+    {
+      uint32_t run = firstRun + n;
+      Metrics base;
+      for (uint32_t c = 0; c < candidates.size (); c++)
+        {
+          Metrics m = RunReplication (cfg, candidates[c], run);
+
+          std::cout << "run " << run << " " << candidates[c].spec;
+          for (Metrics::iterator it = m.begin (); it != m.end (); ++it)
+            {
+              stats[c][it->first].Add (it->second);
+              std::cout << " " << it->first << "=" << it->second;
+              if (c > 0)
+                {
+                  diffs[c][it->first].Add (it->second - base[it->first]);
+                }
+            }
+          std::cout << std::endl;
+          if (c == 0)
+            {
+              base = m;
+            }
+        }
+      n++;
+
+      if (n < minRuns)
+        {
+          continue;
+        }
+
+      converged = true;
+      if (candidates.size () == 1)
+        {
+          converged = IsConverged (stats[0], metrics, targets, relPrecision, confidence);
+        }
+      for (uint32_t c = 1; c < candidates.size () && converged; c++)
+        {
+          // a relative target makes little sense around a zero difference,
+          // so scale it by the baseline mean
+          std::map<std::string, double> diffTargets = targets;
+          for (std::vector<std::string>::iterator it = metrics.begin (); it != metrics.end (); ++it)
+            {
+              diffTargets[*it] = std::max (diffTargets[*it], relPrecision * std::fabs (stats[0][*it].GetMean ()));
+            }
+          converged = IsConverged (diffs[c], metrics, diffTargets, 0.0, confidence);
+        }
+    }
+
+  std::cout << "*** " << n << " replications, "
+            << (converged ? "converged" : "run limit reached") << " ***" << std::endl;
+  for (uint32_t c = 0; c < candidates.size (); c++)
+    {
+      std::cout << "*** " << candidates[c].spec << " ***" << std::endl;
+      for (std::map<std::string, RunningStats>::iterator it = stats[c].begin (); it != stats[c].end (); ++it)
+        {
+          std::cout << "\t " << std::setw (12) << std::left << it->first
+                    << it->second.GetMean () << " +- " << it->second.GetHalfWidth (confidence) << std::endl;
+        }
+    }
+  for (uint32_t c = 1; c < candidates.size (); c++)
+    {
+      std::cout << "*** paired difference " << candidates[c].spec << " - " << candidates[0].spec << " ***" << std::endl;
+      for (std::map<std::string, RunningStats>::iterator it = diffs[c].begin (); it != diffs[c].end (); ++it)
+        {
+          double mean = it->second.GetMean ();
+          double hw = it->second.GetHalfWidth (confidence);
+          std::cout << "\t " << std::setw (12) << std::left << it->first
+                    << mean << " +- " << hw
+                    << (std::fabs (mean) > hw ? "  (significant)" : "") << std::endl;
+        }
+    }
+  // machine readable summary, one metric per line
+  for (uint32_t c = 0; c < candidates.size (); c++)
+    {
+      std::string prefix = candidates.size () > 1 ? candidates[c].spec + ":" : "";
+      for (std::map<std::string, RunningStats>::iterator it = stats[c].begin (); it != stats[c].end (); ++it)
+        {
+          std::cout << "summary " << prefix << it->first << " " << it->second.GetMean () << std::endl;
+        }
+    }
+
+  return 0;
+}
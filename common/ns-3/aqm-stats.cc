@@ -0,0 +1,73 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aqm-stats.h"
+
+namespace ns3 {
+
+AqmStats::AqmStats ()
+{
+  Reset ();
+}
+
+void
+AqmStats::Reset (void)
+{
+  for (uint32_t i = 0; i < N_EVENTS; i++)
+    {
+      m_packets[i] = 0;
+      m_bytes[i] = 0;
+    }
+}
+
+AqmStats::Snapshot
+AqmStats::GetSnapshot (Time now) const
+{
+  Snapshot s;
+  s.time = now;
+  for (uint32_t i = 0; i < N_EVENTS; i++)
+    {
+      s.packets[i] = m_packets[i];
+      s.bytes[i] = m_bytes[i];
+    }
+  return s;
+}
+
+AqmStats::Rates
+AqmStats::GetRates (const Snapshot &from, const Snapshot &to)
+{
+  Rates r;
+  r.interval = to.time - from.time;
+  double seconds = r.interval.GetSeconds ();
+  for (uint32_t i = 0; i < N_EVENTS; i++)
+    {
+      if (seconds > 0)
+        {
+          r.packets[i] = (to.packets[i] - from.packets[i]) / seconds;
+          r.bytes[i] = (to.bytes[i] - from.bytes[i]) / seconds;
+        }
+      else
+        {
+          r.packets[i] = 0;
+          r.bytes[i] = 0;
+        }
+    }
+  return r;
+}
+
+} // namespace ns3
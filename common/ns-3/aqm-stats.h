@@ -0,0 +1,137 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AQM_STATS_H
+#define AQM_STATS_H
+
+#include <stdint.h>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief 64-bit packet and byte counters of the events of an AQM queue disc.
+ *
+ * The counters only ever grow. A consumer that wants rates takes a
+ * Snapshot at its own cadence and computes the rates over the delta
+ * from its previous snapshot, so any number of consumers can poll the
+ * same queue disc without resetting anything.
+ */
+class AqmStats
+{
+public:
+  /**
+   * \brief Events counted
+   */
+  enum Event
+  {
+    ENQUEUE,            //!< Packet accepted into the queue
+    DEQUEUE,            //!< Packet handed to the device
+    FORCED_DROP,        //!< Drop due to queue limit: reactive
+    EARLY_DROP,         //!< Early probability drop: proactive
+    MARK,               //!< Packet marked instead of dropped
+    N_EVENTS            //!< Number of event types
+  };
+
+  /**
+   * \brief The counters at a point in time
+   */
+  struct Snapshot
+  {
+    Time time;                          //!< Time of the snapshot
+    uint64_t packets[N_EVENTS];         //!< Packets per event type
+    uint64_t bytes[N_EVENTS];           //!< Bytes per event type
+  };
+
+  /**
+   * \brief Rates between two snapshots
+   */
+  struct Rates
+  {
+    Time interval;                      //!< Length of the window
+    double packets[N_EVENTS];           //!< Packets per second per event type
+    double bytes[N_EVENTS];             //!< Bytes per second per event type
+  };
+
+  /**
+   * \brief AqmStats Constructor
+   */
+  AqmStats ();
+
+  /**
+   * \brief Set all the counters to zero.
+   */
+  void Reset (void);
+
+  /**
+   * \brief Count an event.
+   *
+   * \param event The event type
+   * \param bytes The size of the packet
+   */
+  void Record (Event event, uint32_t bytes)
+  {
+    m_packets[event]++;
+    m_bytes[event] += bytes;
+  }
+
+  /**
+   * \param event The event type
+   * \returns The packets counted for the event type
+   */
+  uint64_t GetPackets (Event event) const
+  {
+    return m_packets[event];
+  }
+
+  /**
+   * \param event The event type
+   * \returns The bytes counted for the event type
+   */
+  uint64_t GetBytes (Event event) const
+  {
+    return m_bytes[event];
+  }
+
+  /**
+   * \brief Copy the counters.
+   *
+   * \param now The time stamp of the snapshot
+   * \returns The snapshot
+   */
+  Snapshot GetSnapshot (Time now) const;
+
+  /**
+   * \brief Compute the rates over the window between two snapshots.
+   *
+   * \param from The earlier snapshot
+   * \param to The later snapshot
+   * \returns The rates, zero if the window is empty
+   */
+  static Rates GetRates (const Snapshot &from, const Snapshot &to);
+
+private:
+  uint64_t m_packets[N_EVENTS];         //!< Packets per event type
+  uint64_t m_bytes[N_EVENTS];           //!< Bytes per event type
+};
+
+} // namespace ns3
+
+#endif // AQM_STATS_H
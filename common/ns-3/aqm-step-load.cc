@@ -0,0 +1,478 @@
+/*
+ * This script measures how an AQM queue disc responds to load changes
+ * on a dumbbell, to compare controllers (e.g. the PI law against the
+ * PID controller of PiQueueDisc with anti-windup):
+ *
+ *   t = 0                  nFlows TCP flows start
+ *   t = stepTime           stepFlows more TCP flows start (load step)
+ *   udpStart .. udpStop    a UDP source at udpRate saturates the bottleneck
+ *
+ * The queue length and the drop or marking probability are sampled every
+ * sampleInterval; the queue is smoothed by an exponential average with
+ * time constant smoothing, since the raw queue of TCP flows never
+ * settles. Reported:
+ *
+ *   step.overshoot         peak of the smoothed queue between the step
+ *                          and udpStart, above target, relative to target
+ *   step.settlingTime      time from the step until the smoothed queue
+ *                          stays within band * target of target
+ *   saturation.maxProb     highest probability under the UDP load
+ *   saturation.recoveryTime       time from udpStop until the smoothed
+ *                          queue stays within the band again
+ *   saturation.probRecoveryTime   time from udpStop until the probability
+ *                          is back at its mean of the second half of the
+ *                          step phase, which integrator windup delays
+ *
+ * A time is -1 if the queue (or probability) did not get there in the
+ * phase.
+ *
+ * Examples:
+ *   ./waf --run "aqm-step-load"
+ *   ./waf --run "aqm-step-load --aqm=ns3::PiQueueDisc[Controller=PID|AntiWindup=BACK_CALCULATION]"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ts-store.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("AqmStepLoad");
+
+/**
+ * A queue disc type together with the attributes it is configured with,
+ * e.g. "ns3::PiQueueDisc[A=0.00003|B=0.00002]"
+ */
+struct AqmSpec
+{
+  std::string spec;                                             //!< As given by the user
+  std::string type;                                             //!< TypeId name
+  std::vector<std::pair<std::string, std::string> > attributes; //!< Attribute name/value pairs
+};
+
+/**
+ * Parse "TypeId[Name=Value|Name=Value]" into an AqmSpec
+ */
+static AqmSpec
+ParseAqmSpec (std::string spec)
+{
+  AqmSpec s;
+  s.spec = spec;
+  std::string::size_type open = spec.find ('[');
+  s.type = spec.substr (0, open);
+  if (open != std::string::npos)
+    {
+      std::string::size_type close = spec.rfind (']');
+      NS_ABORT_MSG_IF (close == std::string::npos || close < open, "Malformed queue disc " << spec);
+      std::string attrs = spec.substr (open + 1, close - open - 1);
+      std::replace (attrs.begin (), attrs.end (), '|', ' ');
+      std::istringstream iss (attrs);
+      std::string token;
+      while (iss >> token)
+        {
+          std::string::size_type eq = token.find ('=');
+          NS_ABORT_MSG_IF (eq == std::string::npos, "Malformed attribute " << token);
+          s.attributes.push_back (std::make_pair (token.substr (0, eq), token.substr (eq + 1)));
+        }
+    }
+  return s;
+}
+
+/**
+ * The drop or marking probability of a BLUE or PI queue disc, the classic
+ * drop probability of DualPI2, or a null callback for other queue discs
+ */
+static Callback<double>
+GetProbabilityCallback (Ptr<QueueDisc> qd)
+{
+  Ptr<BlueQueueDisc> blue = DynamicCast<BlueQueueDisc> (qd);
+  Ptr<PiQueueDisc> pi = DynamicCast<PiQueueDisc> (qd);
+  Ptr<DualPi2QueueDisc> dualPi2 = DynamicCast<DualPi2QueueDisc> (qd);
+  if (blue != 0)
+    {
+      return MakeCallback (&BlueQueueDisc::GetPmark, blue);
+    }
+  if (pi != 0)
+    {
+      return MakeCallback (&PiQueueDisc::GetDropProbability, pi);
+    }
+  if (dualPi2 != 0)
+    {
+      return MakeCallback (&DualPi2QueueDisc::GetClassicProbability, dualPi2);
+    }
+  return MakeNullCallback<double> ();
+}
+
+/**
+ * Samples the bottleneck queue disc, smooths the queue length and
+ * computes the step response metrics at the end.
+ */
+class StepRecorder
+{
+public:
+  StepRecorder (Ptr<QueueDisc> qd, Time interval, Time smoothing)
+    : m_qd (qd),
+      m_probability (GetProbabilityCallback (qd)),
+      m_interval (interval),
+      m_smoothing (smoothing),
+      m_smoothed (0),
+      m_store (0)
+  {
+  }
+
+  /**
+   * \brief Write the samples into a store
+   * \param store The open store, or 0
+   * \param run The run the series are stored under
+   */
+  void SetStore (aqm::TsWriter *store, uint32_t run)
+  {
+    m_store = store;
+    if (m_store)
+      {
+        m_queueSeries = m_store->BeginSeries (run, "queue");
+        m_smoothedSeries = m_store->BeginSeries (run, "smoothedQueue");
+        m_probSeries = m_store->BeginSeries (run, "prob");
+      }
+  }
+
+  void Start (void)
+  {
+    Simulator::ScheduleNow (&StepRecorder::Sample, this);
+  }
+
+  /**
+   * \returns The peak of the smoothed queue in [from, to) above target,
+   * relative to target, or 0 if it stayed below
+   */
+  double GetOvershoot (double from, double to, double target) const
+  {
+    double peak = 0;
+    for (size_t i = 0; i < m_time.size (); i++)
+      {
+        if (m_time[i] >= from && m_time[i] < to)
+          {
+            peak = std::max (peak, m_queue[i]);
+          }
+      }
+    return std::max (peak - target, 0.0) / target;
+  }
+
+  /**
+   * \returns The time from from until the smoothed queue stays within
+   * band * target of target up to to, or -1 if it is outside at the end
+   */
+  double GetSettlingTime (double from, double to, double target, double band) const
+  {
+    double settled = from;
+    bool inside = true;
+    for (size_t i = 0; i < m_time.size (); i++)
+      {
+        if (m_time[i] < from || m_time[i] >= to)
+          {
+            continue;
+          }
+        inside = std::fabs (m_queue[i] - target) <= band * target;
+        if (!inside)
+          {
+            settled = m_time[i] + m_interval.GetSeconds ();
+          }
+      }
+    return inside ? settled - from : -1;
+  }
+
+  /**
+   * \returns The mean probability in [from, to)
+   */
+  double GetMeanProbability (double from, double to) const
+  {
+    double sum = 0;
+    uint32_t n = 0;
+    for (size_t i = 0; i < m_time.size (); i++)
+      {
+        if (m_time[i] >= from && m_time[i] < to)
+          {
+            sum += m_prob[i];
+            n++;
+          }
+      }
+    return n ? sum / n : 0.0;
+  }
+
+  /**
+   * \returns The highest probability in [from, to)
+   */
+  double GetMaxProbability (double from, double to) const
+  {
+    double peak = 0;
+    for (size_t i = 0; i < m_time.size (); i++)
+      {
+        if (m_time[i] >= from && m_time[i] < to)
+          {
+            peak = std::max (peak, m_prob[i]);
+          }
+      }
+    return peak;
+  }
+
+  /**
+   * \returns The time from from until the probability is at most level
+   * for the first time before to, or -1
+   */
+  double GetProbabilityRecoveryTime (double from, double to, double level) const
+  {
+    for (size_t i = 0; i < m_time.size (); i++)
+      {
+        if (m_time[i] >= from && m_time[i] < to && m_prob[i] <= level)
+          {
+            return m_time[i] - from;
+          }
+      }
+    return -1;
+  }
+
+private:
+  void Sample (void)
+  {
+    double t = Simulator::Now ().GetSeconds ();
+    double queue = m_qd->GetNPackets ();
+    double prob = m_probability.IsNull () ? 0.0 : m_probability ();
+    double weight = 1 - std::exp (-m_interval.GetSeconds () / m_smoothing.GetSeconds ());
+    m_smoothed += weight * (queue - m_smoothed);
+    m_time.push_back (t);
+    m_queue.push_back (m_smoothed);
+    m_prob.push_back (prob);
+    if (m_store)
+      {
+        m_store->Append (m_queueSeries, t, queue);
+        m_store->Append (m_smoothedSeries, t, m_smoothed);
+        m_store->Append (m_probSeries, t, prob);
+      }
+    Simulator::Schedule (m_interval, &StepRecorder::Sample, this);
+  }
+
+  Ptr<QueueDisc> m_qd;                  //!< The bottleneck queue disc
+  Callback<double> m_probability;       //!< Drop or marking probability, may be null
+  Time m_interval;                      //!< Sampling interval
+  Time m_smoothing;                     //!< Time constant of the queue average
+  double m_smoothed;                    //!< Smoothed queue length in packets
+  std::vector<double> m_time;           //!< Sample times in seconds
+  std::vector<double> m_queue;          //!< Smoothed queue length of each sample
+  std::vector<double> m_prob;           //!< Probability of each sample
+  aqm::TsWriter *m_store;               //!< Store of the series, may be 0
+  uint32_t m_queueSeries;               //!< Store series of the queue length
+  uint32_t m_smoothedSeries;            //!< Store series of the smoothed queue length
+  uint32_t m_probSeries;                //!< Store series of the probability
+};
+
+int main (int argc, char *argv[])
+{
+  std::string aqm = "ns3::PiQueueDisc";
+  uint32_t nFlows = 10;
+  uint32_t stepFlows = 20;
+  double stepTime = 30;
+  std::string udpRate = "20Mbps";
+  double udpStart = 60;
+  double udpStop = 70;
+  double simDuration = 100;
+  std::string bottleneckBandwidth = "10Mbps";
+  std::string bottleneckDelay = "50ms";
+  std::string accessBandwidth = "100Mbps";
+  std::string accessDelay = "5ms";
+  double target = 50;
+  double band = 0.2;
+  double smoothing = 0.5;
+  double sampleInterval = 0.01;
+  std::string tsStore = "";     // time-series store file, empty disables it
+
+  Config::SetDefault ("ns3::Queue::MaxPackets", UintegerValue (13));
+  Config::SetDefault ("ns3::PfifoFastQueueDisc::Limit", UintegerValue (1000));
+
+  Config::SetDefault ("ns3::TcpSocket::DelAckTimeout", TimeValue (Seconds (0)));
+  Config::SetDefault ("ns3::TcpSocket::InitialCwnd", UintegerValue (1));
+  Config::SetDefault ("ns3::TcpSocketBase::LimitedTransmit", BooleanValue (false));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::TcpSocketBase::WindowScaling", BooleanValue (true));
+
+  Config::SetDefault ("ns3::PiQueueDisc::MeanPktSize", UintegerValue (1000));
+  Config::SetDefault ("ns3::PiQueueDisc::Mode", StringValue ("QUEUE_MODE_PACKETS"));
+  Config::SetDefault ("ns3::PiQueueDisc::QueueRef", DoubleValue (50));
+  Config::SetDefault ("ns3::PiQueueDisc::QueueLimit", DoubleValue (200));
+
+  Config::SetDefault ("ns3::BlueQueueDisc::Mode", StringValue ("QUEUE_MODE_PACKETS"));
+  Config::SetDefault ("ns3::BlueQueueDisc::QueueLimit", UintegerValue (200));
+
+  // Attribute defaults above can be overridden from the command line,
+  // e.g. --ns3::PiQueueDisc::Controller=PID
+  CommandLine cmd;
+  cmd.AddValue ("aqm", "Bottleneck queue disc, e.g. ns3::PiQueueDisc[Controller=PID|Kd=0.00001]", aqm);
+  cmd.AddValue ("nFlows", "Number of TCP flows from the start", nFlows);
+  cmd.AddValue ("stepFlows", "Number of TCP flows added at stepTime", stepFlows);
+  cmd.AddValue ("stepTime", "Time of the load step in seconds", stepTime);
+  cmd.AddValue ("udpRate", "Rate of the UDP load, 0 to disable it", udpRate);
+  cmd.AddValue ("udpStart", "Start of the UDP load in seconds", udpStart);
+  cmd.AddValue ("udpStop", "End of the UDP load in seconds", udpStop);
+  cmd.AddValue ("simDuration", "Simulation duration in seconds", simDuration);
+  cmd.AddValue ("bottleneckBandwidth", "Bottleneck link rate", bottleneckBandwidth);
+  cmd.AddValue ("bottleneckDelay", "Bottleneck link delay", bottleneckDelay);
+  cmd.AddValue ("accessBandwidth", "Access link rate", accessBandwidth);
+  cmd.AddValue ("accessDelay", "Access link delay", accessDelay);
+  cmd.AddValue ("target", "Queue length the metrics are relative to, in packets (QueueRef of PI)", target);
+  cmd.AddValue ("band", "Settling band, as a fraction of target", band);
+  cmd.AddValue ("smoothing", "Time constant of the queue average in seconds", smoothing);
+  cmd.AddValue ("sampleInterval", "Seconds between two samples of the queue", sampleInterval);
+  cmd.AddValue ("tsStore", "Time-series store of the samples (empty disables it)", tsStore);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (!(stepTime < udpStart && udpStart < udpStop && udpStop < simDuration - 1),
+                   "The phases must be in order: stepTime < udpStart < udpStop < simDuration - 1");
+  NS_ABORT_MSG_IF (target <= 0, "The target must be positive");
+
+  AqmSpec spec = ParseAqmSpec (aqm);
+
+  NodeContainer hosts;                  // TCP sources, UDP source, sink
+  hosts.Create (3);
+  NodeContainer routers;
+  routers.Create (2);
+
+  InternetStackHelper internet;
+  internet.InstallAll ();
+
+  TrafficControlHelper tchPfifo;
+  uint16_t handle = tchPfifo.SetRootQueueDisc ("ns3::PfifoFastQueueDisc");
+  tchPfifo.AddInternalQueues (handle, 3, "ns3::DropTailQueue", "MaxPackets", UintegerValue (1000));
+
+  PointToPointHelper accessLink;
+  accessLink.SetQueue ("ns3::DropTailQueue");
+  accessLink.SetDeviceAttribute ("DataRate", StringValue (accessBandwidth));
+  accessLink.SetChannelAttribute ("Delay", StringValue (accessDelay));
+
+  PointToPointHelper bottleneckLink;
+  bottleneckLink.SetQueue ("ns3::DropTailQueue");
+  bottleneckLink.SetDeviceAttribute ("DataRate", StringValue (bottleneckBandwidth));
+  bottleneckLink.SetChannelAttribute ("Delay", StringValue (bottleneckDelay));
+
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.255.255.0");
+
+  // The bottleneck: AQM on the forward device, FIFO on the reverse one
+  NetDeviceContainer devices = bottleneckLink.Install (routers.Get (0), routers.Get (1));
+  TrafficControlHelper tchAqm;
+  uint16_t aqmHandle = tchAqm.SetRootQueueDisc (spec.type);
+  if (TypeId::LookupByName (spec.type).IsChildOf (FqAqmQueueDisc::GetTypeId ()))
+    {
+      // The flow-queuing discs tell the flows apart by their packet filter
+      tchAqm.AddPacketFilter (aqmHandle, "ns3::FqCoDelIpv4PacketFilter");
+    }
+  Ptr<QueueDisc> bottleneck = tchAqm.Install (devices.Get (0)).Get (0);
+  if (DynamicCast<BlueQueueDisc> (bottleneck) != 0)
+    {
+      bottleneck->SetAttribute ("LinkBandwidth", StringValue (bottleneckBandwidth));
+    }
+  for (uint32_t j = 0; j < spec.attributes.size (); j++)
+    {
+      bottleneck->SetAttribute (spec.attributes[j].first, StringValue (spec.attributes[j].second));
+    }
+  tchPfifo.Install (devices.Get (1));
+  address.NewNetwork ();
+  address.Assign (devices);
+
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      devices = accessLink.Install (hosts.Get (i), routers.Get (0));
+      tchPfifo.Install (devices);
+      address.NewNetwork ();
+      address.Assign (devices);
+    }
+  devices = accessLink.Install (routers.Get (1), hosts.Get (2));
+  tchPfifo.Install (devices);
+  address.NewNetwork ();
+  Ipv4Address sinkAddress = address.Assign (devices).GetAddress (1);
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  double stopTime = simDuration;
+  uint16_t tcpPort = 50000;
+  uint16_t udpPort = 50001;
+
+  PacketSinkHelper tcpSink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), tcpPort));
+  PacketSinkHelper udpSink ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), udpPort));
+  ApplicationContainer sinkApps;
+  sinkApps.Add (tcpSink.Install (hosts.Get (2)));
+  sinkApps.Add (udpSink.Install (hosts.Get (2)));
+  sinkApps.Start (Seconds (0));
+  sinkApps.Stop (Seconds (stopTime));
+
+  Ptr<UniformRandomVariable> startVar = CreateObject<UniformRandomVariable> ();
+  startVar->SetAttribute ("Max", DoubleValue (1.0));
+
+  BulkSendHelper ftp ("ns3::TcpSocketFactory", InetSocketAddress (sinkAddress, tcpPort));
+  ftp.SetAttribute ("SendSize", UintegerValue (1000));
+  ApplicationContainer sourceApps;
+  for (uint32_t i = 0; i < nFlows + stepFlows; i++)
+    {
+      ApplicationContainer app = ftp.Install (hosts.Get (0));
+      double start = (i < nFlows ? 0 : stepTime) + startVar->GetValue ();
+      app.Start (Seconds (start));
+      sourceApps.Add (app);
+    }
+  sourceApps.Stop (Seconds (stopTime - 1));
+
+  if (DataRate (udpRate).GetBitRate () > 0)
+    {
+      OnOffHelper cbr ("ns3::UdpSocketFactory", InetSocketAddress (sinkAddress, udpPort));
+      cbr.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1]"));
+      cbr.SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+      cbr.SetAttribute ("DataRate", DataRateValue (DataRate (udpRate)));
+      cbr.SetAttribute ("PacketSize", UintegerValue (1000));
+      ApplicationContainer udpApp = cbr.Install (hosts.Get (1));
+      udpApp.Start (Seconds (udpStart));
+      udpApp.Stop (Seconds (udpStop));
+    }
+
+  aqm::TsWriter store;
+  if (!tsStore.empty ())
+    {
+      store.Open (tsStore);
+    }
+  StepRecorder recorder (bottleneck, Seconds (sampleInterval), Seconds (smoothing));
+  recorder.SetStore (store.IsOpen () ? &store : 0, RngSeedManager::GetRun ());
+  recorder.Start ();
+
+  Simulator::Stop (Seconds (stopTime));
+  Simulator::Run ();
+  store.Close ();
+
+  double overshoot = recorder.GetOvershoot (stepTime, udpStart, target);
+  double settlingTime = recorder.GetSettlingTime (stepTime, udpStart, target, band);
+  double maxProb = recorder.GetMaxProbability (udpStart, udpStop);
+  double recoveryTime = recorder.GetSettlingTime (udpStop, stopTime - 1, target, band);
+  double probBefore = recorder.GetMeanProbability ((stepTime + udpStart) / 2, udpStart);
+  double probRecoveryTime = recorder.GetProbabilityRecoveryTime (udpStop, stopTime - 1, probBefore);
+
+  std::cout << "step response of " << spec.spec << " (target " << target << " packets, band "
+            << band * 100 << "%)" << std::endl;
+  std::cout << "load step at " << stepTime << " s: overshoot " << overshoot * 100
+            << "%, settling time " << settlingTime << " s" << std::endl;
+  std::cout << "saturation " << udpStart << "-" << udpStop << " s: max probability " << maxProb
+            << ", queue recovery " << recoveryTime << " s, probability back to "
+            << probBefore << " after " << probRecoveryTime << " s" << std::endl;
+
+  std::cout << "summary step.overshoot " << overshoot << std::endl
+            << "summary step.settlingTime " << settlingTime << std::endl
+            << "summary saturation.maxProb " << maxProb << std::endl
+            << "summary saturation.recoveryTime " << recoveryTime << std::endl
+            << "summary saturation.probRecoveryTime " << probRecoveryTime << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/simulator.h"
+#include "aqm-telemetry.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("AqmTelemetry");
+
+NS_OBJECT_ENSURE_REGISTERED (AqmTelemetry);
+
+TypeId AqmTelemetry::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::AqmTelemetry")
+    .SetParent<Object> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<AqmTelemetry> ()
+    .AddAttribute ("SegmentName",
+                   "Name of the shared-memory segment; empty for aqm-<pid>",
+                   StringValue (""),
+                   MakeStringAccessor (&AqmTelemetry::m_segmentName),
+                   MakeStringChecker ())
+    .AddAttribute ("Interval",
+                   "Simulation time between two samples",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&AqmTelemetry::m_interval),
+                   MakeTimeChecker ())
+    .AddAttribute ("Capacity",
+                   "Number of records kept in the ring before the oldest are overwritten",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&AqmTelemetry::m_capacity),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("KeepSegment",
+                   "True to leave the segment in /dev/shm after the simulation",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&AqmTelemetry::m_keepSegment),
+                   MakeBooleanChecker ())
+  ;
+
+  return tid;
+}
+
+AqmTelemetry::AqmTelemetry ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+AqmTelemetry::~AqmTelemetry ()
+{
+  NS_LOG_FUNCTION (this);
+  m_writer.Close (!m_keepSegment);
+}
+
+void
+AqmTelemetry::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Remove (m_sampleEvent);
+  m_writer.Close (!m_keepSegment);
+  m_sources.clear ();
+  Object::DoDispose ();
+}
+
+void
+AqmTelemetry::Watch (Ptr<QueueDisc> queueDisc, std::string name)
+{
+  Watch (queueDisc, name, MakeNullCallback<double> (), 0);
+}
+
+void
+AqmTelemetry::Watch (Ptr<QueueDisc> queueDisc, std::string name,
+                     Callback<double> probability, const AqmStats *stats)
+{
+  NS_LOG_FUNCTION (this << queueDisc << name << stats);
+  NS_ABORT_MSG_IF (m_writer.IsOpen (), "Watch must be called before Start");
+  NS_ABORT_MSG_IF (m_sources.size () == aqm::TELEMETRY_MAX_SOURCES,
+                   "At most " << aqm::TELEMETRY_MAX_SOURCES << " queue discs per telemetry segment");
+  Source s;
+  s.queueDisc = queueDisc;
+  s.name = name;
+  s.probability = probability;
+  s.stats = stats;
+  m_sources.push_back (s);
+}
+
+void
+AqmTelemetry::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_segmentName.empty ())
+    {
+      std::ostringstream name;
+      name << "aqm-" << getpid ();
+      m_segmentName = name.str ();
+    }
+  if (!m_writer.Create (m_segmentName, m_capacity, m_interval.GetNanoSeconds ()))
+    {
+      NS_ABORT_MSG ("Cannot create the telemetry segment " << m_segmentName << ": " << std::strerror (errno));
+    }
+  for (uint32_t i = 0; i < m_sources.size (); i++)
+    {
+      m_writer.AddSource (m_sources[i].name);
+    }
+  m_writer.Start ();
+  NS_LOG_INFO ("Publishing telemetry in /dev/shm/" << m_segmentName);
+  m_sampleEvent = Simulator::ScheduleNow (&AqmTelemetry::Sample, this);
+}
+
+void
+AqmTelemetry::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Remove (m_sampleEvent);
+  m_writer.Close (!m_keepSegment);
+}
+
+void
+AqmTelemetry::Sample (void)
+{
+  aqm::TelemetrySample sample;
+  std::memset (&sample, 0, sizeof (sample));
+  sample.time = Simulator::Now ().GetNanoSeconds ();
+  for (uint32_t i = 0; i < m_sources.size (); i++)
+    {
+      const Source &s = m_sources[i];
+      sample.source = i;
+      sample.queuePackets = s.queueDisc->GetNPackets ();
+      sample.queueBytes = s.queueDisc->GetNBytes ();
+      sample.prob = s.probability.IsNull () ? -1 : s.probability ();
+      for (uint32_t e = 0; e < AqmStats::N_EVENTS; e++)
+        {
+          sample.packets[e] = s.stats ? s.stats->GetPackets (AqmStats::Event (e)) : 0;
+          sample.bytes[e] = s.stats ? s.stats->GetBytes (AqmStats::Event (e)) : 0;
+        }
+      m_writer.Publish (sample);
+    }
+  m_sampleEvent = Simulator::Schedule (m_interval, &AqmTelemetry::Sample, this);
+}
+
+} // namespace ns3
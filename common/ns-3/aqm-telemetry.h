@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AQM_TELEMETRY_H
+#define AQM_TELEMETRY_H
+
+#include <string>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/queue-disc.h"
+#include "aqm-stats.h"
+#include "telemetry-ring.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Publishes periodic samples of queue discs into shared memory.
+ *
+ * Every Interval of simulation time the queue length, the drop or
+ * marking probability and the AqmStats counters of every watched queue
+ * disc are copied into a fixed-layout record of a lock-free ring in the
+ * POSIX shared-memory segment SegmentName (see tools/telemetry), where
+ * the aqm-telemetry reader can tail it while the simulation runs. The
+ * segment is created and mapped by Start; a sample only stores into the
+ * mapped ring, without system calls or formatting. The segment is
+ * removed when the publisher is disposed.
+ */
+class AqmTelemetry : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief AqmTelemetry Constructor
+   */
+  AqmTelemetry ();
+
+  /**
+   * \brief AqmTelemetry Destructor
+   */
+  virtual ~AqmTelemetry ();
+
+  /**
+   * \brief Add a queue disc whose queue length is sampled.
+   *
+   * \param queueDisc The queue disc
+   * \param name The name shown by the reader
+   */
+  void Watch (Ptr<QueueDisc> queueDisc, std::string name);
+
+  /**
+   * \brief Add an AQM queue disc whose controller state and event
+   * counters are sampled too.
+   *
+   * For example, for a PiQueueDisc pi:
+   * Watch (pi, "bottleneck", MakeCallback (&PiQueueDisc::GetDropProbability, pi), &pi->GetAqmStats ())
+   *
+   * \param queueDisc The queue disc
+   * \param name The name shown by the reader
+   * \param probability Returns the drop or marking probability
+   * \param stats The event counters of the queue disc
+   */
+  void Watch (Ptr<QueueDisc> queueDisc, std::string name,
+              Callback<double> probability, const AqmStats *stats);
+
+  /**
+   * \brief Create the segment and schedule the first sample now.
+   */
+  void Start (void);
+
+  /**
+   * \brief Stop sampling and mark the segment finished.
+   */
+  void Stop (void);
+
+protected:
+  /**
+   * \brief Dispose of the object
+   */
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief A watched queue disc
+   */
+  struct Source
+  {
+    Ptr<QueueDisc> queueDisc;           //!< The queue disc
+    std::string name;                   //!< Name for the reader
+    Callback<double> probability;       //!< Drop or marking probability, may be null
+    const AqmStats *stats;              //!< Event counters, may be null
+  };
+
+  /**
+   * \brief Publish one record per source and schedule the next sample.
+   */
+  void Sample (void);
+
+  std::string m_segmentName;            //!< Shared-memory object name
+  Time m_interval;                      //!< Sampling interval
+  uint32_t m_capacity;                  //!< Records kept in the ring
+  bool m_keepSegment;                   //!< Leave the segment behind when disposed
+
+  std::vector<Source> m_sources;        //!< Watched queue discs
+  aqm::TelemetryWriter m_writer;        //!< The mapped segment
+  EventId m_sampleEvent;                //!< Next sample
+};
+
+} // namespace ns3
+
+#endif // AQM_TELEMETRY_H
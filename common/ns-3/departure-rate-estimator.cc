@@ -0,0 +1,73 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "departure-rate-estimator.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DepartureRateEstimator");
+
+DepartureRateEstimator::DepartureRateEstimator (Time window)
+  : m_rate (0),
+    m_last (Seconds (0))
+{
+  SetWindow (window);
+}
+
+void
+DepartureRateEstimator::SetWindow (Time window)
+{
+  NS_ASSERT_MSG (window.IsStrictlyPositive (), "The averaging window must be positive");
+  m_window = window.GetSeconds ();
+}
+
+void
+DepartureRateEstimator::Reset (void)
+{
+  m_rate = 0;
+  m_last = Seconds (0);
+}
+
+void
+DepartureRateEstimator::NotifyDeparture (uint32_t bytes, Time now)
+{
+  double bytesInWindow = m_rate * m_window;
+  m_rate = (bytesInWindow + bytes) / ((now - m_last).GetSeconds () + m_window);
+  m_last = now;
+  NS_LOG_LOGIC ("Departure rate " << m_rate << " bytes/s");
+}
+
+double
+DepartureRateEstimator::GetRate (Time now) const
+{
+  return m_rate * m_window / ((now - m_last).GetSeconds () + m_window);
+}
+
+double
+DepartureRateEstimator::GetUtilization (Time now, DataRate link) const
+{
+  if (link.GetBitRate () == 0)
+    {
+      return 0;
+    }
+  return GetRate (now) * 8.0 / link.GetBitRate ();
+}
+
+} // namespace ns3
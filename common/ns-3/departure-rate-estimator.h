@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DEPARTURE_RATE_ESTIMATOR_H
+#define DEPARTURE_RATE_ESTIMATOR_H
+
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Time sliding window estimator of the departure rate of a queue.
+ *
+ * Every departure folds the bytes sent into an average that decays over
+ * the window length (Clark and Fang's TSW), so the estimate costs one
+ * division per packet and no per-packet history. Queue discs call
+ * NotifyDeparture from DoDequeue and compare GetRate or GetUtilization
+ * with the capacity of the link.
+ */
+class DepartureRateEstimator
+{
+public:
+  /**
+   * \brief DepartureRateEstimator Constructor
+   *
+   * \param window The averaging window
+   */
+  DepartureRateEstimator (Time window = MilliSeconds (100));
+
+  /**
+   * \brief Set the averaging window.
+   *
+   * \param window The averaging window
+   */
+  void SetWindow (Time window);
+
+  /**
+   * \brief Forget the departures seen so far.
+   */
+  void Reset (void);
+
+  /**
+   * \brief Account for a departing packet.
+   *
+   * \param bytes The size of the packet
+   * \param now The departure time
+   */
+  void NotifyDeparture (uint32_t bytes, Time now);
+
+  /**
+   * \brief Get the estimated departure rate, decayed over the time since
+   * the last departure.
+   *
+   * \param now The current time
+   * \returns The departure rate in bytes per second
+   */
+  double GetRate (Time now) const;
+
+  /**
+   * \brief Get the estimated utilization of a link.
+   *
+   * \param now The current time
+   * \param link The capacity of the link
+   * \returns The departure rate divided by the link capacity, 0 if the capacity is 0
+   */
+  double GetUtilization (Time now, DataRate link) const;
+
+private:
+  double m_window;                              //!< Averaging window in seconds
+  double m_rate;                                //!< Estimated rate in bytes per second
+  Time m_last;                                  //!< Time of the last departure
+};
+
+} // namespace ns3
+
+#endif // DEPARTURE_RATE_ESTIMATOR_H
@@ -0,0 +1,383 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/simulator.h"
+#include "ns3/abort.h"
+#include "ns3/packet-filter.h"
+#include "ns3/drop-tail-queue.h"
+#include "dual-pi2-queue-disc.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DualPi2QueueDisc");
+
+NS_OBJECT_ENSURE_REGISTERED (DualPi2QueueDisc);
+
+TypeId DualPi2QueueDisc::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DualPi2QueueDisc")
+    .SetParent<QueueDisc> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<DualPi2QueueDisc> ()
+    .AddAttribute ("QueueLimit",
+                   "Queue limit of both queues together, in packets",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&DualPi2QueueDisc::m_queueLimit),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Target",
+                   "Target sojourn time of the classic queue",
+                   TimeValue (MilliSeconds (15)),
+                   MakeTimeAccessor (&DualPi2QueueDisc::m_target),
+                   MakeTimeChecker ())
+    .AddAttribute ("TUpdate",
+                   "Time between two updates of the base probability",
+                   TimeValue (MilliSeconds (16)),
+                   MakeTimeAccessor (&DualPi2QueueDisc::m_tUpdate),
+                   MakeTimeChecker ())
+    .AddAttribute ("Alpha",
+                   "Integral gain of the base probability, per second of sojourn time",
+                   DoubleValue (0.16),
+                   MakeDoubleAccessor (&DualPi2QueueDisc::m_alpha),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("Beta",
+                   "Proportional gain of the base probability, per second of sojourn time",
+                   DoubleValue (3.2),
+                   MakeDoubleAccessor (&DualPi2QueueDisc::m_beta),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("CouplingFactor",
+                   "L4S marking probability per unit of base probability",
+                   DoubleValue (2.0),
+                   MakeDoubleAccessor (&DualPi2QueueDisc::m_coupling),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("L4sStepThreshold",
+                   "L4S sojourn time above which every L4S packet is marked",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&DualPi2QueueDisc::m_stepThreshold),
+                   MakeTimeChecker ())
+    .AddAttribute ("TimeShift",
+                   "Extra sojourn time the classic head needs to be served before the L4S head",
+                   TimeValue (MilliSeconds (30)),
+                   MakeTimeAccessor (&DualPi2QueueDisc::m_timeShift),
+                   MakeTimeChecker ())
+    .AddAttribute ("L4sClass",
+                   "Packet filter result of the packets of the L4S queue",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DualPi2QueueDisc::m_l4sClass),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+
+  return tid;
+}
+
+DualPi2QueueDisc::DualPi2QueueDisc ()
+  : QueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+  m_uv = CreateObject<UniformRandomVariable> ();
+}
+
+DualPi2QueueDisc::~DualPi2QueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DualPi2QueueDisc::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_uv = 0;
+  Simulator::Remove (m_rtrsEvent);
+  QueueDisc::DoDispose ();
+}
+
+double
+DualPi2QueueDisc::GetBaseProbability (void) const
+{
+  return m_baseProb;
+}
+
+double
+DualPi2QueueDisc::GetClassicProbability (void) const
+{
+  return m_baseProb * m_baseProb;
+}
+
+double
+DualPi2QueueDisc::GetL4sProbability (void) const
+{
+  return std::min (m_coupling * m_baseProb, 1.0);
+}
+
+DualPi2QueueDisc::Stats
+DualPi2QueueDisc::GetStats ()
+{
+  NS_LOG_FUNCTION (this);
+  return m_st;
+}
+
+const AqmStats &
+DualPi2QueueDisc::GetAqmStats (void) const
+{
+  return m_stats;
+}
+
+int64_t
+DualPi2QueueDisc::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_uv->SetStream (stream);
+  return 1;
+}
+
+bool
+DualPi2QueueDisc::Mark (Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << item);
+  return false;
+}
+
+bool
+DualPi2QueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << item);
+
+  uint32_t queue = CLASSIC;
+  if (GetNPacketFilters () > 0)
+    {
+      int32_t ret = Classify (item);
+      if (ret != PacketFilter::PF_NO_MATCH && (uint32_t) ret == m_l4sClass)
+        {
+          queue = L4S;
+        }
+    }
+
+  uint32_t nQueued = GetInternalQueue (CLASSIC)->GetNPackets () + GetInternalQueue (L4S)->GetNPackets ();
+  if (nQueued >= m_queueLimit)
+    {
+      // Drops due to queue limit: reactive
+      if (queue == L4S)
+        {
+          m_st.l4sForcedDrop++;
+        }
+      else
+        {
+          m_st.classicForcedDrop++;
+        }
+      m_stats.Record (AqmStats::FORCED_DROP, item->GetPacketSize ());
+      Drop (item);
+      return false;
+    }
+
+  bool isEnqueued = GetInternalQueue (queue)->Enqueue (item);
+  if (isEnqueued)
+    {
+      m_stats.Record (AqmStats::ENQUEUE, item->GetPacketSize ());
+      m_enqueueTimes[queue].push (Simulator::Now ());
+    }
+
+  NS_LOG_LOGIC ("\t classic packets " << GetInternalQueue (CLASSIC)->GetNPackets ());
+  NS_LOG_LOGIC ("\t L4S packets " << GetInternalQueue (L4S)->GetNPackets ());
+
+  return isEnqueued;
+}
+
+void
+DualPi2QueueDisc::InitializeParams (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_baseProb = 0.0;
+  m_prevDelay = Time (Seconds (0.0));
+  m_stats.Reset ();
+  m_st.classicEarlyDrop = 0;
+  m_st.classicForcedDrop = 0;
+  m_st.classicDequeued = 0;
+  m_st.classicSojournSum = 0;
+  m_st.classicMaxSojourn = 0;
+  m_st.l4sMarks = 0;
+  m_st.l4sEarlyDrop = 0;
+  m_st.l4sForcedDrop = 0;
+  m_st.l4sDequeued = 0;
+  m_st.l4sSojournSum = 0;
+  m_st.l4sMaxSojourn = 0;
+  m_rtrsEvent = Simulator::Schedule (m_tUpdate, &DualPi2QueueDisc::CalculateP, this);
+}
+
+void
+DualPi2QueueDisc::CalculateP (void)
+{
+  NS_LOG_FUNCTION (this);
+  Time delay = m_enqueueTimes[CLASSIC].empty () ? Time (Seconds (0.0))
+    : Simulator::Now () - m_enqueueTimes[CLASSIC].front ();
+
+  // PI on the sojourn time of the classic head, in the velocity form of
+  // PiQueueDisc; p' is squared for classic and scaled for L4S traffic
+  double p = m_baseProb + m_alpha * (delay - m_target).GetSeconds ()
+    + m_beta * (delay - m_prevDelay).GetSeconds ();
+  m_baseProb = std::max (0.0, std::min (p, 1.0));
+  m_prevDelay = delay;
+
+  m_rtrsEvent = Simulator::Schedule (m_tUpdate, &DualPi2QueueDisc::CalculateP, this);
+}
+
+int32_t
+DualPi2QueueDisc::SelectQueue (void) const
+{
+  bool classic = !m_enqueueTimes[CLASSIC].empty ();
+  bool l4s = !m_enqueueTimes[L4S].empty ();
+  if (!classic && !l4s)
+    {
+      return -1;
+    }
+  if (!classic || !l4s)
+    {
+      return l4s ? (int32_t) L4S : (int32_t) CLASSIC;
+    }
+  // Time-shifted FIFO: the classic head goes first only once it has
+  // waited TimeShift longer than the L4S head
+  Time now = Simulator::Now ();
+  Time classicSojourn = now - m_enqueueTimes[CLASSIC].front ();
+  Time l4sSojourn = now - m_enqueueTimes[L4S].front ();
+  return l4sSojourn + m_timeShift >= classicSojourn ? (int32_t) L4S : (int32_t) CLASSIC;
+}
+
+Ptr<QueueDiscItem>
+DualPi2QueueDisc::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (int32_t queue = SelectQueue (); queue >= 0; queue = SelectQueue ())
+    {
+      Ptr<QueueDiscItem> item = StaticCast<QueueDiscItem> (GetInternalQueue (queue)->Dequeue ());
+      double sojourn = (Simulator::Now () - m_enqueueTimes[queue].front ()).GetSeconds ();
+      m_enqueueTimes[queue].pop ();
+
+      if (queue == L4S)
+        {
+          m_st.l4sSojournSum += sojourn;
+          m_st.l4sMaxSojourn = std::max (m_st.l4sMaxSojourn, sojourn);
+          if (m_coupling * m_baseProb >= 1.0
+              && m_baseProb > std::max (m_uv->GetValue (), m_uv->GetValue ()))
+            {
+              // Overload: the coupled probability saturated, so L4S
+              // traffic is dropped like classic traffic, with p'^2
+              m_st.l4sEarlyDrop++;
+              m_stats.Record (AqmStats::EARLY_DROP, item->GetPacketSize ());
+              Drop (item);
+              continue;
+            }
+          if (sojourn > m_stepThreshold.GetSeconds () || m_uv->GetValue () < GetL4sProbability ())
+            {
+              m_st.l4sMarks++;
+              m_stats.Record (AqmStats::MARK, item->GetPacketSize ());
+              if (!Mark (item))
+                {
+                  Drop (item);
+                  continue;
+                }
+            }
+          m_st.l4sDequeued++;
+        }
+      else
+        {
+          m_st.classicSojournSum += sojourn;
+          m_st.classicMaxSojourn = std::max (m_st.classicMaxSojourn, sojourn);
+          // Drop with p'^2: p' exceeds the larger of two uniform draws
+          if (m_baseProb > std::max (m_uv->GetValue (), m_uv->GetValue ()))
+            {
+              m_st.classicEarlyDrop++;
+              m_stats.Record (AqmStats::EARLY_DROP, item->GetPacketSize ());
+              Drop (item);
+              continue;
+            }
+          m_st.classicDequeued++;
+        }
+
+      m_stats.Record (AqmStats::DEQUEUE, item->GetPacketSize ());
+      NS_LOG_LOGIC ("Popped from " << (queue == L4S ? "L4S" : "classic") << " queue: " << item);
+      return item;
+    }
+
+  NS_LOG_LOGIC ("Queue empty");
+  return 0;
+}
+
+Ptr<const QueueDiscItem>
+DualPi2QueueDisc::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+  int32_t queue = SelectQueue ();
+  if (queue < 0)
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+  return StaticCast<const QueueDiscItem> (GetInternalQueue (queue)->Peek ());
+}
+
+bool
+DualPi2QueueDisc::CheckConfig (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (GetNQueueDiscClasses () > 0)
+    {
+      NS_LOG_ERROR ("DualPi2QueueDisc cannot have classes");
+      return false;
+    }
+
+  if (m_tUpdate.IsZero () || m_tUpdate.IsStrictlyNegative ())
+    {
+      NS_LOG_ERROR ("TUpdate must be positive");
+      return false;
+    }
+
+  if (GetNInternalQueues () == 0)
+    {
+      // the classic and the L4S queue, each able to hold the whole limit
+      for (uint32_t i = 0; i < 2; i++)
+        {
+          Ptr<Queue> queue = CreateObjectWithAttributes<DropTailQueue> ("Mode", EnumValue (Queue::QUEUE_MODE_PACKETS));
+          queue->SetMaxPackets (m_queueLimit);
+          AddInternalQueue (queue);
+        }
+    }
+
+  if (GetNInternalQueues () != 2)
+    {
+      NS_LOG_ERROR ("DualPi2QueueDisc needs 2 internal queues");
+      return false;
+    }
+
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      if (GetInternalQueue (i)->GetMode () != Queue::QUEUE_MODE_PACKETS
+          || GetInternalQueue (i)->GetMaxPackets () < m_queueLimit)
+        {
+          NS_LOG_ERROR ("The internal queues must hold QueueLimit packets");
+          return false;
+        }
+    }
+
+  return true;
+}
+
+} //namespace ns3
@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DUAL_PI2_QUEUE_DISC_H
+#define DUAL_PI2_QUEUE_DISC_H
+
+#include <queue>
+#include "ns3/queue-disc.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/random-variable-stream.h"
+#include "aqm-stats.h"
+
+namespace ns3 {
+
+class UniformRandomVariable;
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Dual-queue coupled PI2 AQM (DualPI2, RFC 9332).
+ *
+ * A classic queue and a low-latency (L4S) queue share one limit. A PI
+ * controller on the sojourn time of the classic queue computes a base
+ * probability p'. Classic packets are dropped with p'^2 (PI2), L4S
+ * packets are marked with the coupled probability CouplingFactor * p',
+ * or always once they have waited longer than L4sStepThreshold. The
+ * queues are served by a time-shifted FIFO: the L4S head goes first
+ * unless the classic head has waited TimeShift longer.
+ *
+ * Packets are put in the L4S queue when a packet filter classifies them
+ * into L4sClass (e.g. band 0 of PfifoFastIpv4PacketFilter, the low-delay
+ * ToS); all the others are classic.
+ */
+class DualPi2QueueDisc : public QueueDisc
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief DualPi2QueueDisc Constructor
+   */
+  DualPi2QueueDisc ();
+
+  /**
+   * \brief DualPi2QueueDisc Destructor
+   */
+  virtual ~DualPi2QueueDisc ();
+
+  /**
+   * \brief Stats of the two queues
+   */
+  typedef struct
+  {
+    uint64_t classicEarlyDrop;  //!< Drops of the PI2 controller
+    uint64_t classicForcedDrop; //!< Classic drops due to the queue limit
+    uint64_t classicDequeued;   //!< Classic packets dequeued
+    double classicSojournSum;   //!< Sum of the sojourn times of the dequeued classic packets, in seconds
+    double classicMaxSojourn;   //!< Largest sojourn time of a classic packet, in seconds
+    uint64_t l4sMarks;          //!< Congestion marks of L4S packets
+    uint64_t l4sEarlyDrop;      //!< L4S drops of the classic probability under overload
+    uint64_t l4sForcedDrop;     //!< L4S drops due to the queue limit
+    uint64_t l4sDequeued;       //!< L4S packets dequeued, marked or not
+    double l4sSojournSum;       //!< Sum of the sojourn times of the dequeued L4S packets, in seconds
+    double l4sMaxSojourn;       //!< Largest sojourn time of an L4S packet, in seconds
+  } Stats;
+
+  /**
+   * \brief Get the base probability p' of the PI controller
+   *
+   * \returns p'
+   */
+  double GetBaseProbability (void) const;
+
+  /**
+   * \brief Get the drop probability of the classic queue
+   *
+   * \returns p'^2
+   */
+  double GetClassicProbability (void) const;
+
+  /**
+   * \brief Get the coupled marking probability of the L4S queue
+   *
+   * \returns CouplingFactor * p', at most 1
+   */
+  double GetL4sProbability (void) const;
+
+  /**
+   * \brief Get the DualPI2 statistics after running.
+   *
+   * \returns The drop, mark and sojourn statistics of both queues.
+   */
+  Stats GetStats ();
+
+  /**
+   * \brief Get the event counters
+   *
+   * \returns The 64-bit packet and byte counters
+   */
+  const AqmStats & GetAqmStats (void) const;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.  Return the number of streams (possibly zero) that
+   * have been assigned.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+
+protected:
+  /**
+   * \brief Dispose of the object
+   */
+  virtual void DoDispose (void);
+
+  /**
+   * \brief Set the congestion mark of an L4S packet
+   *
+   * Queue disc items of ns-3.26 do not expose the ECN field, so the
+   * default returns false and the packet is dropped instead; the mark is
+   * still counted as a mark. With ECN support this is item->Mark ().
+   *
+   * \param item The packet to mark
+   * \returns True if the packet was marked and can be sent
+   */
+  virtual bool Mark (Ptr<QueueDiscItem> item);
+
+private:
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item);
+  virtual Ptr<QueueDiscItem> DoDequeue (void);
+  virtual Ptr<const QueueDiscItem> DoPeek (void) const;
+  virtual bool CheckConfig (void);
+  virtual void InitializeParams (void);
+
+  /**
+   * \brief Update the base probability, every TUpdate
+   */
+  void CalculateP (void);
+
+  /**
+   * \brief Select the queue the next packet is dequeued from
+   * \returns The index of the internal queue, -1 if both are empty
+   */
+  int32_t SelectQueue (void) const;
+
+  /**
+   * \brief Indices of the internal queues
+   */
+  enum QueueIndex
+  {
+    CLASSIC = 0,        //!< Classic packets
+    L4S = 1             //!< L4S packets
+  };
+
+  Stats m_st;                                   //!< DualPI2 statistics
+  AqmStats m_stats;                             //!< Event counters of both queues
+  Ptr<UniformRandomVariable> m_uv;              //!< Rng stream
+
+  // ** Variables supplied by user
+  uint32_t m_queueLimit;                        //!< Packets in both queues together
+  Time m_target;                                //!< Target sojourn time of the classic queue
+  Time m_tUpdate;                               //!< Time between two updates of p'
+  double m_alpha;                               //!< Integral gain, per second of sojourn time
+  double m_beta;                                //!< Proportional gain, per second of sojourn time
+  double m_coupling;                            //!< Coupling factor k of the L4S probability
+  Time m_stepThreshold;                         //!< L4S sojourn time above which every packet is marked
+  Time m_timeShift;                             //!< Head start of the L4S queue in the scheduler
+  uint32_t m_l4sClass;                          //!< Packet filter result of the L4S packets
+
+  // ** Variables maintained by DualPI2
+  double m_baseProb;                            //!< Base probability p'
+  Time m_prevDelay;                             //!< Classic sojourn time at the previous update
+  EventId m_rtrsEvent;                          //!< Event of the next update of p'
+  std::queue<Time> m_enqueueTimes[2];           //!< Enqueue times of the packets of each queue, oldest first
+};
+
+} // namespace ns3
+
+#endif // DUAL_PI2_QUEUE_DISC_H
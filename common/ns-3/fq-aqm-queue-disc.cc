@@ -0,0 +1,471 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstring>
+#include <utility>
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+#include "ns3/hash.h"
+#include "ns3/packet-filter.h"
+#include "fq-aqm-queue-disc.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("FqAqmQueueDisc");
+
+NS_OBJECT_ENSURE_REGISTERED (FqAqmQueueDisc);
+
+TypeId FqAqmQueueDisc::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FqAqmQueueDisc")
+    .SetParent<QueueDisc> ()
+    .SetGroupName ("TrafficControl")
+    .AddAttribute ("Flows",
+                   "The number of sub-queues into which the incoming packets are classified",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&FqAqmQueueDisc::m_nFlows),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("PacketLimit",
+                   "The hard limit on the real queue size, measured in packets",
+                   UintegerValue (10240),
+                   MakeUintegerAccessor (&FqAqmQueueDisc::m_limit),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Quantum",
+                   "The DRR quantum in bytes",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&FqAqmQueueDisc::m_quantum),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Perturbation",
+                   "The salt used as an additional input to the hash function",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&FqAqmQueueDisc::m_perturbation),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+
+  return tid;
+}
+
+FqAqmQueueDisc::FqAqmQueueDisc ()
+  : QueueDisc (),
+    m_nUsedFlows (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_uv = CreateObject<UniformRandomVariable> ();
+}
+
+FqAqmQueueDisc::~FqAqmQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+FqAqmQueueDisc::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_uv = 0;
+  m_flows.clear ();
+  m_newFlows.clear ();
+  m_oldFlows.clear ();
+  QueueDisc::DoDispose ();
+}
+
+uint32_t
+FqAqmQueueDisc::GetNFlows (void) const
+{
+  return m_flows.size ();
+}
+
+uint32_t
+FqAqmQueueDisc::GetFlowLength (uint32_t flow) const
+{
+  NS_ASSERT (flow < m_flows.size ());
+  return m_flows[flow].items.size ();
+}
+
+uint32_t
+FqAqmQueueDisc::GetNUsedFlows (void) const
+{
+  return m_nUsedFlows;
+}
+
+double
+FqAqmQueueDisc::GetFlowProbability (uint32_t flow) const
+{
+  NS_ASSERT (flow < m_flows.size ());
+  return m_flows[flow].prob;
+}
+
+FqAqmQueueDisc::Stats
+FqAqmQueueDisc::GetStats ()
+{
+  NS_LOG_FUNCTION (this);
+  Stats st;
+  st.unforcedDrop = m_stats.GetPackets (AqmStats::EARLY_DROP);
+  st.forcedDrop = m_stats.GetPackets (AqmStats::FORCED_DROP);
+  st.packetsDequeued = m_stats.GetPackets (AqmStats::DEQUEUE);
+  st.bytesDequeued = m_stats.GetBytes (AqmStats::DEQUEUE);
+  return st;
+}
+
+AqmStats::Snapshot
+FqAqmQueueDisc::GetSnapshot (void)
+{
+  return m_stats.GetSnapshot (Simulator::Now ());
+}
+
+const AqmStats &
+FqAqmQueueDisc::GetAqmStats (void) const
+{
+  return m_stats;
+}
+
+int64_t
+FqAqmQueueDisc::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_uv->SetStream (stream);
+  return 1;
+}
+
+FqAqmQueueDisc::FlowQueue &
+FqAqmQueueDisc::GetFlow (uint32_t flow)
+{
+  NS_ASSERT (flow < m_flows.size ());
+  return m_flows[flow];
+}
+
+double
+FqAqmQueueDisc::GetUniform (void)
+{
+  return m_uv->GetValue ();
+}
+
+void
+FqAqmQueueDisc::FlowOverflow (uint32_t flow)
+{
+}
+
+void
+FqAqmQueueDisc::FlowActive (uint32_t flow)
+{
+}
+
+void
+FqAqmQueueDisc::FlowIdle (uint32_t flow)
+{
+}
+
+void
+FqAqmQueueDisc::FlowDequeued (uint32_t flow, Time sojourn)
+{
+}
+
+void
+FqAqmQueueDisc::InitializeController (void)
+{
+}
+
+uint32_t
+FqAqmQueueDisc::Hash (Ptr<QueueDiscItem> item)
+{
+  // The IP header is not part of the packet yet, so the flow is told
+  // apart by the packet filter (e.g. the 5-tuple hash of
+  // FqCoDelIpv4PacketFilter); packets no filter matches share a sub-queue
+  uint8_t buf[8];
+  std::memset (buf, 0, sizeof (buf));
+  int32_t ret = Classify (item);
+  if (ret != PacketFilter::PF_NO_MATCH)
+    {
+      std::memcpy (buf, &ret, 4);
+    }
+  std::memcpy (buf + 4, &m_perturbation, 4);
+  return Hash32 (reinterpret_cast<char *> (buf), sizeof (buf)) % m_flows.size ();
+}
+
+void
+FqAqmQueueDisc::DropFromFattest (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t fattest = 0;
+  uint32_t maxBytes = 0;
+  for (uint32_t i = 0; i < m_flows.size (); i++)
+    {
+      if (m_flows[i].bytes > maxBytes)
+        {
+          maxBytes = m_flows[i].bytes;
+          fattest = i;
+        }
+    }
+
+  FlowQueue &flow = m_flows[fattest];
+  Ptr<QueueDiscItem> item = flow.items.front ().item;
+  flow.items.pop_front ();
+  flow.bytes -= item->GetPacketSize ();
+
+  // Drops due to queue limit: reactive
+  m_stats.Record (AqmStats::FORCED_DROP, item->GetPacketSize ());
+  FlowOverflow (fattest);
+  if (flow.items.empty ())
+    {
+      flow.idle = true;
+      flow.idleStart = Simulator::Now ();
+      FlowIdle (fattest);
+    }
+  Drop (item);
+}
+
+bool
+FqAqmQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << item);
+
+  uint32_t h = Hash (item);
+  FlowQueue &flow = m_flows[h];
+
+  if (!flow.used)
+    {
+      flow.used = true;
+      m_nUsedFlows++;
+    }
+
+  if (flow.idle)
+    {
+      FlowActive (h);
+      flow.idle = false;
+    }
+
+  if (DropEarly (h, item))
+    {
+      // Early probability drop: proactive
+      m_stats.Record (AqmStats::EARLY_DROP, item->GetPacketSize ());
+      if (flow.items.empty ())
+        {
+          // Before Drop, so that the queue disc still counts the packet, as
+          // on the dequeue path
+          flow.idle = true;
+          flow.idleStart = Simulator::Now ();
+          FlowIdle (h);
+        }
+      Drop (item);
+      return false;
+    }
+
+  Entry e;
+  e.item = item;
+  e.tstamp = Simulator::Now ();
+  flow.items.push_back (e);
+  flow.bytes += item->GetPacketSize ();
+  m_stats.Record (AqmStats::ENQUEUE, item->GetPacketSize ());
+
+  if (flow.status == INACTIVE)
+    {
+      flow.status = NEW_FLOW;
+      flow.deficit = m_quantum;
+      m_newFlows.push_back (h);
+    }
+
+  NS_LOG_LOGIC ("Sub-queue " << h << " length " << flow.items.size ());
+
+  // The queue disc counters already include this packet
+  if (GetNPackets () > m_limit)
+    {
+      DropFromFattest ();
+    }
+
+  return true;
+}
+
+Ptr<QueueDiscItem>
+FqAqmQueueDisc::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  while (true)
+    {
+      std::list<uint32_t> *list;
+      if (!m_newFlows.empty ())
+        {
+          list = &m_newFlows;
+        }
+      else if (!m_oldFlows.empty ())
+        {
+          list = &m_oldFlows;
+        }
+      else
+        {
+          NS_LOG_LOGIC ("Queue empty");
+          return 0;
+        }
+
+      uint32_t h = list->front ();
+      FlowQueue &flow = m_flows[h];
+
+      if (flow.deficit <= 0)
+        {
+          flow.deficit += m_quantum;
+          flow.status = OLD_FLOW;
+          list->pop_front ();
+          m_oldFlows.push_back (h);
+          continue;
+        }
+
+      if (flow.items.empty ())
+        {
+          list->pop_front ();
+          // A new flow that emptied goes behind the old ones, so that it
+          // cannot starve them by going idle and coming back
+          if (list == &m_newFlows && !m_oldFlows.empty ())
+            {
+              flow.status = OLD_FLOW;
+              m_oldFlows.push_back (h);
+            }
+          else
+            {
+              flow.status = INACTIVE;
+            }
+          continue;
+        }
+
+      Entry e = flow.items.front ();
+      flow.items.pop_front ();
+      flow.bytes -= e.item->GetPacketSize ();
+      flow.deficit -= e.item->GetPacketSize ();
+
+      m_stats.Record (AqmStats::DEQUEUE, e.item->GetPacketSize ());
+      FlowDequeued (h, Simulator::Now () - e.tstamp);
+
+      if (flow.items.empty ())
+        {
+          flow.idle = true;
+          flow.idleStart = Simulator::Now ();
+          FlowIdle (h);
+        }
+
+      NS_LOG_LOGIC ("Popped " << e.item << " from sub-queue " << h);
+      return e.item;
+    }
+}
+
+int32_t
+FqAqmQueueDisc::SelectFlow (void) const
+{
+  // Walk the lists as DoDequeue does, without moving anything: the flows
+  // DoDequeue would put at the back of the old flows for lack of deficit
+  // are visited again after them, with one more quantum
+  std::vector<std::pair<uint32_t, int32_t> > moved;
+  const std::list<uint32_t> *lists[2] = { &m_newFlows, &m_oldFlows };
+  for (uint32_t l = 0; l < 2; l++)
+    {
+      for (std::list<uint32_t>::const_iterator it = lists[l]->begin (); it != lists[l]->end (); ++it)
+        {
+          const FlowQueue &flow = m_flows[*it];
+          if (flow.deficit <= 0)
+            {
+              moved.push_back (std::make_pair (*it, flow.deficit + (int32_t) m_quantum));
+            }
+          else if (!flow.items.empty ())
+            {
+              return *it;
+            }
+          // An empty flow leaves the lists, or is moved and leaves them later
+        }
+    }
+
+  while (!moved.empty ())
+    {
+      std::vector<std::pair<uint32_t, int32_t> > next;
+      for (uint32_t i = 0; i < moved.size (); i++)
+        {
+          if (moved[i].second <= 0)
+            {
+              next.push_back (std::make_pair (moved[i].first, moved[i].second + (int32_t) m_quantum));
+            }
+          else if (!m_flows[moved[i].first].items.empty ())
+            {
+              return moved[i].first;
+            }
+        }
+      moved.swap (next);
+    }
+  return -1;
+}
+
+Ptr<const QueueDiscItem>
+FqAqmQueueDisc::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  int32_t h = SelectFlow ();
+  if (h < 0)
+    {
+      return 0;
+    }
+  return m_flows[h].items.front ().item;
+}
+
+bool
+FqAqmQueueDisc::CheckConfig (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (GetNQueueDiscClasses () > 0)
+    {
+      NS_LOG_ERROR ("FqAqmQueueDisc cannot have classes");
+      return false;
+    }
+
+  if (GetNInternalQueues () > 0)
+    {
+      NS_LOG_ERROR ("FqAqmQueueDisc cannot have internal queues");
+      return false;
+    }
+
+  if (GetNPacketFilters () == 0)
+    {
+      NS_LOG_ERROR ("FqAqmQueueDisc needs at least a packet filter");
+      return false;
+    }
+
+  return true;
+}
+
+void
+FqAqmQueueDisc::InitializeParams (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  FlowQueue empty;
+  empty.bytes = 0;
+  empty.deficit = 0;
+  empty.status = INACTIVE;
+  empty.prob = 0.0;
+  empty.qOld = 0;
+  empty.lastUpdate = Seconds (0);
+  empty.idle = true;
+  empty.idleStart = Seconds (0);
+  empty.used = false;
+  m_flows.assign (m_nFlows, empty);
+  m_nUsedFlows = 0;
+
+  m_stats.Reset ();
+
+  InitializeController ();
+}
+
+} //namespace ns3
@@ -0,0 +1,277 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FQ_AQM_QUEUE_DISC_H
+#define FQ_AQM_QUEUE_DISC_H
+
+#include <deque>
+#include <list>
+#include <vector>
+#include "ns3/queue-disc.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+#include "aqm-stats.h"
+
+namespace ns3 {
+
+class UniformRandomVariable;
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Base class of the flow-queuing PI and BLUE queue discs.
+ *
+ * Packets are hashed into a fixed number of sub-queues which are served
+ * by deficit round robin, with newly active (sparse) flows served first
+ * as in FQ-CoDel. The state of all the sub-queues lives in one array
+ * allocated at initialization, and the total number of packets is
+ * bounded, so memory use does not grow with the number of flows.
+ * Subclasses supply the AQM controller through the hooks below.
+ *
+ * As in FqCoDelQueueDisc, flows are told apart by a packet filter, which
+ * is mandatory (e.g. FqCoDelIpv4PacketFilter, a hash of the 5-tuple).
+ */
+class FqAqmQueueDisc : public QueueDisc
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief FqAqmQueueDisc Constructor
+   */
+  FqAqmQueueDisc ();
+
+  /**
+   * \brief FqAqmQueueDisc Destructor
+   */
+  virtual ~FqAqmQueueDisc ();
+
+  /**
+   * \brief Stats
+   */
+  typedef struct
+  {
+    uint64_t unforcedDrop;      //!< Early probability drops: proactive
+    uint64_t forcedDrop;        //!< Drops due to queue limit: reactive
+    uint64_t packetsDequeued;   //!< Packets dequeued
+    uint64_t bytesDequeued;     //!< Bytes dequeued
+  } Stats;
+
+  /**
+   * \brief Get the number of sub-queues
+   *
+   * \returns The number of sub-queues
+   */
+  uint32_t GetNFlows (void) const;
+
+  /**
+   * \brief Get the number of packets in a sub-queue
+   *
+   * \param flow The index of the sub-queue
+   * \returns The number of packets queued in it
+   */
+  uint32_t GetFlowLength (uint32_t flow) const;
+
+  /**
+   * \brief Get the number of sub-queues that received a packet
+   *
+   * \returns The number of sub-queues used since initialization
+   */
+  uint32_t GetNUsedFlows (void) const;
+
+  /**
+   * \brief Get the drop or marking probability of a sub-queue
+   *
+   * \param flow The index of the sub-queue
+   * \returns The probability currently applied to it
+   */
+  virtual double GetFlowProbability (uint32_t flow) const;
+
+  /**
+   * \brief Get statistics after running.
+   *
+   * \returns The drop statistics.
+   */
+  Stats GetStats ();
+
+  /**
+   * \brief Get a snapshot of the event counters
+   *
+   * \returns The counters at the current time
+   */
+  AqmStats::Snapshot GetSnapshot (void);
+
+  /**
+   * \brief Get the event counters
+   *
+   * \returns The 64-bit packet and byte counters
+   */
+  const AqmStats & GetAqmStats (void) const;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.  Return the number of streams (possibly zero) that
+   * have been assigned.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+
+protected:
+  /**
+   * \brief Scheduling state of a sub-queue
+   */
+  enum FlowStatus
+  {
+    INACTIVE,           //!< Not in any list
+    NEW_FLOW,           //!< In the list of new (sparse) flows
+    OLD_FLOW            //!< In the list of old flows
+  };
+
+  /**
+   * \brief A queued packet with its enqueue time
+   */
+  struct Entry
+  {
+    Ptr<QueueDiscItem> item;    //!< The packet
+    Time tstamp;                //!< Time it was enqueued
+  };
+
+  /**
+   * \brief A sub-queue and the controller state attached to it
+   */
+  struct FlowQueue
+  {
+    std::deque<Entry> items;    //!< Queued packets
+    uint32_t bytes;             //!< Bytes queued
+    int32_t deficit;            //!< DRR deficit
+    FlowStatus status;          //!< Scheduling state
+    double prob;                //!< Drop probability (PI) or Pmark (BLUE)
+    uint32_t qOld;              //!< Sub-queue length at the previous controller update
+    Time lastUpdate;            //!< Last time the probability was updated
+    bool idle;                  //!< True from the time the sub-queue empties until it receives a packet
+    Time idleStart;             //!< Time the sub-queue became empty
+    bool used;                  //!< True once the sub-queue received a packet
+  };
+
+  /**
+   * \brief Dispose of the object
+   */
+  virtual void DoDispose (void);
+
+  /**
+   * \brief Get a sub-queue
+   * \param flow The index of the sub-queue
+   * \returns The sub-queue
+   */
+  FlowQueue & GetFlow (uint32_t flow);
+
+  /**
+   * \returns a uniform random number in [0, 1)
+   */
+  double GetUniform (void);
+
+  /**
+   * \brief Decide whether an arriving packet is dropped early
+   * \param flow The sub-queue of the packet
+   * \param item The packet
+   * \returns true to drop the packet
+   */
+  virtual bool DropEarly (uint32_t flow, Ptr<QueueDiscItem> item) = 0;
+
+  /**
+   * \brief Called when the packet limit forces a drop from a sub-queue
+   * \param flow The sub-queue
+   */
+  virtual void FlowOverflow (uint32_t flow);
+
+  /**
+   * \brief Called when an idle sub-queue receives a packet, before the
+   * early drop decision
+   * \param flow The sub-queue
+   */
+  virtual void FlowActive (uint32_t flow);
+
+  /**
+   * \brief Called when a sub-queue becomes empty
+   * \param flow The sub-queue
+   */
+  virtual void FlowIdle (uint32_t flow);
+
+  /**
+   * \brief Called for every dequeued packet
+   * \param flow The sub-queue the packet left
+   * \param sojourn Time the packet spent in the queue disc
+   */
+  virtual void FlowDequeued (uint32_t flow, Time sojourn);
+
+  /**
+   * \brief Initialize the controller, after the sub-queues are allocated.
+   */
+  virtual void InitializeController (void);
+
+  AqmStats m_stats;                             //!< Statistics
+
+private:
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item);
+  virtual Ptr<QueueDiscItem> DoDequeue (void);
+  virtual Ptr<const QueueDiscItem> DoPeek (void) const;
+  virtual bool CheckConfig (void);
+  virtual void InitializeParams (void);
+
+  /**
+   * \brief Hash a packet to its sub-queue
+   * \param item queue item
+   * \returns the sub-queue index
+   */
+  uint32_t Hash (Ptr<QueueDiscItem> item);
+
+  /**
+   * \brief Find the sub-queue the next DoDequeue serves, without changing
+   * the scheduling state
+   * \returns the sub-queue index, -1 if all are empty
+   */
+  int32_t SelectFlow (void) const;
+
+  /**
+   * \brief Drop the head packet of the sub-queue with most bytes queued
+   */
+  void DropFromFattest (void);
+
+  // ** Variables supplied by user
+  uint32_t m_nFlows;                            //!< Number of sub-queues
+  uint32_t m_limit;                             //!< Maximum number of packets in the queue disc
+  uint32_t m_quantum;                           //!< DRR quantum in bytes
+  uint32_t m_perturbation;                      //!< Hash perturbation value
+
+  // ** Variables maintained by the scheduler
+  std::vector<FlowQueue> m_flows;               //!< Sub-queues, allocated once
+  std::list<uint32_t> m_newFlows;               //!< Newly active sub-queues
+  std::list<uint32_t> m_oldFlows;               //!< Other active sub-queues
+  uint32_t m_nUsedFlows;                        //!< Sub-queues that received a packet
+  Ptr<UniformRandomVariable> m_uv;              //!< Rng stream
+};
+
+} // namespace ns3
+
+#endif // FQ_AQM_QUEUE_DISC_H
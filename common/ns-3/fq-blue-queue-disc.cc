@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/simulator.h"
+#include "fq-blue-queue-disc.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("FqBlueQueueDisc");
+
+NS_OBJECT_ENSURE_REGISTERED (FqBlueQueueDisc);
+
+TypeId FqBlueQueueDisc::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FqBlueQueueDisc")
+    .SetParent<FqAqmQueueDisc> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<FqBlueQueueDisc> ()
+    .AddAttribute ("Increment",
+                   "Pmark increment value",
+                   DoubleValue (0.0025),
+                   MakeDoubleAccessor (&FqBlueQueueDisc::m_increment),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("Decrement",
+                   "Pmark decrement Value",
+                   DoubleValue (0.00025),
+                   MakeDoubleAccessor (&FqBlueQueueDisc::m_decrement),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("FreezeTime",
+                   "Time interval during which Pmark cannot be updated",
+                   TimeValue (Seconds (0.1)),
+                   MakeTimeAccessor (&FqBlueQueueDisc::m_freezeTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("SharedController",
+                   "Use one Pmark for all the sub-queues instead of one per sub-queue",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&FqBlueQueueDisc::m_shared),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TargetDelay",
+                   "Sojourn time above which the shared Pmark is incremented, zero to disable",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&FqBlueQueueDisc::m_target),
+                   MakeTimeChecker ())
+  ;
+
+  return tid;
+}
+
+FqBlueQueueDisc::FqBlueQueueDisc ()
+  : FqAqmQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+FqBlueQueueDisc::~FqBlueQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+double
+FqBlueQueueDisc::GetFlowProbability (uint32_t flow) const
+{
+  if (m_shared)
+    {
+      return m_Pmark;
+    }
+  return FqAqmQueueDisc::GetFlowProbability (flow);
+}
+
+void
+FqBlueQueueDisc::InitializeController (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_Pmark = 0;
+  m_lastUpdateTime = Time (Seconds (0.0));
+  m_idleStartTime = Time (Seconds (0.0));
+  m_isIdle = true;
+}
+
+void
+FqBlueQueueDisc::IncrementPmark (double &pmark, Time &lastUpdate)
+{
+  Time now = Simulator::Now ();
+  if (now - lastUpdate > m_freezeTime)
+    {
+      pmark += m_increment;
+      lastUpdate = now;
+      if (pmark > 1.0)
+        {
+          pmark = 1.0;
+        }
+    }
+}
+
+void
+FqBlueQueueDisc::DecrementPmark (double &pmark, Time &lastUpdate)
+{
+  Time now = Simulator::Now ();
+  if (now - lastUpdate > m_freezeTime)
+    {
+      pmark -= m_decrement;
+      lastUpdate = now;
+      if (pmark < 0.0)
+        {
+          pmark = 0.0;
+        }
+    }
+}
+
+void
+FqBlueQueueDisc::DecrementIdle (double &pmark, Time &lastUpdate, Time idleStart)
+{
+  Time now = Simulator::Now ();
+  uint32_t m = 0; // stores the number of times Pmark should be decremented
+  m = ((now - idleStart) / m_freezeTime);
+  pmark -= (m_decrement * m);
+  lastUpdate = now;
+  if (pmark < 0.0)
+    {
+      pmark = 0.0;
+    }
+}
+
+bool
+FqBlueQueueDisc::DropEarly (uint32_t flow, Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << flow << item);
+
+  FlowQueue &q = GetFlow (flow);
+  if (q.status != OLD_FLOW)
+    {
+      // Sparse flows are isolated from the backlogged ones
+      return false;
+    }
+
+  double p = m_shared ? m_Pmark : q.prob;
+  if (p <= 0 || GetUniform () > p)
+    {
+      return false;
+    }
+
+  if (m_shared)
+    {
+      IncrementPmark (m_Pmark, m_lastUpdateTime);
+    }
+  else
+    {
+      IncrementPmark (q.prob, q.lastUpdate);
+    }
+  return true;
+}
+
+void
+FqBlueQueueDisc::FlowOverflow (uint32_t flow)
+{
+  NS_LOG_FUNCTION (this << flow);
+  if (m_shared)
+    {
+      IncrementPmark (m_Pmark, m_lastUpdateTime);
+    }
+  else
+    {
+      FlowQueue &q = GetFlow (flow);
+      IncrementPmark (q.prob, q.lastUpdate);
+    }
+}
+
+void
+FqBlueQueueDisc::FlowActive (uint32_t flow)
+{
+  NS_LOG_FUNCTION (this << flow);
+  if (m_shared)
+    {
+      if (m_isIdle)
+        {
+          DecrementIdle (m_Pmark, m_lastUpdateTime, m_idleStartTime);
+          m_isIdle = false;
+        }
+    }
+  else
+    {
+      FlowQueue &q = GetFlow (flow);
+      DecrementIdle (q.prob, q.lastUpdate, q.idleStart);
+    }
+}
+
+void
+FqBlueQueueDisc::FlowIdle (uint32_t flow)
+{
+  NS_LOG_FUNCTION (this << flow);
+  // The packet being dequeued is still counted by the queue disc
+  if (m_shared && !m_isIdle && GetNPackets () <= 1)
+    {
+      m_idleStartTime = Simulator::Now ();
+      m_isIdle = true;
+    }
+}
+
+void
+FqBlueQueueDisc::FlowDequeued (uint32_t flow, Time sojourn)
+{
+  if (!m_shared || m_target.IsZero ())
+    {
+      return;
+    }
+
+  if (sojourn > m_target)
+    {
+      IncrementPmark (m_Pmark, m_lastUpdateTime);
+    }
+  else
+    {
+      DecrementPmark (m_Pmark, m_lastUpdateTime);
+    }
+}
+
+} //namespace ns3
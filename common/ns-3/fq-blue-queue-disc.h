@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FQ_BLUE_QUEUE_DISC_H
+#define FQ_BLUE_QUEUE_DISC_H
+
+#include "fq-aqm-queue-disc.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Flow-queuing BLUE queue disc.
+ *
+ * Either every sub-queue keeps its own Pmark, raised when the packet limit
+ * forces a drop from it and lowered after it has been idle, or a single
+ * Pmark is shared by all the sub-queues. The shared Pmark is raised on
+ * overflow and lowered when the whole queue disc goes idle; with a
+ * TargetDelay it also follows the sojourn time of the dequeued packets.
+ * Packets of sparse flows are never dropped early.
+ */
+class FqBlueQueueDisc : public FqAqmQueueDisc
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief FqBlueQueueDisc Constructor
+   */
+  FqBlueQueueDisc ();
+
+  /**
+   * \brief FqBlueQueueDisc Destructor
+   */
+  virtual ~FqBlueQueueDisc ();
+
+  virtual double GetFlowProbability (uint32_t flow) const;
+
+private:
+  virtual bool DropEarly (uint32_t flow, Ptr<QueueDiscItem> item);
+  virtual void FlowOverflow (uint32_t flow);
+  virtual void FlowActive (uint32_t flow);
+  virtual void FlowIdle (uint32_t flow);
+  virtual void FlowDequeued (uint32_t flow, Time sojourn);
+  virtual void InitializeController (void);
+
+  /**
+   * \brief Increment a marking probability, at most once per freeze time
+   * \param pmark The probability
+   * \param lastUpdate The time it was last updated
+   */
+  void IncrementPmark (double &pmark, Time &lastUpdate);
+
+  /**
+   * \brief Decrement a marking probability, at most once per freeze time
+   * \param pmark The probability
+   * \param lastUpdate The time it was last updated
+   */
+  void DecrementPmark (double &pmark, Time &lastUpdate);
+
+  /**
+   * \brief Decrement a marking probability once for every freeze time
+   * spent idle
+   * \param pmark The probability
+   * \param lastUpdate The time it was last updated
+   * \param idleStart The time the idle period started
+   */
+  void DecrementIdle (double &pmark, Time &lastUpdate, Time idleStart);
+
+  // ** Variables supplied by user
+  double m_increment;                           //!< increment value for marking probability
+  double m_decrement;                           //!< decrement value for marking probability
+  Time m_freezeTime;                            //!< Time interval during which Pmark cannot be updated
+  bool m_shared;                                //!< Use one Pmark for all the sub-queues
+  Time m_target;                                //!< Desired sojourn time of the shared Pmark, zero to disable
+
+  // ** Variables maintained by FQ-BLUE
+  double m_Pmark;                               //!< Shared marking probability
+  Time m_lastUpdateTime;                        //!< last time at which the shared Pmark was updated
+  Time m_idleStartTime;                         //!< Time when the queue disc entered the idle period
+  bool m_isIdle;                                //!< True if the whole queue disc is idle
+};
+
+} // namespace ns3
+
+#endif // FQ_BLUE_QUEUE_DISC_H
@@ -0,0 +1,189 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/simulator.h"
+#include "fq-pi-queue-disc.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("FqPiQueueDisc");
+
+NS_OBJECT_ENSURE_REGISTERED (FqPiQueueDisc);
+
+TypeId FqPiQueueDisc::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FqPiQueueDisc")
+    .SetParent<FqAqmQueueDisc> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<FqPiQueueDisc> ()
+    .AddAttribute ("QueueRef",
+                   "Desired length of a sub-queue in packets",
+                   DoubleValue (50),
+                   MakeDoubleAccessor (&FqPiQueueDisc::m_qRef),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("A",
+                   "Value of alpha",
+                   DoubleValue (0.00001822),
+                   MakeDoubleAccessor (&FqPiQueueDisc::m_a),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("B",
+                   "Value of beta",
+                   DoubleValue (0.00001816),
+                   MakeDoubleAccessor (&FqPiQueueDisc::m_b),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("W",
+                   "Sampling frequency",
+                   DoubleValue (170),
+                   MakeDoubleAccessor (&FqPiQueueDisc::m_w),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("SharedController",
+                   "Use one controller driven by the sojourn time instead of one per sub-queue",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&FqPiQueueDisc::m_shared),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TargetDelay",
+                   "Desired sojourn time of the shared controller",
+                   TimeValue (MilliSeconds (20)),
+                   MakeTimeAccessor (&FqPiQueueDisc::m_target),
+                   MakeTimeChecker ())
+    .AddAttribute ("SharedA",
+                   "Value of alpha of the shared controller, per second of sojourn time",
+                   DoubleValue (0.02278),
+                   MakeDoubleAccessor (&FqPiQueueDisc::m_sharedA),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("SharedB",
+                   "Value of beta of the shared controller, per second of sojourn time",
+                   DoubleValue (0.0227),
+                   MakeDoubleAccessor (&FqPiQueueDisc::m_sharedB),
+                   MakeDoubleChecker<double> ())
+  ;
+
+  return tid;
+}
+
+FqPiQueueDisc::FqPiQueueDisc ()
+  : FqAqmQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+FqPiQueueDisc::~FqPiQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+FqPiQueueDisc::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Remove (m_rtrsEvent);
+  FqAqmQueueDisc::DoDispose ();
+}
+
+double
+FqPiQueueDisc::GetFlowProbability (uint32_t flow) const
+{
+  if (m_shared)
+    {
+      return m_dropProb;
+    }
+  return FqAqmQueueDisc::GetFlowProbability (flow);
+}
+
+void
+FqPiQueueDisc::InitializeController (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_dropProb = 0;
+  m_maxSojourn = Seconds (0);
+  m_oldSojourn = Seconds (0);
+  // The sampling frequency is known only once the attributes are set
+  m_rtrsEvent = Simulator::Schedule (Time (Seconds (1.0 / m_w)), &FqPiQueueDisc::CalculateP, this);
+}
+
+bool
+FqPiQueueDisc::DropEarly (uint32_t flow, Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << flow << item);
+
+  FlowQueue &q = GetFlow (flow);
+  if (q.status != OLD_FLOW)
+    {
+      // Sparse flows are isolated from the backlogged ones
+      return false;
+    }
+
+  double p = m_shared ? m_dropProb : q.prob;
+  if (p <= 0)
+    {
+      return false;
+    }
+  return GetUniform () <= p;
+}
+
+void
+FqPiQueueDisc::FlowDequeued (uint32_t flow, Time sojourn)
+{
+  if (sojourn > m_maxSojourn)
+    {
+      m_maxSojourn = sojourn;
+    }
+}
+
+void
+FqPiQueueDisc::CalculateP ()
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_shared)
+    {
+      double p = m_sharedA * (m_maxSojourn - m_target).GetSeconds ()
+        - m_sharedB * (m_oldSojourn - m_target).GetSeconds () + m_dropProb;
+      p = (p < 0) ? 0 : p;
+      p = (p > 1) ? 1 : p;
+      m_dropProb = p;
+      m_oldSojourn = m_maxSojourn;
+      m_maxSojourn = Seconds (0);
+    }
+  else
+    {
+      for (uint32_t i = 0; i < GetNFlows (); i++)
+        {
+          FlowQueue &q = GetFlow (i);
+          uint32_t qlen = q.items.size ();
+          if (qlen == 0 && q.qOld == 0 && q.prob == 0)
+            {
+              // Idle sub-queue whose controller has settled
+              continue;
+            }
+          double p = m_a * (qlen - m_qRef) - m_b * (q.qOld - m_qRef) + q.prob;
+          p = (p < 0) ? 0 : p;
+          p = (p > 1) ? 1 : p;
+          q.prob = p;
+          q.qOld = qlen;
+          q.lastUpdate = Simulator::Now ();
+        }
+    }
+
+  m_rtrsEvent = Simulator::Schedule (Time (Seconds (1.0 / m_w)), &FqPiQueueDisc::CalculateP, this);
+}
+
+} //namespace ns3
@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FQ_PI_QUEUE_DISC_H
+#define FQ_PI_QUEUE_DISC_H
+
+#include "ns3/event-id.h"
+#include "fq-aqm-queue-disc.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Flow-queuing PI queue disc.
+ *
+ * Either every sub-queue runs its own PI controller on its length, or a
+ * single controller shared by all the sub-queues is driven by the largest
+ * sojourn time seen in each sampling interval. Packets of sparse flows
+ * (sub-queues in the new flows list) are never dropped early.
+ */
+class FqPiQueueDisc : public FqAqmQueueDisc
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief FqPiQueueDisc Constructor
+   */
+  FqPiQueueDisc ();
+
+  /**
+   * \brief FqPiQueueDisc Destructor
+   */
+  virtual ~FqPiQueueDisc ();
+
+  virtual double GetFlowProbability (uint32_t flow) const;
+
+protected:
+  /**
+   * \brief Dispose of the object
+   */
+  virtual void DoDispose (void);
+
+private:
+  virtual bool DropEarly (uint32_t flow, Ptr<QueueDiscItem> item);
+  virtual void FlowDequeued (uint32_t flow, Time sojourn);
+  virtual void InitializeController (void);
+
+  /**
+   * Periodically update the drop probabilities, of every sub-queue or of
+   * the shared controller
+   */
+  void CalculateP ();
+
+  // ** Variables supplied by user
+  double m_qRef;                                //!< Desired length of a sub-queue in packets
+  double m_a;                                   //!< Parameter to the per sub-queue controllers
+  double m_b;                                   //!< Parameter to the per sub-queue controllers
+  double m_w;                                   //!< Sampling frequency (Number of times per second)
+  bool m_shared;                                //!< Use one controller driven by the sojourn time
+  Time m_target;                                //!< Desired sojourn time of the shared controller
+  double m_sharedA;                             //!< Parameter to the shared controller, per second
+  double m_sharedB;                             //!< Parameter to the shared controller, per second
+
+  // ** Variables maintained by FQ-PI
+  double m_dropProb;                            //!< Drop probability of the shared controller
+  Time m_maxSojourn;                            //!< Largest sojourn time in the current interval
+  Time m_oldSojourn;                            //!< Largest sojourn time in the previous interval
+  EventId m_rtrsEvent;                          //!< Event used to decide the decision of interval of drop probability calculation
+};
+
+} // namespace ns3
+
+#endif // FQ_PI_QUEUE_DISC_H
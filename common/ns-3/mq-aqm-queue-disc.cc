@@ -0,0 +1,262 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/hash.h"
+#include "ns3/abort.h"
+#include "ns3/net-device.h"
+#include "ns3/packet-filter.h"
+#include "mq-aqm-queue-disc.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MqAqmQueueDisc");
+
+NS_OBJECT_ENSURE_REGISTERED (MqAqmQueueDisc);
+
+TypeId MqAqmQueueDisc::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MqAqmQueueDisc")
+    .SetParent<QueueDisc> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<MqAqmQueueDisc> ()
+    .AddAttribute ("NumQueues",
+                   "Number of child queue discs, 0 to use one per device transmit queue",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&MqAqmQueueDisc::m_nQueues),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ChildQueueDiscType",
+                   "TypeId of the child queue discs (configured through their attribute defaults)",
+                   StringValue ("ns3::PiQueueDisc"),
+                   MakeStringAccessor (&MqAqmQueueDisc::m_childType),
+                   MakeStringChecker ())
+    .AddAttribute ("Steering",
+                   "Steering of packets to the child queue discs",
+                   EnumValue (MqAqmQueueDisc::FLOW_HASH),
+                   MakeEnumAccessor (&MqAqmQueueDisc::m_steering),
+                   MakeEnumChecker (MqAqmQueueDisc::FLOW_HASH, "FLOW_HASH",
+                                    MqAqmQueueDisc::TX_QUEUE, "TX_QUEUE"))
+    .AddAttribute ("Perturbation",
+                   "The salt used as an additional input to the flow hash",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&MqAqmQueueDisc::m_perturbation),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+
+  return tid;
+}
+
+MqAqmQueueDisc::MqAqmQueueDisc ()
+  : QueueDisc (),
+    m_next (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MqAqmQueueDisc::~MqAqmQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+MqAqmQueueDisc::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  QueueDisc::DoDispose ();
+}
+
+uint32_t
+MqAqmQueueDisc::GetNChildren (void) const
+{
+  return GetNQueueDiscClasses ();
+}
+
+Ptr<QueueDisc>
+MqAqmQueueDisc::GetChild (uint32_t i) const
+{
+  return GetQueueDiscClass (i)->GetQueueDisc ();
+}
+
+MqAqmQueueDisc::Stats
+MqAqmQueueDisc::GetStats ()
+{
+  NS_LOG_FUNCTION (this);
+  Stats st;
+  st.nChildren = GetNChildren ();
+  st.packetsReceived = 0;
+  st.packetsDropped = 0;
+  st.packetsQueued = 0;
+  st.maxChildQueue = 0;
+  for (uint32_t i = 0; i < st.nChildren; i++)
+    {
+      Ptr<QueueDisc> child = GetChild (i);
+      st.packetsReceived += child->GetTotalReceivedPackets ();
+      st.packetsDropped += child->GetTotalDroppedPackets ();
+      st.packetsQueued += child->GetNPackets ();
+      st.maxChildQueue = std::max (st.maxChildQueue, child->GetNPackets ());
+    }
+  return st;
+}
+
+QueueDisc::WakeMode
+MqAqmQueueDisc::GetWakeMode (void)
+{
+  // With TX_QUEUE steering child i holds exactly the packets of device
+  // transmit queue i, so it can be woken on its own
+  return m_steering == TX_QUEUE ? WAKE_CHILD : WAKE_ROOT;
+}
+
+uint32_t
+MqAqmQueueDisc::SelectChild (Ptr<QueueDiscItem> item)
+{
+  uint32_t n = GetNChildren ();
+  if (m_steering == TX_QUEUE)
+    {
+      return item->GetTxQueueIndex () % n;
+    }
+
+  // The flow is told apart by the packet filter (e.g. the 5-tuple hash
+  // of FqCoDelIpv4PacketFilter); packets no filter matches share a child
+  uint8_t buf[8];
+  std::memset (buf, 0, sizeof (buf));
+  int32_t ret = Classify (item);
+  if (ret != PacketFilter::PF_NO_MATCH)
+    {
+      std::memcpy (buf, &ret, 4);
+    }
+  std::memcpy (buf + 4, &m_perturbation, 4);
+  return Hash32 (reinterpret_cast<char *> (buf), sizeof (buf)) % n;
+}
+
+bool
+MqAqmQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << item);
+
+  uint32_t child = SelectChild (item);
+  NS_LOG_LOGIC ("Steering to child " << child);
+
+  // If the child drops the packet, it notifies this queue disc
+  return GetChild (child)->Enqueue (item);
+}
+
+Ptr<QueueDiscItem>
+MqAqmQueueDisc::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t n = GetNChildren ();
+  for (uint32_t i = 0; i < n; i++)
+    {
+      uint32_t child = (m_next + i) % n;
+      Ptr<QueueDiscItem> item = GetChild (child)->Dequeue ();
+      if (item != 0)
+        {
+          m_next = (child + 1) % n;
+          NS_LOG_LOGIC ("Popped from child " << child << ": " << item);
+          return item;
+        }
+    }
+
+  NS_LOG_LOGIC ("Queue empty");
+  return 0;
+}
+
+Ptr<const QueueDiscItem>
+MqAqmQueueDisc::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t n = GetNChildren ();
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Ptr<const QueueDiscItem> item = GetChild ((m_next + i) % n)->Peek ();
+      if (item != 0)
+        {
+          return item;
+        }
+    }
+  return 0;
+}
+
+bool
+MqAqmQueueDisc::CheckConfig (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (GetNInternalQueues () > 0)
+    {
+      NS_LOG_ERROR ("MqAqmQueueDisc cannot have internal queues");
+      return false;
+    }
+
+  if (m_steering == FLOW_HASH && GetNPacketFilters () == 0)
+    {
+      NS_LOG_ERROR ("MqAqmQueueDisc needs at least a packet filter with FLOW_HASH steering");
+      return false;
+    }
+
+  uint32_t nTxQueues = 1;
+  Ptr<NetDevice> device = GetNetDevice ();
+  if (device != 0 && device->GetObject<NetDeviceQueueInterface> () != 0)
+    {
+      nTxQueues = device->GetObject<NetDeviceQueueInterface> ()->GetNTxQueues ();
+    }
+
+  if (GetNQueueDiscClasses () == 0)
+    {
+      uint32_t n = m_nQueues ? m_nQueues : nTxQueues;
+      ObjectFactory factory;
+      factory.SetTypeId (m_childType);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          Ptr<QueueDisc> qd = factory.Create<QueueDisc> ();
+          qd->SetNetDevice (device);
+          Ptr<QueueDiscClass> c = CreateObject<QueueDiscClass> ();
+          c->SetQueueDisc (qd);
+          AddQueueDiscClass (c);
+        }
+    }
+
+  if (GetNQueueDiscClasses () == 0)
+    {
+      NS_LOG_ERROR ("MqAqmQueueDisc needs at least one child queue disc");
+      return false;
+    }
+
+  if (m_steering == TX_QUEUE && GetNQueueDiscClasses () != nTxQueues)
+    {
+      NS_LOG_ERROR ("MqAqmQueueDisc needs one child per device transmit queue with TX_QUEUE steering");
+      return false;
+    }
+
+  return true;
+}
+
+void
+MqAqmQueueDisc::InitializeParams (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_next = 0;
+}
+
+} //namespace ns3
@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MQ_AQM_QUEUE_DISC_H
+#define MQ_AQM_QUEUE_DISC_H
+
+#include "ns3/queue-disc.h"
+#include "ns3/object-factory.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Multi-queue root disc with one AQM instance per transmit queue.
+ *
+ * Models a multi-queue NIC where every TX ring has its own AQM (PI or
+ * BLUE) and flows are hashed across the rings. The root disc creates
+ * one child queue disc per ring and steers every packet to a child
+ * either by flow hash or by the device transmit queue selected for it.
+ * Flow hash steering needs a packet filter that tells the flows apart.
+ *
+ * With TX_QUEUE steering the traffic control layer enqueues into and
+ * wakes the children directly, so the packet and drop counters of the
+ * root stay at zero; GetStats sums those of the children.
+ */
+class MqAqmQueueDisc : public QueueDisc
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief MqAqmQueueDisc Constructor
+   */
+  MqAqmQueueDisc ();
+
+  /**
+   * \brief MqAqmQueueDisc Destructor
+   */
+  virtual ~MqAqmQueueDisc ();
+
+  /**
+   * \brief How packets are steered to the child queue discs
+   */
+  enum SteeringMode
+  {
+    FLOW_HASH,          //!< Hash of the packet filter result, e.g. of FqCoDelIpv4PacketFilter
+    TX_QUEUE            //!< Device transmit queue selected by the traffic control layer
+  };
+
+  /**
+   * \brief Stats aggregated over the child queue discs
+   */
+  typedef struct
+  {
+    uint32_t nChildren;         //!< Number of child queue discs
+    uint64_t packetsReceived;   //!< Packets received by the children
+    uint64_t packetsDropped;    //!< Packets dropped by the children
+    uint64_t packetsQueued;     //!< Packets currently queued in the children
+    uint32_t maxChildQueue;     //!< Packets queued in the most loaded child
+  } Stats;
+
+  /**
+   * \brief Get the number of child queue discs
+   *
+   * \returns The number of children
+   */
+  uint32_t GetNChildren (void) const;
+
+  /**
+   * \brief Get a child queue disc
+   *
+   * \param i The index of the child
+   * \returns The i-th child queue disc
+   */
+  Ptr<QueueDisc> GetChild (uint32_t i) const;
+
+  /**
+   * \brief Get the statistics aggregated over all the children.
+   *
+   * \returns The aggregated statistics.
+   */
+  Stats GetStats ();
+
+  virtual WakeMode GetWakeMode (void);
+
+protected:
+  /**
+   * \brief Dispose of the object
+   */
+  virtual void DoDispose (void);
+
+private:
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item);
+  virtual Ptr<QueueDiscItem> DoDequeue (void);
+  virtual Ptr<const QueueDiscItem> DoPeek (void) const;
+  virtual bool CheckConfig (void);
+  virtual void InitializeParams (void);
+
+  /**
+   * \brief Select the child queue disc of a packet
+   * \param item queue item
+   * \returns the child index
+   */
+  uint32_t SelectChild (Ptr<QueueDiscItem> item);
+
+  // ** Variables supplied by user
+  uint32_t m_nQueues;                           //!< Number of children, 0 to match the device TX queues
+  std::string m_childType;                      //!< TypeId of the children
+  SteeringMode m_steering;                      //!< Steering of packets to children
+  uint32_t m_perturbation;                      //!< Hash perturbation value
+
+  // ** Variables maintained by MQ
+  uint32_t m_next;                              //!< Child served first by the next dequeue
+};
+
+} // namespace ns3
+
+#endif // MQ_AQM_QUEUE_DISC_H
@@ -0,0 +1,354 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/abort.h"
+#include "ns3/object-factory.h"
+#include "ns3/packet-filter.h"
+#include "prio-aqm-queue-disc.h"
+#include "pi-queue-disc.h"
+#include "blue-queue-disc.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PrioAqmQueueDisc");
+
+NS_OBJECT_ENSURE_REGISTERED (PrioAqmQueueDisc);
+
+TypeId PrioAqmQueueDisc::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PrioAqmQueueDisc")
+    .SetParent<QueueDisc> ()
+    .SetGroupName ("TrafficControl")
+    .AddConstructor<PrioAqmQueueDisc> ()
+    .AddAttribute ("Bands",
+                   "Number of bands, used when BandQueueDiscs is empty",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&PrioAqmQueueDisc::m_nBands),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("BandQueueDiscs",
+                   "Queue disc of every band, highest priority first, semicolon separated, "
+                   "e.g. ns3::PiQueueDisc[QueueLimit=20|QueueRef=5];ns3::PiQueueDisc;ns3::BlueQueueDisc "
+                   "(empty for Bands PiQueueDiscs)",
+                   StringValue (""),
+                   MakeStringAccessor (&PrioAqmQueueDisc::m_bandTypes),
+                   MakeStringChecker ())
+    .AddAttribute ("DefaultBand",
+                   "Band of the packets that no packet filter classifies",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&PrioAqmQueueDisc::m_defaultBand),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Scheduler",
+                   "Scheduling of the bands",
+                   EnumValue (PrioAqmQueueDisc::STRICT_PRIORITY),
+                   MakeEnumAccessor (&PrioAqmQueueDisc::m_scheduler),
+                   MakeEnumChecker (PrioAqmQueueDisc::STRICT_PRIORITY, "STRICT_PRIORITY",
+                                    PrioAqmQueueDisc::DRR, "DRR"))
+    .AddAttribute ("Quantum",
+                   "Bytes a band of weight 1 may send per DRR round",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&PrioAqmQueueDisc::m_quantum),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Weights",
+                   "DRR weight of every band, highest priority first, semicolon separated (empty for all 1)",
+                   StringValue (""),
+                   MakeStringAccessor (&PrioAqmQueueDisc::m_weights),
+                   MakeStringChecker ())
+  ;
+
+  return tid;
+}
+
+PrioAqmQueueDisc::PrioAqmQueueDisc ()
+  : QueueDisc (),
+    m_current (0),
+    m_newRound (true)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+PrioAqmQueueDisc::~PrioAqmQueueDisc ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+PrioAqmQueueDisc::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  QueueDisc::DoDispose ();
+}
+
+uint32_t
+PrioAqmQueueDisc::GetNBands (void) const
+{
+  return GetNQueueDiscClasses ();
+}
+
+Ptr<QueueDisc>
+PrioAqmQueueDisc::GetBand (uint32_t band) const
+{
+  return GetQueueDiscClass (band)->GetQueueDisc ();
+}
+
+PrioAqmQueueDisc::BandStats
+PrioAqmQueueDisc::GetBandStats (uint32_t band)
+{
+  NS_LOG_FUNCTION (this << band);
+  Ptr<QueueDisc> child = GetBand (band);
+  BandStats st;
+  st.packetsReceived = child->GetTotalReceivedPackets ();
+  st.packetsDropped = child->GetTotalDroppedPackets ();
+  st.unforcedDrop = 0;
+  st.forcedDrop = 0;
+  st.packetsDequeued = band < m_dequeued.size () ? m_dequeued[band] : 0;
+  st.packetsQueued = child->GetNPackets ();
+  st.probability = 0;
+
+  Ptr<PiQueueDisc> pi = DynamicCast<PiQueueDisc> (child);
+  Ptr<BlueQueueDisc> blue = DynamicCast<BlueQueueDisc> (child);
+  if (pi != 0)
+    {
+      st.unforcedDrop = pi->GetAqmStats ().GetPackets (AqmStats::EARLY_DROP);
+      st.forcedDrop = pi->GetAqmStats ().GetPackets (AqmStats::FORCED_DROP);
+      st.probability = pi->GetDropProbability ();
+    }
+  else if (blue != 0)
+    {
+      st.unforcedDrop = blue->GetAqmStats ().GetPackets (AqmStats::EARLY_DROP);
+      st.forcedDrop = blue->GetAqmStats ().GetPackets (AqmStats::FORCED_DROP);
+      st.probability = blue->GetPmark ();
+    }
+  return st;
+}
+
+uint32_t
+PrioAqmQueueDisc::SelectBand (Ptr<QueueDiscItem> item)
+{
+  uint32_t n = GetNBands ();
+  int32_t ret = PacketFilter::PF_NO_MATCH;
+  if (GetNPacketFilters () > 0)
+    {
+      ret = Classify (item);
+    }
+  if (ret < 0)
+    {
+      // PF_NO_MATCH
+      return std::min (m_defaultBand, n - 1);
+    }
+  return std::min ((uint32_t) ret, n - 1);
+}
+
+bool
+PrioAqmQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << item);
+
+  uint32_t band = SelectBand (item);
+  NS_LOG_LOGIC ("Enqueue in band " << band);
+
+  // If the band drops the packet, it notifies this queue disc
+  return GetBand (band)->Enqueue (item);
+}
+
+Ptr<QueueDiscItem>
+PrioAqmQueueDisc::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_scheduler == DRR)
+    {
+      return DequeueDrr ();
+    }
+
+  for (uint32_t band = 0; band < GetNBands (); band++)
+    {
+      Ptr<QueueDiscItem> item = GetBand (band)->Dequeue ();
+      if (item != 0)
+        {
+          m_dequeued[band]++;
+          NS_LOG_LOGIC ("Popped from band " << band << ": " << item);
+          return item;
+        }
+    }
+
+  NS_LOG_LOGIC ("Queue empty");
+  return 0;
+}
+
+Ptr<QueueDiscItem>
+PrioAqmQueueDisc::DequeueDrr (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t n = GetNBands ();
+  uint32_t emptyBands = 0;
+  while (emptyBands < n)
+    {
+      Ptr<QueueDisc> child = GetBand (m_current);
+      Ptr<const QueueDiscItem> head = child->Peek ();
+      if (head == 0)
+        {
+          // An empty band does not keep its deficit
+          m_deficits[m_current] = 0;
+          m_current = (m_current + 1) % n;
+          m_newRound = true;
+          emptyBands++;
+          continue;
+        }
+      emptyBands = 0;
+
+      if (m_newRound)
+        {
+          m_deficits[m_current] += m_quanta[m_current];
+          m_newRound = false;
+        }
+
+      if (m_deficits[m_current] >= (int64_t) head->GetPacketSize ())
+        {
+          Ptr<QueueDiscItem> item = child->Dequeue ();
+          if (item != 0)
+            {
+              m_deficits[m_current] -= item->GetPacketSize ();
+              m_dequeued[m_current]++;
+              NS_LOG_LOGIC ("Popped from band " << m_current << ": " << item);
+              return item;
+            }
+        }
+      else
+        {
+          m_current = (m_current + 1) % n;
+          m_newRound = true;
+        }
+    }
+
+  NS_LOG_LOGIC ("Queue empty");
+  return 0;
+}
+
+Ptr<const QueueDiscItem>
+PrioAqmQueueDisc::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t n = GetNBands ();
+  uint32_t first = m_scheduler == DRR ? m_current : 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Ptr<const QueueDiscItem> item = GetBand ((first + i) % n)->Peek ();
+      if (item != 0)
+        {
+          return item;
+        }
+    }
+  return 0;
+}
+
+bool
+PrioAqmQueueDisc::CheckConfig (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (GetNInternalQueues () > 0)
+    {
+      NS_LOG_ERROR ("PrioAqmQueueDisc cannot have internal queues");
+      return false;
+    }
+
+  if (GetNQueueDiscClasses () == 0)
+    {
+      std::vector<std::string> specs;
+      std::istringstream bands (m_bandTypes);
+      std::string spec;
+      while (std::getline (bands, spec, ';'))
+        {
+          if (!spec.empty ())
+            {
+              specs.push_back (spec);
+            }
+        }
+      if (specs.empty ())
+        {
+          specs.assign (m_nBands, "ns3::PiQueueDisc");
+        }
+
+      for (uint32_t i = 0; i < specs.size (); i++)
+        {
+          // "TypeId[Name=Value|Name=Value]", as the --aqm option of the programs
+          ObjectFactory factory;
+          std::string::size_type open = specs[i].find ('[');
+          factory.SetTypeId (specs[i].substr (0, open));
+          if (open != std::string::npos)
+            {
+              std::string::size_type close = specs[i].rfind (']');
+              NS_ABORT_MSG_IF (close == std::string::npos || close < open, "Malformed band queue disc " << specs[i]);
+              std::istringstream attrs (specs[i].substr (open + 1, close - open - 1));
+              std::string token;
+              while (std::getline (attrs, token, '|'))
+                {
+                  std::string::size_type eq = token.find ('=');
+                  NS_ABORT_MSG_IF (eq == std::string::npos, "Malformed attribute " << token);
+                  factory.Set (token.substr (0, eq), StringValue (token.substr (eq + 1)));
+                }
+            }
+          Ptr<QueueDisc> qd = factory.Create<QueueDisc> ();
+          qd->SetNetDevice (GetNetDevice ());
+          Ptr<QueueDiscClass> c = CreateObject<QueueDiscClass> ();
+          c->SetQueueDisc (qd);
+          AddQueueDiscClass (c);
+        }
+    }
+
+  if (GetNQueueDiscClasses () == 0)
+    {
+      NS_LOG_ERROR ("PrioAqmQueueDisc needs at least one band");
+      return false;
+    }
+
+  m_quanta.assign (GetNQueueDiscClasses (), m_quantum);
+  std::istringstream weights (m_weights);
+  std::string weight;
+  for (uint32_t i = 0; std::getline (weights, weight, ';'); i++)
+    {
+      if (i >= m_quanta.size () || std::atof (weight.c_str ()) <= 0)
+        {
+          NS_LOG_ERROR ("Weights needs one positive weight per band");
+          return false;
+        }
+      m_quanta[i] = std::max (1u, (uint32_t) (m_quantum * std::atof (weight.c_str ())));
+    }
+
+  return true;
+}
+
+void
+PrioAqmQueueDisc::InitializeParams (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_deficits.assign (GetNBands (), 0);
+  m_dequeued.assign (GetNBands (), 0);
+  m_current = 0;
+  m_newRound = true;
+}
+
+} //namespace ns3
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PRIO_AQM_QUEUE_DISC_H
+#define PRIO_AQM_QUEUE_DISC_H
+
+#include <vector>
+#include "ns3/queue-disc.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup traffic-control
+ *
+ * \brief Multi-band root disc with one AQM instance per priority band.
+ *
+ * Like pfifo_fast, packets are classified into bands by the packet
+ * filters (e.g. PfifoFastIpv4PacketFilter, which maps the ToS field to
+ * bands 0 to 2), but every band is a child PI or BLUE queue disc with its
+ * own controller and limit. Band 0 is the highest priority. Bands are
+ * served in strict priority or by deficit round robin with per-band
+ * weights, so interactive traffic does not wait behind the bulk band
+ * while the bulk band keeps its AQM.
+ */
+class PrioAqmQueueDisc : public QueueDisc
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief PrioAqmQueueDisc Constructor
+   */
+  PrioAqmQueueDisc ();
+
+  /**
+   * \brief PrioAqmQueueDisc Destructor
+   */
+  virtual ~PrioAqmQueueDisc ();
+
+  /**
+   * \brief How the bands are served
+   */
+  enum Scheduler
+  {
+    STRICT_PRIORITY,    //!< Lowest non-empty band first
+    DRR                 //!< Deficit round robin, Quantum times the band weight per round
+  };
+
+  /**
+   * \brief Stats of one band
+   */
+  typedef struct
+  {
+    uint64_t packetsReceived;   //!< Packets classified into the band
+    uint64_t packetsDropped;    //!< Packets dropped by the band
+    uint64_t unforcedDrop;      //!< Early drops of the band's controller
+    uint64_t forcedDrop;        //!< Drops due to the band's limit
+    uint64_t packetsDequeued;   //!< Packets served from the band
+    uint32_t packetsQueued;     //!< Packets currently queued in the band
+    double probability;         //!< Drop probability or Pmark of the band's controller, 0 for other queue discs
+  } BandStats;
+
+  /**
+   * \brief Get the number of bands
+   *
+   * \returns The number of child queue discs
+   */
+  uint32_t GetNBands (void) const;
+
+  /**
+   * \brief Get the queue disc of a band
+   *
+   * \param band The band, 0 being the highest priority
+   * \returns The child queue disc of the band
+   */
+  Ptr<QueueDisc> GetBand (uint32_t band) const;
+
+  /**
+   * \brief Get the statistics of a band.
+   *
+   * \param band The band, 0 being the highest priority
+   * \returns The band statistics.
+   */
+  BandStats GetBandStats (uint32_t band);
+
+protected:
+  /**
+   * \brief Dispose of the object
+   */
+  virtual void DoDispose (void);
+
+private:
+  virtual bool DoEnqueue (Ptr<QueueDiscItem> item);
+  virtual Ptr<QueueDiscItem> DoDequeue (void);
+  virtual Ptr<const QueueDiscItem> DoPeek (void) const;
+  virtual bool CheckConfig (void);
+  virtual void InitializeParams (void);
+
+  /**
+   * \brief Select the band of a packet
+   * \param item queue item
+   * \returns the band
+   */
+  uint32_t SelectBand (Ptr<QueueDiscItem> item);
+
+  /**
+   * \brief Dequeue by deficit round robin
+   * \returns the dequeued item, or 0 if all the bands are empty
+   */
+  Ptr<QueueDiscItem> DequeueDrr (void);
+
+  // ** Variables supplied by user
+  uint32_t m_nBands;                            //!< Number of bands
+  std::string m_bandTypes;                      //!< Queue discs of the bands, semicolon separated
+  uint32_t m_defaultBand;                       //!< Band of the packets no filter matches
+  Scheduler m_scheduler;                        //!< Scheduling of the bands
+  uint32_t m_quantum;                           //!< Bytes per DRR round of a band of weight 1
+  std::string m_weights;                        //!< DRR weights of the bands, semicolon separated
+
+  // ** Variables maintained by PRIO
+  std::vector<uint32_t> m_quanta;               //!< Bytes per DRR round of each band
+  std::vector<int64_t> m_deficits;              //!< DRR deficit of each band
+  std::vector<uint64_t> m_dequeued;             //!< Packets served from each band
+  uint32_t m_current;                           //!< Band the DRR round is at
+  bool m_newRound;                              //!< The current band has not received its quantum yet
+};
+
+} // namespace ns3
+
+#endif // PRIO_AQM_QUEUE_DISC_H
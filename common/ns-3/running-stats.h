@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <cmath>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \brief Single-pass mean and variance of a sample (Welford's algorithm).
+ *
+ * Used by the replication drivers to fold the result of every
+ * replication into memory without keeping the individual samples.
+ */
+class RunningStats
+{
+public:
+  RunningStats ()
+    : m_n (0),
+      m_mean (0.0),
+      m_m2 (0.0)
+  {
+  }
+
+  /**
+   * \brief Add one observation
+   * \param x the observed value
+   */
+  void Add (double x)
+  {
+    m_n++;
+    double delta = x - m_mean;
+    m_mean += delta / m_n;
+    m_m2 += delta * (x - m_mean);
+  }
+
+  /**
+   * \returns the number of observations
+   */
+  uint32_t GetCount (void) const
+  {
+    return m_n;
+  }
+
+  /**
+   * \returns the sample mean
+   */
+  double GetMean (void) const
+  {
+    return m_mean;
+  }
+
+  /**
+   * \returns the unbiased sample variance, 0 with less than two observations
+   */
+  double GetVariance (void) const
+  {
+    return m_n > 1 ? m_m2 / (m_n - 1) : 0.0;
+  }
+
+  /**
+   * \brief Half-width of the confidence interval of the mean
+   * \param confidence confidence level, either 0.90, 0.95 or 0.99
+   * \returns the half-width, infinite with less than two observations
+   */
+  double GetHalfWidth (double confidence) const
+  {
+    if (m_n < 2)
+      {
+        return INFINITY;
+      }
+    return StudentT (m_n - 1, confidence) * std::sqrt (GetVariance () / m_n);
+  }
+
+  /**
+   * \brief Two-sided quantile of the Student t distribution
+   * \param df degrees of freedom
+   * \param confidence confidence level, either 0.90, 0.95 or 0.99
+   * \returns the t value
+   */
+  static double StudentT (uint32_t df, double confidence)
+  {
+    // Rows: df = 1..30; columns: 90 %, 95 %, 99 %
+    static const double table[30][3] = {
+      { 6.314, 12.706, 63.657 }, { 2.920, 4.303, 9.925 }, { 2.353, 3.182, 5.841 },
+      { 2.132, 2.776, 4.604 }, { 2.015, 2.571, 4.032 }, { 1.943, 2.447, 3.707 },
+      { 1.895, 2.365, 3.499 }, { 1.860, 2.306, 3.355 }, { 1.833, 2.262, 3.250 },
+      { 1.812, 2.228, 3.169 }, { 1.796, 2.201, 3.106 }, { 1.782, 2.179, 3.055 },
+      { 1.771, 2.160, 3.012 }, { 1.761, 2.145, 2.977 }, { 1.753, 2.131, 2.947 },
+      { 1.746, 2.120, 2.921 }, { 1.740, 2.110, 2.898 }, { 1.734, 2.101, 2.878 },
+      { 1.729, 2.093, 2.861 }, { 1.725, 2.086, 2.845 }, { 1.721, 2.080, 2.831 },
+      { 1.717, 2.074, 2.819 }, { 1.714, 2.069, 2.807 }, { 1.711, 2.064, 2.797 },
+      { 1.708, 2.060, 2.787 }, { 1.706, 2.056, 2.779 }, { 1.703, 2.052, 2.771 },
+      { 1.701, 2.048, 2.763 }, { 1.699, 2.045, 2.756 }, { 1.697, 2.042, 2.750 }
+    };
+    static const double normal[3] = { 1.644854, 1.959964, 2.575829 };
+
+    int col = 1;
+    if (confidence < 0.925)
+      {
+        col = 0;
+      }
+    else if (confidence > 0.975)
+      {
+        col = 2;
+      }
+    if (df == 0)
+      {
+        return INFINITY;
+      }
+    if (df <= 30)
+      {
+        return table[df - 1][col];
+      }
+    // Cornish-Fisher expansion around the normal quantile: it matches the
+    // table at df = 30 within its rounding, so the quantile does not jump
+    // to the normal one past the end of the table
+    double z = normal[col];
+    double z2 = z * z;
+    double n = df;
+    return z + z * (z2 + 1) / (4 * n)
+      + z * (5 * z2 * z2 + 16 * z2 + 3) / (96 * n * n)
+      + z * (3 * z2 * z2 * z2 + 19 * z2 * z2 + 17 * z2 - 15) / (384 * n * n * n);
+  }
+
+private:
+  uint32_t m_n;         //!< Number of observations
+  double m_mean;        //!< Running mean
+  double m_m2;          //!< Running sum of squared deviations from the mean
+};
+
+} // namespace ns3
+
+#endif // RUNNING_STATS_H
@@ -0,0 +1,417 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SHORT_FLOW_WORKLOAD_H
+#define SHORT_FLOW_WORKLOAD_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Records the start and finish time of every short transfer.
+ *
+ * Records are kept in a compact table (one fixed-size entry per
+ * transfer); percentiles per size bucket are computed once at the end.
+ */
+class FctRecorder
+{
+public:
+  /**
+   * One transfer
+   */
+  struct Record
+  {
+    uint32_t size;      //!< Transfer size in bytes
+    int64_t start;      //!< Start time in nanoseconds
+    int64_t finish;     //!< Finish time in nanoseconds, -1 while unfinished
+  };
+
+  /**
+   * \brief Record the start of a transfer
+   * \param size the transfer size in bytes
+   * \returns the transfer id
+   */
+  uint32_t Start (uint32_t size)
+  {
+    Record r;
+    r.size = size;
+    r.start = Simulator::Now ().GetNanoSeconds ();
+    r.finish = -1;
+    m_records.push_back (r);
+    return m_records.size () - 1;
+  }
+
+  /**
+   * \brief Record the completion of a transfer
+   * \param id the transfer id returned by Start
+   */
+  void Finish (uint32_t id)
+  {
+    NS_ASSERT (id < m_records.size ());
+    m_records[id].finish = Simulator::Now ().GetNanoSeconds ();
+  }
+
+  /**
+   * \returns the table of transfers
+   */
+  const std::vector<Record> & GetRecords (void) const
+  {
+    return m_records;
+  }
+
+  /**
+   * \brief Completion time percentile of the finished transfers whose size
+   * is in [minSize, maxSize)
+   * \returns the percentile in seconds, 0 if no transfer finished
+   */
+  double GetPercentile (double percentile, uint32_t minSize = 0, uint32_t maxSize = 0xffffffff) const
+  {
+    std::vector<int64_t> fct;
+    for (std::vector<Record>::const_iterator it = m_records.begin (); it != m_records.end (); ++it)
+      {
+        if (it->finish >= 0 && it->size >= minSize && it->size < maxSize)
+          {
+            fct.push_back (it->finish - it->start);
+          }
+      }
+    if (fct.empty ())
+      {
+        return 0.0;
+      }
+    size_t k = std::min (fct.size () - 1, static_cast<size_t> (percentile * fct.size ()));
+    std::nth_element (fct.begin (), fct.begin () + k, fct.end ());
+    return fct[k] * 1e-9;
+  }
+
+  /**
+   * \brief Print count, unfinished transfers and FCT percentiles per size bucket
+   * \param os the output stream
+   * \param edges increasing bucket edges in bytes
+   */
+  void Report (std::ostream &os, std::vector<uint32_t> edges) const
+  {
+    edges.insert (edges.begin (), 0);
+    edges.push_back (0xffffffff);
+    os << "*** flow completion times (s) ***" << std::endl;
+    for (uint32_t b = 0; b + 1 < edges.size (); b++)
+      {
+        uint32_t finished = 0;
+        uint32_t unfinished = 0;
+        for (std::vector<Record>::const_iterator it = m_records.begin (); it != m_records.end (); ++it)
+          {
+            if (it->size >= edges[b] && it->size < edges[b + 1])
+              {
+                it->finish >= 0 ? finished++ : unfinished++;
+              }
+          }
+        os << "\t [" << edges[b] << ", " << edges[b + 1] << ") bytes: "
+           << finished << " done, " << unfinished << " unfinished, p50 "
+           << GetPercentile (0.50, edges[b], edges[b + 1]) << " p95 "
+           << GetPercentile (0.95, edges[b], edges[b + 1]) << " p99 "
+           << GetPercentile (0.99, edges[b], edges[b + 1]) << std::endl;
+      }
+  }
+
+  /**
+   * \brief Write the table as "size start finish" lines (times in seconds,
+   * finish is -1 for unfinished transfers)
+   */
+  void WriteTable (std::string fileName) const
+  {
+    std::ofstream out (fileName.c_str (), std::ios::out);
+    for (std::vector<Record>::const_iterator it = m_records.begin (); it != m_records.end (); ++it)
+      {
+        out << it->size << " " << it->start * 1e-9 << " "
+            << (it->finish >= 0 ? it->finish * 1e-9 : -1.0) << std::endl;
+      }
+  }
+
+private:
+  std::vector<Record> m_records;        //!< Table of transfers
+};
+
+/**
+ * \brief Short TCP transfers with Poisson arrivals and heavy-tailed sizes.
+ *
+ * Every arrival opens a new TCP connection from a randomly chosen source
+ * node to the sink, sends the drawn number of bytes and closes. The
+ * transfer is complete when the sink has received all its bytes.
+ */
+class ShortFlowWorkload
+{
+public:
+  /**
+   * \param sources the nodes opening the transfers
+   * \param sink the node receiving the transfers
+   * \param sinkAddress the address of the sink
+   * \param port the port the sink listens on
+   * \param recorder the recorder the transfers are logged into
+   */
+  ShortFlowWorkload (NodeContainer sources, Ptr<Node> sink, Ipv4Address sinkAddress,
+                     uint16_t port, FctRecorder *recorder)
+    : m_sources (sources),
+      m_sink (sink),
+      m_sinkAddress (sinkAddress),
+      m_port (port),
+      m_recorder (recorder),
+      m_rate (10),
+      m_meanSize (50000),
+      m_shape (1.2),
+      m_bound (10000000),
+      m_stream (-1)
+  {
+  }
+
+  /**
+   * \param flowsPerSecond mean rate of the Poisson arrivals
+   */
+  void SetArrivalRate (double flowsPerSecond)
+  {
+    m_rate = flowsPerSecond;
+  }
+
+  /**
+   * \brief Draw sizes from a bounded Pareto distribution
+   * \param mean mean size in bytes
+   * \param shape Pareto shape (tail index)
+   * \param bound largest size in bytes
+   */
+  void SetParetoSizes (double mean, double shape, double bound)
+  {
+    m_meanSize = mean;
+    m_shape = shape;
+    m_bound = bound;
+    m_cdfFile = "";
+  }
+
+  /**
+   * \brief Draw sizes from an empirical CDF read from a file of
+   * "bytes cumulative-probability" lines in increasing order
+   */
+  void SetEmpiricalSizes (std::string fileName)
+  {
+    m_cdfFile = fileName;
+  }
+
+  /**
+   * \brief Assign fixed random variable streams
+   * \param stream first stream index to use
+   * \returns the number of stream indices assigned
+   */
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_stream = stream;
+    return 3;
+  }
+
+  /**
+   * \brief Listen on the sink and generate arrivals in [start, stop)
+   *
+   * The random variables are created here rather than in the constructor,
+   * so that a disabled workload does not shift the automatically assigned
+   * streams of the scenario.
+   */
+  void Install (Time start, Time stop)
+  {
+    m_interArrival = CreateObject<ExponentialRandomVariable> ();
+    m_interArrival->SetAttribute ("Mean", DoubleValue (1.0 / m_rate));
+    m_sourceVar = CreateObject<UniformRandomVariable> ();
+    if (m_cdfFile.empty ())
+      {
+        Ptr<ParetoRandomVariable> size = CreateObject<ParetoRandomVariable> ();
+        size->SetAttribute ("Mean", DoubleValue (m_meanSize));
+        size->SetAttribute ("Shape", DoubleValue (m_shape));
+        size->SetAttribute ("Bound", DoubleValue (m_bound));
+        m_size = size;
+      }
+    else
+      {
+        std::ifstream in (m_cdfFile.c_str ());
+        NS_ABORT_MSG_IF (!in, "Cannot open size distribution " << m_cdfFile);
+        Ptr<EmpiricalRandomVariable> size = CreateObject<EmpiricalRandomVariable> ();
+        double bytes, cdf;
+        while (in >> bytes >> cdf)
+          {
+            size->CDF (bytes, cdf);
+          }
+        m_size = size;
+      }
+    if (m_stream >= 0)
+      {
+        m_interArrival->SetStream (m_stream);
+        m_sourceVar->SetStream (m_stream + 1);
+        m_size->SetStream (m_stream + 2);
+      }
+
+    m_stop = stop;
+    m_listener = Socket::CreateSocket (m_sink, TcpSocketFactory::GetTypeId ());
+    m_listener->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port));
+    m_listener->Listen ();
+    m_listener->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                   MakeCallback (&ShortFlowWorkload::HandleAccept, this));
+    Simulator::Schedule (start, &ShortFlowWorkload::ScheduleNext, this);
+  }
+
+private:
+  /**
+   * Sender side of a transfer
+   */
+  struct TxState
+  {
+    uint32_t remaining;         //!< Bytes not yet handed to the socket
+  };
+
+  /**
+   * Receiver side of a transfer
+   */
+  struct RxState
+  {
+    uint32_t id;                //!< Transfer id in the recorder
+    uint32_t size;              //!< Transfer size
+    uint32_t received;          //!< Bytes received so far
+  };
+
+  typedef std::pair<uint32_t, uint16_t> Endpoint; //!< Source address and port
+
+  void ScheduleNext (void)
+  {
+    Time next = Seconds (m_interArrival->GetValue ());
+    if (Simulator::Now () + next < m_stop)
+      {
+        Simulator::Schedule (next, &ShortFlowWorkload::StartFlow, this);
+      }
+  }
+
+  void StartFlow (void)
+  {
+    ScheduleNext ();
+
+    uint32_t size = std::max (1u, static_cast<uint32_t> (m_size->GetValue ()));
+    Ptr<Node> node = m_sources.Get (m_sourceVar->GetInteger (0, m_sources.GetN () - 1));
+
+    Ptr<Socket> socket = Socket::CreateSocket (node, TcpSocketFactory::GetTypeId ());
+    socket->Bind ();
+    socket->Connect (InetSocketAddress (m_sinkAddress, m_port));
+
+    Address local;
+    socket->GetSockName (local);
+    uint16_t localPort = InetSocketAddress::ConvertFrom (local).GetPort ();
+    Ipv4Address localAddress = node->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+
+    RxState rx;
+    rx.id = m_recorder->Start (size);
+    rx.size = size;
+    rx.received = 0;
+    m_pending[Endpoint (localAddress.Get (), localPort)] = rx;
+
+    TxState tx;
+    tx.remaining = size;
+    m_tx[socket] = tx;
+    socket->SetSendCallback (MakeCallback (&ShortFlowWorkload::HandleSend, this));
+    // TCP buffers data written while the handshake is in progress
+    HandleSend (socket, socket->GetTxAvailable ());
+  }
+
+  void HandleSend (Ptr<Socket> socket, uint32_t available)
+  {
+    std::map<Ptr<Socket>, TxState>::iterator it = m_tx.find (socket);
+    if (it == m_tx.end ())
+      {
+        return;
+      }
+    while (it->second.remaining > 0 && socket->GetTxAvailable () > 0)
+      {
+        uint32_t chunk = std::min (it->second.remaining, socket->GetTxAvailable ());
+        int sent = socket->Send (Create<Packet> (chunk));
+        if (sent <= 0)
+          {
+            return;
+          }
+        it->second.remaining -= sent;
+      }
+    if (it->second.remaining == 0)
+      {
+        socket->Close ();
+        m_tx.erase (it);
+      }
+  }
+
+  void HandleAccept (Ptr<Socket> socket, const Address &from)
+  {
+    InetSocketAddress peer = InetSocketAddress::ConvertFrom (from);
+    std::map<Endpoint, RxState>::iterator it = m_pending.find (Endpoint (peer.GetIpv4 ().Get (), peer.GetPort ()));
+    if (it == m_pending.end ())
+      {
+        return;
+      }
+    m_rx[socket] = it->second;
+    m_pending.erase (it);
+    socket->SetRecvCallback (MakeCallback (&ShortFlowWorkload::HandleRead, this));
+  }
+
+  void HandleRead (Ptr<Socket> socket)
+  {
+    std::map<Ptr<Socket>, RxState>::iterator it = m_rx.find (socket);
+    Ptr<Packet> packet;
+    while ((packet = socket->Recv ()))
+      {
+        if (it != m_rx.end ())
+          {
+            it->second.received += packet->GetSize ();
+          }
+      }
+    if (it != m_rx.end () && it->second.received >= it->second.size)
+      {
+        m_recorder->Finish (it->second.id);
+        m_rx.erase (it);
+        socket->Close ();
+      }
+  }
+
+  NodeContainer m_sources;                      //!< Nodes opening the transfers
+  Ptr<Node> m_sink;                             //!< Node receiving the transfers
+  Ipv4Address m_sinkAddress;                    //!< Address of the sink
+  uint16_t m_port;                              //!< Port of the sink
+  FctRecorder *m_recorder;                      //!< Transfer log
+  double m_rate;                                //!< Arrivals per second
+  double m_meanSize;                            //!< Mean Pareto size in bytes
+  double m_shape;                               //!< Pareto shape
+  double m_bound;                               //!< Largest Pareto size in bytes
+  std::string m_cdfFile;                        //!< Empirical size CDF, empty for Pareto sizes
+  int64_t m_stream;                             //!< First assigned stream, -1 for automatic
+  Time m_stop;                                  //!< No arrival after this time
+  Ptr<Socket> m_listener;                       //!< Listening socket on the sink
+  Ptr<ExponentialRandomVariable> m_interArrival; //!< Poisson inter-arrival times
+  Ptr<UniformRandomVariable> m_sourceVar;       //!< Source node choice
+  Ptr<RandomVariableStream> m_size;             //!< Transfer sizes
+  std::map<Ptr<Socket>, TxState> m_tx;          //!< Transfers still being written
+  std::map<Endpoint, RxState> m_pending;        //!< Transfers not yet accepted by the sink
+  std::map<Ptr<Socket>, RxState> m_rx;          //!< Transfers being received
+};
+
+} // namespace ns3
+
+#endif // SHORT_FLOW_WORKLOAD_H
@@ -0,0 +1,588 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * The PI and BLUE controllers of PiQueueDisc and BlueQueueDisc without
+ * ns-3: times are seconds and queue lengths are packets. The tools that
+ * evaluate the controllers outside the simulator (fluid model, trace
+ * replay, emulator) share these so that a parameter set means the same
+ * thing everywhere. Keep them in step with the queue discs.
+ *
+ * With fixedPoint the controllers run the Q48 arithmetic of
+ * aqm-fixed-point.h, as the queue discs do with FixedPoint=true;
+ * GetProbability still returns a double and GetThreshold gives the
+ * integer drop test.
+ */
+
+#ifndef AQM_CORE_H
+#define AQM_CORE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include "aqm-fixed-point.h"
+
+namespace aqm {
+
+/**
+ * \brief Integrator anti-windup of the PID controller, as in PiQueueDisc
+ */
+enum AntiWindup
+{
+  ANTI_WINDUP_NONE,
+  ANTI_WINDUP_CONDITIONAL,
+  ANTI_WINDUP_BACK_CALCULATION
+};
+
+/**
+ * \brief Parameters of PiQueueDisc, with its defaults
+ */
+struct PiParams
+{
+  PiParams ()
+    : a (0.00001822),
+      b (0.00001816),
+      w (170),
+      qRef (50),
+      fixedPoint (false),
+      adaptiveSampling (false),
+      minInterval (0),
+      maxInterval (0.1),
+      stableQueueDelta (2),
+      maxBurstAllowance (0),
+      lowWatermark (0),
+      idleDecay (1),
+      pid (false),
+      kd (0),
+      antiWindup (ANTI_WINDUP_CONDITIONAL),
+      trackingTime (0.1),
+      maxRate (0)
+  {
+  }
+
+  double a;                     //!< Value of alpha
+  double b;                     //!< Value of beta
+  double w;                     //!< Sampling frequency (Number of times per second)
+  double qRef;                  //!< Desired queue size in packets
+  bool fixedPoint;              //!< Q48 arithmetic, queue lengths rounded to whole packets
+  bool adaptiveSampling;        //!< Adapt the update interval to the load
+  double minInterval;           //!< Update interval during transients in seconds, 0 for 1 / w
+  double maxInterval;           //!< Longest update interval in seconds
+  double stableQueueDelta;      //!< Queue change, in packets, below which the queue is stable
+  double maxBurstAllowance;     //!< Burst allowance granted after a quiet period in seconds, 0 to disable
+  double lowWatermark;          //!< Queue size in packets below which there is no early drop
+  double idleDecay;             //!< Factor of the drop probability while the queue stays empty
+  bool pid;                     //!< The PID controller instead of the PI law (not with fixedPoint)
+  double kd;                    //!< Derivative gain, probability per packet per second
+  AntiWindup antiWindup;        //!< Anti-windup of the PID controller
+  double trackingTime;          //!< Time constant of the back-calculation in seconds
+  double maxRate;               //!< Largest change of the PID output per second, 0 for no limit
+};
+
+/**
+ * \brief The PI drop probability update of PiQueueDisc::CalculateP
+ *
+ * With adaptiveSampling the interval doubles, up to maxInterval, while
+ * the queue is stable and drops to minInterval when it is not; a and b
+ * are recomputed for each interval (Tustin) so that the continuous-time
+ * controller stays the one of a and b at 1 / w. Schedule the updates
+ * with GetInterval after each Update.
+ */
+class PiController
+{
+public:
+  PiController ()
+  {
+    SetParams (PiParams ());
+    Reset ();
+  }
+
+  void SetParams (const PiParams &params)
+  {
+    m_params = params;
+    m_interval = 1.0 / params.w;
+    m_burstAllowance = params.maxBurstAllowance;
+    m_integral = (params.a + params.b) / 2 * params.qRef;
+    SetGains (params.a, params.b);
+  }
+
+  const PiParams & GetParams (void) const
+  {
+    return m_params;
+  }
+
+  void Reset (void)
+  {
+    m_dropProb = 0;
+    m_qOld = 0;
+    m_dropProbFixed = 0;
+    m_qOldFixed = 0;
+    m_interval = 1.0 / m_params.w;
+    m_burstAllowance = m_params.maxBurstAllowance;
+    m_integral = (m_params.a + m_params.b) / 2 * m_params.qRef;
+  }
+
+  /**
+   * \returns The time until the next update in seconds
+   */
+  double GetInterval (void) const
+  {
+    return m_interval;
+  }
+
+  /**
+   * \brief Update the drop probability, once per sampling interval
+   * \param qlen The queue length in packets
+   * \returns The new drop probability
+   */
+  double Update (double qlen)
+  {
+    double qOld = m_params.fixedPoint ? m_qOldFixed : m_qOld;
+    bool idle = m_params.idleDecay < 1 && qlen == 0 && qOld == 0;
+    if (m_params.adaptiveSampling)
+      {
+        double kp = (m_params.a + m_params.b) / 2;
+        double ki = (m_params.a - m_params.b) * m_params.w;
+        SetGains (kp + ki * m_interval / 2, kp - ki * m_interval / 2);
+      }
+    if (m_params.fixedPoint)
+      {
+        int64_t q = (int64_t) (qlen + 0.5);
+        m_dropProbFixed = AqmClampFixed (m_aFixed * q - m_aQRefFixed - (m_bFixed * m_qOldFixed - m_bQRefFixed) + m_dropProbFixed);
+        m_qOldFixed = q;
+        if (idle)
+          {
+            uint64_t decay = std::min<uint64_t> ((uint64_t) (m_params.idleDecay * 65536 + 0.5), 65535);
+            m_dropProbFixed = (int64_t) (((uint64_t) m_dropProbFixed * decay) >> 16);
+          }
+      }
+    else
+      {
+        double p;
+        if (m_params.pid)
+          {
+            p = UpdatePid (qlen - m_params.qRef, m_qOld - m_params.qRef);
+          }
+        else
+          {
+            p = m_a * (qlen - m_params.qRef) - m_b * (m_qOld - m_params.qRef) + m_dropProb;
+          }
+        p = (p < 0) ? 0 : p;
+        p = (p > 1) ? 1 : p;
+        if (idle && m_params.pid)
+          {
+            m_integral -= p * (1 - m_params.idleDecay);
+          }
+        m_dropProb = idle ? p * m_params.idleDecay : p;
+        m_qOld = qlen;
+      }
+    if (m_params.maxBurstAllowance > 0)
+      {
+        m_burstAllowance = std::max (m_burstAllowance - m_interval, 0.0);
+        if (m_burstAllowance == 0 && GetProbability () == 0
+            && qlen < m_params.qRef / 2 && qOld < m_params.qRef / 2)
+          {
+            m_burstAllowance = m_params.maxBurstAllowance;
+          }
+      }
+    if (m_params.adaptiveSampling)
+      {
+        double p = GetProbability ();
+        double error = qlen - m_params.qRef;
+        double delta = m_params.stableQueueDelta;
+        bool stable = std::fabs (qlen - qOld) <= delta
+          && (std::fabs (error) <= delta || (p <= 0 && error < 0) || (p >= 1 && error > 0));
+        double minInterval = m_params.minInterval > 0 ? m_params.minInterval : 1.0 / m_params.w;
+        m_interval = stable ? std::min (2 * m_interval, m_params.maxInterval) : minInterval;
+      }
+    return GetProbability ();
+  }
+
+  double GetProbability (void) const
+  {
+    return m_params.fixedPoint ? AqmFromFixed (m_dropProbFixed) : m_dropProb;
+  }
+
+  /**
+   * \returns The threshold of the integer drop test (AqmFixedDrop), with fixedPoint
+   */
+  uint64_t GetThreshold (void) const
+  {
+    return AqmFixedThreshold (m_dropProbFixed);
+  }
+
+  /**
+   * \param qlen The queue length in packets
+   * \returns False while the burst allowance lasts or the queue is below
+   * lowWatermark, when no packet may be dropped early
+   */
+  bool AllowEarlyDrop (double qlen) const
+  {
+    return m_burstAllowance <= 0 && qlen >= m_params.lowWatermark;
+  }
+
+private:
+  /**
+   * \brief The PiQueueDisc::UpdatePid step over the current interval
+   */
+  double UpdatePid (double error, double errorOld)
+  {
+    double t = m_interval;
+    double kp = (m_params.a + m_params.b) / 2;
+    double ki = (m_params.a - m_params.b) * m_params.w;
+    double step = ki * t * (error + errorOld) / 2;
+    double integral = m_integral + step;
+    double p = kp * error + integral + m_params.kd * (error - errorOld) / t;
+    double low = 0;
+    double high = 1;
+    if (m_params.maxRate > 0)
+      {
+        low = std::max (low, m_dropProb - m_params.maxRate * t);
+        high = std::min (high, m_dropProb + m_params.maxRate * t);
+      }
+    double limited = std::min (std::max (p, low), high);
+    if (m_params.antiWindup == ANTI_WINDUP_CONDITIONAL)
+      {
+        if ((p > high && step > 0) || (p < low && step < 0))
+          {
+            integral = m_integral;
+          }
+      }
+    else if (m_params.antiWindup == ANTI_WINDUP_BACK_CALCULATION)
+      {
+        integral += (limited - p) * std::min (t / m_params.trackingTime, 1.0);
+      }
+    m_integral = integral;
+    return limited;
+  }
+
+  /**
+   * \brief Set alpha and beta of the next update
+   */
+  void SetGains (double a, double b)
+  {
+    m_a = a;
+    m_b = b;
+    m_aFixed = AqmToFixed (a);
+    m_bFixed = AqmToFixed (b);
+    m_aQRefFixed = AqmToFixed (a * m_params.qRef);
+    m_bQRefFixed = AqmToFixed (b * m_params.qRef);
+  }
+
+  PiParams m_params;
+  double m_a;                   //!< Alpha of the current interval
+  double m_b;                   //!< Beta of the current interval
+  double m_interval;            //!< Time until the next update in seconds
+  double m_burstAllowance;      //!< Remaining time without early drops in seconds
+  double m_integral;            //!< Integral term of the PID controller
+  double m_dropProb;            //!< Drop probability
+  double m_qOld;                //!< Queue length at the previous update
+  int64_t m_dropProbFixed;      //!< Drop probability in Q48
+  int64_t m_qOldFixed;          //!< Queue length at the previous update, whole packets
+  int64_t m_aFixed;             //!< Alpha in Q48
+  int64_t m_bFixed;             //!< Beta in Q48
+  int64_t m_aQRefFixed;         //!< Alpha times qRef in Q48
+  int64_t m_bQRefFixed;         //!< Beta times qRef in Q48
+};
+
+/**
+ * \brief Parameters of BlueQueueDisc, with its defaults
+ */
+struct BlueParams
+{
+  BlueParams ()
+    : increment (0.0025),
+      decrement (0.00025),
+      freezeTime (0.1),
+      rtt (0),
+      freezeRttFactor (1),
+      adaptiveSteps (false),
+      maxStepScale (16),
+      fixedPoint (false),
+      targetDelay (0)
+  {
+  }
+
+  double increment;             //!< increment value for marking probability
+  double decrement;             //!< decrement value for marking probability
+  double freezeTime;            //!< Time interval during which Pmark cannot be updated, in seconds
+  double rtt;                   //!< Base round trip time in seconds, 0 to use freezeTime
+  double freezeRttFactor;       //!< Freeze time in round trip times
+  bool adaptiveSteps;           //!< Scale the steps while Pmark keeps moving one way
+  double maxStepScale;          //!< Bound of the step scale
+  bool fixedPoint;              //!< Q48 arithmetic for Pmark and the steps
+  double targetDelay;           //!< Sojourn time above which a departure increments Pmark, in seconds, 0 to disable
+};
+
+/**
+ * \brief The Pmark updates of BlueQueueDisc
+ *
+ * Increment on every drop (queue overflow or early drop), Decrement
+ * when the queue goes idle and once per freeze time spent idle when it
+ * becomes busy again. With an rtt the freeze time is freezeRttFactor
+ * times rtt plus the queueing delay given to SetQueueDelay, and with
+ * adaptiveSteps the step doubles, up to maxStepScale times, on every
+ * consecutive update in the same direction. With a targetDelay,
+ * Departure also increments when a packet waited longer and decrements
+ * otherwise.
+ */
+class BlueController
+{
+public:
+  BlueController ()
+  {
+    SetParams (BlueParams ());
+    Reset ();
+  }
+
+  void SetParams (const BlueParams &params)
+  {
+    m_params = params;
+    m_incrementFixed = AqmToFixed (params.increment);
+    m_decrementFixed = AqmToFixed (params.decrement);
+    m_maxIncrementStepFixed = AqmToFixed (params.increment * params.maxStepScale);
+    m_maxDecrementStepFixed = AqmToFixed (params.decrement * params.maxStepScale);
+    m_incrementStepFixed = m_incrementFixed;
+    m_decrementStepFixed = m_decrementFixed;
+  }
+
+  const BlueParams & GetParams (void) const
+  {
+    return m_params;
+  }
+
+  void Reset (void)
+  {
+    m_Pmark = 0;
+    m_lastUpdateTime = 0;
+    m_idleStartTime = 0;
+    m_isIdle = true;
+    m_queueDelay = 0;
+    m_incrementScale = 1;
+    m_decrementScale = 1;
+    m_PmarkFixed = 0;
+    m_incrementStepFixed = m_incrementFixed;
+    m_decrementStepFixed = m_decrementFixed;
+  }
+
+  /**
+   * \brief Set the current queueing delay, for the RTT-derived freeze time
+   * \param delay The queueing delay in seconds
+   */
+  void SetQueueDelay (double delay)
+  {
+    m_queueDelay = delay;
+  }
+
+  /**
+   * \returns The interval during which Pmark cannot be updated, in seconds
+   */
+  double GetFreezeTime (void) const
+  {
+    if (m_params.rtt <= 0)
+      {
+        return m_params.freezeTime;
+      }
+    return m_params.freezeRttFactor * (m_params.rtt + m_queueDelay);
+  }
+
+  /**
+   * \brief A packet was dropped
+   * \param now The current time in seconds
+   */
+  void Increment (double now)
+  {
+    if (now - m_lastUpdateTime > GetFreezeTime ())
+      {
+        m_lastUpdateTime = now;
+        if (m_params.fixedPoint)
+          {
+            m_PmarkFixed = AqmClampFixed (m_PmarkFixed + m_incrementStepFixed);
+            if (m_params.adaptiveSteps)
+              {
+                m_incrementStepFixed = std::min (m_incrementStepFixed * 2, m_maxIncrementStepFixed);
+                m_decrementStepFixed = m_decrementFixed;
+              }
+            return;
+          }
+        m_Pmark += m_params.increment * m_incrementScale;
+        if (m_Pmark > 1.0)
+          {
+            m_Pmark = 1.0;
+          }
+        if (m_params.adaptiveSteps)
+          {
+            m_incrementScale = std::min (m_incrementScale * 2, m_params.maxStepScale);
+            m_decrementScale = 1;
+          }
+      }
+  }
+
+  /**
+   * \brief Decrement at most once per freeze time while busy
+   * \param now The current time in seconds
+   */
+  void Decrement (double now)
+  {
+    if (now - m_lastUpdateTime > GetFreezeTime ())
+      {
+        m_lastUpdateTime = now;
+        if (m_params.fixedPoint)
+          {
+            m_PmarkFixed = AqmClampFixed (m_PmarkFixed - m_decrementStepFixed);
+            if (m_params.adaptiveSteps)
+              {
+                m_decrementStepFixed = std::min (m_decrementStepFixed * 2, m_maxDecrementStepFixed);
+                m_incrementStepFixed = m_incrementFixed;
+              }
+            return;
+          }
+        m_Pmark -= m_params.decrement * m_decrementScale;
+        if (m_Pmark < 0.0)
+          {
+            m_Pmark = 0.0;
+          }
+        if (m_params.adaptiveSteps)
+          {
+            m_decrementScale = std::min (m_decrementScale * 2, m_params.maxStepScale);
+            m_incrementScale = 1;
+          }
+      }
+  }
+
+  /**
+   * \brief The queue became empty
+   * \param now The current time in seconds
+   */
+  void QueueIdle (double now)
+  {
+    if (!m_isIdle)
+      {
+        m_idleStartTime = now;
+        m_isIdle = true;
+        m_lastUpdateTime = now;
+      }
+  }
+
+  /**
+   * \brief A packet arrived; ends an idle period
+   * \param now The current time in seconds
+   */
+  void QueueBusy (double now)
+  {
+    if (m_isIdle)
+      {
+        // Decrement once for every freeze time spent idle
+        uint32_t m = (uint32_t)((now - m_idleStartTime) / GetFreezeTime ());
+        if (m_params.fixedPoint)
+          {
+            DecrementIdleFixed (m);
+          }
+        else if (!m_params.adaptiveSteps)
+          {
+            m_Pmark -= m_params.decrement * m;
+          }
+        for (uint32_t i = 0; !m_params.fixedPoint && m_params.adaptiveSteps && i < m && m_Pmark > 0; i++)
+          {
+            m_Pmark -= m_params.decrement * m_decrementScale;
+            m_decrementScale = std::min (m_decrementScale * 2, m_params.maxStepScale);
+            m_incrementScale = 1;
+          }
+        m_lastUpdateTime = now;
+        if (m_Pmark < 0.0)
+          {
+            m_Pmark = 0.0;
+          }
+        m_isIdle = false;
+      }
+  }
+
+  /**
+   * \brief A packet left the queue; the delay-based update of targetDelay
+   * \param now The current time in seconds
+   * \param sojourn The time the packet spent in the queue, in seconds
+   */
+  void Departure (double now, double sojourn)
+  {
+    if (m_params.targetDelay <= 0)
+      {
+        return;
+      }
+    if (sojourn > m_params.targetDelay)
+      {
+        Increment (now);
+      }
+    else
+      {
+        Decrement (now);
+      }
+  }
+
+  double GetProbability (void) const
+  {
+    return m_params.fixedPoint ? AqmFromFixed (m_PmarkFixed) : m_Pmark;
+  }
+
+  /**
+   * \returns The threshold of the integer drop test (AqmFixedDrop), with fixedPoint
+   */
+  uint64_t GetThreshold (void) const
+  {
+    return AqmFixedThreshold (m_PmarkFixed);
+  }
+
+private:
+  /**
+   * \brief The m idle decrements of QueueBusy in Q48
+   */
+  void DecrementIdleFixed (uint32_t m)
+  {
+    if (!m_params.adaptiveSteps && m > 0 && m_decrementFixed > 0)
+      {
+        // m decrements at once, without overflowing m * decrement
+        m_PmarkFixed = (m > m_PmarkFixed / m_decrementFixed) ? 0 : m_PmarkFixed - m_decrementFixed * m;
+      }
+    for (uint32_t i = 0; m_params.adaptiveSteps && i < m && m_PmarkFixed > 0; i++)
+      {
+        m_PmarkFixed -= m_decrementStepFixed;
+        m_decrementStepFixed = std::min (m_decrementStepFixed * 2, m_maxDecrementStepFixed);
+        m_incrementStepFixed = m_incrementFixed;
+      }
+    m_PmarkFixed = AqmClampFixed (m_PmarkFixed);
+  }
+
+  BlueParams m_params;
+  double m_Pmark;               //!< Marking probability
+  double m_lastUpdateTime;      //!< last time at which Pmark was updated
+  double m_idleStartTime;       //!< Time when the queue entered the idle period
+  bool m_isIdle;                //!< True if queue is Idle
+  double m_queueDelay;          //!< Current queueing delay in seconds
+  double m_incrementScale;      //!< Current multiple of the increment
+  double m_decrementScale;      //!< Current multiple of the decrement
+  int64_t m_PmarkFixed;         //!< Marking probability in Q48
+  int64_t m_incrementFixed;     //!< Increment in Q48
+  int64_t m_decrementFixed;     //!< Decrement in Q48
+  int64_t m_incrementStepFixed; //!< Current increment step in Q48
+  int64_t m_decrementStepFixed; //!< Current decrement step in Q48
+  int64_t m_maxIncrementStepFixed;      //!< Bound of the increment step in Q48
+  int64_t m_maxDecrementStepFixed;      //!< Bound of the decrement step in Q48
+};
+
+} // namespace aqm
+
+#endif // AQM_CORE_H
@@ -0,0 +1,195 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Fixed-point arithmetic of the PI and BLUE controllers, for datapaths
+ * without floating point. Used by PiQueueDisc and BlueQueueDisc with
+ * FixedPoint=true and by the controllers of aqm-core.h.
+ *
+ * Formats
+ *
+ *   Probabilities, the PI gains and the BLUE steps are signed 64-bit
+ *   integers in Q48: the value times 2^48, so probability 1 is 2^48. The
+ *   state keeps 48 fractional bits so that the small per-update changes
+ *   of PI (alpha is about 2e-5) do not vanish; the drop test only uses
+ *   the top 32 fractional bits.
+ *
+ *   The drop test draws a uniform 32-bit integer u and drops if
+ *   u < p >> 16, where p >> 16 = 2^32 (probability 1) always drops.
+ *
+ * Error bounds versus the double version (up to the double's own
+ * rounding, about 1e-16 per operation)
+ *
+ *   PI: alpha and beta are rounded to the nearest 2^-48, and so are
+ *   alpha * QueueRef and beta * QueueRef. An update therefore differs
+ *   from the exact one by at most 2^-49 (q + qOld + 2 QueueRef + 2), with
+ *   q and qOld in packets (in bytes with alpha / MeanPktSize per byte in
+ *   byte mode). The clamp to [0, 1] never increases the difference, so
+ *   after N updates |p_fixed - p_double| <= N 2^-48 (QueueLimit +
+ *   QueueRef + 1). With the defaults (QueueLimit 200, QueueRef 50, W
+ *   170) that is 1.5e-8 after 100 s.
+ *
+ *   BLUE: Increment and Decrement are rounded to the nearest 2^-48, so
+ *   after k updates (counting each of the m idle decrements) |Pmark_fixed
+ *   - Pmark_double| <= k 2^-49.
+ *
+ *   Drop test: with the same random draw the two versions can only
+ *   disagree when u lies within 2^-32 of p, i.e. with probability at most
+ *   2^-32 plus the difference of the probabilities above.
+ */
+
+#ifndef AQM_FIXED_POINT_H
+#define AQM_FIXED_POINT_H
+
+#include <stdint.h>
+#include <cmath>
+
+namespace aqm {
+
+static const int AQM_FIXED_BITS = 48;                           //!< Fractional bits of the state
+static const int64_t AQM_FIXED_ONE = int64_t (1) << AQM_FIXED_BITS;     //!< Probability 1
+static const uint64_t AQM_FIXED_DRAW_ONE = uint64_t (1) << 32;  //!< Probability 1 of the drop test
+
+/**
+ * \brief Convert to Q48, rounding to nearest
+ */
+inline int64_t
+AqmToFixed (double v)
+{
+  return (int64_t) std::floor (std::ldexp (v, AQM_FIXED_BITS) + 0.5);
+}
+
+/**
+ * \brief Convert from Q48
+ */
+inline double
+AqmFromFixed (int64_t v)
+{
+  return std::ldexp ((double) v, -AQM_FIXED_BITS);
+}
+
+/**
+ * \brief Clamp a Q48 probability to [0, 1]
+ */
+inline int64_t
+AqmClampFixed (int64_t p)
+{
+  return p < 0 ? 0 : (p > AQM_FIXED_ONE ? AQM_FIXED_ONE : p);
+}
+
+/**
+ * \brief The 32-bit threshold of the drop test
+ * \param p Probability in Q48, in [0, 1]
+ * \returns p in Q32, 2^32 for probability 1
+ */
+inline uint64_t
+AqmFixedThreshold (int64_t p)
+{
+  return (uint64_t) p >> (AQM_FIXED_BITS - 32);
+}
+
+/**
+ * \brief Scale a threshold by size / meanSize, as in byte mode
+ * \returns The scaled threshold, at most 2^32
+ */
+inline uint64_t
+AqmScaleThreshold (uint64_t threshold, uint32_t size, uint32_t meanSize)
+{
+  // threshold <= 2^32 and size < 2^32: the product fits in 64 bits only
+  // for packet sizes below 2^31, which the queue discs never see
+  uint64_t scaled = threshold * size / meanSize;
+  return scaled > AQM_FIXED_DRAW_ONE ? AQM_FIXED_DRAW_ONE : scaled;
+}
+
+/**
+ * \brief The drop test
+ * \param u Uniform 32-bit random integer
+ * \param threshold From AqmFixedThreshold
+ * \returns True to drop
+ */
+inline bool
+AqmFixedDrop (uint32_t u, uint64_t threshold)
+{
+  return u < threshold;
+}
+
+/**
+ * \brief The 32-bit integer equivalent of a uniform double in [0, 1),
+ * so that both versions can be fed the same random draw
+ */
+inline uint32_t
+AqmDrawToFixed (double u)
+{
+  return (uint32_t) std::ldexp (u, 32);
+}
+
+/**
+ * \brief Largest |x| for which gain * x cannot overflow
+ * \param gain A gain in Q48
+ */
+inline double
+AqmFixedRange (int64_t gain)
+{
+  return gain == 0 ? 1e300 : std::ldexp (1.0, 62) / std::fabs ((double) gain);
+}
+
+/**
+ * \brief Divergence between the fixed-point and the double controller
+ * run side by side on the same inputs and random draws
+ */
+struct AqmFixedDivergence
+{
+  AqmFixedDivergence ()
+    : updates (0),
+      maxError (0),
+      sumError (0),
+      decisions (0),
+      disagreements (0)
+  {
+  }
+
+  /**
+   * \brief Compare the probabilities after a controller update
+   */
+  void RecordUpdate (int64_t fixed, double reference)
+  {
+    double error = std::fabs (AqmFromFixed (fixed) - reference);
+    updates++;
+    sumError += error;
+    maxError = error > maxError ? error : maxError;
+  }
+
+  /**
+   * \brief Compare the drop decisions for one packet
+   */
+  void RecordDecision (bool fixed, bool reference)
+  {
+    decisions++;
+    disagreements += fixed != reference;
+  }
+
+  uint64_t updates;             //!< Controller updates compared
+  double maxError;              //!< Largest probability difference after an update
+  double sumError;              //!< Sum of the probability differences
+  uint64_t decisions;           //!< Drop decisions compared
+  uint64_t disagreements;       //!< Decisions that differ for the same random draw
+};
+
+} // namespace aqm
+
+#endif // AQM_FIXED_POINT_H
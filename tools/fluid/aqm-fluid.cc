@@ -0,0 +1,589 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Fluid model of N long-lived TCP flows through a PI or BLUE bottleneck
+ * (Misra, Gong and Towsley, SIGCOMM 2000):
+ *
+ *   dW/dt = 1/R(t) - W(t) W(t-R) / (2 R(t-R)) p(t-R)
+ *   dq/dt = N W(t) / R(t) - C,          0 <= q <= QueueLimit
+ *   R(t)  = Tp + q(t) / C
+ *
+ * integrated with a fixed step. The controllers are the ones of
+ * tools/aqm-core, driven by the fluid queue: PI is updated W times per
+ * second on the queue length, BLUE is incremented when the expected
+ * drops reach one packet and decremented once per freeze time while the
+ * queue is empty (the packet disc only counts idle gaps of at least a
+ * freeze time, so the fluid BLUE is optimistic at low load). Overflow
+ * of the queue limit adds the excess arrival fraction to the loss
+ * probability.
+ *
+ * Modes:
+ *   aqm-fluid [--name=value ...]             one run, writes .plotme files
+ *   aqm-fluid --validate=pi-queue.plotme     also overlays a packet-level run
+ *   aqm-fluid --batch=configs.txt            one summary line per config line
+ */
+
+#include <sys/time.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../aqm-core/aqm-core.h"
+
+using namespace aqm;
+
+/**
+ * Scenario and controller parameters; defaults match second-bulksend.cc
+ */
+struct FluidConfig
+{
+  FluidConfig ()
+    : aqm ("pi"),
+      nFlows (50),
+      bandwidth (10e6),
+      pktSize (1000),
+      rtt (0.12),
+      queueLimit (200),
+      duration (101),
+      warmup (20),
+      dt (0.001),
+      sample (0.1),
+      maxWindow (1e6),
+      out ("fluid")
+  {
+  }
+
+  std::string aqm;              //!< "pi" or "blue"
+  double nFlows;                //!< Number of TCP flows
+  double bandwidth;             //!< Bottleneck bandwidth in bit/s
+  double pktSize;               //!< Packet size in bytes
+  double rtt;                   //!< Round trip propagation delay in seconds
+  double queueLimit;            //!< Queue limit in packets
+  double duration;              //!< Simulated time in seconds
+  double warmup;                //!< Time excluded from the metrics
+  double dt;                    //!< Integration step in seconds
+  double sample;                //!< Sampling period of the trajectories
+  double maxWindow;             //!< Receive window in packets
+  std::string out;              //!< Prefix of the output files
+  PiParams pi;                  //!< PiQueueDisc parameters
+  BlueParams blue;              //!< BlueQueueDisc parameters
+};
+
+/**
+ * Set a parameter by the name of its command line option or attribute
+ */
+static bool
+SetParam (FluidConfig &cfg, const std::string &name, const std::string &value)
+{
+  double v = std::atof (value.c_str ());
+  if (name == "aqm")
+    {
+      cfg.aqm = value;
+    }
+  else if (name == "nFlows")
+    {
+      cfg.nFlows = v;
+    }
+  else if (name == "bandwidth")
+    {
+      // Mbps, as in the scenario programs
+      cfg.bandwidth = v * 1e6;
+    }
+  else if (name == "pktSize")
+    {
+      cfg.pktSize = v;
+    }
+  else if (name == "rtt")
+    {
+      cfg.rtt = v;
+    }
+  else if (name == "queueLimit" || name == "QueueLimit")
+    {
+      cfg.queueLimit = v;
+    }
+  else if (name == "duration")
+    {
+      cfg.duration = v;
+    }
+  else if (name == "warmup")
+    {
+      cfg.warmup = v;
+    }
+  else if (name == "dt")
+    {
+      cfg.dt = v;
+    }
+  else if (name == "sample")
+    {
+      cfg.sample = v;
+    }
+  else if (name == "maxWindow")
+    {
+      cfg.maxWindow = v;
+    }
+  else if (name == "out")
+    {
+      cfg.out = value;
+    }
+  else if (name == "A")
+    {
+      cfg.pi.a = v;
+    }
+  else if (name == "B")
+    {
+      cfg.pi.b = v;
+    }
+  else if (name == "W")
+    {
+      cfg.pi.w = v;
+    }
+  else if (name == "QueueRef")
+    {
+      cfg.pi.qRef = v;
+    }
+  else if (name == "Increment")
+    {
+      cfg.blue.increment = v;
+    }
+  else if (name == "Decrement")
+    {
+      cfg.blue.decrement = v;
+    }
+  else if (name == "FreezeTime")
+    {
+      cfg.blue.freezeTime = v;
+    }
+  else if (name == "Rtt")
+    {
+      cfg.blue.rtt = v;
+    }
+  else if (name == "FreezeRttFactor")
+    {
+      cfg.blue.freezeRttFactor = v;
+    }
+  else if (name == "AdaptiveSteps")
+    {
+      cfg.blue.adaptiveSteps = v != 0;
+    }
+  else if (name == "MaxStepScale")
+    {
+      cfg.blue.maxStepScale = v;
+    }
+  else if (name == "TargetDelay")
+    {
+      cfg.blue.targetDelay = v;
+    }
+  else if (name == "FixedPoint")
+    {
+      cfg.pi.fixedPoint = v != 0;
+      cfg.blue.fixedPoint = v != 0;
+    }
+  else if (name == "AdaptiveSampling")
+    {
+      cfg.pi.adaptiveSampling = v != 0;
+    }
+  else if (name == "MinInterval")
+    {
+      cfg.pi.minInterval = v;
+    }
+  else if (name == "MaxInterval")
+    {
+      cfg.pi.maxInterval = v;
+    }
+  else if (name == "StableQueueDelta")
+    {
+      cfg.pi.stableQueueDelta = v;
+    }
+  else if (name == "MaxBurstAllowance")
+    {
+      cfg.pi.maxBurstAllowance = v;
+    }
+  else if (name == "LowWatermark")
+    {
+      cfg.pi.lowWatermark = v;
+    }
+  else if (name == "IdleDecay")
+    {
+      cfg.pi.idleDecay = v;
+    }
+  else if (name == "Controller")
+    {
+      cfg.pi.pid = value == "PID";
+    }
+  else if (name == "Kd")
+    {
+      cfg.pi.kd = v;
+    }
+  else if (name == "AntiWindup")
+    {
+      cfg.pi.antiWindup = value == "NONE" ? ANTI_WINDUP_NONE
+        : value == "BACK_CALCULATION" ? ANTI_WINDUP_BACK_CALCULATION : ANTI_WINDUP_CONDITIONAL;
+    }
+  else if (name == "TrackingTime")
+    {
+      cfg.pi.trackingTime = v;
+    }
+  else if (name == "MaxRate")
+    {
+      cfg.pi.maxRate = v;
+    }
+  else
+    {
+      return false;
+    }
+  return true;
+}
+
+/**
+ * Sampled trajectories of a run
+ */
+struct Trajectory
+{
+  std::vector<double> time;
+  std::vector<double> queue;
+  std::vector<double> prob;
+  std::vector<double> window;
+};
+
+/**
+ * Metrics of a run, after the warmup
+ */
+struct FluidMetrics
+{
+  double meanQueue;             //!< Mean queue length in packets
+  double stdQueue;              //!< Standard deviation of the queue length
+  double meanDelay;             //!< Mean queueing delay in seconds
+  double meanProb;              //!< Mean AQM probability
+  double utilization;           //!< Fraction of the capacity used
+  double lossRate;              //!< Dropped fraction of the arrivals
+};
+
+static FluidMetrics
+Run (const FluidConfig &cfg, Trajectory *traj)
+{
+  double c = cfg.bandwidth / (8 * cfg.pktSize);     // packets per second
+  uint64_t steps = (uint64_t)(cfg.duration / cfg.dt);
+
+  PiController pi;
+  pi.SetParams (cfg.pi);
+  BlueController blue;
+  blue.SetParams (cfg.blue);
+  bool isPi = (cfg.aqm == "pi");
+
+  // History of the delayed terms, one entry per step
+  std::vector<double> histW (steps + 1, 1.0);
+  std::vector<double> histR (steps + 1, cfg.rtt);
+  std::vector<double> histP (steps + 1, 0.0);
+
+  double w = 1;
+  double q = 0;
+  double pAqm = 0;
+  double nextUpdate = pi.GetInterval ();
+  double nextSample = 0;
+  double expectedDrops = 0;
+
+  double sumQ = 0, sumQ2 = 0, sumP = 0, served = 0, arrived = 0, dropped = 0;
+  uint64_t nMeasured = 0;
+
+  for (uint64_t k = 0; k <= steps; k++)
+    {
+      double t = k * cfg.dt;
+      double r = cfg.rtt + q / c;
+
+      // Delayed state at t - R
+      int64_t j = (int64_t) k - (int64_t) llround (r / cfg.dt);
+      double wd = j >= 0 ? histW[j] : 1.0;
+      double rd = j >= 0 ? histR[j] : cfg.rtt;
+      double pd = j >= 0 ? histP[j] : 0.0;
+
+      double lambda = cfg.nFlows * w / r;
+      double overflow = 0;
+      if (q >= cfg.queueLimit && lambda > c)
+        {
+          overflow = (lambda - c) / lambda;
+        }
+      double pEarly = (isPi && !pi.AllowEarlyDrop (q)) ? 0 : pAqm;
+      double pTotal = 1 - (1 - pEarly) * (1 - overflow);
+
+      histW[k] = w;
+      histR[k] = r;
+      histP[k] = pTotal;
+
+      if (traj && t >= nextSample - cfg.dt / 2)
+        {
+          traj->time.push_back (t);
+          traj->queue.push_back (q);
+          traj->prob.push_back (pAqm);
+          traj->window.push_back (w);
+          nextSample += cfg.sample;
+        }
+
+      double accepted = lambda * (1 - pTotal);
+      double out = (q > 0 || accepted >= c) ? c : accepted;
+      if (t >= cfg.warmup)
+        {
+          sumQ += q;
+          sumQ2 += q * q;
+          sumP += pAqm;
+          served += out * cfg.dt;
+          arrived += lambda * cfg.dt;
+          dropped += lambda * pTotal * cfg.dt;
+          nMeasured++;
+        }
+
+      // Controllers
+      if (isPi)
+        {
+          if (t >= nextUpdate)
+            {
+              pAqm = pi.Update (q);
+              nextUpdate += pi.GetInterval ();
+            }
+        }
+      else
+        {
+          blue.SetQueueDelay (q / c);
+          if (q > 0)
+            {
+              blue.Departure (t, q / c);
+            }
+          if (q <= 0 && lambda * (1 - pTotal) < c)
+            {
+              // Fluid limit of the idle decrement: once per freeze time
+              // spent with an empty queue
+              blue.Decrement (t);
+            }
+          expectedDrops += lambda * pTotal * cfg.dt;
+          if (expectedDrops >= 1)
+            {
+              blue.Increment (t);
+              expectedDrops -= std::floor (expectedDrops);
+            }
+          pAqm = blue.GetProbability ();
+        }
+
+      // Euler step of the delay differential equations
+      double dw = 1 / r - w * wd / (2 * rd) * pd;
+      double dq = accepted - c;
+      w += dw * cfg.dt;
+      w = w < 1 ? 1 : (w > cfg.maxWindow ? cfg.maxWindow : w);
+      q += dq * cfg.dt;
+      q = q < 0 ? 0 : (q > cfg.queueLimit ? cfg.queueLimit : q);
+    }
+
+  FluidMetrics m;
+  double n = nMeasured > 0 ? nMeasured : 1;
+  m.meanQueue = sumQ / n;
+  m.stdQueue = std::sqrt (std::max (0.0, sumQ2 / n - m.meanQueue * m.meanQueue));
+  m.meanDelay = m.meanQueue / c;
+  m.meanProb = sumP / n;
+  m.utilization = served / (c * nMeasured * cfg.dt > 0 ? c * nMeasured * cfg.dt : 1);
+  m.lossRate = arrived > 0 ? dropped / arrived : 0;
+  return m;
+}
+
+static void
+WritePlotme (const std::string &file, const std::vector<double> &t, const std::vector<double> &v)
+{
+  std::ofstream f (file.c_str ());
+  for (size_t i = 0; i < t.size (); i++)
+    {
+      f << t[i] << " " << v[i] << std::endl;
+    }
+}
+
+static void
+PrintSummary (const FluidMetrics &m)
+{
+  std::cout << "summary meanQueue " << m.meanQueue << std::endl;
+  std::cout << "summary stdQueue " << m.stdQueue << std::endl;
+  std::cout << "summary meanDelay " << m.meanDelay << std::endl;
+  std::cout << "summary meanProb " << m.meanProb << std::endl;
+  std::cout << "summary utilization " << m.utilization << std::endl;
+  std::cout << "summary lossRate " << m.lossRate << std::endl;
+}
+
+/**
+ * Overlay a packet-level queue trace on the fluid one
+ */
+static bool
+Validate (const FluidConfig &cfg, const Trajectory &traj, const std::string &file)
+{
+  std::ifstream in (file.c_str ());
+  if (!in)
+    {
+      std::cerr << "cannot open " << file << std::endl;
+      return false;
+    }
+
+  std::ofstream overlay ((cfg.out + "-validate.plotme").c_str ());
+  double t, qp;
+  double sumErr = 0, sumErr2 = 0, sumPacket = 0, sumFluid = 0;
+  uint32_t n = 0;
+  while (in >> t >> qp)
+    {
+      if (traj.time.empty () || t > traj.time.back ())
+        {
+          break;
+        }
+      // Linear interpolation of the sampled fluid queue
+      size_t i = 0;
+      while (i + 1 < traj.time.size () && traj.time[i + 1] < t)
+        {
+          i++;
+        }
+      double qf = traj.queue[i];
+      if (i + 1 < traj.time.size () && traj.time[i + 1] > traj.time[i])
+        {
+          double f = (t - traj.time[i]) / (traj.time[i + 1] - traj.time[i]);
+          f = f < 0 ? 0 : (f > 1 ? 1 : f);
+          qf += f * (traj.queue[i + 1] - traj.queue[i]);
+        }
+      overlay << t << " " << qp << " " << qf << std::endl;
+      if (t >= cfg.warmup)
+        {
+          sumErr += qf - qp;
+          sumErr2 += (qf - qp) * (qf - qp);
+          sumPacket += qp;
+          sumFluid += qf;
+          n++;
+        }
+    }
+
+  if (n > 0)
+    {
+      std::cout << "summary validatePacketMean " << sumPacket / n << std::endl;
+      std::cout << "summary validateFluidMean " << sumFluid / n << std::endl;
+      std::cout << "summary validateBias " << sumErr / n << std::endl;
+      std::cout << "summary validateRmse " << std::sqrt (sumErr2 / n) << std::endl;
+    }
+  return true;
+}
+
+/**
+ * Run every line of a batch file, each a list of name=value overrides
+ */
+static int
+Batch (const FluidConfig &base, const std::string &file)
+{
+  std::ifstream in (file.c_str ());
+  if (!in)
+    {
+      std::cerr << "cannot open " << file << std::endl;
+      return 1;
+    }
+
+  struct timeval start, end;
+  gettimeofday (&start, 0);
+
+  std::cout << "config\tmeanQueue\tstdQueue\tmeanDelay\tmeanProb\tutilization\tlossRate" << std::endl;
+  std::string line;
+  uint32_t nRuns = 0;
+  while (std::getline (in, line))
+    {
+      if (line.empty () || line[0] == '#')
+        {
+          continue;
+        }
+      FluidConfig cfg = base;
+      std::istringstream tokens (line);
+      std::string token;
+      std::string label;
+      while (tokens >> token)
+        {
+          std::string::size_type eq = token.find ('=');
+          if (eq == std::string::npos || !SetParam (cfg, token.substr (0, eq), token.substr (eq + 1)))
+            {
+              std::cerr << "unknown parameter " << token << std::endl;
+              return 1;
+            }
+          label += (label.empty () ? "" : "|") + token;
+        }
+      FluidMetrics m = Run (cfg, 0);
+      std::cout << label << "\t" << m.meanQueue << "\t" << m.stdQueue << "\t" << m.meanDelay
+                << "\t" << m.meanProb << "\t" << m.utilization << "\t" << m.lossRate << std::endl;
+      nRuns++;
+    }
+
+  gettimeofday (&end, 0);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  std::cerr << nRuns << " configurations in " << elapsed << " s" << std::endl;
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  FluidConfig cfg;
+  std::string validate;
+  std::string batch;
+
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      std::string::size_type eq = arg.find ('=');
+      if (arg.compare (0, 2, "--") != 0 || eq == std::string::npos)
+        {
+          std::cerr << "usage: aqm-fluid [--name=value ...] [--validate=<packet plotme>] [--batch=<file>]" << std::endl;
+          return 2;
+        }
+      std::string name = arg.substr (2, eq - 2);
+      std::string value = arg.substr (eq + 1);
+      if (name == "validate")
+        {
+          validate = value;
+        }
+      else if (name == "batch")
+        {
+          batch = value;
+        }
+      else if (!SetParam (cfg, name, value))
+        {
+          std::cerr << "unknown option --" << name << std::endl;
+          return 2;
+        }
+    }
+
+  if (cfg.aqm != "pi" && cfg.aqm != "blue")
+    {
+      std::cerr << "--aqm must be pi or blue" << std::endl;
+      return 2;
+    }
+
+  if (!batch.empty ())
+    {
+      return Batch (cfg, batch);
+    }
+
+  Trajectory traj;
+  FluidMetrics m = Run (cfg, &traj);
+  WritePlotme (cfg.out + "-queue.plotme", traj.time, traj.queue);
+  WritePlotme (cfg.out + "-prob.plotme", traj.time, traj.prob);
+  WritePlotme (cfg.out + "-window.plotme", traj.time, traj.window);
+  PrintSummary (m);
+
+  if (!validate.empty () && !Validate (cfg, traj, validate))
+    {
+      return 1;
+    }
+  return 0;
+}
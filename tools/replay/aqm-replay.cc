@@ -0,0 +1,736 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Open-loop replay of a packet arrival trace through a PI or BLUE queue
+ * served at a fixed link rate: what would these parameters have done to
+ * this traffic. There is no TCP feedback, the arrivals do not change
+ * with the drops.
+ *
+ * Every packet pops the packets whose transmission has started by its
+ * arrival, runs the PI updates that fell due in between, and is then
+ * dropped (queue limit or early drop) or queued behind the backlog. A
+ * packet leaves the queue when its transmission starts, as with the
+ * queue disc on a point-to-point device.
+ *
+ *   aqm-replay --trace=<pcap or .arr> [--name=value ...]
+ *   aqm-replay --trace=<pcap or .arr> --configs=<file> [--threads=N]
+ *   aqm-replay --trace=<pcap>[,<pcap> ...] [--src=<prefix>] [--dst=<prefix>] ...
+ *   aqm-replay --trace=<pcap> --convert=<file.arr>
+ *
+ * All the configurations of a file are evaluated in one pass over the
+ * trace per thread, the configurations split among the threads.
+ */
+
+#include <sys/time.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../aqm-core/aqm-core.h"
+#include "trace-reader.h"
+
+using namespace aqm;
+
+/**
+ * Queue and controller parameters of one what-if run
+ */
+struct ReplayConfig
+{
+  ReplayConfig ()
+    : aqm ("pi"),
+      bandwidth (10e6),
+      queueLimit (200),
+      seed (1)
+  {
+  }
+
+  std::string aqm;              //!< "pi" or "blue"
+  double bandwidth;             //!< Link rate in bit/s
+  uint32_t queueLimit;          //!< Queue limit in packets
+  uint64_t seed;                //!< Seed of the early drop draws
+  PiParams pi;                  //!< PiQueueDisc parameters
+  BlueParams blue;              //!< BlueQueueDisc parameters
+  std::string label;            //!< The overrides of this configuration
+};
+
+/**
+ * Set a parameter by its command line option or attribute name
+ */
+static bool
+SetParam (ReplayConfig &cfg, const std::string &name, const std::string &value)
+{
+  double v = std::atof (value.c_str ());
+  if (name == "aqm")
+    {
+      cfg.aqm = value;
+    }
+  else if (name == "bandwidth")
+    {
+      // Mbps, as in the scenario programs
+      cfg.bandwidth = v * 1e6;
+    }
+  else if (name == "queueLimit" || name == "QueueLimit")
+    {
+      cfg.queueLimit = v;
+    }
+  else if (name == "seed")
+    {
+      cfg.seed = v;
+    }
+  else if (name == "A")
+    {
+      cfg.pi.a = v;
+    }
+  else if (name == "B")
+    {
+      cfg.pi.b = v;
+    }
+  else if (name == "W")
+    {
+      cfg.pi.w = v;
+    }
+  else if (name == "QueueRef")
+    {
+      cfg.pi.qRef = v;
+    }
+  else if (name == "Increment")
+    {
+      cfg.blue.increment = v;
+    }
+  else if (name == "Decrement")
+    {
+      cfg.blue.decrement = v;
+    }
+  else if (name == "FreezeTime")
+    {
+      cfg.blue.freezeTime = v;
+    }
+  else if (name == "Rtt")
+    {
+      cfg.blue.rtt = v;
+    }
+  else if (name == "FreezeRttFactor")
+    {
+      cfg.blue.freezeRttFactor = v;
+    }
+  else if (name == "AdaptiveSteps")
+    {
+      cfg.blue.adaptiveSteps = v != 0;
+    }
+  else if (name == "MaxStepScale")
+    {
+      cfg.blue.maxStepScale = v;
+    }
+  else if (name == "TargetDelay")
+    {
+      cfg.blue.targetDelay = v;
+    }
+  else if (name == "FixedPoint")
+    {
+      cfg.pi.fixedPoint = v != 0;
+      cfg.blue.fixedPoint = v != 0;
+    }
+  else if (name == "AdaptiveSampling")
+    {
+      cfg.pi.adaptiveSampling = v != 0;
+    }
+  else if (name == "MinInterval")
+    {
+      cfg.pi.minInterval = v;
+    }
+  else if (name == "MaxInterval")
+    {
+      cfg.pi.maxInterval = v;
+    }
+  else if (name == "StableQueueDelta")
+    {
+      cfg.pi.stableQueueDelta = v;
+    }
+  else if (name == "MaxBurstAllowance")
+    {
+      cfg.pi.maxBurstAllowance = v;
+    }
+  else if (name == "LowWatermark")
+    {
+      cfg.pi.lowWatermark = v;
+    }
+  else if (name == "IdleDecay")
+    {
+      cfg.pi.idleDecay = v;
+    }
+  else if (name == "Controller")
+    {
+      cfg.pi.pid = value == "PID";
+    }
+  else if (name == "Kd")
+    {
+      cfg.pi.kd = v;
+    }
+  else if (name == "AntiWindup")
+    {
+      cfg.pi.antiWindup = value == "NONE" ? ANTI_WINDUP_NONE
+        : value == "BACK_CALCULATION" ? ANTI_WINDUP_BACK_CALCULATION : ANTI_WINDUP_CONDITIONAL;
+    }
+  else if (name == "TrackingTime")
+    {
+      cfg.pi.trackingTime = v;
+    }
+  else if (name == "MaxRate")
+    {
+      cfg.pi.maxRate = v;
+    }
+  else
+    {
+      return false;
+    }
+  return true;
+}
+
+/**
+ * Log-linear histogram of microseconds: exact below 64, then 32
+ * buckets per power of two (about 3% resolution)
+ */
+class DelayHistogram
+{
+public:
+  DelayHistogram ()
+    : m_buckets (1024, 0),
+      m_count (0)
+  {
+  }
+
+  void Add (uint64_t us)
+  {
+    m_buckets[Index (us)]++;
+    m_count++;
+  }
+
+  /**
+   * \returns The lower bound in microseconds of the bucket of the q-quantile
+   */
+  uint64_t GetQuantile (double q) const
+  {
+    uint64_t rank = (uint64_t) std::ceil (q * m_count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_buckets.size (); i++)
+      {
+        seen += m_buckets[i];
+        if (seen >= rank && seen > 0)
+          {
+            return LowerBound (i);
+          }
+      }
+    return 0;
+  }
+
+  const std::vector<uint64_t> & GetBuckets (void) const
+  {
+    return m_buckets;
+  }
+
+  static uint64_t LowerBound (size_t i)
+  {
+    if (i < 64)
+      {
+        return i;
+      }
+    uint32_t e = (i - 64) / 32 + 6;
+    return (uint64_t) (32 + (i - 64) % 32) << (e - 5);
+  }
+
+private:
+  static size_t Index (uint64_t v)
+  {
+    if (v < 64)
+      {
+        return v;
+      }
+    uint32_t e = 63 - __builtin_clzll (v);
+    size_t i = 64 + (e - 6) * 32 + ((v >> (e - 5)) - 32);
+    return i < 1024 ? i : 1023;
+  }
+
+  std::vector<uint64_t> m_buckets;
+  uint64_t m_count;
+};
+
+/**
+ * Counters and distributions of one run
+ */
+struct ReplayResult
+{
+  ReplayResult ()
+    : arrivals (0),
+      forcedDrops (0),
+      earlyDrops (0),
+      bytesSent (0),
+      sumQueue (0),
+      sumSojourn (0),
+      maxSojourn (0),
+      finalProb (0)
+  {
+  }
+
+  uint64_t arrivals;                    //!< Packets in the trace
+  uint64_t forcedDrops;                 //!< Drops due to the queue limit
+  uint64_t earlyDrops;                  //!< Early drops
+  uint64_t bytesSent;                   //!< Bytes of the packets served
+  double sumQueue;                      //!< Sum of the queue lengths seen by the arrivals
+  double sumSojourn;                    //!< Sum of the sojourn times in seconds
+  double maxSojourn;                    //!< Largest sojourn time in seconds
+  double finalProb;                     //!< Drop probability at the end of the trace
+  std::vector<uint64_t> queueHist;      //!< Queue lengths seen by the arrivals
+  DelayHistogram sojournHist;           //!< Sojourn times of the served packets
+};
+
+/**
+ * State of one configuration during the pass over the trace
+ */
+class ReplayQueue
+{
+public:
+  ReplayQueue (const ReplayConfig &cfg, ReplayResult &result)
+    : m_cfg (cfg),
+      m_result (result),
+      m_isPi (cfg.aqm == "pi"),
+      m_starts (cfg.queueLimit + 1),
+      m_arrivals (cfg.queueLimit + 1),
+      m_head (0),
+      m_size (0),
+      m_busyUntil (0),
+      m_nextUpdate (0),
+      m_rng (cfg.seed * 0x9e3779b97f4a7c15ULL + 1)
+  {
+    m_pi.SetParams (cfg.pi);
+    m_blue.SetParams (cfg.blue);
+    m_nextUpdate = m_pi.GetInterval ();
+    m_result.queueHist.assign (cfg.queueLimit + 1, 0);
+  }
+
+  void Arrive (double t, uint32_t bytes)
+  {
+    if (m_isPi)
+      {
+        while (m_nextUpdate <= t)
+          {
+            Serve (m_nextUpdate);
+            m_pi.Update (m_size);
+            m_nextUpdate += m_pi.GetInterval ();
+          }
+      }
+    Serve (t);
+    m_result.arrivals++;
+    m_result.sumQueue += m_size;
+    m_result.queueHist[m_size]++;
+
+    double p;
+    if (m_isPi)
+      {
+        p = m_pi.GetProbability ();
+      }
+    else
+      {
+        m_blue.SetQueueDelay (m_busyUntil > t ? m_busyUntil - t : 0);
+        m_blue.QueueBusy (t);
+        p = m_blue.GetProbability ();
+      }
+
+    if (m_size >= m_cfg.queueLimit)
+      {
+        m_result.forcedDrops++;
+        if (!m_isPi)
+          {
+            m_blue.Increment (t);
+          }
+        return;
+      }
+    bool earlyDrop;
+    if (m_cfg.pi.fixedPoint)
+      {
+        earlyDrop = AqmFixedDrop (UniformInteger (), m_isPi ? m_pi.GetThreshold () : m_blue.GetThreshold ());
+      }
+    else
+      {
+        earlyDrop = Uniform () <= p && p > 0;
+      }
+    if (m_isPi && !m_pi.AllowEarlyDrop (m_size))
+      {
+        earlyDrop = false;
+      }
+    if (earlyDrop)
+      {
+        m_result.earlyDrops++;
+        if (!m_isPi)
+          {
+            m_blue.Increment (t);
+          }
+        return;
+      }
+
+    double start = m_busyUntil > t ? m_busyUntil : t;
+    m_busyUntil = start + bytes * 8.0 / m_cfg.bandwidth;
+    m_starts[(m_head + m_size) % m_starts.size ()] = start;
+    m_arrivals[(m_head + m_size) % m_arrivals.size ()] = t;
+    m_size++;
+    m_result.bytesSent += bytes;
+    double sojourn = start - t;
+    m_result.sumSojourn += sojourn;
+    m_result.maxSojourn = sojourn > m_result.maxSojourn ? sojourn : m_result.maxSojourn;
+    m_result.sojournHist.Add ((uint64_t) (sojourn * 1e6));
+  }
+
+  void Finish (void)
+  {
+    m_result.finalProb = m_isPi ? m_pi.GetProbability () : m_blue.GetProbability ();
+  }
+
+private:
+  /**
+   * Dequeue the packets whose transmission has started by time t
+   */
+  void Serve (double t)
+  {
+    while (m_size > 0 && m_starts[m_head] <= t)
+      {
+        double start = m_starts[m_head];
+        double arrival = m_arrivals[m_head];
+        m_head = (m_head + 1) % m_starts.size ();
+        m_size--;
+        if (!m_isPi)
+          {
+            m_blue.Departure (start, start - arrival);
+          }
+        if (m_size == 0 && !m_isPi)
+          {
+            m_blue.QueueIdle (start);
+          }
+      }
+  }
+
+  /**
+   * xorshift64*, uniform in [0, 1)
+   */
+  double Uniform (void)
+  {
+    m_rng ^= m_rng >> 12;
+    m_rng ^= m_rng << 25;
+    m_rng ^= m_rng >> 27;
+    return ((m_rng * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /**
+   * xorshift64*, uniform 32-bit integer for the fixed-point drop test
+   */
+  uint32_t UniformInteger (void)
+  {
+    m_rng ^= m_rng >> 12;
+    m_rng ^= m_rng << 25;
+    m_rng ^= m_rng >> 27;
+    return (uint32_t) ((m_rng * 0x2545f4914f6cdd1dULL) >> 32);
+  }
+
+  const ReplayConfig &m_cfg;
+  ReplayResult &m_result;
+  bool m_isPi;
+  PiController m_pi;
+  BlueController m_blue;
+  std::vector<double> m_starts;         //!< Transmission start times of the queued packets
+  std::vector<double> m_arrivals;       //!< Arrival times of the queued packets
+  size_t m_head;                        //!< Oldest queued packet in m_starts
+  uint32_t m_size;                      //!< Queued packets
+  double m_busyUntil;                   //!< End of the transmission of the backlog
+  double m_nextUpdate;                  //!< Time of the next PI update
+  uint64_t m_rng;                       //!< State of the random number generator
+};
+
+/**
+ * One pass over the trace for every configuration in configs[first],
+ * configs[first + stride], ...
+ */
+static void
+ReplayWorker (const std::vector<Arrival> *arrivals, const std::vector<ReplayConfig> *configs,
+              std::vector<ReplayResult> *results, size_t first, size_t stride)
+{
+  std::vector<ReplayQueue *> queues;
+  for (size_t c = first; c < configs->size (); c += stride)
+    {
+      queues.push_back (new ReplayQueue ((*configs)[c], (*results)[c]));
+    }
+  for (size_t i = 0; i < arrivals->size (); i++)
+    {
+      double t = (*arrivals)[i].time * 1e-9;
+      uint32_t bytes = (*arrivals)[i].bytes;
+      for (size_t q = 0; q < queues.size (); q++)
+        {
+          queues[q]->Arrive (t, bytes);
+        }
+    }
+  for (size_t q = 0; q < queues.size (); q++)
+    {
+      queues[q]->Finish ();
+      delete queues[q];
+    }
+}
+
+static double
+QueueQuantile (const std::vector<uint64_t> &hist, uint64_t total, double q)
+{
+  uint64_t rank = (uint64_t) std::ceil (q * total);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < hist.size (); i++)
+    {
+      seen += hist[i];
+      if (seen >= rank && seen > 0)
+        {
+          return i;
+        }
+    }
+  return 0;
+}
+
+static void
+WriteDistributions (const std::string &prefix, const ReplayResult &r)
+{
+  std::ofstream queue ((prefix + "-queue-cdf.plotme").c_str ());
+  uint64_t seen = 0;
+  for (size_t i = 0; i < r.queueHist.size (); i++)
+    {
+      seen += r.queueHist[i];
+      if (r.queueHist[i] > 0)
+        {
+          queue << i << " " << (double) seen / r.arrivals << std::endl;
+        }
+    }
+  std::ofstream sojourn ((prefix + "-sojourn-cdf.plotme").c_str ());
+  const std::vector<uint64_t> &b = r.sojournHist.GetBuckets ();
+  uint64_t served = r.arrivals - r.forcedDrops - r.earlyDrops;
+  seen = 0;
+  for (size_t i = 0; i < b.size (); i++)
+    {
+      seen += b[i];
+      if (b[i] > 0)
+        {
+          sojourn << DelayHistogram::LowerBound (i) * 1e-6 << " " << (double) seen / served << std::endl;
+        }
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  ReplayConfig base;
+  std::vector<std::string> traces;
+  TraceFilter filter;
+  std::string configFile;
+  std::string convert;
+  std::string hist;
+  unsigned threads = std::thread::hardware_concurrency ();
+
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      std::string::size_type eq = arg.find ('=');
+      if (arg.compare (0, 2, "--") != 0 || eq == std::string::npos)
+        {
+          std::cerr << "usage: aqm-replay --trace=<file>[,<file> ...] [--src=<prefix>] [--dst=<prefix>] "
+                    << "[--configs=<file>] [--threads=N] [--hist=<prefix>] [--convert=<file.arr>] "
+                    << "[--name=value ...]" << std::endl;
+          return 2;
+        }
+      std::string name = arg.substr (2, eq - 2);
+      std::string value = arg.substr (eq + 1);
+      if (name == "trace")
+        {
+          // Repeated or comma separated: the files are merged by timestamp
+          std::string::size_type from = 0, comma;
+          do
+            {
+              comma = value.find (',', from);
+              traces.push_back (value.substr (from, comma - from));
+              from = comma + 1;
+            }
+          while (comma != std::string::npos);
+        }
+      else if (name == "src" || name == "dst")
+        {
+          bool ok = name == "src" ? ParseIpv4Prefix (value, filter.src, filter.srcMask)
+            : ParseIpv4Prefix (value, filter.dst, filter.dstMask);
+          if (!ok)
+            {
+              std::cerr << "--" << name << " must be an IPv4 address or prefix, e.g. 10.1.3.0/24" << std::endl;
+              return 2;
+            }
+        }
+      else if (name == "configs")
+        {
+          configFile = value;
+        }
+      else if (name == "convert")
+        {
+          convert = value;
+        }
+      else if (name == "hist")
+        {
+          hist = value;
+        }
+      else if (name == "threads")
+        {
+          threads = std::atoi (value.c_str ());
+        }
+      else if (!SetParam (base, name, value))
+        {
+          std::cerr << "unknown option --" << name << std::endl;
+          return 2;
+        }
+    }
+  if (traces.empty ())
+    {
+      std::cerr << "--trace is required" << std::endl;
+      return 2;
+    }
+
+  struct timeval start, loaded, end;
+  gettimeofday (&start, 0);
+  std::vector<Arrival> arrivals;
+  try
+    {
+      arrivals = ReadArrivals (traces, filter);
+      if (!convert.empty ())
+        {
+          WriteArrivals (convert, arrivals);
+          std::cerr << arrivals.size () << " packets written to " << convert << std::endl;
+          return 0;
+        }
+    }
+  catch (std::exception &e)
+    {
+      std::cerr << "aqm-replay: " << e.what () << std::endl;
+      return 1;
+    }
+  gettimeofday (&loaded, 0);
+
+  std::vector<ReplayConfig> configs;
+  if (configFile.empty ())
+    {
+      configs.push_back (base);
+    }
+  else
+    {
+      std::ifstream in (configFile.c_str ());
+      if (!in)
+        {
+          std::cerr << "cannot open " << configFile << std::endl;
+          return 1;
+        }
+      std::string line;
+      while (std::getline (in, line))
+        {
+          if (line.empty () || line[0] == '#')
+            {
+              continue;
+            }
+          ReplayConfig cfg = base;
+          std::istringstream tokens (line);
+          std::string token;
+          while (tokens >> token)
+            {
+              std::string::size_type eq = token.find ('=');
+              if (eq == std::string::npos || !SetParam (cfg, token.substr (0, eq), token.substr (eq + 1)))
+                {
+                  std::cerr << "unknown parameter " << token << std::endl;
+                  return 1;
+                }
+              cfg.label += (cfg.label.empty () ? "" : "|") + token;
+            }
+          configs.push_back (cfg);
+        }
+    }
+  for (size_t c = 0; c < configs.size (); c++)
+    {
+      if ((configs[c].aqm != "pi" && configs[c].aqm != "blue") || configs[c].bandwidth <= 0)
+        {
+          std::cerr << "configuration " << c << ": aqm must be pi or blue and the bandwidth positive" << std::endl;
+          return 2;
+        }
+    }
+
+  std::vector<ReplayResult> results (configs.size ());
+  threads = std::max (1u, std::min<unsigned> (threads, configs.size ()));
+  std::vector<std::thread> workers;
+  for (unsigned w = 0; w < threads; w++)
+    {
+      workers.push_back (std::thread (ReplayWorker, &arrivals, &configs, &results, w, threads));
+    }
+  for (unsigned w = 0; w < threads; w++)
+    {
+      workers[w].join ();
+    }
+  gettimeofday (&end, 0);
+
+  double duration = arrivals.empty () ? 0 : arrivals.back ().time * 1e-9;
+  std::cout << "config\tarrivals\tforcedDrops\tearlyDrops\tdropRate\tutilization\tmeanQueue\tp99Queue"
+            << "\tmeanSojourn\tp50Sojourn\tp99Sojourn\tp999Sojourn\tmaxSojourn\tfinalProb" << std::endl;
+  for (size_t c = 0; c < configs.size (); c++)
+    {
+      const ReplayResult &r = results[c];
+      uint64_t served = r.arrivals - r.forcedDrops - r.earlyDrops;
+      double dropRate = r.arrivals ? (double) (r.forcedDrops + r.earlyDrops) / r.arrivals : 0;
+      double utilization = duration > 0 ? r.bytesSent * 8.0 / (configs[c].bandwidth * duration) : 0;
+      double meanQueue = r.arrivals ? r.sumQueue / r.arrivals : 0;
+      double meanSojourn = served ? r.sumSojourn / served : 0;
+      std::cout << (configs[c].label.empty () ? "-" : configs[c].label) << "\t" << r.arrivals
+                << "\t" << r.forcedDrops << "\t" << r.earlyDrops << "\t" << dropRate
+                << "\t" << utilization << "\t" << meanQueue
+                << "\t" << QueueQuantile (r.queueHist, r.arrivals, 0.99)
+                << "\t" << meanSojourn << "\t" << r.sojournHist.GetQuantile (0.50) * 1e-6
+                << "\t" << r.sojournHist.GetQuantile (0.99) * 1e-6
+                << "\t" << r.sojournHist.GetQuantile (0.999) * 1e-6
+                << "\t" << r.maxSojourn << "\t" << r.finalProb << std::endl;
+      if (configs.size () == 1)
+        {
+          std::cout << "summary dropRate " << dropRate << std::endl
+                    << "summary utilization " << utilization << std::endl
+                    << "summary meanQueue " << meanQueue << std::endl
+                    << "summary meanSojourn " << meanSojourn << std::endl
+                    << "summary p99Sojourn " << r.sojournHist.GetQuantile (0.99) * 1e-6 << std::endl;
+        }
+      if (!hist.empty ())
+        {
+          std::ostringstream prefix;
+          prefix << hist;
+          if (configs.size () > 1)
+            {
+              prefix << "-" << c;
+            }
+          WriteDistributions (prefix.str (), r);
+        }
+    }
+
+  double load = (loaded.tv_sec - start.tv_sec) + (loaded.tv_usec - start.tv_usec) / 1e6;
+  double run = (end.tv_sec - loaded.tv_sec) + (end.tv_usec - loaded.tv_usec) / 1e6;
+  std::cerr << arrivals.size () << " packets loaded in " << load << " s; " << configs.size ()
+            << " configurations on " << threads << " threads in " << run << " s ("
+            << (run > 0 ? arrivals.size () * configs.size () / run / 1e6 : 0)
+            << " M packet-configurations per second)" << std::endl;
+  return 0;
+}
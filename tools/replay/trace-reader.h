@@ -0,0 +1,417 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Packet arrival traces: libpcap files (as written by EnablePcap, or
+ * captured with tcpdump) and a compact binary format of 12 bytes per
+ * packet that loads much faster. The packets of a pcap file can be
+ * filtered by IPv4 source and destination prefix, and several files
+ * merged by timestamp.
+ *
+ * Compact format, little endian:
+ *   "AQMARR01"  magic
+ *   uint64      number of packets
+ *   then per packet: uint64 arrival time in nanoseconds, uint32 bytes
+ */
+
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace aqm {
+
+/**
+ * \brief One packet of a trace
+ */
+struct Arrival
+{
+  uint64_t time;                //!< Arrival time in nanoseconds from the first packet
+  uint32_t bytes;               //!< Size on the wire
+};
+
+/**
+ * \brief IPv4 source and destination prefixes a packet has to match
+ *
+ * A mask of 0 matches any address, including packets that are not
+ * IPv4; with either prefix set, only IPv4 packets can match.
+ */
+struct TraceFilter
+{
+  TraceFilter () : src (0), srcMask (0), dst (0), dstMask (0)
+  {
+  }
+  bool IsActive (void) const
+  {
+    return srcMask != 0 || dstMask != 0;
+  }
+  bool Matches (uint32_t s, uint32_t d) const
+  {
+    return (s & srcMask) == src && (d & dstMask) == dst;
+  }
+  uint32_t src;                 //!< Source prefix, host order
+  uint32_t srcMask;             //!< Source prefix mask
+  uint32_t dst;                 //!< Destination prefix, host order
+  uint32_t dstMask;             //!< Destination prefix mask
+};
+
+static const char ARRIVAL_MAGIC[8] = { 'A', 'Q', 'M', 'A', 'R', 'R', '0', '1' };
+
+inline uint32_t
+TraceSwap32 (uint32_t v)
+{
+  return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+/**
+ * \brief Parse an IPv4 address or prefix, "a.b.c.d" or "a.b.c.d/len"
+ * \param text The address or prefix
+ * \param addr Set to the prefix, host order
+ * \param mask Set to the prefix mask
+ * \returns false if the text is not a prefix
+ */
+inline bool
+ParseIpv4Prefix (const std::string &text, uint32_t &addr, uint32_t &mask)
+{
+  std::string::size_type slash = text.find ('/');
+  std::string a = text.substr (0, slash);
+  int len = 32;
+  if (slash != std::string::npos)
+    {
+      char *end;
+      len = std::strtol (text.c_str () + slash + 1, &end, 10);
+      if (*end != '\0' || end == text.c_str () + slash + 1 || len < 0 || len > 32)
+        {
+          return false;
+        }
+    }
+  unsigned b[4];
+  char tail;
+  if (std::sscanf (a.c_str (), "%u.%u.%u.%u%c", &b[0], &b[1], &b[2], &b[3], &tail) != 4
+      || b[0] > 255 || b[1] > 255 || b[2] > 255 || b[3] > 255)
+    {
+      return false;
+    }
+  mask = len == 0 ? 0 : 0xffffffffU << (32 - len);
+  addr = ((b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3]) & mask;
+  return true;
+}
+
+/**
+ * \brief Find the IPv4 addresses of a captured packet
+ * \param linkType Link type of the pcap file
+ * \param p Captured bytes
+ * \param len Number of captured bytes
+ * \param src Set to the source address, host order
+ * \param dst Set to the destination address, host order
+ * \returns false if the packet is not IPv4 or too short
+ */
+inline bool
+TraceIpv4Addresses (uint32_t linkType, const uint8_t *p, uint32_t len, uint32_t &src, uint32_t &dst)
+{
+  uint32_t off;
+  uint32_t proto;               // 0x0800 for IPv4, 0 when the link type has none
+  switch (linkType)
+    {
+    case 0:                     // DLT_NULL, address family in host order
+    case 108:                   // DLT_LOOP, in network order
+      if (len < 4)
+        {
+          return false;
+        }
+      off = 4;
+      proto = (p[0] == 2 && p[1] == 0) || (p[0] == 0 && p[3] == 2) ? 0x0800 : 1;
+      break;
+    case 1:                     // DLT_EN10MB
+      off = 12;
+      if (len < 14)
+        {
+          return false;
+        }
+      proto = (p[12] << 8) | p[13];
+      while ((proto == 0x8100 || proto == 0x88a8) && len >= off + 6)
+        {
+          off += 4;
+          proto = (p[off] << 8) | p[off + 1];
+        }
+      off += 2;
+      break;
+    case 9:                     // DLT_PPP, as written by PointToPointNetDevice
+      off = len >= 2 && p[0] == 0xff && p[1] == 0x03 ? 2 : 0;
+      if (len < off + 2)
+        {
+          return false;
+        }
+      proto = (p[off] << 8) | p[off + 1];
+      proto = proto == 0x0021 ? 0x0800 : proto;
+      off += 2;
+      break;
+    case 113:                   // DLT_LINUX_SLL
+      if (len < 16)
+        {
+          return false;
+        }
+      proto = (p[14] << 8) | p[15];
+      off = 16;
+      break;
+    case 276:                   // DLT_LINUX_SLL2
+      if (len < 20)
+        {
+          return false;
+        }
+      proto = (p[0] << 8) | p[1];
+      off = 20;
+      break;
+    case 12:                    // DLT_RAW on some systems
+    case 14:
+    case 101:                   // DLT_RAW
+    case 228:                   // DLT_IPV4
+      off = 0;
+      proto = 0;
+      break;
+    default:
+      throw std::runtime_error ("cannot filter addresses on this pcap link type");
+    }
+  if ((proto != 0 && proto != 0x0800) || len < off + 20 || (p[off] >> 4) != 4)
+    {
+      return false;
+    }
+  p += off;
+  src = ((uint32_t) p[12] << 24) | (p[13] << 16) | (p[14] << 8) | p[15];
+  dst = ((uint32_t) p[16] << 24) | (p[17] << 16) | (p[18] << 8) | p[19];
+  return true;
+}
+
+/**
+ * \brief Read a whole file
+ */
+inline std::vector<uint8_t>
+TraceReadFile (const std::string &path)
+{
+  FILE *f = std::fopen (path.c_str (), "rb");
+  if (!f)
+    {
+      throw std::runtime_error ("cannot open " + path);
+    }
+  std::vector<uint8_t> data;
+  uint8_t buf[1 << 16];
+  size_t n;
+  while ((n = std::fread (buf, 1, sizeof (buf), f)) > 0)
+    {
+      data.insert (data.end (), buf, buf + n);
+    }
+  std::fclose (f);
+  return data;
+}
+
+/**
+ * \brief Parse a libpcap file
+ *
+ * Uses the original length of every packet, so truncated captures
+ * (snaplen) keep their sizes. Micro and nanosecond timestamps, either
+ * byte order. Only the packets that match the filter are kept, which
+ * needs the IPv4 header in the capture.
+ *
+ * \param data The file
+ * \param filter Source and destination prefixes of the packets to keep
+ * \param absolute Keep the capture timestamps (nanoseconds since the
+ * epoch) instead of counting from the first packet kept
+ */
+inline std::vector<Arrival>
+ReadPcap (const std::vector<uint8_t> &data, const TraceFilter &filter = TraceFilter (),
+          bool absolute = false)
+{
+  if (data.size () < 24)
+    {
+      throw std::runtime_error ("pcap file too short");
+    }
+  uint32_t magic;
+  std::memcpy (&magic, &data[0], 4);
+  bool swap = false;
+  uint64_t fracScale = 1000;
+  switch (magic)
+    {
+    case 0xa1b2c3d4: break;
+    case 0xd4c3b2a1: swap = true; break;
+    case 0xa1b23c4d: fracScale = 1; break;
+    case 0x4d3cb2a1: swap = true; fracScale = 1; break;
+    default: throw std::runtime_error ("not a pcap file");
+    }
+
+  uint32_t linkType;
+  std::memcpy (&linkType, &data[20], 4);
+  linkType = (swap ? TraceSwap32 (linkType) : linkType) & 0xffff;
+
+  std::vector<Arrival> arrivals;
+  arrivals.reserve ((data.size () - 24) / 80);
+  uint64_t first = 0;
+  for (size_t pos = 24; pos + 16 <= data.size (); )
+    {
+      uint32_t hdr[4];
+      std::memcpy (hdr, &data[pos], 16);
+      if (swap)
+        {
+          for (int i = 0; i < 4; i++)
+            {
+              hdr[i] = TraceSwap32 (hdr[i]);
+            }
+        }
+      size_t captured = std::min<size_t> (hdr[2], data.size () - pos - 16);
+      uint32_t s, d;
+      if (filter.IsActive ()
+          && !(TraceIpv4Addresses (linkType, &data[pos + 16], captured, s, d) && filter.Matches (s, d)))
+        {
+          pos += 16 + hdr[2];
+          continue;
+        }
+      uint64_t t = hdr[0] * 1000000000ULL + hdr[1] * fracScale;
+      if (arrivals.empty () && !absolute)
+        {
+          first = t;
+        }
+      Arrival a;
+      a.time = t >= first ? t - first : 0;
+      a.bytes = hdr[3];
+      arrivals.push_back (a);
+      pos += 16 + hdr[2];
+    }
+  return arrivals;
+}
+
+/**
+ * \brief Parse a file in the compact format
+ */
+inline std::vector<Arrival>
+ReadCompact (const std::vector<uint8_t> &data)
+{
+  uint64_t n;
+  if (data.size () < 16 || std::memcmp (&data[0], ARRIVAL_MAGIC, 8) != 0)
+    {
+      throw std::runtime_error ("not an arrival trace");
+    }
+  std::memcpy (&n, &data[8], 8);
+  if (data.size () < 16 + n * 12)
+    {
+      throw std::runtime_error ("arrival trace truncated");
+    }
+  std::vector<Arrival> arrivals (n);
+  for (uint64_t i = 0; i < n; i++)
+    {
+      std::memcpy (&arrivals[i].time, &data[16 + i * 12], 8);
+      std::memcpy (&arrivals[i].bytes, &data[16 + i * 12 + 8], 4);
+    }
+  return arrivals;
+}
+
+inline bool
+ArrivalEarlier (const Arrival &a, const Arrival &b)
+{
+  return a.time < b.time;
+}
+
+/**
+ * \brief Read a pcap file or a compact trace, whichever the file is
+ */
+inline std::vector<Arrival>
+ReadArrivals (const std::string &path, const TraceFilter &filter = TraceFilter ())
+{
+  std::vector<uint8_t> data = TraceReadFile (path);
+  if (data.size () >= 8 && std::memcmp (&data[0], ARRIVAL_MAGIC, 8) == 0)
+    {
+      if (filter.IsActive ())
+        {
+          throw std::runtime_error (path + ": a compact trace has no addresses to filter on");
+        }
+      return ReadCompact (data);
+    }
+  return ReadPcap (data, filter);
+}
+
+/**
+ * \brief Read several traces and merge them by timestamp
+ *
+ * Pcap files are merged on their capture timestamps, so captures of the
+ * links into one queue taken at the same time interleave as they did on
+ * the wire; the merged trace counts from its first packet. Compact
+ * traces carry no absolute time and cannot be merged with others.
+ */
+inline std::vector<Arrival>
+ReadArrivals (const std::vector<std::string> &paths, const TraceFilter &filter = TraceFilter ())
+{
+  if (paths.size () == 1)
+    {
+      return ReadArrivals (paths[0], filter);
+    }
+  std::vector<Arrival> merged;
+  for (size_t i = 0; i < paths.size (); i++)
+    {
+      std::vector<uint8_t> data = TraceReadFile (paths[i]);
+      if (data.size () >= 8 && std::memcmp (&data[0], ARRIVAL_MAGIC, 8) == 0)
+        {
+          throw std::runtime_error (paths[i] + ": compact traces cannot be merged, merge the pcap files");
+        }
+      std::vector<Arrival> one = ReadPcap (data, filter, true);
+      // Captures are in time order except for the odd reordered record
+      std::stable_sort (one.begin (), one.end (), ArrivalEarlier);
+      std::vector<Arrival> both (merged.size () + one.size ());
+      std::merge (merged.begin (), merged.end (), one.begin (), one.end (), both.begin (), ArrivalEarlier);
+      merged.swap (both);
+    }
+  uint64_t first = merged.empty () ? 0 : merged[0].time;
+  for (size_t i = 0; i < merged.size (); i++)
+    {
+      merged[i].time -= first;
+    }
+  return merged;
+}
+
+/**
+ * \brief Write a trace in the compact format
+ */
+inline void
+WriteArrivals (const std::string &path, const std::vector<Arrival> &arrivals)
+{
+  FILE *f = std::fopen (path.c_str (), "wb");
+  if (!f)
+    {
+      throw std::runtime_error ("cannot create " + path);
+    }
+  uint64_t n = arrivals.size ();
+  std::fwrite (ARRIVAL_MAGIC, 1, 8, f);
+  std::fwrite (&n, 8, 1, f);
+  for (size_t i = 0; i < arrivals.size (); i++)
+    {
+      std::fwrite (&arrivals[i].time, 8, 1, f);
+      std::fwrite (&arrivals[i].bytes, 4, 1, f);
+    }
+  if (std::fclose (f) != 0)
+    {
+      throw std::runtime_error ("cannot write " + path);
+    }
+}
+
+} // namespace aqm
+
+#endif // TRACE_READER_H
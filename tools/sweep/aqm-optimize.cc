@@ -0,0 +1,456 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Successive-halving search of AQM parameters.
+ *
+ *   aqm-optimize <spec> [--jobs=N] [--seed=N]
+ *
+ * Candidates are drawn at random from the ranges of the spec, all of
+ * them run with the shortest horizon, and only the best 1/eta of them
+ * go on to the next, longer horizon, until the last horizon ranks the
+ * survivors. The objective is a weighted sum of the metrics a run
+ * prints. Runs use the worker pool of aqm-sweep; see README.md.
+ */
+
+#include "sweep-runner.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+
+using namespace aqm;
+
+/**
+ * \brief A continuous or integer search dimension
+ */
+struct OptRange
+{
+  std::string name;             //!< Parameter name
+  double lo;                    //!< Lower bound
+  double hi;                    //!< Upper bound
+  bool log;                     //!< Sample uniformly in log space
+  bool integer;                 //!< Round to an integer
+};
+
+/**
+ * \brief A candidate parameter set and its results at the current rung
+ */
+struct OptCandidate
+{
+  uint32_t id;                                  //!< Candidate number
+  std::vector<SweepBinding> bindings;           //!< Parameters
+  std::map<std::string, double> metrics;        //!< Metrics averaged over the replications
+  uint32_t runs;                                //!< Successful replications
+  double objective;                             //!< Weighted sum of the metrics
+};
+
+static bool
+ParseOptions (const std::vector<std::pair<std::string, std::string> > &extra,
+              std::vector<OptRange> &ranges,
+              std::vector<std::pair<double, std::string> > &objective,
+              std::string &horizonName, std::vector<std::string> &horizons,
+              uint32_t &candidates, uint32_t &eta, uint32_t &top, uint32_t &seed,
+              std::string &error)
+{
+  for (size_t i = 0; i < extra.size (); i++)
+    {
+      const std::string &key = extra[i].first;
+      std::istringstream tokens (extra[i].second);
+      if (key == "range")
+        {
+          OptRange r;
+          std::string scale;
+          if (!(tokens >> r.name >> r.lo >> r.hi) || r.hi < r.lo)
+            {
+              error = "range needs a name, a lower and an upper bound";
+              return false;
+            }
+          tokens >> scale;
+          r.log = scale == "log";
+          r.integer = scale == "int";
+          if (r.log && r.lo <= 0)
+            {
+              error = "log range " + r.name + " must be positive";
+              return false;
+            }
+          ranges.push_back (r);
+        }
+      else if (key == "objective")
+        {
+          double weight;
+          std::string metric;
+          if (!(tokens >> weight >> metric))
+            {
+              error = "objective needs a weight and a metric";
+              return false;
+            }
+          objective.push_back (std::make_pair (weight, metric));
+        }
+      else if (key == "horizon")
+        {
+          tokens >> horizonName;
+          std::string v;
+          while (tokens >> v)
+            {
+              horizons.push_back (v);
+            }
+        }
+      else if (key == "candidates")
+        {
+          tokens >> candidates;
+        }
+      else if (key == "eta")
+        {
+          tokens >> eta;
+        }
+      else if (key == "top")
+        {
+          tokens >> top;
+        }
+      else if (key == "seed")
+        {
+          tokens >> seed;
+        }
+      else
+        {
+          error = "unknown key " + key;
+          return false;
+        }
+    }
+  if (objective.empty ())
+    {
+      error = "no objective";
+      return false;
+    }
+  if (horizons.empty ())
+    {
+      error = "horizon needs a parameter and at least one value";
+      return false;
+    }
+  if (eta < 2)
+    {
+      error = "eta must be at least 2";
+      return false;
+    }
+  return true;
+}
+
+static std::string
+FormatValue (double v, bool integer)
+{
+  std::ostringstream oss;
+  if (integer)
+    {
+      oss << (int64_t) std::floor (v + 0.5);
+    }
+  else
+    {
+      oss << std::setprecision (6) << v;
+    }
+  return oss.str ();
+}
+
+static std::vector<OptCandidate>
+SampleCandidates (const SweepSpec &spec, const std::vector<OptRange> &ranges, uint32_t n, uint32_t seed)
+{
+  std::mt19937 rng (seed);
+  std::uniform_real_distribution<double> uniform (0.0, 1.0);
+  std::vector<OptCandidate> candidates;
+  for (uint32_t c = 0; c < n; c++)
+    {
+      OptCandidate cand;
+      cand.id = c;
+      cand.runs = 0;
+      cand.objective = -std::numeric_limits<double>::infinity ();
+      for (size_t r = 0; r < ranges.size (); r++)
+        {
+          const OptRange &range = ranges[r];
+          double u = uniform (rng);
+          double v = range.log
+            ? std::exp (std::log (range.lo) + u * (std::log (range.hi) - std::log (range.lo)))
+            : range.lo + u * (range.hi - range.lo);
+          SweepBinding b;
+          b.name = range.name;
+          b.value = FormatValue (v, range.integer);
+          cand.bindings.push_back (b);
+        }
+      // "param" lines are categorical dimensions
+      for (size_t p = 0; p < spec.params.size (); p++)
+        {
+          const std::vector<std::string> &values = spec.params[p].second;
+          SweepBinding b;
+          b.name = spec.params[p].first;
+          b.value = values[std::min<size_t> (values.size () - 1, uniform (rng) * values.size ())];
+          cand.bindings.push_back (b);
+        }
+      candidates.push_back (cand);
+    }
+  return candidates;
+}
+
+static void
+Score (std::vector<OptCandidate> &candidates, const std::vector<SweepRun> &runs, uint32_t repeat,
+       const std::vector<std::pair<double, std::string> > &objective)
+{
+  for (size_t c = 0; c < candidates.size (); c++)
+    {
+      OptCandidate &cand = candidates[c];
+      cand.metrics.clear ();
+      cand.runs = 0;
+      cand.objective = -std::numeric_limits<double>::infinity ();
+      for (uint32_t r = 0; r < repeat; r++)
+        {
+          const SweepRun &run = runs[c * repeat + r];
+          if (!run.ok)
+            {
+              continue;
+            }
+          cand.runs++;
+          for (size_t m = 0; m < run.metrics.size (); m++)
+            {
+              cand.metrics[run.metrics[m].first] += run.metrics[m].second;
+            }
+        }
+      if (cand.runs == 0)
+        {
+          continue;
+        }
+      double score = 0;
+      bool complete = true;
+      for (std::map<std::string, double>::iterator it = cand.metrics.begin (); it != cand.metrics.end (); ++it)
+        {
+          it->second /= cand.runs;
+        }
+      for (size_t o = 0; o < objective.size (); o++)
+        {
+          std::map<std::string, double>::const_iterator it = cand.metrics.find (objective[o].second);
+          if (it == cand.metrics.end ())
+            {
+              complete = false;
+              break;
+            }
+          score += objective[o].first * it->second;
+        }
+      if (complete)
+        {
+          cand.objective = score;
+        }
+    }
+}
+
+static bool
+Better (const OptCandidate &a, const OptCandidate &b)
+{
+  return a.objective > b.objective;
+}
+
+static void
+WriteRung (std::ostream &out, uint32_t rung, const std::string &horizon,
+           const std::vector<OptCandidate> &candidates,
+           const std::vector<std::pair<double, std::string> > &objective)
+{
+  for (size_t c = 0; c < candidates.size (); c++)
+    {
+      const OptCandidate &cand = candidates[c];
+      out << rung << "\t" << horizon << "\t" << cand.id << "\t" << cand.runs << "\t" << cand.objective;
+      for (size_t o = 0; o < objective.size (); o++)
+        {
+          std::map<std::string, double>::const_iterator it = cand.metrics.find (objective[o].second);
+          out << "\t";
+          if (it != cand.metrics.end ())
+            {
+              out << it->second;
+            }
+          else
+            {
+              out << "NA";
+            }
+        }
+      for (size_t b = 0; b < cand.bindings.size (); b++)
+        {
+          out << "\t" << cand.bindings[b].value;
+        }
+      out << std::endl;
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string specFile;
+  int jobs = 0;
+  int seedOverride = -1;
+
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 7, "--jobs=") == 0)
+        {
+          jobs = std::atoi (arg.c_str () + 7);
+        }
+      else if (arg.compare (0, 7, "--seed=") == 0)
+        {
+          seedOverride = std::atoi (arg.c_str () + 7);
+        }
+      else if (specFile.empty () && arg.compare (0, 2, "--") != 0)
+        {
+          specFile = arg;
+        }
+      else
+        {
+          specFile.clear ();
+          break;
+        }
+    }
+  if (specFile.empty ())
+    {
+      std::cerr << "usage: aqm-optimize <spec> [--jobs=N] [--seed=N]" << std::endl;
+      return 2;
+    }
+
+  SweepSpec spec;
+  std::string error;
+  std::vector<std::pair<std::string, std::string> > extra;
+  std::vector<OptRange> ranges;
+  std::vector<std::pair<double, std::string> > objective;
+  std::string horizonName;
+  std::vector<std::string> horizons;
+  uint32_t nCandidates = 27;
+  uint32_t eta = 3;
+  uint32_t top = 5;
+  uint32_t seed = 1;
+  if (!ParseSweepSpec (specFile, spec, error, &extra)
+      || !ParseOptions (extra, ranges, objective, horizonName, horizons, nCandidates, eta, top, seed, error))
+    {
+      std::cerr << "aqm-optimize: " << error << std::endl;
+      return 2;
+    }
+  if (jobs > 0)
+    {
+      spec.jobs = jobs;
+    }
+  if (seedOverride >= 0)
+    {
+      seed = seedOverride;
+    }
+  if (!spec.points.empty ())
+    {
+      std::cerr << "aqm-optimize: use range and param lines, not point" << std::endl;
+      return 2;
+    }
+
+  std::vector<OptCandidate> candidates = SampleCandidates (spec, ranges, nCandidates, seed);
+  std::string base = spec.output;
+  if (!SweepMakeDirs (base))
+    {
+      std::cerr << "aqm-optimize: cannot create " << base << std::endl;
+      return 1;
+    }
+  std::ofstream rungs ((base + "/rungs.tsv").c_str ());
+  rungs << "rung\t" << horizonName << "\tcandidate\truns\tobjective";
+  for (size_t o = 0; o < objective.size (); o++)
+    {
+      rungs << "\t" << objective[o].second;
+    }
+  for (size_t b = 0; !candidates.empty () && b < candidates[0].bindings.size (); b++)
+    {
+      rungs << "\t" << candidates[0].bindings[b].name;
+    }
+  rungs << std::endl;
+
+  uint32_t totalRuns = 0;
+  for (uint32_t rung = 0; rung < horizons.size (); rung++)
+    {
+      std::vector<std::vector<SweepBinding> > bindings;
+      for (size_t c = 0; c < candidates.size (); c++)
+        {
+          bindings.push_back (candidates[c].bindings);
+          SweepBinding h;
+          h.name = horizonName;
+          h.value = horizons[rung];
+          bindings.back ().push_back (h);
+        }
+
+      std::ostringstream dir;
+      dir << base << "/rung-" << rung;
+      SweepSpec rungSpec = spec;
+      rungSpec.output = dir.str ();
+      std::vector<SweepRun> runs = MakeSweepRuns (rungSpec, bindings, 0);
+      std::cerr << "rung " << rung << ": " << candidates.size () << " candidates, "
+                << horizonName << "=" << horizons[rung] << std::endl;
+      SweepRunner runner (rungSpec);
+      if (!runner.Run (runs, error))
+        {
+          std::cerr << "aqm-optimize: " << error << std::endl;
+          return 1;
+        }
+      WriteSweepTable (runs, rungSpec.output + "/summary.tsv");
+      totalRuns += runs.size ();
+
+      Score (candidates, runs, spec.repeat, objective);
+      std::stable_sort (candidates.begin (), candidates.end (), Better);
+      WriteRung (rungs, rung, horizons[rung], candidates, objective);
+
+      // Promote the best 1/eta, but keep at least top candidates for the ranking
+      if (rung + 1 < horizons.size ())
+        {
+          size_t keep = std::max<size_t> ((candidates.size () + eta - 1) / eta, std::min<size_t> (top, candidates.size ()));
+          while (keep > 0 && std::isinf (candidates[keep - 1].objective))
+            {
+              keep--;
+            }
+          candidates.resize (keep);
+          if (candidates.empty ())
+            {
+              std::cerr << "aqm-optimize: every candidate failed" << std::endl;
+              return 1;
+            }
+        }
+    }
+
+  std::ofstream best ((base + "/best.txt").c_str ());
+  for (size_t c = 0; c < std::min<size_t> (top, candidates.size ()); c++)
+    {
+      const OptCandidate &cand = candidates[c];
+      if (std::isinf (cand.objective))
+        {
+          break;
+        }
+      std::ostringstream line;
+      line << "best " << c + 1 << " objective " << cand.objective;
+      for (size_t o = 0; o < objective.size (); o++)
+        {
+          line << " " << objective[o].second << " " << cand.metrics.find (objective[o].second)->second;
+        }
+      line << std::endl << " ";
+      for (size_t b = 0; b < cand.bindings.size (); b++)
+        {
+          line << " --" << cand.bindings[b].name << "=" << cand.bindings[b].value;
+        }
+      line << std::endl;
+      std::cout << line.str ();
+      best << line.str ();
+    }
+  std::cerr << totalRuns << " runs; ranking in " << base << "/rungs.tsv" << std::endl;
+  return 0;
+}
@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Parameter sweeps of the ns-3 programs and ns-2 scripts on all cores.
+ *
+ *   aqm-sweep <spec> [--jobs=N] [--dry-run]
+ *
+ * Every binding of the grid (or list) in the spec file runs as its own
+ * worker process, pinned to one CPU, in its own directory under the
+ * output directory. Failed or timed out runs are retried. The metrics
+ * of every run (its "summary <name> <value>" lines and the mean of the
+ * value column of its .plotme files) are collected into summary.tsv.
+ * See README.md for the spec file format.
+ */
+
+#include "sweep-runner.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace aqm;
+
+int
+main (int argc, char *argv[])
+{
+  std::string specFile;
+  bool dryRun = false;
+  int jobs = 0;
+
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg == "--dry-run")
+        {
+          dryRun = true;
+        }
+      else if (arg.compare (0, 7, "--jobs=") == 0)
+        {
+          jobs = std::atoi (arg.c_str () + 7);
+        }
+      else if (specFile.empty () && arg.compare (0, 2, "--") != 0)
+        {
+          specFile = arg;
+        }
+      else
+        {
+          specFile.clear ();
+          break;
+        }
+    }
+  if (specFile.empty ())
+    {
+      std::cerr << "usage: aqm-sweep <spec> [--jobs=N] [--dry-run]" << std::endl;
+      return 2;
+    }
+
+  SweepSpec spec;
+  std::string error;
+  if (!ParseSweepSpec (specFile, spec, error))
+    {
+      std::cerr << "aqm-sweep: " << error << std::endl;
+      return 2;
+    }
+  if (jobs > 0)
+    {
+      spec.jobs = jobs;
+    }
+
+  std::vector<SweepRun> runs = ExpandSweep (spec);
+  if (dryRun)
+    {
+      for (size_t i = 0; i < runs.size (); i++)
+        {
+          std::cout << runs[i].dir << ": " << runs[i].command << std::endl;
+        }
+      return 0;
+    }
+
+  SweepRunner runner (spec);
+  if (!runner.Run (runs, error))
+    {
+      std::cerr << "aqm-sweep: " << error << std::endl;
+      return 1;
+    }
+
+  std::string table = spec.output + "/summary.tsv";
+  WriteSweepTable (runs, table);
+
+  uint32_t failed = 0;
+  for (size_t i = 0; i < runs.size (); i++)
+    {
+      failed += runs[i].ok ? 0 : 1;
+    }
+  std::cerr << runs.size () - failed << " runs succeeded, " << failed << " failed; metrics in "
+            << table << std::endl;
+  return failed > 0 ? 1 : 0;
+}
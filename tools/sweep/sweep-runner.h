@@ -0,0 +1,918 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Spec parsing, run directories, the worker pool and metric collection
+ * of aqm-sweep, shared with aqm-optimize. POSIX only; CPU pinning only
+ * on Linux.
+ */
+
+#ifndef SWEEP_RUNNER_H
+#define SWEEP_RUNNER_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace aqm {
+
+/**
+ * \brief One parameter set to a value in a run
+ */
+struct SweepBinding
+{
+  std::string name;             //!< ns-3 attribute or program option, or ns-2 "Class::var_" / variable
+  std::string value;            //!< Value as written on the command line or in the script
+};
+
+/**
+ * \brief A parsed spec file
+ */
+struct SweepSpec
+{
+  SweepSpec ()
+    : kind ("ns3"),
+      output ("sweep-out"),
+      repeat (1),
+      jobs (0),
+      retries (1),
+      timeout (0)
+  {
+  }
+
+  std::string kind;                                     //!< "ns3" or "ns2"
+  std::string command;                                  //!< Shell command template
+  std::string script;                                   //!< ns-2 Tcl script
+  std::string output;                                   //!< Output directory
+  std::string cwd;                                      //!< Directory aqm-sweep was started in
+  std::vector<std::pair<std::string, std::vector<std::string> > > params;   //!< Grid axes
+  std::vector<std::vector<SweepBinding> > points;       //!< Explicit bindings, instead of the grid
+  std::vector<std::string> collect;                     //!< Files whose mean value is collected
+  uint32_t repeat;                                      //!< Runs per binding (RngRun 1..repeat)
+  uint32_t jobs;                                        //!< Worker processes, 0 for all CPUs
+  uint32_t retries;                                     //!< Extra attempts for a failed run
+  double timeout;                                       //!< Seconds before a run is killed, 0 for none
+};
+
+/**
+ * \brief A run and its outcome
+ */
+struct SweepRun
+{
+  uint32_t id;                                          //!< Index in the sweep
+  uint32_t rep;                                         //!< Replication, RngRun = rep + 1
+  std::vector<SweepBinding> bindings;                   //!< Parameters of the run
+  std::string dir;                                      //!< Run directory
+  std::string command;                                  //!< Shell command
+  bool ok;                                              //!< True if the run succeeded
+  uint32_t attempts;                                    //!< Attempts made
+  double elapsed;                                       //!< Wall clock seconds of the last attempt
+  std::vector<std::pair<std::string, double> > metrics; //!< Collected metrics
+};
+
+inline std::string
+SweepTrim (const std::string &s)
+{
+  std::string::size_type b = s.find_first_not_of (" \t\r\n");
+  if (b == std::string::npos)
+    {
+      return "";
+    }
+  std::string::size_type e = s.find_last_not_of (" \t\r\n");
+  return s.substr (b, e - b + 1);
+}
+
+inline double
+SweepNow (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+inline bool
+SweepMakeDirs (const std::string &path)
+{
+  for (std::string::size_type i = 1; i <= path.size (); i++)
+    {
+      if (i == path.size () || path[i] == '/')
+        {
+          std::string sub = path.substr (0, i);
+          if (mkdir (sub.c_str (), 0755) != 0 && errno != EEXIST)
+            {
+              return false;
+            }
+        }
+    }
+  return true;
+}
+
+inline std::string
+SweepReplaceAll (std::string s, const std::string &from, const std::string &to)
+{
+  std::string::size_type pos = 0;
+  while ((pos = s.find (from, pos)) != std::string::npos)
+    {
+      s.replace (pos, from.size (), to);
+      pos += to.size ();
+    }
+  return s;
+}
+
+inline std::string
+SweepQuote (const std::string &v)
+{
+  if (v.find_first_not_of ("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._:/=+-") == std::string::npos)
+    {
+      return v;
+    }
+  return "'" + SweepReplaceAll (v, "'", "'\\''") + "'";
+}
+
+/**
+ * \brief Parse "name=value name=value ..." into bindings
+ */
+inline bool
+SweepParseBindings (const std::string &line, std::vector<SweepBinding> &bindings)
+{
+  std::istringstream tokens (line);
+  std::string token;
+  while (tokens >> token)
+    {
+      std::string::size_type eq = token.find ('=');
+      if (eq == std::string::npos || eq == 0)
+        {
+          return false;
+        }
+      SweepBinding b;
+      b.name = token.substr (0, eq);
+      b.value = token.substr (eq + 1);
+      bindings.push_back (b);
+    }
+  return true;
+}
+
+/**
+ * \brief Parse a spec file
+ * \param file The spec file
+ * \param spec The parsed spec
+ * \param error Set when parsing fails
+ * \param extra If not null, receives the (key, rest of line) of the
+ *        directives that are not sweep directives, instead of failing
+ * \returns true on success
+ */
+inline bool
+ParseSweepSpec (const std::string &file, SweepSpec &spec, std::string &error,
+                std::vector<std::pair<std::string, std::string> > *extra = 0)
+{
+  std::ifstream in (file.c_str ());
+  if (!in)
+    {
+      error = "cannot open " + file;
+      return false;
+    }
+  char buf[4096];
+  spec.cwd = getcwd (buf, sizeof (buf)) ? buf : ".";
+
+  std::string line;
+  uint32_t lineNo = 0;
+  while (std::getline (in, line))
+    {
+      lineNo++;
+      line = SweepTrim (line);
+      if (line.empty () || line[0] == '#')
+        {
+          continue;
+        }
+      std::string::size_type sp = line.find_first_of (" \t");
+      std::string key = line.substr (0, sp);
+      std::string rest = sp == std::string::npos ? "" : SweepTrim (line.substr (sp));
+      std::ostringstream where;
+      where << file << ":" << lineNo << ": ";
+
+      if (key == "kind")
+        {
+          spec.kind = rest;
+          if (rest != "ns3" && rest != "ns2")
+            {
+              error = where.str () + "kind must be ns3 or ns2";
+              return false;
+            }
+        }
+      else if (key == "command")
+        {
+          spec.command = rest;
+        }
+      else if (key == "script")
+        {
+          spec.script = rest;
+        }
+      else if (key == "output")
+        {
+          spec.output = rest;
+        }
+      else if (key == "param")
+        {
+          std::istringstream tokens (rest);
+          std::string name;
+          tokens >> name;
+          std::vector<std::string> values;
+          std::string v;
+          while (tokens >> v)
+            {
+              values.push_back (v);
+            }
+          if (name.empty () || values.empty ())
+            {
+              error = where.str () + "param needs a name and at least one value";
+              return false;
+            }
+          spec.params.push_back (std::make_pair (name, values));
+        }
+      else if (key == "point")
+        {
+          std::vector<SweepBinding> bindings;
+          if (!SweepParseBindings (rest, bindings))
+            {
+              error = where.str () + "point needs name=value bindings";
+              return false;
+            }
+          spec.points.push_back (bindings);
+        }
+      else if (key == "collect")
+        {
+          spec.collect.push_back (rest);
+        }
+      else if (key == "repeat")
+        {
+          spec.repeat = std::max (1, std::atoi (rest.c_str ()));
+        }
+      else if (key == "jobs")
+        {
+          spec.jobs = std::atoi (rest.c_str ());
+        }
+      else if (key == "retries")
+        {
+          spec.retries = std::atoi (rest.c_str ());
+        }
+      else if (key == "timeout")
+        {
+          spec.timeout = std::atof (rest.c_str ());
+        }
+      else if (extra)
+        {
+          extra->push_back (std::make_pair (key, rest));
+        }
+      else
+        {
+          error = where.str () + "unknown key " + key;
+          return false;
+        }
+    }
+
+  if (spec.command.empty ())
+    {
+      error = file + ": no command";
+      return false;
+    }
+  if (spec.kind == "ns2" && spec.script.empty ())
+    {
+      error = file + ": ns2 sweeps need a script";
+      return false;
+    }
+  if (spec.output[0] != '/')
+    {
+      spec.output = spec.cwd + "/" + spec.output;
+    }
+  if (!spec.script.empty () && spec.script[0] != '/')
+    {
+      spec.script = spec.cwd + "/" + spec.script;
+    }
+  return true;
+}
+
+/**
+ * \brief Build the shell command of a run
+ */
+inline std::string
+BuildSweepCommand (const SweepSpec &spec, const SweepRun &run)
+{
+  std::ostringstream rep;
+  rep << run.rep + 1;
+  std::string cmd = spec.command;
+  cmd = SweepReplaceAll (cmd, "{cwd}", spec.cwd);
+  cmd = SweepReplaceAll (cmd, "{dir}", run.dir);
+  cmd = SweepReplaceAll (cmd, "{run}", rep.str ());
+
+  if (spec.kind == "ns3")
+    {
+      // Attributes as --ns3::<TypeId>::<Attribute>=<value>, program options as --<name>=<value>
+      std::string args;
+      for (size_t i = 0; i < run.bindings.size (); i++)
+        {
+          args += " --" + run.bindings[i].name + "=" + SweepQuote (run.bindings[i].value);
+        }
+      args += " --RngRun=" + rep.str ();
+      if (cmd.find ("{args}") != std::string::npos)
+        {
+          cmd = SweepReplaceAll (cmd, "{args}", args.substr (1));
+        }
+      else
+        {
+          cmd += args;
+        }
+    }
+  else
+    {
+      std::string script = spec.script.substr (spec.script.rfind ('/') + 1);
+      if (cmd.find ("{script}") != std::string::npos)
+        {
+          cmd = SweepReplaceAll (cmd, "{script}", script);
+        }
+      else
+        {
+          cmd += " " + script;
+        }
+    }
+  return cmd;
+}
+
+/**
+ * \brief Build runs for a list of bindings
+ * \param spec The spec
+ * \param bindings One entry per parameter set
+ * \param firstId Id of the first run, for run directory names
+ * \returns The runs, spec.repeat per parameter set
+ */
+inline std::vector<SweepRun>
+MakeSweepRuns (const SweepSpec &spec, const std::vector<std::vector<SweepBinding> > &bindings, uint32_t firstId)
+{
+  std::vector<SweepRun> runs;
+  for (size_t i = 0; i < bindings.size (); i++)
+    {
+      for (uint32_t r = 0; r < spec.repeat; r++)
+        {
+          SweepRun run;
+          run.id = firstId + runs.size ();
+          run.rep = r;
+          run.bindings = bindings[i];
+          char name[32];
+          std::snprintf (name, sizeof (name), "/run-%05u", run.id);
+          run.dir = spec.output + name;
+          run.command = BuildSweepCommand (spec, run);
+          run.ok = false;
+          run.attempts = 0;
+          run.elapsed = 0;
+          runs.push_back (run);
+        }
+    }
+  return runs;
+}
+
+/**
+ * \brief Expand the grid, or the list of points, of a spec into runs
+ */
+inline std::vector<SweepRun>
+ExpandSweep (const SweepSpec &spec)
+{
+  std::vector<std::vector<SweepBinding> > bindings;
+  if (!spec.points.empty ())
+    {
+      bindings = spec.points;
+    }
+  else
+    {
+      bindings.push_back (std::vector<SweepBinding> ());
+      for (size_t p = 0; p < spec.params.size (); p++)
+        {
+          std::vector<std::vector<SweepBinding> > next;
+          for (size_t i = 0; i < bindings.size (); i++)
+            {
+              for (size_t v = 0; v < spec.params[p].second.size (); v++)
+                {
+                  SweepBinding b;
+                  b.name = spec.params[p].first;
+                  b.value = spec.params[p].second[v];
+                  next.push_back (bindings[i]);
+                  next.back ().push_back (b);
+                }
+            }
+          bindings.swap (next);
+        }
+    }
+  return MakeSweepRuns (spec, bindings, 0);
+}
+
+/**
+ * \brief Copy an ns-2 script, setting the bound variables
+ *
+ * "Queue/PI::a_" rewrites the "Queue/PI set a_ ..." line and "val(stop)"
+ * the "set val(stop) ..." line; bindings without a line are added before
+ * the simulator is created.
+ */
+inline bool
+WriteNs2Script (const SweepSpec &spec, const SweepRun &run, std::string &error)
+{
+  std::ifstream in (spec.script.c_str ());
+  if (!in)
+    {
+      error = "cannot open " + spec.script;
+      return false;
+    }
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline (in, line))
+    {
+      lines.push_back (line);
+    }
+
+  std::vector<std::string> missing;
+  for (size_t b = 0; b < run.bindings.size (); b++)
+    {
+      const SweepBinding &bind = run.bindings[b];
+      std::string::size_type sep = bind.name.find ("::");
+      std::string replacement;
+      std::vector<std::string> match;
+      if (sep != std::string::npos)
+        {
+          match.push_back (bind.name.substr (0, sep));
+          match.push_back ("set");
+          match.push_back (bind.name.substr (sep + 2));
+          replacement = match[0] + " set " + match[2] + " " + bind.value;
+        }
+      else
+        {
+          match.push_back ("set");
+          match.push_back (bind.name);
+          replacement = "set " + bind.name + " " + bind.value;
+        }
+
+      bool found = false;
+      for (size_t i = 0; i < lines.size (); i++)
+        {
+          std::istringstream tokens (lines[i]);
+          bool same = true;
+          for (size_t t = 0; t < match.size () && same; t++)
+            {
+              std::string token;
+              same = (tokens >> token) && token == match[t];
+            }
+          if (same)
+            {
+              // Keep a trailing comment
+              std::string::size_type comment = lines[i].find (";#");
+              lines[i] = replacement + (comment != std::string::npos ? "   " + lines[i].substr (comment) : "");
+              found = true;
+            }
+        }
+      if (!found)
+        {
+          missing.push_back (replacement);
+        }
+    }
+
+  if (spec.repeat > 1)
+    {
+      std::ostringstream seed;
+      seed << "global defaultRNG; $defaultRNG seed " << run.rep + 1;
+      missing.push_back (seed.str ());
+    }
+
+  std::string script = run.dir + spec.script.substr (spec.script.rfind ('/'));
+  std::ofstream out (script.c_str ());
+  bool inserted = missing.empty ();
+  for (size_t i = 0; i < lines.size (); i++)
+    {
+      if (!inserted && lines[i].find ("[new Simulator]") != std::string::npos)
+        {
+          for (size_t m = 0; m < missing.size (); m++)
+            {
+              out << missing[m] << std::endl;
+            }
+          inserted = true;
+        }
+      out << lines[i] << std::endl;
+    }
+  if (!inserted)
+    {
+      error = spec.script + " does not create a Simulator";
+      return false;
+    }
+  return out.good ();
+}
+
+/**
+ * \brief Collect the metrics of a finished run
+ *
+ * "summary <name> <value>" lines of its standard output, and the mean of
+ * the second column of its .plotme files (or of the files listed with
+ * "collect") as "<file>:mean".
+ */
+inline void
+CollectSweepMetrics (const SweepSpec &spec, SweepRun &run)
+{
+  run.metrics.clear ();
+  std::ifstream out ((run.dir + "/stdout.txt").c_str ());
+  std::string line;
+  while (std::getline (out, line))
+    {
+      std::istringstream tokens (line);
+      std::string tag, name;
+      double value;
+      if ((tokens >> tag >> name >> value) && tag == "summary")
+        {
+          run.metrics.push_back (std::make_pair (name, value));
+        }
+    }
+
+  std::vector<std::string> files = spec.collect;
+  if (files.empty ())
+    {
+      DIR *d = opendir (run.dir.c_str ());
+      struct dirent *e;
+      while (d && (e = readdir (d)) != 0)
+        {
+          std::string name = e->d_name;
+          if (name.size () > 7 && name.compare (name.size () - 7, 7, ".plotme") == 0)
+            {
+              files.push_back (name);
+            }
+        }
+      if (d)
+        {
+          closedir (d);
+        }
+    }
+  for (size_t f = 0; f < files.size (); f++)
+    {
+      std::ifstream in ((run.dir + "/" + files[f]).c_str ());
+      double t, v, sum = 0;
+      uint64_t n = 0;
+      while (in >> t >> v)
+        {
+          sum += v;
+          n++;
+        }
+      if (n > 0)
+        {
+          run.metrics.push_back (std::make_pair (files[f] + ":mean", sum / n));
+        }
+    }
+}
+
+/**
+ * \brief Runs worker processes, pinned one per CPU
+ */
+class SweepRunner
+{
+public:
+  SweepRunner (const SweepSpec &spec)
+    : m_spec (spec)
+  {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO (&set);
+    if (sched_getaffinity (0, sizeof (set), &set) == 0)
+      {
+        for (int c = 0; c < CPU_SETSIZE; c++)
+          {
+            if (CPU_ISSET (c, &set))
+              {
+                m_cpus.push_back (c);
+              }
+          }
+      }
+#endif
+    long online = sysconf (_SC_NPROCESSORS_ONLN);
+    if (m_cpus.empty ())
+      {
+        for (long c = 0; c < online; c++)
+          {
+            m_cpus.push_back (c);
+          }
+      }
+    m_jobs = m_spec.jobs > 0 ? m_spec.jobs : (m_cpus.empty () ? 1 : m_cpus.size ());
+  }
+
+  /**
+   * \brief Run all the runs, retrying failed ones
+   * \param runs The runs; their outcome and metrics are filled in
+   * \param error Set if the sweep cannot proceed
+   * \returns false if the sweep could not run
+   */
+  bool Run (std::vector<SweepRun> &runs, std::string &error)
+  {
+    if (!SweepMakeDirs (m_spec.output))
+      {
+        error = "cannot create " + m_spec.output;
+        return false;
+      }
+
+    std::deque<size_t> pending;
+    for (size_t i = 0; i < runs.size (); i++)
+      {
+        pending.push_back (i);
+      }
+    std::vector<Slot> slots (m_jobs);
+    uint32_t done = 0;
+
+    while (!pending.empty () || Active (slots) > 0)
+      {
+        for (size_t s = 0; s < slots.size () && !pending.empty (); s++)
+          {
+            if (slots[s].pid != 0)
+              {
+                continue;
+              }
+            size_t r = pending.front ();
+            pending.pop_front ();
+            if (!Start (runs[r], s, slots[s], error))
+              {
+                // Do not leave the running commands writing into the output
+                Abort (slots);
+                return false;
+              }
+            slots[s].run = r;
+          }
+
+        int status;
+        pid_t pid = waitpid (-1, &status, WNOHANG);
+        if (pid > 0)
+          {
+            for (size_t s = 0; s < slots.size (); s++)
+              {
+                if (slots[s].pid != pid)
+                  {
+                    continue;
+                  }
+                SweepRun &run = runs[slots[s].run];
+                run.elapsed = SweepNow () - slots[s].start;
+                run.ok = !slots[s].killed && WIFEXITED (status) && WEXITSTATUS (status) == 0;
+                slots[s].pid = 0;
+                if (run.ok)
+                  {
+                    CollectSweepMetrics (m_spec, run);
+                  }
+                else if (run.attempts <= m_spec.retries)
+                  {
+                    pending.push_back (slots[s].run);
+                  }
+                if (run.ok || run.attempts > m_spec.retries)
+                  {
+                    done++;
+                  }
+                std::cerr << "[" << done << "/" << runs.size () << "] "
+                          << run.dir.substr (run.dir.rfind ('/') + 1) << " "
+                          << (run.ok ? "ok" : (slots[s].killed ? "timeout" : "failed"))
+                          << " " << run.elapsed << " s" << std::endl;
+              }
+            continue;
+          }
+
+        if (m_spec.timeout > 0)
+          {
+            double now = SweepNow ();
+            for (size_t s = 0; s < slots.size (); s++)
+              {
+                if (slots[s].pid != 0 && !slots[s].killed && now - slots[s].start > m_spec.timeout)
+                  {
+                    kill (-slots[s].pid, SIGKILL);
+                    slots[s].killed = true;
+                  }
+              }
+          }
+        usleep (20000);
+      }
+    return true;
+  }
+
+private:
+  struct Slot
+  {
+    Slot () : pid (0), run (0), start (0), killed (false)
+    {
+    }
+    pid_t pid;
+    size_t run;
+    double start;
+    bool killed;
+  };
+
+  static uint32_t Active (const std::vector<Slot> &slots)
+  {
+    uint32_t n = 0;
+    for (size_t s = 0; s < slots.size (); s++)
+      {
+        n += slots[s].pid != 0 ? 1 : 0;
+      }
+    return n;
+  }
+
+  /**
+   * \brief Kill the process groups of the running commands and reap them
+   */
+  static void Abort (std::vector<Slot> &slots)
+  {
+    for (size_t s = 0; s < slots.size (); s++)
+      {
+        if (slots[s].pid != 0)
+          {
+            kill (-slots[s].pid, SIGKILL);
+          }
+      }
+    for (size_t s = 0; s < slots.size (); s++)
+      {
+        if (slots[s].pid != 0)
+          {
+            int status;
+            while (waitpid (slots[s].pid, &status, 0) < 0 && errno == EINTR)
+              {
+              }
+            slots[s].pid = 0;
+          }
+      }
+  }
+
+  bool Start (SweepRun &run, size_t slotIndex, Slot &slot, std::string &error)
+  {
+    run.attempts++;
+    if (run.attempts > 1)
+      {
+        // Keep the output of the failed attempt for inspection
+        std::ostringstream failed;
+        failed << run.dir << ".failed-" << run.attempts - 1;
+        std::rename (run.dir.c_str (), failed.str ().c_str ());
+      }
+    if (!SweepMakeDirs (run.dir))
+      {
+        error = "cannot create " + run.dir;
+        return false;
+      }
+    std::ofstream bindings ((run.dir + "/bindings.txt").c_str ());
+    for (size_t i = 0; i < run.bindings.size (); i++)
+      {
+        bindings << run.bindings[i].name << "=" << run.bindings[i].value << std::endl;
+      }
+    bindings << "# " << run.command << std::endl;
+    bindings.close ();
+    if (m_spec.kind == "ns2" && !WriteNs2Script (m_spec, run, error))
+      {
+        return false;
+      }
+
+    int cpu = m_cpus.empty () ? -1 : m_cpus[slotIndex % m_cpus.size ()];
+    pid_t pid = fork ();
+    if (pid < 0)
+      {
+        error = "fork failed";
+        return false;
+      }
+    if (pid == 0)
+      {
+        // Own process group, so that a timeout kills the whole command
+        setpgid (0, 0);
+#ifdef __linux__
+        if (cpu >= 0)
+          {
+            cpu_set_t set;
+            CPU_ZERO (&set);
+            CPU_SET (cpu, &set);
+            sched_setaffinity (0, sizeof (set), &set);
+          }
+#endif
+        if (chdir (run.dir.c_str ()) != 0
+            || !std::freopen ("stdout.txt", "w", stdout)
+            || !std::freopen ("stderr.txt", "w", stderr))
+          {
+            _exit (126);
+          }
+        execl ("/bin/sh", "sh", "-c", run.command.c_str (), (char *) 0);
+        _exit (127);
+      }
+    setpgid (pid, pid);
+    slot.pid = pid;
+    slot.start = SweepNow ();
+    slot.killed = false;
+    return true;
+  }
+
+  SweepSpec m_spec;
+  std::vector<int> m_cpus;
+  uint32_t m_jobs;
+};
+
+/**
+ * \brief Write the bindings, outcome and metrics of the runs as a
+ * tab-separated table, one line per run
+ */
+inline void
+WriteSweepTable (const std::vector<SweepRun> &runs, const std::string &file)
+{
+  std::vector<std::string> params;
+  std::vector<std::string> metrics;
+  for (size_t i = 0; i < runs.size (); i++)
+    {
+      for (size_t b = 0; b < runs[i].bindings.size (); b++)
+        {
+          if (std::find (params.begin (), params.end (), runs[i].bindings[b].name) == params.end ())
+            {
+              params.push_back (runs[i].bindings[b].name);
+            }
+        }
+      for (size_t m = 0; m < runs[i].metrics.size (); m++)
+        {
+          if (std::find (metrics.begin (), metrics.end (), runs[i].metrics[m].first) == metrics.end ())
+            {
+              metrics.push_back (runs[i].metrics[m].first);
+            }
+        }
+    }
+
+  std::ofstream out (file.c_str ());
+  out << "run\trep\tstatus\tattempts\telapsed";
+  for (size_t p = 0; p < params.size (); p++)
+    {
+      out << "\t" << params[p];
+    }
+  for (size_t m = 0; m < metrics.size (); m++)
+    {
+      out << "\t" << metrics[m];
+    }
+  out << std::endl;
+
+  for (size_t i = 0; i < runs.size (); i++)
+    {
+      const SweepRun &r = runs[i];
+      out << r.id << "\t" << r.rep << "\t" << (r.ok ? "ok" : "failed") << "\t" << r.attempts << "\t" << r.elapsed;
+      for (size_t p = 0; p < params.size (); p++)
+        {
+          std::string v = "NA";
+          for (size_t b = 0; b < r.bindings.size (); b++)
+            {
+              if (r.bindings[b].name == params[p])
+                {
+                  v = r.bindings[b].value;
+                }
+            }
+          out << "\t" << v;
+        }
+      for (size_t m = 0; m < metrics.size (); m++)
+        {
+          out << "\t";
+          bool found = false;
+          for (size_t k = 0; k < r.metrics.size () && !found; k++)
+            {
+              if (r.metrics[k].first == metrics[m])
+                {
+                  out << r.metrics[k].second;
+                  found = true;
+                }
+            }
+          if (!found)
+            {
+              out << "NA";
+            }
+        }
+      out << std::endl;
+    }
+}
+
+} // namespace aqm
+
+#endif // SWEEP_RUNNER_H
@@ -0,0 +1,297 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Reader of the telemetry segments published by ns3::AqmTelemetry.
+ *
+ *   aqm-telemetry list
+ *   aqm-telemetry tail <segment> [--all] [--source=<name>] [--step=<s>] [--out=<prefix>]
+ *   aqm-telemetry clean
+ */
+
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "telemetry-ring.h"
+
+using namespace aqm;
+
+static const char *SHM_DIR = "/dev/shm";
+
+static bool g_stop = false;
+
+static void
+HandleSignal (int)
+{
+  g_stop = true;
+}
+
+static int
+Usage (void)
+{
+  std::cerr << "usage: aqm-telemetry list" << std::endl
+            << "       aqm-telemetry tail <segment> [--all] [--source=<name>] [--step=<s>] [--out=<prefix>]" << std::endl
+            << "       aqm-telemetry clean" << std::endl;
+  return 2;
+}
+
+static bool
+WriterAlive (const TelemetryHeader &h)
+{
+  return kill (h.pid, 0) == 0 || errno == EPERM;
+}
+
+/**
+ * Names of the telemetry segments in /dev/shm
+ */
+static std::vector<std::string>
+FindSegments (void)
+{
+  std::vector<std::string> names;
+  DIR *dir = opendir (SHM_DIR);
+  if (!dir)
+    {
+      return names;
+    }
+  struct dirent *e;
+  while ((e = readdir (dir)) != 0)
+    {
+      std::string name = e->d_name;
+      if (name[0] == '.')
+        {
+          continue;
+        }
+      std::ifstream f ((std::string (SHM_DIR) + "/" + name).c_str (), std::ios::binary);
+      char magic[8];
+      if (f.read (magic, 8) && std::memcmp (magic, TELEMETRY_MAGIC, 8) == 0)
+        {
+          names.push_back (name);
+        }
+    }
+  closedir (dir);
+  return names;
+}
+
+static int
+List (void)
+{
+  std::vector<std::string> names = FindSegments ();
+  std::cout << "segment\tpid\tstate\tintervalMs\trecords\tsources" << std::endl;
+  for (size_t i = 0; i < names.size (); i++)
+    {
+      TelemetryReader reader;
+      std::string error;
+      if (!reader.Attach (names[i], error))
+        {
+          std::cerr << error << std::endl;
+          continue;
+        }
+      const TelemetryHeader &h = reader.GetHeader ();
+      std::cout << names[i] << "\t" << h.pid << "\t"
+                << (reader.IsFinished () ? "finished" : WriterAlive (h) ? "running" : "dead")
+                << "\t" << h.interval / 1e6 << "\t" << reader.GetWritten () << "\t";
+      for (uint32_t s = 0; s < h.nSources; s++)
+        {
+          std::cout << (s ? "," : "") << reader.GetSourceName (s);
+        }
+      std::cout << std::endl;
+    }
+  return 0;
+}
+
+static int
+Clean (void)
+{
+  std::vector<std::string> names = FindSegments ();
+  for (size_t i = 0; i < names.size (); i++)
+    {
+      TelemetryReader reader;
+      std::string error;
+      if (reader.Attach (names[i], error) && !reader.IsFinished () && WriterAlive (reader.GetHeader ()))
+        {
+          continue;
+        }
+      if (shm_unlink (TelemetryObjectName (names[i]).c_str ()) == 0)
+        {
+          std::cout << "removed " << names[i] << std::endl;
+        }
+    }
+  return 0;
+}
+
+/**
+ * Per-source state of the tail: the last printed sample and the files
+ */
+struct TailSource
+{
+  TailSource ()
+    : printed (false)
+  {
+  }
+
+  bool printed;                 //!< last holds a sample
+  TelemetrySample last;         //!< Last printed sample
+  std::ofstream queueFile;      //!< <prefix>-<source>-queue.plotme
+  std::ofstream probFile;       //!< <prefix>-<source>-prob.plotme
+  std::ofstream throughputFile; //!< <prefix>-<source>-throughput.plotme
+};
+
+static int
+Tail (const std::string &segment, bool all, const std::string &only, double step, const std::string &out)
+{
+  TelemetryReader reader;
+  std::string error;
+  if (!reader.Attach (segment, error))
+    {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+  if (all)
+    {
+      reader.SeekStart ();
+    }
+  else
+    {
+      reader.SeekEnd ();
+    }
+  signal (SIGINT, HandleSignal);
+  signal (SIGTERM, HandleSignal);
+
+  std::map<uint32_t, TailSource> sources;
+  uint64_t stepNs = step * 1e9;
+  std::cout << "time\tsource\tqueue\tqueueBytes\tprob\tMbps\tforced\tearly\tmarks" << std::endl;
+  while (!g_stop)
+    {
+      TelemetrySample s;
+      if (!reader.Next (s))
+        {
+          if (reader.IsFinished () || !WriterAlive (reader.GetHeader ()))
+            {
+              break;
+            }
+          struct timespec ts = { 0, 50000000 };
+          nanosleep (&ts, 0);
+          continue;
+        }
+      std::string name = reader.GetSourceName (s.source);
+      if (!only.empty () && name != only)
+        {
+          continue;
+        }
+      TailSource &src = sources[s.source];
+      if (src.printed && s.time < src.last.time + stepNs)
+        {
+          continue;
+        }
+      // Events 1 to 4 of AqmStats: dequeue, forced drop, early drop, mark
+      double mbps = 0;
+      uint64_t delta[5] = { 0, 0, 0, 0, 0 };
+      if (src.printed && s.time > src.last.time)
+        {
+          mbps = (s.bytes[1] - src.last.bytes[1]) * 8e3 / (s.time - src.last.time);
+          for (int e = 0; e < 5; e++)
+            {
+              delta[e] = s.packets[e] - src.last.packets[e];
+            }
+        }
+      double t = s.time * 1e-9;
+      std::cout << t << "\t" << name << "\t" << s.queuePackets << "\t" << s.queueBytes << "\t"
+                << s.prob << "\t" << mbps << "\t" << delta[2] << "\t" << delta[3] << "\t" << delta[4]
+                << std::endl;
+      if (!out.empty ())
+        {
+          if (!src.queueFile.is_open ())
+            {
+              std::string prefix = out + "-" + name;
+              src.queueFile.open ((prefix + "-queue.plotme").c_str ());
+              src.probFile.open ((prefix + "-prob.plotme").c_str ());
+              src.throughputFile.open ((prefix + "-throughput.plotme").c_str ());
+            }
+          src.queueFile << t << " " << s.queuePackets << "\n";
+          src.probFile << t << " " << s.prob << "\n";
+          if (src.printed)
+            {
+              src.throughputFile << t << " " << mbps << "\n";
+            }
+        }
+      src.last = s;
+      src.printed = true;
+    }
+  if (reader.GetLost () > 0)
+    {
+      std::cerr << reader.GetLost () << " records were overwritten before they could be read" << std::endl;
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      return Usage ();
+    }
+  std::string command = argv[1];
+  if (command == "list" && argc == 2)
+    {
+      return List ();
+    }
+  if (command == "clean" && argc == 2)
+    {
+      return Clean ();
+    }
+  if (command != "tail" || argc < 3)
+    {
+      return Usage ();
+    }
+
+  bool all = false;
+  std::string only, out;
+  double step = 0;
+  for (int i = 3; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg == "--all")
+        {
+          all = true;
+        }
+      else if (arg.compare (0, 9, "--source=") == 0)
+        {
+          only = arg.substr (9);
+        }
+      else if (arg.compare (0, 7, "--step=") == 0)
+        {
+          step = std::atof (arg.c_str () + 7);
+        }
+      else if (arg.compare (0, 6, "--out=") == 0)
+        {
+          out = arg.substr (6);
+        }
+      else
+        {
+          return Usage ();
+        }
+    }
+  return Tail (argv[2], all, only, step, out);
+}
@@ -0,0 +1,444 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Live telemetry of a running simulation in a POSIX shared-memory
+ * segment: a header followed by a ring of fixed-size slots.
+ *
+ *   TelemetryHeader    magic "AQMTEL01", layout sizes, writer pid,
+ *                      state, number of records written, source names
+ *   TelemetrySlot[n]   sequence number and one TelemetrySample
+ *
+ * There is one writer. It fills the slot of record i (i % n), then
+ * publishes i + 1 in the slot's sequence number and in the header. A
+ * reader copies a slot and keeps the copy only if the sequence number
+ * was i + 1 both before and after, so a slot overwritten meanwhile is
+ * detected (and counted as lost) instead of read torn. Writing costs a
+ * few stores and no system call; readers never write into the segment.
+ */
+
+#ifndef TELEMETRY_RING_H
+#define TELEMETRY_RING_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace aqm {
+
+static const char TELEMETRY_MAGIC[8] = { 'A', 'Q', 'M', 'T', 'E', 'L', '0', '1' };
+static const uint32_t TELEMETRY_MAX_SOURCES = 16;       //!< Queue discs per segment
+static const uint32_t TELEMETRY_NAME_LEN = 32;          //!< Bytes per source name
+
+/**
+ * \brief Writer state, in the header
+ */
+enum TelemetryState
+{
+  TELEMETRY_RUNNING = 1,        //!< The writer is publishing records
+  TELEMETRY_FINISHED = 2        //!< The writer is done; no more records
+};
+
+/**
+ * \brief One sample of one queue disc
+ *
+ * The event counters are those of ns3::AqmStats (enqueue, dequeue,
+ * forced drop, early drop, mark) and only ever grow; a reader computes
+ * rates from the difference between two samples of the same source.
+ */
+struct TelemetrySample
+{
+  uint64_t time;                //!< Simulation time in nanoseconds
+  uint32_t source;              //!< Index of the queue disc in the header
+  uint32_t queuePackets;        //!< Queue length in packets
+  uint64_t queueBytes;          //!< Queue length in bytes
+  double prob;                  //!< Pmark (BLUE) or drop probability (PI), -1 if none
+  uint64_t packets[5];          //!< Packets per event
+  uint64_t bytes[5];            //!< Bytes per event
+};
+
+/**
+ * \brief A slot of the ring
+ */
+struct TelemetrySlot
+{
+  std::atomic<uint64_t> seq;    //!< Record number plus one, 0 while being written
+  TelemetrySample sample;       //!< The record
+};
+
+/**
+ * \brief The start of the segment
+ */
+struct TelemetryHeader
+{
+  char magic[8];                        //!< TELEMETRY_MAGIC
+  uint32_t headerSize;                  //!< sizeof (TelemetryHeader) of the writer
+  uint32_t slotSize;                    //!< sizeof (TelemetrySlot) of the writer
+  uint64_t capacity;                    //!< Number of slots
+  uint64_t interval;                    //!< Sampling interval in nanoseconds
+  int32_t pid;                          //!< Process id of the writer
+  uint32_t nSources;                    //!< Number of sources named below
+  std::atomic<uint32_t> state;          //!< TelemetryState
+  uint32_t reserved;                    //!< Padding
+  std::atomic<uint64_t> written;        //!< Number of records published
+  char sources[TELEMETRY_MAX_SOURCES][TELEMETRY_NAME_LEN];      //!< Source names
+};
+
+/**
+ * \brief Name of the shared-memory object, with the leading slash
+ */
+inline std::string
+TelemetryObjectName (const std::string &name)
+{
+  return name.empty () || name[0] == '/' ? name : "/" + name;
+}
+
+/**
+ * \brief Writer side of a telemetry segment
+ *
+ * Create, AddSource and Start allocate and map the segment; Publish is
+ * the only call made while the simulation runs.
+ */
+class TelemetryWriter
+{
+public:
+  TelemetryWriter ()
+    : m_header (0),
+      m_slots (0),
+      m_size (0),
+      m_mask (0),
+      m_next (0)
+  {
+  }
+
+  ~TelemetryWriter ()
+  {
+    Close (true);
+  }
+
+  /**
+   * \brief Create (or replace) the segment
+   * \param name Name of the shared-memory object, e.g. "aqm-1234"
+   * \param capacity Minimum number of slots, rounded up to a power of two
+   * \param interval Sampling interval in nanoseconds, for the readers
+   * \returns False with errno set if the segment cannot be created
+   */
+  bool Create (const std::string &name, uint64_t capacity, uint64_t interval)
+  {
+    Close (true);
+    uint64_t n = 1;
+    while (n < capacity)
+      {
+        n <<= 1;
+      }
+    m_name = TelemetryObjectName (name);
+    m_size = sizeof (TelemetryHeader) + n * sizeof (TelemetrySlot);
+    shm_unlink (m_name.c_str ());
+    int fd = shm_open (m_name.c_str (), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+      {
+        return false;
+      }
+    if (ftruncate (fd, m_size) != 0)
+      {
+        close (fd);
+        shm_unlink (m_name.c_str ());
+        return false;
+      }
+    void *p = mmap (0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED)
+      {
+        shm_unlink (m_name.c_str ());
+        return false;
+      }
+    // ftruncate zero-fills, so every slot starts with seq 0 (empty)
+    m_header = static_cast<TelemetryHeader *> (p);
+    m_slots = reinterpret_cast<TelemetrySlot *> (m_header + 1);
+    m_header->headerSize = sizeof (TelemetryHeader);
+    m_header->slotSize = sizeof (TelemetrySlot);
+    m_header->capacity = n;
+    m_header->interval = interval;
+    m_header->pid = getpid ();
+    m_mask = n - 1;
+    m_next = 0;
+    return true;
+  }
+
+  /**
+   * \brief Name the next source
+   * \returns The index of the source, or -1 if there are too many
+   */
+  int AddSource (const std::string &name)
+  {
+    if (!m_header || m_header->nSources == TELEMETRY_MAX_SOURCES)
+      {
+        return -1;
+      }
+    char *dst = m_header->sources[m_header->nSources];
+    std::strncpy (dst, name.c_str (), TELEMETRY_NAME_LEN - 1);
+    return m_header->nSources++;
+  }
+
+  /**
+   * \brief Make the segment visible to readers
+   */
+  void Start (void)
+  {
+    m_header->state.store (TELEMETRY_RUNNING, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+    std::memcpy (m_header->magic, TELEMETRY_MAGIC, sizeof (TELEMETRY_MAGIC));
+  }
+
+  bool IsOpen (void) const
+  {
+    return m_header != 0;
+  }
+
+  /**
+   * \brief Append a record, overwriting the oldest one if the ring is full
+   */
+  void Publish (const TelemetrySample &sample)
+  {
+    TelemetrySlot &slot = m_slots[m_next & m_mask];
+    slot.seq.store (0, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+    slot.sample = sample;
+    m_next++;
+    slot.seq.store (m_next, std::memory_order_release);
+    m_header->written.store (m_next, std::memory_order_release);
+  }
+
+  /**
+   * \brief Mark the segment finished and unmap it
+   * \param unlink Also remove the name; readers that are attached keep
+   * their mapping until they detach
+   */
+  void Close (bool unlink)
+  {
+    if (!m_header)
+      {
+        return;
+      }
+    m_header->state.store (TELEMETRY_FINISHED, std::memory_order_release);
+    munmap (m_header, m_size);
+    if (unlink)
+      {
+        shm_unlink (m_name.c_str ());
+      }
+    m_header = 0;
+    m_slots = 0;
+  }
+
+private:
+  TelemetryWriter (const TelemetryWriter &);
+  TelemetryWriter & operator= (const TelemetryWriter &);
+
+  std::string m_name;           //!< Shared-memory object name
+  TelemetryHeader *m_header;    //!< Mapped header
+  TelemetrySlot *m_slots;       //!< Mapped slots
+  size_t m_size;                //!< Mapped bytes
+  uint64_t m_mask;              //!< Number of slots minus one
+  uint64_t m_next;              //!< Number of records published
+};
+
+/**
+ * \brief Reader side of a telemetry segment
+ */
+class TelemetryReader
+{
+public:
+  TelemetryReader ()
+    : m_header (0),
+      m_slots (0),
+      m_size (0),
+      m_next (0),
+      m_lost (0)
+  {
+  }
+
+  ~TelemetryReader ()
+  {
+    Detach ();
+  }
+
+  /**
+   * \brief Map an existing segment read only
+   * \param error Set to the reason on failure
+   * \returns False if the segment does not exist or is not a telemetry segment
+   */
+  bool Attach (const std::string &name, std::string &error)
+  {
+    Detach ();
+    std::string object = TelemetryObjectName (name);
+    int fd = shm_open (object.c_str (), O_RDONLY, 0);
+    if (fd < 0)
+      {
+        error = object + ": " + std::strerror (errno);
+        return false;
+      }
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (TelemetryHeader))
+      {
+        close (fd);
+        error = object + ": not a telemetry segment";
+        return false;
+      }
+    void *p = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED)
+      {
+        error = object + ": " + std::strerror (errno);
+        return false;
+      }
+    m_header = static_cast<const TelemetryHeader *> (p);
+    m_size = st.st_size;
+    if (std::memcmp (m_header->magic, TELEMETRY_MAGIC, sizeof (TELEMETRY_MAGIC)) != 0
+        || m_header->headerSize != sizeof (TelemetryHeader)
+        || m_header->slotSize != sizeof (TelemetrySlot)
+        || m_size < sizeof (TelemetryHeader) + m_header->capacity * sizeof (TelemetrySlot))
+      {
+        Detach ();
+        error = object + ": not a telemetry segment of this version";
+        return false;
+      }
+    std::atomic_thread_fence (std::memory_order_acquire);
+    m_slots = reinterpret_cast<const TelemetrySlot *> (m_header + 1);
+    m_next = 0;
+    m_lost = 0;
+    return true;
+  }
+
+  void Detach (void)
+  {
+    if (m_header)
+      {
+        munmap (const_cast<TelemetryHeader *> (m_header), m_size);
+      }
+    m_header = 0;
+    m_slots = 0;
+  }
+
+  const TelemetryHeader & GetHeader (void) const
+  {
+    return *m_header;
+  }
+
+  /**
+   * \returns The name of a source, "?" if the index is out of range
+   */
+  std::string GetSourceName (uint32_t source) const
+  {
+    if (source >= m_header->nSources || source >= TELEMETRY_MAX_SOURCES)
+      {
+        return "?";
+      }
+    return std::string (m_header->sources[source],
+                        strnlen (m_header->sources[source], TELEMETRY_NAME_LEN));
+  }
+
+  uint64_t GetWritten (void) const
+  {
+    return m_header->written.load (std::memory_order_acquire);
+  }
+
+  bool IsFinished (void) const
+  {
+    return m_header->state.load (std::memory_order_acquire) == TELEMETRY_FINISHED;
+  }
+
+  /**
+   * \brief Skip to the records published from now on
+   */
+  void SeekEnd (void)
+  {
+    m_next = GetWritten ();
+  }
+
+  /**
+   * \brief Skip to the oldest record still in the ring
+   */
+  void SeekStart (void)
+  {
+    uint64_t written = GetWritten ();
+    m_next = written > m_header->capacity ? written - m_header->capacity : 0;
+  }
+
+  /**
+   * \brief Copy the next record
+   *
+   * Records overwritten before they could be read are skipped and
+   * counted in GetLost.
+   *
+   * \returns False if there is no new record yet
+   */
+  bool Next (TelemetrySample &sample)
+  {
+    while (true)
+      {
+        uint64_t written = GetWritten ();
+        if (m_next >= written)
+          {
+            return false;
+          }
+        if (written - m_next > m_header->capacity)
+          {
+            m_lost += written - m_header->capacity - m_next;
+            m_next = written - m_header->capacity;
+          }
+        const TelemetrySlot &slot = m_slots[m_next % m_header->capacity];
+        uint64_t before = slot.seq.load (std::memory_order_acquire);
+        sample = slot.sample;
+        std::atomic_thread_fence (std::memory_order_acquire);
+        uint64_t after = slot.seq.load (std::memory_order_relaxed);
+        if (before == m_next + 1 && after == before)
+          {
+            m_next++;
+            return true;
+          }
+        // overwritten meanwhile: the writer has lapped us
+        m_lost++;
+        m_next++;
+      }
+  }
+
+  uint64_t GetLost (void) const
+  {
+    return m_lost;
+  }
+
+private:
+  TelemetryReader (const TelemetryReader &);
+  TelemetryReader & operator= (const TelemetryReader &);
+
+  const TelemetryHeader *m_header;      //!< Mapped header
+  const TelemetrySlot *m_slots;         //!< Mapped slots
+  size_t m_size;                        //!< Mapped bytes
+  uint64_t m_next;                      //!< Next record to read
+  uint64_t m_lost;                      //!< Records overwritten before being read
+};
+
+} // namespace aqm
+
+#endif // TELEMETRY_RING_H
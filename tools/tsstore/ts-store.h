@@ -0,0 +1,724 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Columnar, compressed store for sampled series (queue length, Pmark,
+ * drop probability, throughput) of many runs in one file.
+ *
+ * File layout:
+ *
+ *   "AQMTS\0\0\1"                              magic and version
+ *   series block *                             one per (run, series)
+ *   index                                      see TsSeriesInfo
+ *   u64 index offset, "AQMTSIDX"               footer
+ *
+ * A series block holds the varint length of the time column, the time
+ * column and the value column. Times are nanoseconds, stored as the first
+ * time, the first delta and then zigzag varint delta-of-deltas, so a
+ * fixed sampling period costs one byte per sample. Values are doubles
+ * compressed with the XOR scheme of Gorilla (Pelkonen et al., VLDB 2015):
+ * a repeated value costs one bit and a slowly changing one a few bits.
+ *
+ * Header only and independent of ns-3, so that ns-3 programs can write
+ * a store directly and the command line tool can read it.
+ */
+
+#ifndef TS_STORE_H
+#define TS_STORE_H
+
+#include <stdint.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace aqm {
+
+/**
+ * \brief A sample of a series
+ */
+struct TsPoint
+{
+  double time;                  //!< Time in seconds
+  double value;                 //!< Sampled value
+};
+
+/**
+ * \brief Index entry of a series
+ */
+struct TsSeriesInfo
+{
+  uint32_t run;                 //!< Run the series belongs to
+  std::string name;             //!< Series name, e.g. "queue" or "pmark"
+  uint64_t nPoints;             //!< Number of samples
+  uint64_t offset;              //!< File offset of the series block
+  uint64_t size;                //!< Size of the series block in bytes
+  double firstTime;             //!< Time of the first sample in seconds
+  double lastTime;              //!< Time of the last sample in seconds
+};
+
+static const char TS_MAGIC[8] = { 'A', 'Q', 'M', 'T', 'S', 0, 0, 1 };
+static const char TS_INDEX_MAGIC[8] = { 'A', 'Q', 'M', 'T', 'S', 'I', 'D', 'X' };
+
+/**
+ * \brief Append-only bit stream, most significant bit first
+ */
+class TsBitWriter
+{
+public:
+  TsBitWriter () : m_nBits (0)
+  {
+  }
+
+  void Write (uint64_t bits, uint32_t n)
+  {
+    for (int32_t i = n - 1; i >= 0; i--)
+      {
+        if (m_nBits % 8 == 0)
+          {
+            m_bytes.push_back (0);
+          }
+        if ((bits >> i) & 1)
+          {
+            m_bytes.back () |= (uint8_t)(0x80 >> (m_nBits % 8));
+          }
+        m_nBits++;
+      }
+  }
+
+  const std::vector<uint8_t> & GetBytes (void) const
+  {
+    return m_bytes;
+  }
+
+private:
+  std::vector<uint8_t> m_bytes;
+  uint64_t m_nBits;
+};
+
+/**
+ * \brief Reader of a TsBitWriter stream
+ */
+class TsBitReader
+{
+public:
+  TsBitReader (const uint8_t *data, uint64_t size) : m_data (data), m_size (size), m_pos (0)
+  {
+  }
+
+  uint64_t Read (uint32_t n)
+  {
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < n; i++)
+      {
+        if (m_pos >= m_size * 8)
+          {
+            throw std::runtime_error ("truncated value column");
+          }
+        bits = (bits << 1) | ((m_data[m_pos / 8] >> (7 - m_pos % 8)) & 1);
+        m_pos++;
+      }
+    return bits;
+  }
+
+private:
+  const uint8_t *m_data;
+  uint64_t m_size;
+  uint64_t m_pos;
+};
+
+inline void
+TsPutVarint (std::vector<uint8_t> &out, uint64_t v)
+{
+  while (v >= 0x80)
+    {
+      out.push_back ((uint8_t)(v | 0x80));
+      v >>= 7;
+    }
+  out.push_back ((uint8_t) v);
+}
+
+inline uint64_t
+TsGetVarint (const uint8_t *data, uint64_t size, uint64_t &pos)
+{
+  uint64_t v = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+      if (pos >= size)
+        {
+          throw std::runtime_error ("truncated varint");
+        }
+      uint8_t b = data[pos++];
+      v |= (uint64_t)(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        {
+          return v;
+        }
+    }
+  throw std::runtime_error ("malformed varint");
+}
+
+inline uint64_t
+TsZigzag (int64_t v)
+{
+  return ((uint64_t) v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t
+TsUnzigzag (uint64_t v)
+{
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+inline uint64_t
+TsDoubleBits (double d)
+{
+  uint64_t u;
+  std::memcpy (&u, &d, 8);
+  return u;
+}
+
+inline double
+TsBitsDouble (uint64_t u)
+{
+  double d;
+  std::memcpy (&d, &u, 8);
+  return d;
+}
+
+inline uint32_t
+TsLeadingZeros (uint64_t v)
+{
+  uint32_t n = 0;
+  for (uint64_t mask = 1ULL << 63; mask && !(v & mask); mask >>= 1)
+    {
+      n++;
+    }
+  return n;
+}
+
+inline uint32_t
+TsTrailingZeros (uint64_t v)
+{
+  uint32_t n = 0;
+  for (uint64_t mask = 1; mask && !(v & mask); mask <<= 1)
+    {
+      n++;
+    }
+  return n;
+}
+
+/**
+ * \brief Encode a series into a block
+ * \param points The samples, in increasing time order
+ * \returns The block
+ */
+inline std::vector<uint8_t>
+TsEncode (const std::vector<TsPoint> &points)
+{
+  std::vector<uint8_t> times;
+  int64_t prevTime = 0;
+  int64_t prevDelta = 0;
+  for (size_t i = 0; i < points.size (); i++)
+    {
+      int64_t t = (int64_t) llround (points[i].time * 1e9);
+      int64_t delta = t - prevTime;
+      if (i == 0)
+        {
+          TsPutVarint (times, TsZigzag (t));
+        }
+      else if (i == 1)
+        {
+          TsPutVarint (times, TsZigzag (delta));
+        }
+      else
+        {
+          TsPutVarint (times, TsZigzag (delta - prevDelta));
+        }
+      prevDelta = delta;
+      prevTime = t;
+    }
+
+  TsBitWriter values;
+  uint64_t prev = 0;
+  uint32_t prevLeading = 65;
+  uint32_t prevTrailing = 0;
+  for (size_t i = 0; i < points.size (); i++)
+    {
+      uint64_t bits = TsDoubleBits (points[i].value);
+      if (i == 0)
+        {
+          values.Write (bits, 64);
+          prev = bits;
+          continue;
+        }
+      uint64_t x = bits ^ prev;
+      prev = bits;
+      if (x == 0)
+        {
+          values.Write (0, 1);
+          continue;
+        }
+      values.Write (1, 1);
+      uint32_t leading = TsLeadingZeros (x);
+      uint32_t trailing = TsTrailingZeros (x);
+      if (leading > 31)
+        {
+          leading = 31;
+        }
+      if (prevLeading <= 64 && leading >= prevLeading && trailing >= prevTrailing)
+        {
+          // The meaningful bits fit in the window of the previous value
+          values.Write (0, 1);
+          values.Write (x >> prevTrailing, 64 - prevLeading - prevTrailing);
+        }
+      else
+        {
+          uint32_t length = 64 - leading - trailing;
+          values.Write (1, 1);
+          values.Write (leading, 5);
+          values.Write (length & 63, 6);   // 64 is stored as 0
+          values.Write (x >> trailing, length);
+          prevLeading = leading;
+          prevTrailing = trailing;
+        }
+    }
+
+  std::vector<uint8_t> block;
+  TsPutVarint (block, times.size ());
+  block.insert (block.end (), times.begin (), times.end ());
+  block.insert (block.end (), values.GetBytes ().begin (), values.GetBytes ().end ());
+  return block;
+}
+
+/**
+ * \brief Decode a block
+ * \param data The block
+ * \param size The size of the block
+ * \param nPoints The number of samples in the block
+ * \returns The samples
+ */
+inline std::vector<TsPoint>
+TsDecode (const uint8_t *data, uint64_t size, uint64_t nPoints)
+{
+  std::vector<TsPoint> points (nPoints);
+
+  uint64_t pos = 0;
+  uint64_t timesSize = TsGetVarint (data, size, pos);
+  uint64_t timesEnd = pos + timesSize;
+  if (timesEnd > size)
+    {
+      throw std::runtime_error ("truncated time column");
+    }
+  int64_t t = 0;
+  int64_t delta = 0;
+  for (uint64_t i = 0; i < nPoints; i++)
+    {
+      int64_t v = TsUnzigzag (TsGetVarint (data, timesEnd, pos));
+      if (i == 0)
+        {
+          t = v;
+        }
+      else if (i == 1)
+        {
+          delta = v;
+          t += delta;
+        }
+      else
+        {
+          delta += v;
+          t += delta;
+        }
+      points[i].time = t / 1e9;
+    }
+
+  TsBitReader values (data + timesEnd, size - timesEnd);
+  uint64_t prev = 0;
+  uint32_t leading = 0;
+  uint32_t trailing = 0;
+  for (uint64_t i = 0; i < nPoints; i++)
+    {
+      if (i == 0)
+        {
+          prev = values.Read (64);
+        }
+      else if (values.Read (1))
+        {
+          if (values.Read (1))
+            {
+              leading = values.Read (5);
+              uint32_t length = values.Read (6);
+              if (length == 0)
+                {
+                  length = 64;
+                }
+              trailing = 64 - leading - length;
+            }
+          uint64_t x = values.Read (64 - leading - trailing);
+          prev ^= x << trailing;
+        }
+      points[i].value = TsBitsDouble (prev);
+    }
+  return points;
+}
+
+/**
+ * \brief Writes series of many runs into one store file
+ *
+ * Samples are buffered per series and encoded when the series is ended,
+ * so any number of series can be open at the same time.
+ */
+class TsWriter
+{
+public:
+  TsWriter () : m_file (0), m_offset (0)
+  {
+  }
+
+  ~TsWriter ()
+  {
+    Close ();
+  }
+
+  /**
+   * \brief Create the store, replacing an existing file
+   * \param path The file name
+   */
+  void Open (const std::string &path)
+  {
+    m_file = std::fopen (path.c_str (), "wb");
+    if (m_file == 0)
+      {
+        throw std::runtime_error ("cannot create " + path);
+      }
+    WriteBytes (TS_MAGIC, 8);
+  }
+
+  bool IsOpen (void) const
+  {
+    return m_file != 0;
+  }
+
+  /**
+   * \brief Start a series
+   * \param run The run of the series
+   * \param name The name of the series
+   * \returns The handle used by Append and EndSeries
+   */
+  uint32_t BeginSeries (uint32_t run, const std::string &name)
+  {
+    Pending p;
+    p.run = run;
+    p.name = name;
+    p.open = true;
+    m_pending.push_back (p);
+    return m_pending.size () - 1;
+  }
+
+  /**
+   * \brief Add a sample to a series
+   * \param series The handle returned by BeginSeries
+   * \param time The time in seconds
+   * \param value The value
+   */
+  void Append (uint32_t series, double time, double value)
+  {
+    TsPoint p;
+    p.time = time;
+    p.value = value;
+    m_pending[series].points.push_back (p);
+  }
+
+  /**
+   * \brief Encode a series and write it to the file
+   * \param series The handle returned by BeginSeries
+   */
+  void EndSeries (uint32_t series)
+  {
+    Pending &p = m_pending[series];
+    if (!p.open)
+      {
+        return;
+      }
+    WriteSeries (p.run, p.name, p.points);
+    p.open = false;
+    std::vector<TsPoint> ().swap (p.points);
+  }
+
+  /**
+   * \brief Write a whole series
+   * \param run The run of the series
+   * \param name The name of the series
+   * \param points The samples, in increasing time order
+   */
+  void WriteSeries (uint32_t run, const std::string &name, const std::vector<TsPoint> &points)
+  {
+    std::vector<uint8_t> block = TsEncode (points);
+    TsSeriesInfo info;
+    info.run = run;
+    info.name = name;
+    info.nPoints = points.size ();
+    info.offset = m_offset;
+    info.size = block.size ();
+    info.firstTime = points.empty () ? 0 : points.front ().time;
+    info.lastTime = points.empty () ? 0 : points.back ().time;
+    WriteBlock (info, block.empty () ? 0 : &block[0]);
+  }
+
+  /**
+   * \brief Write an already encoded block, e.g. when merging stores
+   * \param info The index entry; its offset is replaced
+   * \param block The encoded block of info.size bytes
+   */
+  void WriteBlock (TsSeriesInfo info, const uint8_t *block)
+  {
+    info.offset = m_offset;
+    WriteBytes (block, info.size);
+    m_index.push_back (info);
+  }
+
+  /**
+   * \brief End the open series, write the index and close the file
+   */
+  void Close (void)
+  {
+    if (m_file == 0)
+      {
+        return;
+      }
+    for (uint32_t i = 0; i < m_pending.size (); i++)
+      {
+        EndSeries (i);
+      }
+
+    uint64_t indexOffset = m_offset;
+    std::vector<uint8_t> index;
+    TsPutVarint (index, m_index.size ());
+    for (size_t i = 0; i < m_index.size (); i++)
+      {
+        const TsSeriesInfo &s = m_index[i];
+        TsPutVarint (index, s.run);
+        TsPutVarint (index, s.name.size ());
+        index.insert (index.end (), s.name.begin (), s.name.end ());
+        TsPutVarint (index, s.nPoints);
+        TsPutVarint (index, s.offset);
+        TsPutVarint (index, s.size);
+        PutFixed (index, TsDoubleBits (s.firstTime));
+        PutFixed (index, TsDoubleBits (s.lastTime));
+      }
+    PutFixed (index, indexOffset);
+    index.insert (index.end (), TS_INDEX_MAGIC, TS_INDEX_MAGIC + 8);
+    WriteBytes (&index[0], index.size ());
+
+    std::fclose (m_file);
+    m_file = 0;
+    m_pending.clear ();
+    m_index.clear ();
+  }
+
+private:
+  struct Pending
+  {
+    uint32_t run;
+    std::string name;
+    std::vector<TsPoint> points;
+    bool open;
+  };
+
+  static void PutFixed (std::vector<uint8_t> &out, uint64_t v)
+  {
+    for (uint32_t i = 0; i < 8; i++)
+      {
+        out.push_back ((uint8_t)(v >> (8 * i)));
+      }
+  }
+
+  void WriteBytes (const void *data, uint64_t size)
+  {
+    if (size > 0 && std::fwrite (data, 1, size, m_file) != size)
+      {
+        throw std::runtime_error ("write failed");
+      }
+    m_offset += size;
+  }
+
+  std::FILE *m_file;
+  uint64_t m_offset;
+  std::vector<Pending> m_pending;
+  std::vector<TsSeriesInfo> m_index;
+};
+
+/**
+ * \brief Reads a store written by TsWriter
+ */
+class TsReader
+{
+public:
+  TsReader () : m_file (0)
+  {
+  }
+
+  ~TsReader ()
+  {
+    if (m_file != 0)
+      {
+        std::fclose (m_file);
+      }
+  }
+
+  /**
+   * \brief Open a store and load its index
+   * \param path The file name
+   */
+  void Open (const std::string &path)
+  {
+    m_file = std::fopen (path.c_str (), "rb");
+    if (m_file == 0)
+      {
+        throw std::runtime_error ("cannot open " + path);
+      }
+    char magic[8];
+    if (std::fread (magic, 1, 8, m_file) != 8 || std::memcmp (magic, TS_MAGIC, 8) != 0)
+      {
+        throw std::runtime_error (path + " is not a time-series store");
+      }
+
+    std::fseek (m_file, 0, SEEK_END);
+    long end = std::ftell (m_file);
+    if (end < 24)
+      {
+        throw std::runtime_error (path + " has no index");
+      }
+    uint8_t footer[16];
+    ReadAt (end - 16, footer, 16);
+    if (std::memcmp (footer + 8, TS_INDEX_MAGIC, 8) != 0)
+      {
+        throw std::runtime_error (path + " has no index (was the writer closed?)");
+      }
+    uint64_t indexOffset = GetFixed (footer);
+    uint64_t indexSize = end - 16 - indexOffset;
+    std::vector<uint8_t> index (indexSize + 1);
+    ReadAt (indexOffset, &index[0], indexSize);
+
+    uint64_t pos = 0;
+    uint64_t n = TsGetVarint (&index[0], indexSize, pos);
+    for (uint64_t i = 0; i < n; i++)
+      {
+        TsSeriesInfo s;
+        s.run = TsGetVarint (&index[0], indexSize, pos);
+        uint64_t len = TsGetVarint (&index[0], indexSize, pos);
+        if (pos + len + 16 > indexSize)
+          {
+            throw std::runtime_error ("truncated index");
+          }
+        s.name.assign ((const char *) &index[pos], len);
+        pos += len;
+        s.nPoints = TsGetVarint (&index[0], indexSize, pos);
+        s.offset = TsGetVarint (&index[0], indexSize, pos);
+        s.size = TsGetVarint (&index[0], indexSize, pos);
+        if (pos + 16 > indexSize)
+          {
+            throw std::runtime_error ("truncated index");
+          }
+        s.firstTime = TsBitsDouble (GetFixed (&index[pos]));
+        s.lastTime = TsBitsDouble (GetFixed (&index[pos + 8]));
+        pos += 16;
+        m_index.push_back (s);
+      }
+  }
+
+  /**
+   * \returns The index entries of all the series
+   */
+  const std::vector<TsSeriesInfo> & GetSeries (void) const
+  {
+    return m_index;
+  }
+
+  /**
+   * \brief Find a series
+   * \param run The run
+   * \param name The series name
+   * \returns The position in GetSeries, or -1
+   */
+  int64_t Find (uint32_t run, const std::string &name) const
+  {
+    for (size_t i = 0; i < m_index.size (); i++)
+      {
+        if (m_index[i].run == run && m_index[i].name == name)
+          {
+            return i;
+          }
+      }
+    return -1;
+  }
+
+  /**
+   * \brief Read the encoded block of a series
+   * \param i The position in GetSeries
+   * \returns The block
+   */
+  std::vector<uint8_t> ReadBlock (size_t i)
+  {
+    const TsSeriesInfo &s = m_index.at (i);
+    std::vector<uint8_t> block (s.size + 1);
+    ReadAt (s.offset, &block[0], s.size);
+    block.resize (s.size);
+    return block;
+  }
+
+  /**
+   * \brief Read and decode a series
+   * \param i The position in GetSeries
+   * \returns The samples
+   */
+  std::vector<TsPoint> Read (size_t i)
+  {
+    std::vector<uint8_t> block = ReadBlock (i);
+    return TsDecode (block.empty () ? 0 : &block[0], block.size (), m_index[i].nPoints);
+  }
+
+private:
+  static uint64_t GetFixed (const uint8_t *p)
+  {
+    uint64_t v = 0;
+    for (uint32_t i = 0; i < 8; i++)
+      {
+        v |= (uint64_t) p[i] << (8 * i);
+      }
+    return v;
+  }
+
+  void ReadAt (uint64_t offset, void *data, uint64_t size)
+  {
+    if (std::fseek (m_file, offset, SEEK_SET) != 0
+        || (size > 0 && std::fread (data, 1, size, m_file) != size))
+      {
+        throw std::runtime_error ("read failed");
+      }
+  }
+
+  std::FILE *m_file;
+  std::vector<TsSeriesInfo> m_index;
+};
+
+} // namespace aqm
+
+#endif // TS_STORE_H
@@ -0,0 +1,173 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Command line tool for the time-series store:
+ *
+ *   tsstore list <store>
+ *   tsstore csv <store> [run [series]]
+ *   tsstore import <store> <run> <series> <file.plotme> [<run> <series> <file.plotme> ...]
+ *   tsstore merge <store> <input store> [<input store> ...]
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "ts-store.h"
+
+using namespace aqm;
+
+static int
+Usage (void)
+{
+  std::cerr << "usage: tsstore list <store>" << std::endl
+            << "       tsstore csv <store> [run [series]]" << std::endl
+            << "       tsstore import <store> <run> <series> <file.plotme> [...]" << std::endl
+            << "       tsstore merge <store> <input store> [...]" << std::endl;
+  return 2;
+}
+
+static int
+List (const std::string &path)
+{
+  TsReader reader;
+  reader.Open (path);
+  const std::vector<TsSeriesInfo> &series = reader.GetSeries ();
+  std::cout << "run\tseries\tpoints\tbytes\tfirst\tlast" << std::endl;
+  for (size_t i = 0; i < series.size (); i++)
+    {
+      const TsSeriesInfo &s = series[i];
+      std::cout << s.run << "\t" << s.name << "\t" << s.nPoints << "\t" << s.size
+                << "\t" << s.firstTime << "\t" << s.lastTime << std::endl;
+    }
+  return 0;
+}
+
+static int
+Csv (const std::string &path, int64_t run, const std::string &name)
+{
+  TsReader reader;
+  reader.Open (path);
+  const std::vector<TsSeriesInfo> &series = reader.GetSeries ();
+  std::cout.precision (9);
+  std::cout << "run,series,time,value" << std::endl;
+  for (size_t i = 0; i < series.size (); i++)
+    {
+      if ((run >= 0 && series[i].run != run) || (!name.empty () && series[i].name != name))
+        {
+          continue;
+        }
+      std::vector<TsPoint> points = reader.Read (i);
+      for (size_t j = 0; j < points.size (); j++)
+        {
+          std::cout << series[i].run << "," << series[i].name << ","
+                    << points[j].time << "," << points[j].value << "\n";
+        }
+    }
+  return 0;
+}
+
+static int
+Import (const std::string &path, int argc, char *argv[])
+{
+  if (argc % 3 != 0)
+    {
+      return Usage ();
+    }
+  TsWriter writer;
+  writer.Open (path);
+  for (int i = 0; i < argc; i += 3)
+    {
+      uint32_t run = std::strtoul (argv[i], 0, 10);
+      std::ifstream in (argv[i + 2]);
+      if (!in)
+        {
+          std::cerr << "cannot open " << argv[i + 2] << std::endl;
+          return 1;
+        }
+      // .plotme files hold "time value" lines
+      std::vector<TsPoint> points;
+      TsPoint p;
+      while (in >> p.time >> p.value)
+        {
+          points.push_back (p);
+        }
+      writer.WriteSeries (run, argv[i + 1], points);
+    }
+  writer.Close ();
+  return 0;
+}
+
+static int
+Merge (const std::string &path, int argc, char *argv[])
+{
+  TsWriter writer;
+  writer.Open (path);
+  for (int i = 0; i < argc; i++)
+    {
+      TsReader reader;
+      reader.Open (argv[i]);
+      const std::vector<TsSeriesInfo> &series = reader.GetSeries ();
+      for (size_t j = 0; j < series.size (); j++)
+        {
+          // Blocks are copied without decoding them
+          std::vector<uint8_t> block = reader.ReadBlock (j);
+          writer.WriteBlock (series[j], block.empty () ? 0 : &block[0]);
+        }
+    }
+  writer.Close ();
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 3)
+    {
+      return Usage ();
+    }
+  std::string cmd = argv[1];
+  try
+    {
+      if (cmd == "list")
+        {
+          return List (argv[2]);
+        }
+      else if (cmd == "csv")
+        {
+          int64_t run = argc > 3 ? std::strtol (argv[3], 0, 10) : -1;
+          std::string name = argc > 4 ? argv[4] : "";
+          return Csv (argv[2], run, name);
+        }
+      else if (cmd == "import")
+        {
+          return Import (argv[2], argc - 3, argv + 3);
+        }
+      else if (cmd == "merge")
+        {
+          return Merge (argv[2], argc - 3, argv + 3);
+        }
+    }
+  catch (std::exception &e)
+    {
+      std::cerr << "tsstore: " << e.what () << std::endl;
+      return 1;
+    }
+  return Usage ();
+}
@@ -0,0 +1,903 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Emulated PI or BLUE bottleneck between two TUN devices, for real
+ * kernel TCP stacks on one machine (Linux only).
+ *
+ * Packets the kernel sends out of the first TUN device are read by the
+ * ingress thread, which runs the drop decision and the controller and
+ * puts the accepted packets in a lock-free ring. The egress thread takes
+ * them out at the link rate and writes them into the second TUN device.
+ * Packets in the other direction (the ACKs) are passed straight through
+ * by the ingress thread. The main thread prints the queue and drop
+ * statistics once per interval.
+ *
+ * The devices offload TCP segmentation (IFF_VNET_HDR), so one read or
+ * write carries a whole GSO packet of up to 64 KB. The queue still
+ * counts, limits and drops the segments the link would carry: a GSO
+ * packet of which some segments are dropped is split into the runs of
+ * segments that are kept, as the kernel would segment it.
+ *
+ *   aqm-tunemu [--tunA=aqm0] [--tunB=aqm1] [--aqm=pi|blue] [--bandwidth=<Mbps>]
+ *              [--QueueLimit=<packets>] [--gso=0|1] [--A=...] [--Increment=...] ...
+ *
+ * See README.md for putting the two devices into network namespaces.
+ */
+
+#include <fcntl.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../aqm-core/aqm-core.h"
+#include "spsc-ring.h"
+
+using namespace aqm;
+
+/**
+ * The header in front of every packet of a device with IFF_VNET_HDR, as
+ * struct virtio_net_hdr of linux/virtio_net.h, which does not compile
+ * as C++; host byte order
+ */
+struct VnetHeader
+{
+  uint8_t flags;
+  uint8_t gsoType;
+  uint16_t hdrLen;              //!< Header bytes in front of the payload
+  uint16_t gsoSize;             //!< Payload bytes per segment
+  uint16_t csumStart;
+  uint16_t csumOffset;
+};
+
+static const uint8_t VNET_F_NEEDS_CSUM = 1;
+static const uint8_t VNET_GSO_NONE = 0;
+static const uint8_t VNET_GSO_ECN = 0x80;
+
+static const uint32_t MAX_SEGMENT = 9216;       //!< Largest packet, for a 9000 byte MTU
+static const uint32_t VNET_HDR = sizeof (VnetHeader);
+static const uint32_t MAX_PACKET = 65536 + VNET_HDR;    //!< Largest GSO packet and its header
+
+/**
+ * A queued packet; the packet itself is read in place into the arena
+ */
+struct PacketSlot
+{
+  uint64_t arrival;             //!< Arrival time in nanoseconds
+  uint64_t pos;                 //!< Position in the arena
+  uint32_t len;                 //!< Length in bytes, with the virtio header if any
+  uint32_t segments;            //!< Packets on the link
+  uint32_t wireBytes;           //!< Bytes on the link, the headers of every segment included
+};
+
+/**
+ * Where the headers of a packet read from a device are, and how many
+ * packets on the link it stands for
+ */
+struct PacketLayout
+{
+  uint32_t ipLen;               //!< IP header length, 0 if not TCP
+  uint32_t hdrLen;              //!< IP and TCP header length
+  uint32_t mss;                 //!< Payload bytes per segment
+  uint32_t segments;            //!< Packets on the link
+  uint32_t wireBytes;           //!< Bytes on the link
+  bool splittable;              //!< A TCP GSO packet with the checksum offloaded
+};
+
+/**
+ * Emulator parameters; controller parameters use the attribute names
+ */
+struct EmuConfig
+{
+  EmuConfig ()
+    : tunA ("aqm0"),
+      tunB ("aqm1"),
+      aqm ("pi"),
+      bandwidth (10e6),
+      queueLimit (200),
+      gso (true),
+      interval (1.0),
+      duration (0),
+      out ("")
+  {
+  }
+
+  std::string tunA;             //!< Device whose packets are queued
+  std::string tunB;             //!< Device the queued packets are written to
+  std::string aqm;              //!< "pi" or "blue"
+  double bandwidth;             //!< Link rate in bit/s
+  uint32_t queueLimit;          //!< Queue limit in packets
+  bool gso;                     //!< Read and write GSO packets
+  double interval;              //!< Statistics interval in seconds
+  double duration;              //!< Seconds to run, 0 until interrupted
+  std::string out;              //!< Prefix of the .plotme files, empty for none
+  PiParams pi;                  //!< PiQueueDisc parameters
+  BlueParams blue;              //!< BlueQueueDisc parameters
+};
+
+/**
+ * Counters, each written by one thread only
+ */
+struct EmuCounters
+{
+  EmuCounters ()
+    : inPackets (0), inBytes (0), forcedDrops (0), earlyDrops (0), queuedPackets (0), queuedBytes (0),
+      outPackets (0), outBytes (0), sojournNs (0), lastSojournNs (0), idleSince (0), prob (0)
+  {
+  }
+
+  // Ingress thread; packets and bytes are the segments on the link
+  std::atomic<uint64_t> inPackets;
+  std::atomic<uint64_t> inBytes;
+  std::atomic<uint64_t> forcedDrops;
+  std::atomic<uint64_t> earlyDrops;
+  std::atomic<uint64_t> queuedPackets;  //!< Packets committed to the ring
+  std::atomic<uint64_t> queuedBytes;    //!< Bytes committed to the ring
+  // Egress thread
+  alignas (64) std::atomic<uint64_t> outPackets;
+  std::atomic<uint64_t> outBytes;
+  std::atomic<uint64_t> sojournNs;      //!< Sum over the packets sent
+  std::atomic<uint64_t> lastSojournNs;  //!< Sojourn time of the last packet sent
+  std::atomic<uint64_t> idleSince;      //!< Time the queue last went empty, seen by the egress thread
+  // Ingress thread
+  alignas (64) std::atomic<double> prob;
+};
+
+static std::atomic<bool> g_stop (false);
+
+static void
+HandleSignal (int)
+{
+  g_stop.store (true);
+}
+
+static uint64_t
+NowNs (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Add to a counter only this thread writes
+ */
+static inline void
+Bump (std::atomic<uint64_t> &counter, uint64_t v)
+{
+  counter.store (counter.load (std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+static int
+OpenTun (std::string &name, bool gso)
+{
+  int fd = open ("/dev/net/tun", O_RDWR | O_NONBLOCK);
+  if (fd < 0)
+    {
+      return -1;
+    }
+  struct ifreq ifr;
+  std::memset (&ifr, 0, sizeof (ifr));
+  ifr.ifr_flags = IFF_TUN | IFF_NO_PI | (gso ? IFF_VNET_HDR : 0);
+  std::strncpy (ifr.ifr_name, name.c_str (), IFNAMSIZ - 1);
+  // TCP hands the device whole TSO packets, and takes them in as well
+  unsigned offload = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+  if (ioctl (fd, TUNSETIFF, &ifr) < 0 || (gso && ioctl (fd, TUNSETOFFLOAD, offload) < 0))
+    {
+      close (fd);
+      return -1;
+    }
+  name = ifr.ifr_name;
+  return fd;
+}
+
+static inline uint32_t
+Get16 (const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static inline void
+Put16 (uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+/**
+ * Find the headers of a packet and the segments it stands for
+ * \param buf The IP packet
+ * \param len Bytes in buf
+ * \param h The virtio header, 0 without one
+ */
+static PacketLayout
+ParsePacket (const uint8_t *buf, uint32_t len, const VnetHeader *h)
+{
+  PacketLayout l;
+  l.ipLen = 0;
+  l.hdrLen = 0;
+  l.mss = 0;
+  l.segments = 1;
+  l.wireBytes = len;
+  l.splittable = false;
+  if (!h || (h->gsoType & ~VNET_GSO_ECN) == VNET_GSO_NONE || h->gsoSize == 0)
+    {
+      return l;
+    }
+  if (len >= 20 && (buf[0] >> 4) == 4 && buf[9] == 6)
+    {
+      l.ipLen = (buf[0] & 0x0f) * 4;
+    }
+  else if (len >= 40 && (buf[0] >> 4) == 6 && buf[6] == 6)
+    {
+      l.ipLen = 40;
+    }
+  if (l.ipLen != 0 && len >= l.ipLen + 20)
+    {
+      l.hdrLen = l.ipLen + (buf[l.ipLen + 12] >> 4) * 4;
+      l.splittable = (h->flags & VNET_F_NEEDS_CSUM) != 0;
+    }
+  else
+    {
+      // Not TCP over IPv4 or IPv6 without extension headers: count the
+      // segments from the header lengths of the virtio header
+      l.ipLen = 0;
+      l.hdrLen = h->hdrLen < len ? h->hdrLen : 0;
+    }
+  if (l.hdrLen >= len)
+    {
+      l.ipLen = 0;
+      l.hdrLen = 0;
+      l.splittable = false;
+      return l;
+    }
+  l.mss = h->gsoSize;
+  uint32_t payload = len - l.hdrLen;
+  l.segments = (payload + l.mss - 1) / l.mss;
+  l.wireBytes = payload + l.segments * l.hdrLen;
+  return l;
+}
+
+/**
+ * Write segments [first, first + count) of a TCP GSO packet as a packet
+ * of its own, fixing up the headers as the kernel's segmentation would:
+ * the sequence number, the lengths, the IPv4 id and header checksum,
+ * the flags that only the first or last segment carries, and the
+ * pseudo-header sum that the checksum offload completes.
+ * \param src The virtio header and the GSO packet
+ * \param len Bytes in src
+ * \param l Layout of the packet
+ * \param dst Where to write the packet, VNET_HDR + l.hdrLen + count * l.mss bytes at most
+ * \param slot Descriptor whose length, segments and bytes on the link are set
+ */
+static void
+CopySegments (const uint8_t *src, uint32_t len, const PacketLayout &l,
+              uint32_t first, uint32_t count, uint8_t *dst, PacketSlot *slot)
+{
+  const uint8_t *pkt = src + VNET_HDR;
+  uint32_t offset = first * l.mss;
+  uint32_t payload = len - VNET_HDR - l.hdrLen - offset;
+  payload = payload < count * l.mss ? payload : count * l.mss;
+
+  std::memcpy (dst, src, VNET_HDR + l.hdrLen);
+  std::memcpy (dst + VNET_HDR + l.hdrLen, pkt + l.hdrLen + offset, payload);
+  slot->len = VNET_HDR + l.hdrLen + payload;
+  slot->segments = count;
+  slot->wireBytes = payload + count * l.hdrLen;
+
+  VnetHeader *h = (VnetHeader *) dst;
+  if (count == 1)
+    {
+      h->gsoType = VNET_GSO_NONE;
+      h->gsoSize = 0;
+    }
+  uint8_t *ip = dst + VNET_HDR;
+  uint8_t *tcp = ip + l.ipLen;
+  uint32_t tcpLen = l.hdrLen - l.ipLen + payload;
+  uint32_t sum = 6 + (tcpLen & 0xffff) + (tcpLen >> 16);
+  if ((ip[0] >> 4) == 4)
+    {
+      Put16 (ip + 2, l.hdrLen + payload);
+      Put16 (ip + 4, Get16 (ip + 4) + first);
+      Put16 (ip + 10, 0);
+      uint32_t ipSum = 0;
+      for (uint32_t i = 0; i < l.ipLen; i += 2)
+        {
+          ipSum += Get16 (ip + i);
+        }
+      while (ipSum >> 16)
+        {
+          ipSum = (ipSum & 0xffff) + (ipSum >> 16);
+        }
+      Put16 (ip + 10, ~ipSum);
+      for (uint32_t i = 12; i < 20; i += 2)
+        {
+          sum += Get16 (ip + i);
+        }
+    }
+  else
+    {
+      Put16 (ip + 4, tcpLen);
+      for (uint32_t i = 8; i < 40; i += 2)
+        {
+          sum += Get16 (ip + i);
+        }
+    }
+  uint32_t seq = (Get16 (tcp + 4) << 16 | Get16 (tcp + 6)) + offset;
+  Put16 (tcp + 4, seq >> 16);
+  Put16 (tcp + 6, seq);
+  uint32_t total = (len - VNET_HDR - l.hdrLen + l.mss - 1) / l.mss;
+  if (first + count < total)
+    {
+      tcp[13] &= ~0x09;         // FIN and PSH: last segment only
+    }
+  if (first > 0)
+    {
+      tcp[13] &= ~0x80;         // CWR: first segment only
+    }
+  // The offload expects the pseudo-header sum, not complemented
+  while (sum >> 16)
+    {
+      sum = (sum & 0xffff) + (sum >> 16);
+    }
+  Put16 (tcp + 16, sum);
+}
+
+static bool
+SetParam (EmuConfig &cfg, const std::string &name, const std::string &value)
+{
+  double v = std::atof (value.c_str ());
+  if (name == "tunA")
+    {
+      cfg.tunA = value;
+    }
+  else if (name == "tunB")
+    {
+      cfg.tunB = value;
+    }
+  else if (name == "aqm")
+    {
+      cfg.aqm = value;
+    }
+  else if (name == "bandwidth")
+    {
+      // Mbps, as in the scenario programs
+      cfg.bandwidth = v * 1e6;
+    }
+  else if (name == "queueLimit" || name == "QueueLimit")
+    {
+      cfg.queueLimit = v;
+    }
+  else if (name == "gso")
+    {
+      cfg.gso = v != 0;
+    }
+  else if (name == "interval")
+    {
+      cfg.interval = v;
+    }
+  else if (name == "duration")
+    {
+      cfg.duration = v;
+    }
+  else if (name == "out")
+    {
+      cfg.out = value;
+    }
+  else if (name == "A")
+    {
+      cfg.pi.a = v;
+    }
+  else if (name == "B")
+    {
+      cfg.pi.b = v;
+    }
+  else if (name == "W")
+    {
+      cfg.pi.w = v;
+    }
+  else if (name == "QueueRef")
+    {
+      cfg.pi.qRef = v;
+    }
+  else if (name == "Increment")
+    {
+      cfg.blue.increment = v;
+    }
+  else if (name == "Decrement")
+    {
+      cfg.blue.decrement = v;
+    }
+  else if (name == "FreezeTime")
+    {
+      cfg.blue.freezeTime = v;
+    }
+  else if (name == "Rtt")
+    {
+      cfg.blue.rtt = v;
+    }
+  else if (name == "FreezeRttFactor")
+    {
+      cfg.blue.freezeRttFactor = v;
+    }
+  else if (name == "AdaptiveSteps")
+    {
+      cfg.blue.adaptiveSteps = v != 0;
+    }
+  else if (name == "MaxStepScale")
+    {
+      cfg.blue.maxStepScale = v;
+    }
+  else if (name == "TargetDelay")
+    {
+      cfg.blue.targetDelay = v;
+    }
+  else if (name == "FixedPoint")
+    {
+      cfg.pi.fixedPoint = v != 0;
+      cfg.blue.fixedPoint = v != 0;
+    }
+  else if (name == "AdaptiveSampling")
+    {
+      cfg.pi.adaptiveSampling = v != 0;
+    }
+  else if (name == "MinInterval")
+    {
+      cfg.pi.minInterval = v;
+    }
+  else if (name == "MaxInterval")
+    {
+      cfg.pi.maxInterval = v;
+    }
+  else if (name == "StableQueueDelta")
+    {
+      cfg.pi.stableQueueDelta = v;
+    }
+  else if (name == "MaxBurstAllowance")
+    {
+      cfg.pi.maxBurstAllowance = v;
+    }
+  else if (name == "LowWatermark")
+    {
+      cfg.pi.lowWatermark = v;
+    }
+  else if (name == "IdleDecay")
+    {
+      cfg.pi.idleDecay = v;
+    }
+  else if (name == "Controller")
+    {
+      cfg.pi.pid = value == "PID";
+    }
+  else if (name == "Kd")
+    {
+      cfg.pi.kd = v;
+    }
+  else if (name == "AntiWindup")
+    {
+      cfg.pi.antiWindup = value == "NONE" ? ANTI_WINDUP_NONE
+        : value == "BACK_CALCULATION" ? ANTI_WINDUP_BACK_CALCULATION : ANTI_WINDUP_CONDITIONAL;
+    }
+  else if (name == "TrackingTime")
+    {
+      cfg.pi.trackingTime = v;
+    }
+  else if (name == "MaxRate")
+    {
+      cfg.pi.maxRate = v;
+    }
+  else
+    {
+      return false;
+    }
+  return true;
+}
+
+/**
+ * Reads both devices: queues the packets of the first one, passes those
+ * of the second one back, and runs the controller
+ */
+static void
+Ingress (const EmuConfig *cfg, int fdA, int fdB, SpscRing<PacketSlot> *ring, SpscArena *arena,
+         EmuCounters *c)
+{
+  bool isPi = cfg->aqm == "pi";
+  PiController pi;
+  BlueController blue;
+  pi.SetParams (cfg->pi);
+  blue.SetParams (cfg->blue);
+  uint64_t start = NowNs ();
+  uint64_t nextUpdate = start + (uint64_t) (pi.GetInterval () * 1e9);
+  uint64_t lastDeparted = 0;
+  uint64_t lastIdle = 0;
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  uint32_t vnetLen = cfg->gso ? VNET_HDR : 0;
+  uint32_t readSize = cfg->gso ? MAX_PACKET : MAX_SEGMENT;
+  static uint8_t scratch[MAX_PACKET];
+  std::vector<bool> keep;
+
+  struct pollfd fds[2];
+  fds[0].fd = fdA;
+  fds[0].events = POLLIN;
+  fds[1].fd = fdB;
+  fds[1].events = POLLIN;
+
+  while (!g_stop.load (std::memory_order_relaxed))
+    {
+      // 1 ms timeout, so that the PI updates go on without packets
+      poll (fds, 2, 1);
+      uint64_t now = NowNs ();
+      if (isPi)
+        {
+          while (now >= nextUpdate)
+            {
+              pi.Update (c->queuedPackets.load (std::memory_order_relaxed)
+                         - c->outPackets.load (std::memory_order_relaxed));
+              nextUpdate += (uint64_t) (pi.GetInterval () * 1e9);
+            }
+          c->prob.store (pi.GetProbability (), std::memory_order_relaxed);
+        }
+
+      // Reverse direction, not shaped
+      for (uint32_t i = 0; i < 64; i++)
+        {
+          ssize_t n = read (fdB, scratch, readSize);
+          if (n <= 0 || write (fdA, scratch, n) < 0)
+            {
+              break;
+            }
+        }
+
+      // Forward direction: up to 256 reads per wakeup, each a GSO packet
+      // of up to 64 KB
+      for (uint32_t i = 0; i < 256; i++)
+        {
+          PacketSlot *slot = ring->Reserve ();
+          uint64_t pos = 0;
+          uint8_t *buf = slot ? arena->Reserve (readSize, pos) : 0;
+          if (!buf)
+            {
+              slot = 0;
+              buf = scratch;
+            }
+          ssize_t n = read (fdA, buf, readSize);
+          if (n <= (ssize_t) vnetLen)
+            {
+              break;
+            }
+          now = NowNs ();
+          PacketLayout l = ParsePacket (buf + vnetLen, n - vnetLen,
+                                        vnetLen ? (const VnetHeader *) buf : 0);
+          Bump (c->inPackets, l.segments);
+          Bump (c->inBytes, l.wireBytes);
+          double t = (now - start) * 1e-9;
+          uint64_t qlen = c->queuedPackets.load (std::memory_order_relaxed)
+            - c->outPackets.load (std::memory_order_relaxed);
+
+          double p;
+          if (isPi)
+            {
+              p = pi.GetProbability ();
+            }
+          else
+            {
+              // The egress thread saw the queue go empty since the last
+              // arrival: it was idle until this one
+              uint64_t idle = c->idleSince.load (std::memory_order_acquire);
+              if (idle != lastIdle)
+                {
+                  blue.QueueIdle ((idle - start) * 1e-9);
+                  lastIdle = idle;
+                }
+              // Dropped packets never reach the ring: count what was queued
+              uint64_t backlog = c->queuedBytes.load (std::memory_order_relaxed)
+                - c->outBytes.load (std::memory_order_relaxed);
+              blue.SetQueueDelay (backlog * 8.0 / cfg->bandwidth);
+              blue.QueueBusy (t);
+              // The departures happen on the egress thread: apply the
+              // delay-based update of the latest one with the next arrival
+              uint64_t departed = c->outPackets.load (std::memory_order_relaxed);
+              if (departed != lastDeparted)
+                {
+                  blue.Departure (t, c->lastSojournNs.load (std::memory_order_relaxed) * 1e-9);
+                  lastDeparted = departed;
+                }
+              p = blue.GetProbability ();
+            }
+
+          // The drop decision of every segment, as if they had come one
+          // by one; a packet that cannot be split is decided as a whole
+          uint32_t units = l.splittable ? l.segments : 1;
+          uint32_t unitSegments = l.splittable ? 1 : l.segments;
+          uint32_t kept = 0;
+          keep.assign (units, false);
+          for (uint32_t u = 0; u < units; u++)
+            {
+              if (!slot || qlen + kept + unitSegments > cfg->queueLimit)
+                {
+                  Bump (c->forcedDrops, unitSegments);
+                  if (!isPi)
+                    {
+                      blue.Increment (t);
+                    }
+                  continue;
+                }
+              rng ^= rng >> 12;
+              rng ^= rng << 25;
+              rng ^= rng >> 27;
+              bool earlyDrop;
+              if (cfg->pi.fixedPoint)
+                {
+                  uint32_t r = (uint32_t) ((rng * 0x2545f4914f6cdd1dULL) >> 32);
+                  earlyDrop = AqmFixedDrop (r, isPi ? pi.GetThreshold () : blue.GetThreshold ());
+                }
+              else
+                {
+                  double r = ((rng * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+                  earlyDrop = p > 0 && r <= p;
+                }
+              if (isPi && !pi.AllowEarlyDrop (qlen + kept))
+                {
+                  earlyDrop = false;
+                }
+              if (earlyDrop)
+                {
+                  Bump (c->earlyDrops, unitSegments);
+                  if (!isPi)
+                    {
+                      blue.Increment (t);
+                      p = blue.GetProbability ();
+                    }
+                  continue;
+                }
+              keep[u] = true;
+              kept += unitSegments;
+            }
+
+          if (kept == l.segments)
+            {
+              slot->arrival = now;
+              slot->pos = pos;
+              slot->len = n;
+              slot->segments = l.segments;
+              slot->wireBytes = l.wireBytes;
+              Bump (c->queuedPackets, l.segments);
+              Bump (c->queuedBytes, l.wireBytes);
+              arena->Commit (pos + n);
+              ring->Commit ();
+            }
+          else if (kept > 0)
+            {
+              // Queue the runs of kept segments, each a packet of its own
+              std::memcpy (scratch, buf, n);
+              for (uint32_t first = 0; first < units; )
+                {
+                  if (!keep[first])
+                    {
+                      first++;
+                      continue;
+                    }
+                  uint32_t end = first;
+                  while (end < units && keep[end])
+                    {
+                      end++;
+                    }
+                  PacketSlot *run = ring->Reserve ();
+                  uint8_t *dst = run ? arena->Reserve (VNET_HDR + l.hdrLen + (end - first) * l.mss, pos) : 0;
+                  if (!dst)
+                    {
+                      Bump (c->forcedDrops, end - first);
+                      first = end;
+                      continue;
+                    }
+                  CopySegments (scratch, n, l, first, end - first, dst, run);
+                  run->arrival = now;
+                  run->pos = pos;
+                  Bump (c->queuedPackets, run->segments);
+                  Bump (c->queuedBytes, run->wireBytes);
+                  arena->Commit (pos + run->len);
+                  ring->Commit ();
+                  first = end;
+                }
+            }
+          if (!isPi)
+            {
+              c->prob.store (blue.GetProbability (), std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+/**
+ * Sends the queued packets at the link rate
+ */
+static void
+Egress (const EmuConfig *cfg, int fdB, SpscRing<PacketSlot> *ring, SpscArena *arena, EmuCounters *c)
+{
+  double nsPerByte = 8e9 / cfg->bandwidth;
+  uint64_t nextTx = 0;
+  // Wake up from nanosleep as precisely as the kernel can
+  prctl (PR_SET_TIMERSLACK, 1);
+
+  while (!g_stop.load (std::memory_order_relaxed))
+    {
+      PacketSlot *slot = ring->Front ();
+      uint64_t now = NowNs ();
+      if (!slot)
+        {
+          struct timespec ts = { 0, 20000 };
+          nanosleep (&ts, 0);
+          continue;
+        }
+      if (now < nextTx)
+        {
+          // Sleep for long waits, spin for the last few microseconds,
+          // yielding to the TCP stacks if they share the core
+          if (nextTx - now > 60000)
+            {
+              struct timespec ts = { 0, (long) (nextTx - now - 50000) };
+              nanosleep (&ts, 0);
+            }
+          else
+            {
+              sched_yield ();
+            }
+          continue;
+        }
+
+      uint64_t txStart = now;
+      if (write (fdB, arena->Get (slot->pos), slot->len) < 0 && errno != EAGAIN)
+        {
+          std::cerr << "write to " << cfg->tunB << ": " << std::strerror (errno) << std::endl;
+        }
+      // The link is busy from the end of the previous packet or from the
+      // arrival of this one, whichever is later; late wakeups are made up
+      // for with the next packets instead of lowering the rate. A GSO
+      // packet takes the time of all its segments, headers included
+      uint64_t base = nextTx > slot->arrival ? nextTx : slot->arrival;
+      nextTx = base + (uint64_t) (slot->wireBytes * nsPerByte);
+      Bump (c->sojournNs, (txStart - slot->arrival) * slot->segments);
+      c->lastSojournNs.store (txStart - slot->arrival, std::memory_order_relaxed);
+      Bump (c->outBytes, slot->wireBytes);
+      Bump (c->outPackets, slot->segments);
+      uint64_t end = slot->pos + slot->len;
+      ring->Release ();
+      arena->Release (end);
+      if (!ring->Front ())
+        {
+          // Nothing left that the ingress thread has published: the
+          // queue went idle as this packet started
+          c->idleSince.store (txStart, std::memory_order_release);
+        }
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  EmuConfig cfg;
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      std::string::size_type eq = arg.find ('=');
+      if (arg.compare (0, 2, "--") != 0 || eq == std::string::npos
+          || !SetParam (cfg, arg.substr (2, eq - 2), arg.substr (eq + 1)))
+        {
+          std::cerr << "usage: aqm-tunemu [--tunA=aqm0] [--tunB=aqm1] [--aqm=pi|blue] [--bandwidth=<Mbps>] "
+                    << "[--QueueLimit=<packets>] [--gso=0|1] [--interval=<s>] [--duration=<s>] [--out=<prefix>] "
+                    << "[--<attribute>=<value> ...]" << std::endl;
+          return 2;
+        }
+    }
+  if (cfg.aqm != "pi" && cfg.aqm != "blue")
+    {
+      std::cerr << "--aqm must be pi or blue" << std::endl;
+      return 2;
+    }
+
+  int fdA = OpenTun (cfg.tunA, cfg.gso);
+  int fdB = OpenTun (cfg.tunB, cfg.gso);
+  if (fdA < 0 || fdB < 0)
+    {
+      std::cerr << "cannot create the TUN devices: " << std::strerror (errno)
+                << (cfg.gso ? " (try --gso=0)" : "") << std::endl;
+      return 1;
+    }
+  signal (SIGINT, HandleSignal);
+  signal (SIGTERM, HandleSignal);
+
+  // Every slot holds at least one of the QueueLimit packets, and the
+  // packets of the slots take at most MAX_SEGMENT bytes per packet on
+  // the link, plus the space left at the end when the arena wraps
+  SpscRing<PacketSlot> ring (cfg.queueLimit + 1);
+  uint32_t readSize = cfg.gso ? MAX_PACKET : MAX_SEGMENT;
+  SpscArena arena ((size_t) cfg.queueLimit * (MAX_SEGMENT + VNET_HDR) + 2 * readSize);
+  EmuCounters c;
+  std::cerr << "queueing " << cfg.tunA << " -> " << cfg.tunB << " at " << cfg.bandwidth / 1e6
+            << " Mbps with " << cfg.aqm << ", limit " << cfg.queueLimit << " packets"
+            << (cfg.gso ? ", GSO" : "") << std::endl;
+  std::thread ingress (Ingress, &cfg, fdA, fdB, &ring, &arena, &c);
+  std::thread egress (Egress, &cfg, fdB, &ring, &arena, &c);
+
+  std::ofstream queueFile, probFile;
+  if (!cfg.out.empty ())
+    {
+      queueFile.open ((cfg.out + "-queue.plotme").c_str ());
+      probFile.open ((cfg.out + "-prob.plotme").c_str ());
+    }
+  std::cout << "time\tinMbps\toutMbps\tqueue\tforced\tearly\tprob\tsojournMs" << std::endl;
+  uint64_t start = NowNs ();
+  uint64_t lastIn = 0, lastOut = 0, lastPackets = 0, lastSojourn = 0;
+  while (!g_stop.load ())
+    {
+      struct timespec ts = { (time_t) cfg.interval, (long) ((cfg.interval - (time_t) cfg.interval) * 1e9) };
+      nanosleep (&ts, 0);
+      double t = (NowNs () - start) * 1e-9;
+      uint64_t in = c.inBytes.load (), out = c.outBytes.load ();
+      uint64_t packets = c.outPackets.load (), sojourn = c.sojournNs.load ();
+      uint64_t queue = c.queuedPackets.load () - packets;
+      double prob = c.prob.load ();
+      std::cout << t << "\t" << (in - lastIn) * 8 / cfg.interval / 1e6
+                << "\t" << (out - lastOut) * 8 / cfg.interval / 1e6
+                << "\t" << queue << "\t" << c.forcedDrops.load () << "\t" << c.earlyDrops.load ()
+                << "\t" << prob << "\t"
+                << (packets > lastPackets ? (sojourn - lastSojourn) / 1e6 / (packets - lastPackets) : 0)
+                << std::endl;
+      if (queueFile.is_open ())
+        {
+          queueFile << t << " " << queue << std::endl;
+          probFile << t << " " << prob << std::endl;
+        }
+      lastIn = in;
+      lastOut = out;
+      lastPackets = packets;
+      lastSojourn = sojourn;
+      if (cfg.duration > 0 && t >= cfg.duration)
+        {
+          g_stop.store (true);
+        }
+    }
+
+  ingress.join ();
+  egress.join ();
+  uint64_t inPackets = c.inPackets.load ();
+  double elapsed = (NowNs () - start) * 1e-9;
+  std::cout << "summary dropRate "
+            << (inPackets ? (double) (c.forcedDrops.load () + c.earlyDrops.load ()) / inPackets : 0) << std::endl
+            << "summary throughput " << c.outBytes.load () * 8 / elapsed / 1e6 << std::endl
+            << "summary meanSojourn "
+            << (c.outPackets.load () ? c.sojournNs.load () / 1e9 / c.outPackets.load () : 0) << std::endl;
+  close (fdA);
+  close (fdB);
+  return 0;
+}
@@ -0,0 +1,238 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 NITK Surathkal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace aqm {
+
+/**
+ * \brief Lock-free ring between one producer and one consumer thread
+ *
+ * The slots are preallocated and filled in place: the producer gets a
+ * free slot with Reserve and publishes it with Commit, the consumer gets
+ * the oldest published slot with Front and frees it with Release. Each
+ * side keeps a cached copy of the other side's index and only reloads it
+ * (one shared cache line) when the ring looks full or empty, so a burst
+ * costs one cross-core transfer rather than one per packet.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+  /**
+   * \param capacity Minimum number of slots, rounded up to a power of two
+   */
+  explicit SpscRing (size_t capacity)
+    : m_head (0),
+      m_cachedTail (0),
+      m_tail (0),
+      m_cachedHead (0)
+  {
+    size_t n = 1;
+    while (n < capacity)
+      {
+        n <<= 1;
+      }
+    m_slots.resize (n);
+    m_mask = n - 1;
+  }
+
+  size_t GetCapacity (void) const
+  {
+    return m_slots.size ();
+  }
+
+  /**
+   * \brief Producer: the next free slot
+   * \returns The slot, or 0 if the ring is full
+   */
+  T * Reserve (void)
+  {
+    size_t head = m_head.load (std::memory_order_relaxed);
+    if (head - m_cachedTail == m_slots.size ())
+      {
+        m_cachedTail = m_tail.load (std::memory_order_acquire);
+        if (head - m_cachedTail == m_slots.size ())
+          {
+            return 0;
+          }
+      }
+    return &m_slots[head & m_mask];
+  }
+
+  /**
+   * \brief Producer: publish the slot returned by Reserve
+   */
+  void Commit (void)
+  {
+    m_head.store (m_head.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /**
+   * \brief Consumer: the oldest published slot
+   * \returns The slot, or 0 if the ring is empty
+   */
+  T * Front (void)
+  {
+    size_t tail = m_tail.load (std::memory_order_relaxed);
+    if (tail == m_cachedHead)
+      {
+        m_cachedHead = m_head.load (std::memory_order_acquire);
+        if (tail == m_cachedHead)
+          {
+            return 0;
+          }
+      }
+    return &m_slots[tail & m_mask];
+  }
+
+  /**
+   * \brief Consumer: free the slot returned by Front
+   */
+  void Release (void)
+  {
+    m_tail.store (m_tail.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /**
+   * \returns The number of published slots; exact on either side for the
+   * slots that side has not yet handed over
+   */
+  size_t GetSize (void) const
+  {
+    return m_head.load (std::memory_order_acquire) - m_tail.load (std::memory_order_acquire);
+  }
+
+private:
+  std::vector<T> m_slots;
+  size_t m_mask;
+
+  // Producer side
+  alignas (64) std::atomic<size_t> m_head;
+  size_t m_cachedTail;
+
+  // Consumer side
+  alignas (64) std::atomic<size_t> m_tail;
+  size_t m_cachedHead;
+};
+
+/**
+ * \brief Buffer space for records of any length, handed from one
+ * producer to one consumer in order
+ *
+ * Goes with an SpscRing of descriptors that carry the position of each
+ * record: the producer takes contiguous space with Reserve (skipping the
+ * end of the buffer if the record would not fit there), writes the
+ * record and advances with Commit before it publishes the descriptor;
+ * the consumer frees everything up to the end of a record with Release.
+ * Positions count bytes from the start and never wrap.
+ */
+class SpscArena
+{
+public:
+  /**
+   * \param size Bytes of buffer space
+   */
+  explicit SpscArena (size_t size)
+    : m_data (new uint8_t[size]),
+      m_size (size),
+      m_head (0),
+      m_cachedTail (0),
+      m_tail (0)
+  {
+  }
+
+  ~SpscArena ()
+  {
+    delete [] m_data;
+  }
+
+  /**
+   * \brief Producer: contiguous space for a record
+   * \param need Bytes the record may take
+   * \param pos Set to the position of the record
+   * \returns The space, or 0 if there is not enough free
+   */
+  uint8_t * Reserve (size_t need, uint64_t &pos)
+  {
+    uint64_t start = m_head;
+    size_t offset = start % m_size;
+    if (offset + need > m_size)
+      {
+        start += m_size - offset;
+      }
+    if (start + need - m_cachedTail > m_size)
+      {
+        m_cachedTail = m_tail.load (std::memory_order_acquire);
+        if (start + need - m_cachedTail > m_size)
+          {
+            return 0;
+          }
+      }
+    pos = start;
+    return m_data + start % m_size;
+  }
+
+  /**
+   * \brief Producer: the record written at the space of Reserve ends here
+   */
+  void Commit (uint64_t end)
+  {
+    m_head = end;
+  }
+
+  /**
+   * \brief Consumer: the record at a position
+   */
+  const uint8_t * Get (uint64_t pos) const
+  {
+    return m_data + pos % m_size;
+  }
+
+  /**
+   * \brief Consumer: free the space up to the end of a record
+   */
+  void Release (uint64_t end)
+  {
+    m_tail.store (end, std::memory_order_release);
+  }
+
+private:
+  SpscArena (const SpscArena &);
+  SpscArena & operator = (const SpscArena &);
+
+  uint8_t *m_data;
+  size_t m_size;
+
+  // Producer side
+  uint64_t m_head;
+  uint64_t m_cachedTail;
+
+  // Consumer side
+  alignas (64) std::atomic<uint64_t> m_tail;
+};
+
+} // namespace aqm
+
+#endif // SPSC_RING_H